@@ -9,6 +9,7 @@
 #include "disc.h"
 #include "disc_drive.h"
 #include "intel_fdc.h"
+#include "interp.h"
 #include "joystick.h"
 #include "keyboard.h"
 #include "log.h"
@@ -16,6 +17,7 @@
 #include "memory_access.h"
 #include "os_alloc.h"
 #include "os_channel.h"
+#include "os_fault.h"
 #include "os_thread.h"
 #include "os_time.h"
 #include "render.h"
@@ -25,6 +27,7 @@
 #include "tape.h"
 #include "teletext.h"
 #include "timing.h"
+#include "tube.h"
 #include "util.h"
 #include "via.h"
 #include "video.h"
@@ -37,7 +40,10 @@
 #include "asm/asm_util.h"
 
 #include <assert.h>
+#include <ctype.h>
 #include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static const size_t k_bbc_os_rom_offset = 0xC000;
@@ -95,6 +101,61 @@ enum {
   k_acccon_hazel = 0x08,
 };
 
+enum {
+  k_bbc_max_forks = 64,
+};
+
+enum {
+  k_bbc_lockstep_continue = 1,
+  k_bbc_lockstep_stop = 2,
+  k_bbc_lockstep_max_diffs = 32,
+};
+
+/* Sent by the lockstep peer at every check. The processes run the same
+ * binary, so the raw struct is fine on the wire.
+ */
+struct bbc_lockstep_record {
+  uint64_t ticks;
+  uint64_t hw_reg_hits;
+  uint64_t hw_reg_hash;
+  uint64_t mem_hash;
+  uint16_t pc;
+  uint8_t a;
+  uint8_t x;
+  uint8_t y;
+  uint8_t s;
+  uint8_t flags;
+};
+
+enum {
+  /* Reads of $FE00-$FEFF first, then writes. */
+  k_bbc_hw_reg_stats_num = 512,
+  k_bbc_hw_reg_stats_num_pcs = 4,
+  k_bbc_hw_reg_stats_num_dumped = 16,
+  k_bbc_hw_reg_stats_dump_us = 10000000,
+};
+
+struct bbc_snapshot_page {
+  uint32_t refs;
+  uint8_t* p_data;
+};
+
+struct bbc_memory_snapshot {
+  uint32_t page_size;
+  uint32_t num_pages;
+  struct bbc_snapshot_page** p_pages;
+};
+
+struct bbc_hw_reg_stats {
+  uint64_t hits;
+  /* Heaviest calling PCs, tracked approximately with a "space saving" scheme
+   * so that a register hit from many places costs a fixed amount of memory.
+   */
+  uint64_t pc_hits[k_bbc_hw_reg_stats_num_pcs];
+  uint16_t pcs[k_bbc_hw_reg_stats_num_pcs];
+  int is_jit_inline;
+};
+
 struct bbc_struct {
   /* Fields referenced by JIT encoded callbacks. */
   struct timing_struct* p_timing;
@@ -205,15 +266,17 @@ struct bbc_struct {
   struct serial_ula_struct* p_serial_ula;
   struct tape_struct* p_tape;
   struct cmos_struct* p_cmos;
+  struct tube_struct* p_tube;
   struct cpu_driver* p_cpu_driver;
   struct debug_struct* p_debug;
 
   /* Timing support. */
   struct os_time_sleeper* p_sleeper;
   uint32_t timer_id_cycles;
-  uint32_t timer_id_stop_cycles;
+  int32_t timer_id_stop_cycles;
   int32_t timer_id_autoboot;
   int32_t timer_id_test_nmi;
+  int32_t timer_id_fork;
   uint32_t wakeup_rate;
   uint64_t cycles_per_run_fast;
   uint64_t cycles_per_run_normal;
@@ -231,8 +294,43 @@ struct bbc_struct {
   int log_speed;
   int log_timestamp;
   int log_hw_reg_hits;
+  /* Per-register histogram, only allocated with -log perf:regs. */
+  struct bbc_hw_reg_stats* p_hw_reg_stats;
+  uint64_t last_time_us_hw_reg_stats;
+
+  /* Process forks, one per set of held keys. -1 if not a forked child. */
+  char* p_fork_keys[k_bbc_max_forks];
+  uint32_t num_forks;
+  uint64_t fork_run_cycles;
+  int32_t fork_index;
+  int is_at_fork_point;
+
+  /* Lockstep checking against a forked peer with a different CPU driver. */
+  int is_lockstep;
+  int is_lockstep_checker;
+  int32_t timer_id_lockstep;
+  uint64_t lockstep_cycles;
+  intptr_t lockstep_handle_read;
+  intptr_t lockstep_handle_write;
+  uint64_t lockstep_hw_reg_hits;
+  uint64_t lockstep_hw_reg_hash;
+  int is_lockstep_diverged;
+
+  /* RAM snapshots. Once the first is taken, RAM is kept read-only in all the
+   * mappings and a write fault marks the host page dirty and unprotects it.
+   * Pages not dirtied since the last snapshot share its copy.
+   */
+  uint32_t snapshot_page_size;
+  uint32_t snapshot_num_pages;
+  uint8_t* p_snapshot_dirty;
+  struct bbc_snapshot_page** p_snapshot_last_pages;
 };
 
+/* The fault handler needs to find the machine. There's only ever one per
+ * process because of the fixed address space mappings.
+ */
+static struct bbc_struct* s_p_snapshot_bbc;
+
 static int
 bbc_is_always_ram_address(void* p, uint16_t addr) {
   (void) p;
@@ -418,6 +516,135 @@ bbc_do_master_ram_write(struct bbc_struct* p_bbc,
   }
 }
 
+static void
+bbc_hw_reg_stats_hit(struct bbc_struct* p_bbc,
+                     uint16_t addr,
+                     uint16_t pc,
+                     int is_write) {
+  struct bbc_hw_reg_stats* p_stats;
+  uint32_t i;
+  uint32_t min_index;
+
+  if ((addr & 0xFF00) != 0xFE00) {
+    return;
+  }
+  p_stats = &p_bbc->p_hw_reg_stats[(is_write * 256) + (addr & 0xFF)];
+  p_stats->hits++;
+
+  min_index = 0;
+  for (i = 0; i < k_bbc_hw_reg_stats_num_pcs; ++i) {
+    if ((p_stats->pcs[i] == pc) && (p_stats->pc_hits[i] > 0)) {
+      p_stats->pc_hits[i]++;
+      return;
+    }
+    if (p_stats->pc_hits[i] < p_stats->pc_hits[min_index]) {
+      min_index = i;
+    }
+  }
+  /* Evict the lightest PC. The newcomer inherits its count, which keeps any
+   * PC hit more than hits / num_pcs times in the table.
+   */
+  p_stats->pcs[min_index] = pc;
+  p_stats->pc_hits[min_index]++;
+}
+
+static inline uint64_t
+bbc_lockstep_hash_mix(uint64_t hash, uint64_t val) {
+  /* Not cryptographic, or even a great hash, but cheap enough to run on every
+   * register access and over all of memory at every check.
+   */
+  hash = ((hash ^ val) * 0x9E3779B97F4A7C15ull);
+  return (hash ^ (hash >> 29));
+}
+
+static void
+bbc_lockstep_hw_reg_hit(struct bbc_struct* p_bbc,
+                        uint16_t addr,
+                        uint8_t val,
+                        int is_write,
+                        uint64_t cycles) {
+  /* Reads fold in just the address and time; the value read follows from
+   * the device state, which the writes and timing already pin down.
+   */
+  uint64_t hash = p_bbc->lockstep_hw_reg_hash;
+
+  /* Writes to ROM above the registers come through here for some CPU drivers
+   * but not others.
+   */
+  if ((addr < k_addr_fred) || (addr > k_addr_shiela_end)) {
+    return;
+  }
+  p_bbc->lockstep_hw_reg_hits++;
+  hash = bbc_lockstep_hash_mix(hash, cycles);
+  hash = bbc_lockstep_hash_mix(hash,
+                               (addr | (val << 16) | (is_write << 24)));
+  p_bbc->lockstep_hw_reg_hash = hash;
+}
+
+static void
+bbc_do_log_hw_reg_stats(struct bbc_struct* p_bbc) {
+  uint32_t i;
+  uint32_t j;
+  uint32_t num_dumped;
+  uint8_t is_dumped[k_bbc_hw_reg_stats_num];
+
+  struct bbc_hw_reg_stats* p_all_stats = p_bbc->p_hw_reg_stats;
+
+  (void) memset(is_dumped, '\0', sizeof(is_dumped));
+
+  log_do_log(k_log_perf,
+             k_log_info,
+             "hw registers, top %d by hits (%"PRIu64" total):",
+             k_bbc_hw_reg_stats_num_dumped,
+             p_bbc->num_hw_reg_hits);
+
+  for (num_dumped = 0;
+       num_dumped < k_bbc_hw_reg_stats_num_dumped;
+       ++num_dumped) {
+    char pcs_str[128];
+    size_t pcs_len;
+    struct bbc_hw_reg_stats* p_stats;
+    uint32_t max_index = 0;
+    uint64_t max_hits = 0;
+
+    for (i = 0; i < k_bbc_hw_reg_stats_num; ++i) {
+      if (!is_dumped[i] && (p_all_stats[i].hits > max_hits)) {
+        max_index = i;
+        max_hits = p_all_stats[i].hits;
+      }
+    }
+    if (max_hits == 0) {
+      break;
+    }
+    is_dumped[max_index] = 1;
+    p_stats = &p_all_stats[max_index];
+
+    pcs_str[0] = '\0';
+    pcs_len = 0;
+    for (j = 0; j < k_bbc_hw_reg_stats_num_pcs; ++j) {
+      if (p_stats->pc_hits[j] == 0) {
+        continue;
+      }
+      (void) snprintf((pcs_str + pcs_len),
+                      (sizeof(pcs_str) - pcs_len),
+                      " $%.4"PRIX16"=%"PRIu64,
+                      p_stats->pcs[j],
+                      p_stats->pc_hits[j]);
+      pcs_len = strlen(pcs_str);
+    }
+
+    /* A JIT inline register would normally skip the callback. */
+    log_do_log(k_log_perf,
+               k_log_info,
+               "  $FE%.2X %s %s: %"PRIu64" hits, PCs%s",
+               (max_index & 0xFF),
+               ((max_index & 0x100) ? "write" : "read "),
+               (p_stats->is_jit_inline ? "jit" : "cb "),
+               p_stats->hits,
+               pcs_str);
+  }
+}
+
 uint8_t
 bbc_read_callback(void* p,
                   uint16_t addr,
@@ -453,6 +680,12 @@ bbc_read_callback(void* p,
 
   ret = 0xFE;
   p_bbc->num_hw_reg_hits++;
+  if (p_bbc->p_hw_reg_stats != NULL) {
+    bbc_hw_reg_stats_hit(p_bbc, addr, pc, 0);
+  }
+  if (p_bbc->is_lockstep) {
+    bbc_lockstep_hw_reg_hit(p_bbc, addr, 0, 0, cycles);
+  }
 
   switch (addr & ~3) {
   case (k_addr_crtc + 0):
@@ -623,8 +856,10 @@ bbc_read_callback(void* p,
       default:
         break;
       }
+    } else if (p_bbc->p_tube != NULL) {
+      ret = tube_host_read(p_bbc->p_tube, (addr & 7));
     }
-    /* Not present. */
+    /* Otherwise, not present. */
     break;
   default:
     assert(addr >= (k_bbc_os_rom_offset - 0x100));
@@ -686,55 +921,18 @@ bbc_get_effective_bank(struct bbc_struct* p_bbc, uint8_t romsel) {
 }
 
 static void
-bbc_page_rom(struct bbc_struct* p_bbc,
-             uint8_t effective_curr_bank,
-             uint8_t effective_new_bank,
-             uint8_t* p_sideways_old,
-             uint8_t* p_sideways_new) {
-  size_t map_size;
-  size_t half_map_size;
-  size_t map_offset;
-
-  struct cpu_driver* p_cpu_driver = p_bbc->p_cpu_driver;
-  int curr_is_ram = p_bbc->is_sideways_ram_bank[effective_curr_bank];
-  int new_is_ram = p_bbc->is_sideways_ram_bank[effective_new_bank];
-  uint8_t* p_mem_sideways = (p_bbc->p_mem_raw + k_bbc_sideways_offset);
-  intptr_t mem_handle = p_bbc->mem_handle;
-
-  /* If current bank is RAM, save it. */
-  if (curr_is_ram) {
-    (void) memcpy(p_sideways_old, p_mem_sideways, k_bbc_rom_size);
-  }
-
-  (void) memcpy(p_mem_sideways, p_sideways_new, k_bbc_rom_size);
-
-  /* The BBC Master mode does not support JIT (so no invalidate required).
-   * The BBC Master has all sorts of pageable regions, and the virtual memory
-   * tricks possible with the model B's clean RAM / sideways / OS ROM split
-   * are not possible.
-   */
-  if (p_bbc->is_master) {
-    return;
-  }
-
-  p_cpu_driver->p_funcs->memory_range_invalidate(p_cpu_driver,
-                                                 k_bbc_sideways_offset,
-                                                 k_bbc_rom_size);
-
-  if (curr_is_ram == new_is_ram) {
-    return;
-  }
-
-  /* We flipped from ROM to RAM or visa versa, we need to update the write
-   * mapping with either a dummy area (ROM) or the real sideways area (RAM).
+bbc_map_sideways_writes(struct bbc_struct* p_bbc, int is_ram) {
+  /* The write mapping for $8000 - $FFFF is either a dummy area (ROM) or the
+   * real sideways area (RAM).
    */
-  map_size = (k_6502_addr_space_size * 2);
-  half_map_size = (map_size / 2);
-  map_offset = (k_6502_addr_space_size / 2);
+  size_t map_size = (k_6502_addr_space_size * 2);
+  size_t half_map_size = (map_size / 2);
+  size_t map_offset = (k_6502_addr_space_size / 2);
+  intptr_t mem_handle = p_bbc->mem_handle;
 
   os_alloc_free_mapping(p_bbc->p_mapping_write_2);
 
-  if (new_is_ram) {
+  if (is_ram) {
     p_bbc->p_mapping_write_2 = os_alloc_get_mapping_from_handle(
         mem_handle,
         (void*) (size_t) (K_BBC_MEM_WRITE_FULL_ADDR + map_offset),
@@ -756,7 +954,7 @@ bbc_page_rom(struct bbc_struct* p_bbc,
 
   os_alloc_free_mapping(p_bbc->p_mapping_write_ind_2);
 
-  if (new_is_ram) {
+  if (is_ram) {
     p_bbc->p_mapping_write_ind_2 = os_alloc_get_mapping_from_handle(
         mem_handle,
         (void*) (size_t) (K_BBC_MEM_WRITE_IND_ADDR + map_offset),
@@ -778,6 +976,45 @@ bbc_page_rom(struct bbc_struct* p_bbc,
       map_offset);
 }
 
+static void
+bbc_page_rom(struct bbc_struct* p_bbc,
+             uint8_t effective_curr_bank,
+             uint8_t effective_new_bank,
+             uint8_t* p_sideways_old,
+             uint8_t* p_sideways_new) {
+  struct cpu_driver* p_cpu_driver = p_bbc->p_cpu_driver;
+  int curr_is_ram = p_bbc->is_sideways_ram_bank[effective_curr_bank];
+  int new_is_ram = p_bbc->is_sideways_ram_bank[effective_new_bank];
+  uint8_t* p_mem_sideways = (p_bbc->p_mem_raw + k_bbc_sideways_offset);
+
+  /* If current bank is RAM, save it. */
+  if (curr_is_ram) {
+    (void) memcpy(p_sideways_old, p_mem_sideways, k_bbc_rom_size);
+  }
+
+  (void) memcpy(p_mem_sideways, p_sideways_new, k_bbc_rom_size);
+
+  /* The BBC Master mode does not support JIT (so no invalidate required).
+   * The BBC Master has all sorts of pageable regions, and the virtual memory
+   * tricks possible with the model B's clean RAM / sideways / OS ROM split
+   * are not possible.
+   */
+  if (p_bbc->is_master) {
+    return;
+  }
+
+  p_cpu_driver->p_funcs->memory_range_invalidate(p_cpu_driver,
+                                                 k_bbc_sideways_offset,
+                                                 k_bbc_rom_size);
+
+  if (curr_is_ram == new_is_ram) {
+    return;
+  }
+
+  /* We flipped from ROM to RAM or visa versa. */
+  bbc_map_sideways_writes(p_bbc, new_is_ram);
+}
+
 void
 bbc_sideways_select(struct bbc_struct* p_bbc, uint8_t val) {
   /* The broad approach here is: slower sideways bank switching in order to
@@ -1001,6 +1238,12 @@ bbc_write_callback(void* p,
   }
 
   p_bbc->num_hw_reg_hits++;
+  if (p_bbc->p_hw_reg_stats != NULL) {
+    bbc_hw_reg_stats_hit(p_bbc, addr, pc, 1);
+  }
+  if (p_bbc->is_lockstep) {
+    bbc_lockstep_hw_reg_hit(p_bbc, addr, val, 1, cycles);
+  }
 
   switch (addr & ~3) {
   case (k_addr_crtc + 0):
@@ -1012,6 +1255,8 @@ bbc_write_callback(void* p,
     break;
   case (k_addr_acia + 0):
   case (k_addr_acia + 4):
+    /* Tape bits already due must arrive under the old ACIA settings. */
+    tape_sync(p_bbc->p_tape);
     mc6850_write(p_bbc->p_serial, (addr & 0x1), val);
     break;
   case (k_addr_serial_ula + 0):
@@ -1205,6 +1450,8 @@ bbc_write_callback(void* p,
       default:
         break;
       }
+    } else if (p_bbc->p_tube != NULL) {
+      tube_host_write(p_bbc->p_tube, (addr & 7), val);
     } else {
       log_do_log_max_count(&p_bbc->log_count_misc_unimplemented,
                            k_log_misc,
@@ -1408,6 +1655,16 @@ bbc_get_read_jit_encoding(void* p,
     return 0;
   }
 
+  if (p_bbc->is_lockstep) {
+    /* The peer's CPU driver may not inline, so keep the traffic comparable. */
+    return 0;
+  }
+  if (p_bbc->p_hw_reg_stats != NULL) {
+    /* Route the access through the callback so it's counted. */
+    p_bbc->p_hw_reg_stats[addr_6502 & 0xFF].is_jit_inline = 1;
+    return 0;
+  }
+
   /* TODO: fetch these unseemly constants in a more graceful manner! */
   asm_make_uop1(p_uop, k_opcode_deref_context, 0x40078);
   p_uop++;
@@ -1628,6 +1885,14 @@ bbc_get_write_jit_encoding(void* p,
     returns_time = 1;
   }
 
+  if (p_bbc->is_lockstep) {
+    return 0;
+  }
+  if (p_bbc->p_hw_reg_stats != NULL) {
+    p_bbc->p_hw_reg_stats[256 + (addr_6502 & 0xFF)].is_jit_inline = 1;
+    return 0;
+  }
+
   /* TODO: fetch these unseemly constants in a more graceful manner! */
   asm_make_uop1(p_uop, k_opcode_deref_context, 0x40078);
   p_uop++;
@@ -1742,6 +2007,11 @@ bbc_framebuffer_ready_callback(void* p,
 
   struct bbc_struct* p_bbc = (struct bbc_struct*) p;
 
+  if (p_bbc->fork_index >= 0) {
+    /* A forked child has no main thread to paint for. */
+    return;
+  }
+
   if (!p_bbc->fast_flag) {
     do_wait_for_paint = 1;
   }
@@ -1772,6 +2042,9 @@ bbc_break_reset(struct bbc_struct* p_bbc) {
   } else {
     intel_fdc_break_reset(p_bbc->p_intel_fdc);
   }
+  if (p_bbc->p_tube != NULL) {
+    tube_reset(p_bbc->p_tube);
+  }
   state_6502_reset(p_bbc->p_state_6502);
 
   if (p_bbc->is_compat_old_1MHz_cycles) {
@@ -1810,6 +2083,7 @@ bbc_do_reset_callback(void* p, uint32_t flags) {
   }
   if (flags & k_cpu_flag_replay) {
     keyboard_rewind(p_bbc->p_keyboard, p_bbc->rewind_to_cycles);
+    debug_replay_rewound(p_bbc->p_debug);
   }
 
   p_cpu_driver->p_funcs->apply_flags(
@@ -1825,6 +2099,7 @@ bbc_set_fast_mode_callback(void* p, int is_fast) {
   void (*p_memory_written_callback)(void* p) = NULL;
 
   p_bbc->fast_flag = is_fast;
+  sound_set_fast_mode(p_bbc->p_sound, is_fast);
 
   /* In accurate mode, and when not running super fast, we use the interpreter
    * with a special callback to sync 6502 memory writes to the 6845 CRTC memory
@@ -1932,80 +2207,410 @@ bbc_setup_indirect_mappings(struct bbc_struct* p_bbc,
 }
 
 static void
-bbc_CA2_changed_callback(void* p, int level, int output) {
-  struct bbc_struct* p_bbc;
-  struct via_struct* p_user_via;
-  uint8_t val;
-
-  if (level || !output) {
-    return;
-  }
-
-  p_bbc = (struct bbc_struct*) p;
-
-  if (p_bbc->p_printer_file == NULL) {
-    p_bbc->p_printer_file = util_file_try_open("beebjit.printer", 1, 1);
-    if (p_bbc->p_printer_file == NULL) {
-      log_do_log(k_log_misc, k_log_error, "FAILED to create printer file");
-    } else {
-      log_do_log(k_log_misc, k_log_info, "created printer file");
-    }
-  }
-
-  p_user_via = p_bbc->p_user_via;
-  val = via_read_ORAnh(p_user_via);
-
-  if (p_bbc->p_printer_file != NULL) {
-    /* Replace CR with LF. */
-    if (val == 0x0D) {
-      val = 0x0A;
-    }
-    util_file_write(p_bbc->p_printer_file, &val, 1);
-  }
-
-  /* This is the world's fastest printer. It acks the character simultaneously
-   * with it being transmitted!
-   */
-  via_set_CA1(p_user_via, 0);
-  via_set_CA1(p_user_via, 1);
-}
-
-struct bbc_struct*
-bbc_create(int mode,
-           int is_master,
-           int has_sideways_ram,
-           uint8_t* p_os_rom,
-           int wd_1770_type,
-           int debug_flag,
-           int run_flag,
-           int print_flag,
-           int fast_flag,
-           int accurate_flag,
-           int fasttape_flag,
-           int test_map_flag,
-           const char* p_opt_flags,
-           const char* p_log_flags) {
-  struct timing_struct* p_timing;
-  struct state_6502* p_state_6502;
-  struct debug_struct* p_debug;
-  uint32_t cpu_scale_factor;
+bbc_create_mappings(struct bbc_struct* p_bbc) {
   size_t map_size;
   size_t half_map_size;
   size_t map_offset;
   uint8_t* p_mem_raw;
-  uint8_t* p_os_start;
 
-  int externally_clocked_via = 1;
-  int externally_clocked_crtc = 1;
-  int externally_clocked_adc = 1;
-  int synchronous_sound = 0;
-  int is_65c12 = is_master;
+  /* We allocate 2 times the 6502 64k address space size. This is so we can
+   * place it in the middle of a 128k region and straddle a 64k boundary in the
+   * middle. We need that for a satisfactory mappings setup on Windows, which
+   * only has 64k allocation resolution. This way, the stuff that is usually
+   * RAM is below the boundary and the stuff that is usually ROM is above the
+   * boundary, permitting a high performance setup.
+   */
+  map_size = (k_6502_addr_space_size * 2);
+  half_map_size = (map_size / 2);
+  map_offset = (k_6502_addr_space_size / 2);
+  p_bbc->mem_handle = os_alloc_get_memory_handle(map_size);
+  if (p_bbc->mem_handle < 0) {
+    util_bail("os_alloc_get_memory_handle failed");
+  }
 
-  struct bbc_struct* p_bbc = util_mallocz(sizeof(struct bbc_struct));
+  p_bbc->p_mapping_raw =
+      os_alloc_get_mapping_from_handle(
+          p_bbc->mem_handle,
+          (void*) (size_t) (K_BBC_MEM_RAW_ADDR - map_offset),
+          0,
+          map_size);
+  p_mem_raw =
+      ((uint8_t*) os_alloc_get_mapping_addr(p_bbc->p_mapping_raw) + map_offset);
+  p_bbc->p_mem_raw = p_mem_raw;
+  os_alloc_make_mapping_none((p_mem_raw - map_offset), map_offset);
+  os_alloc_make_mapping_none((p_mem_raw + k_6502_addr_space_size), map_offset);
 
-  p_bbc->wakeup_rate = k_bbc_default_wakeup_rate;
-  (void) util_get_u32_option(&p_bbc->wakeup_rate,
-                             p_opt_flags,
+  /* Runtime memory regions.
+   * The write regions differ from the read regions for 6502 ROM addresses.
+   * Writes to those in the writable region write to a dummy backing store to
+   * avoid a fault but also to avoid modifying 6502 ROM.
+   * The indirect regions are the same as the normal read / write regions
+   * except the page containing the hardware registers is marked inaccessible.
+   * This is used to enable a fast common case (no checks for hardware register
+   * access for indirect reads and writes) but work for the exceptional case
+   * via a fault + fixup.
+   */
+  if (asm_jit_uses_indirect_mappings()) {
+    bbc_setup_indirect_mappings(p_bbc, map_size, half_map_size, map_offset);
+  }
+
+  p_bbc->p_mapping_read =
+      os_alloc_get_mapping_from_handle(
+          p_bbc->mem_handle,
+          (void*) (size_t) (K_BBC_MEM_READ_FULL_ADDR - map_offset),
+          0,
+          map_size);
+  p_bbc->p_mem_read =
+      ((uint8_t*) os_alloc_get_mapping_addr(p_bbc->p_mapping_read) +
+       map_offset);
+  os_alloc_make_mapping_none((p_bbc->p_mem_read - map_offset), map_offset);
+  os_alloc_make_mapping_none((p_bbc->p_mem_read + k_6502_addr_space_size),
+                             map_offset);
+  /* TODO: we can widen what we make read-only? */
+  /* Make the ROM readonly in the read mapping used at runtime. */
+  os_alloc_make_mapping_read_only((p_bbc->p_mem_read + k_bbc_ram_size),
+                                  (k_6502_addr_space_size - k_bbc_ram_size));
+
+  p_bbc->p_mapping_write =
+      os_alloc_get_mapping_from_handle(
+          p_bbc->mem_handle,
+          (void*) (size_t) (K_BBC_MEM_WRITE_FULL_ADDR - map_offset),
+          0,
+          half_map_size);
+  /* Writeable dummy ROM region. */
+  p_bbc->p_mapping_write_2 =
+      os_alloc_get_mapping(
+          (void*) (size_t) (K_BBC_MEM_WRITE_FULL_ADDR + map_offset),
+          half_map_size);
+  p_bbc->p_mem_write =
+      ((uint8_t*) os_alloc_get_mapping_addr(p_bbc->p_mapping_write) +
+       map_offset);
+  os_alloc_make_mapping_none((p_bbc->p_mem_write - map_offset), map_offset);
+  os_alloc_make_mapping_none((p_bbc->p_mem_write + k_6502_addr_space_size),
+                             map_offset);
+}
+
+static void
+bbc_free_mappings(struct bbc_struct* p_bbc) {
+  os_alloc_free_mapping(p_bbc->p_mapping_raw);
+  os_alloc_free_mapping(p_bbc->p_mapping_read);
+  os_alloc_free_mapping(p_bbc->p_mapping_write);
+  os_alloc_free_mapping(p_bbc->p_mapping_write_2);
+  if (p_bbc->p_mapping_read_ind != NULL) {
+    os_alloc_free_mapping(p_bbc->p_mapping_read_ind);
+    os_alloc_free_mapping(p_bbc->p_mapping_write_ind);
+    os_alloc_free_mapping(p_bbc->p_mapping_write_ind_2);
+    p_bbc->p_mapping_read_ind = NULL;
+    p_bbc->p_mapping_write_ind = NULL;
+    p_bbc->p_mapping_write_ind_2 = NULL;
+  }
+  os_alloc_free_memory_handle(p_bbc->mem_handle);
+}
+
+static void
+bbc_snapshot_protect_range(struct bbc_struct* p_bbc,
+                           size_t offset,
+                           size_t len,
+                           int is_read_only) {
+  uint8_t* p_mems[5];
+  uint32_t num_mems = 0;
+  uint32_t i;
+
+  p_mems[num_mems++] = p_bbc->p_mem_raw;
+  p_mems[num_mems++] = p_bbc->p_mem_read;
+  p_mems[num_mems++] = p_bbc->p_mem_write;
+  if (p_bbc->p_mapping_read_ind != NULL) {
+    p_mems[num_mems++] = p_bbc->p_mem_read_ind;
+    p_mems[num_mems++] = p_bbc->p_mem_write_ind;
+  }
+
+  for (i = 0; i < num_mems; ++i) {
+    if (is_read_only) {
+      os_alloc_make_mapping_read_only((p_mems[i] + offset), len);
+    } else {
+      os_alloc_make_mapping_read_write((p_mems[i] + offset), len);
+    }
+  }
+}
+
+static int
+bbc_snapshot_access_fault(uintptr_t host_fault_addr) {
+  /* NOTE: called in the fault context, so no allocation or logging. */
+  struct bbc_struct* p_bbc = s_p_snapshot_bbc;
+  uint8_t* p_fault_addr = (uint8_t*) host_fault_addr;
+  uint8_t* p_mems[5];
+  uint32_t num_mems = 0;
+  uint32_t i;
+
+  if (p_bbc == NULL) {
+    return 0;
+  }
+
+  p_mems[num_mems++] = p_bbc->p_mem_raw;
+  p_mems[num_mems++] = p_bbc->p_mem_read;
+  p_mems[num_mems++] = p_bbc->p_mem_write;
+  if (p_bbc->p_mapping_read_ind != NULL) {
+    p_mems[num_mems++] = p_bbc->p_mem_read_ind;
+    p_mems[num_mems++] = p_bbc->p_mem_write_ind;
+  }
+
+  for (i = 0; i < num_mems; ++i) {
+    uint32_t page;
+    if ((p_fault_addr < p_mems[i]) ||
+        (p_fault_addr >= (p_mems[i] + k_bbc_ram_size))) {
+      continue;
+    }
+    page = ((p_fault_addr - p_mems[i]) / p_bbc->snapshot_page_size);
+    /* A page already marked dirty might be a racing fault from another
+     * thread; the unprotect has happened or is about to, so just retry.
+     */
+    if (!p_bbc->p_snapshot_dirty[page]) {
+      p_bbc->p_snapshot_dirty[page] = 1;
+      bbc_snapshot_protect_range(p_bbc,
+                                 (page * p_bbc->snapshot_page_size),
+                                 p_bbc->snapshot_page_size,
+                                 0);
+    }
+    return 1;
+  }
+
+  return 0;
+}
+
+static void
+bbc_snapshot_page_release(struct bbc_snapshot_page* p_page) {
+  if (p_page == NULL) {
+    return;
+  }
+  assert(p_page->refs > 0);
+  p_page->refs--;
+  if (p_page->refs == 0) {
+    util_free(p_page->p_data);
+    util_free(p_page);
+  }
+}
+
+static void
+bbc_snapshot_mark_all_dirty(struct bbc_struct* p_bbc) {
+  if (p_bbc->p_snapshot_dirty == NULL) {
+    return;
+  }
+  (void) memset(p_bbc->p_snapshot_dirty, 1, p_bbc->snapshot_num_pages);
+}
+
+static void
+bbc_snapshot_protect_clean(struct bbc_struct* p_bbc) {
+  bbc_snapshot_protect_range(p_bbc, 0, k_bbc_ram_size, 1);
+  (void) memset(p_bbc->p_snapshot_dirty, 0, p_bbc->snapshot_num_pages);
+}
+
+static void
+bbc_snapshot_init(struct bbc_struct* p_bbc) {
+  size_t page_size = os_alloc_get_page_size();
+  uint32_t num_pages;
+
+  if ((page_size > k_bbc_ram_size) || ((k_bbc_ram_size % page_size) != 0)) {
+    util_bail("host page size %zu unsuitable for snapshots", page_size);
+  }
+  if ((s_p_snapshot_bbc != NULL) && (s_p_snapshot_bbc != p_bbc)) {
+    util_bail("snapshots already tracking another machine");
+  }
+  num_pages = (k_bbc_ram_size / page_size);
+  p_bbc->snapshot_page_size = page_size;
+  p_bbc->snapshot_num_pages = num_pages;
+  p_bbc->p_snapshot_last_pages =
+      util_mallocz(num_pages * sizeof(struct bbc_snapshot_page*));
+  /* Everything starts dirty: there's no previous snapshot to share with. */
+  p_bbc->p_snapshot_dirty = util_malloc(num_pages);
+  bbc_snapshot_mark_all_dirty(p_bbc);
+
+  s_p_snapshot_bbc = p_bbc;
+  os_fault_register_access_handler(bbc_snapshot_access_fault);
+}
+
+static void
+bbc_snapshot_destroy(struct bbc_struct* p_bbc) {
+  uint32_t i;
+
+  if (p_bbc->p_snapshot_dirty == NULL) {
+    return;
+  }
+  for (i = 0; i < p_bbc->snapshot_num_pages; ++i) {
+    bbc_snapshot_page_release(p_bbc->p_snapshot_last_pages[i]);
+  }
+  util_free(p_bbc->p_snapshot_last_pages);
+  util_free(p_bbc->p_snapshot_dirty);
+  p_bbc->p_snapshot_dirty = NULL;
+  s_p_snapshot_bbc = NULL;
+}
+
+struct bbc_memory_snapshot*
+bbc_snapshot_memory(struct bbc_struct* p_bbc) {
+  struct bbc_memory_snapshot* p_snapshot;
+  uint32_t page_size;
+  uint32_t num_pages;
+  uint32_t i;
+
+  if (p_bbc->p_snapshot_dirty == NULL) {
+    bbc_snapshot_init(p_bbc);
+  }
+  page_size = p_bbc->snapshot_page_size;
+  num_pages = p_bbc->snapshot_num_pages;
+
+  p_snapshot = util_mallocz(sizeof(struct bbc_memory_snapshot));
+  p_snapshot->page_size = page_size;
+  p_snapshot->num_pages = num_pages;
+  p_snapshot->p_pages =
+      util_mallocz(num_pages * sizeof(struct bbc_snapshot_page*));
+
+  for (i = 0; i < num_pages; ++i) {
+    struct bbc_snapshot_page* p_page = p_bbc->p_snapshot_last_pages[i];
+    if (p_bbc->p_snapshot_dirty[i]) {
+      bbc_snapshot_page_release(p_page);
+      p_page = util_mallocz(sizeof(struct bbc_snapshot_page));
+      p_page->refs = 1;
+      p_page->p_data = util_malloc(page_size);
+      (void) memcpy(p_page->p_data,
+                    (p_bbc->p_mem_raw + (i * page_size)),
+                    page_size);
+      p_bbc->p_snapshot_last_pages[i] = p_page;
+    }
+    p_page->refs++;
+    p_snapshot->p_pages[i] = p_page;
+  }
+
+  bbc_snapshot_protect_clean(p_bbc);
+
+  return p_snapshot;
+}
+
+void
+bbc_restore_memory(struct bbc_struct* p_bbc,
+                   struct bbc_memory_snapshot* p_snapshot) {
+  struct cpu_driver* p_cpu_driver = p_bbc->p_cpu_driver;
+  uint32_t page_size = p_snapshot->page_size;
+  uint32_t i;
+
+  assert(p_bbc->p_snapshot_dirty != NULL);
+  assert(page_size == p_bbc->snapshot_page_size);
+
+  bbc_snapshot_protect_range(p_bbc, 0, k_bbc_ram_size, 0);
+  for (i = 0; i < p_snapshot->num_pages; ++i) {
+    struct bbc_snapshot_page* p_page = p_snapshot->p_pages[i];
+    /* Pages untouched since the snapshot they share with are still good. */
+    if (!p_bbc->p_snapshot_dirty[i] &&
+        (p_page == p_bbc->p_snapshot_last_pages[i])) {
+      continue;
+    }
+    (void) memcpy((p_bbc->p_mem_raw + (i * page_size)),
+                  p_page->p_data,
+                  page_size);
+    p_cpu_driver->p_funcs->memory_range_invalidate(p_cpu_driver,
+                                                   (i * page_size),
+                                                   page_size);
+    p_page->refs++;
+    bbc_snapshot_page_release(p_bbc->p_snapshot_last_pages[i]);
+    p_bbc->p_snapshot_last_pages[i] = p_page;
+  }
+
+  bbc_snapshot_protect_clean(p_bbc);
+}
+
+void
+bbc_free_memory_snapshot(struct bbc_memory_snapshot* p_snapshot) {
+  uint32_t i;
+
+  for (i = 0; i < p_snapshot->num_pages; ++i) {
+    bbc_snapshot_page_release(p_snapshot->p_pages[i]);
+  }
+  util_free(p_snapshot->p_pages);
+  util_free(p_snapshot);
+}
+
+void
+bbc_copy_memory_snapshot(struct bbc_memory_snapshot* p_snapshot,
+                         uint8_t* p_dest) {
+  uint32_t page_size = p_snapshot->page_size;
+  uint32_t i;
+
+  for (i = 0; i < p_snapshot->num_pages; ++i) {
+    (void) memcpy((p_dest + (i * page_size)),
+                  p_snapshot->p_pages[i]->p_data,
+                  page_size);
+  }
+}
+
+static void
+bbc_CA2_changed_callback(void* p, int level, int output) {
+  struct bbc_struct* p_bbc;
+  struct via_struct* p_user_via;
+  uint8_t val;
+
+  if (level || !output) {
+    return;
+  }
+
+  p_bbc = (struct bbc_struct*) p;
+
+  if (p_bbc->p_printer_file == NULL) {
+    p_bbc->p_printer_file = util_file_try_open("beebjit.printer", 1, 1);
+    if (p_bbc->p_printer_file == NULL) {
+      log_do_log(k_log_misc, k_log_error, "FAILED to create printer file");
+    } else {
+      log_do_log(k_log_misc, k_log_info, "created printer file");
+    }
+  }
+
+  p_user_via = p_bbc->p_user_via;
+  val = via_read_ORAnh(p_user_via);
+
+  if (p_bbc->p_printer_file != NULL) {
+    /* Replace CR with LF. */
+    if (val == 0x0D) {
+      val = 0x0A;
+    }
+    util_file_write(p_bbc->p_printer_file, &val, 1);
+  }
+
+  /* This is the world's fastest printer. It acks the character simultaneously
+   * with it being transmitted!
+   */
+  via_set_CA1(p_user_via, 0);
+  via_set_CA1(p_user_via, 1);
+}
+
+struct bbc_struct*
+bbc_create(int mode,
+           int is_master,
+           int has_sideways_ram,
+           uint8_t* p_os_rom,
+           int wd_1770_type,
+           int debug_flag,
+           int run_flag,
+           int print_flag,
+           int fast_flag,
+           int accurate_flag,
+           int fasttape_flag,
+           int test_map_flag,
+           const char* p_opt_flags,
+           const char* p_log_flags) {
+  struct timing_struct* p_timing;
+  struct state_6502* p_state_6502;
+  struct debug_struct* p_debug;
+  uint32_t cpu_scale_factor;
+  uint8_t* p_os_start;
+
+  int externally_clocked_via = 1;
+  int externally_clocked_crtc = 1;
+  int externally_clocked_adc = 1;
+  int synchronous_sound = 0;
+  int is_65c12 = is_master;
+
+  struct bbc_struct* p_bbc = util_mallocz(sizeof(struct bbc_struct));
+
+  p_bbc->wakeup_rate = k_bbc_default_wakeup_rate;
+  (void) util_get_u32_option(&p_bbc->wakeup_rate,
+                             p_opt_flags,
                              "bbc:wakeup-rate=");
   cpu_scale_factor = 1;
   (void) util_get_u32_option(&cpu_scale_factor,
@@ -2030,8 +2635,12 @@ bbc_create(int mode,
   p_bbc->handle_channel_write_bbc = -1;
   p_bbc->handle_channel_read_client = -1;
   p_bbc->handle_channel_write_client = -1;
+  p_bbc->timer_id_stop_cycles = -1;
   p_bbc->timer_id_autoboot = -1;
   p_bbc->timer_id_test_nmi = -1;
+  p_bbc->timer_id_fork = -1;
+  p_bbc->timer_id_lockstep = -1;
+  p_bbc->fork_index = -1;
 
   p_bbc->do_video_memory_sync = 1;
   if (util_has_option(p_opt_flags, "video:no-memory-sync")) {
@@ -2051,95 +2660,25 @@ bbc_create(int mode,
   p_bbc->log_speed = util_has_option(p_log_flags, "perf:speed");
   p_bbc->log_timestamp = util_has_option(p_log_flags, "perf:timestamp");
   p_bbc->log_hw_reg_hits = util_has_option(p_log_flags, "perf:hw");
+  if (util_has_option(p_log_flags, "perf:regs")) {
+    p_bbc->p_hw_reg_stats = util_mallocz(sizeof(struct bbc_hw_reg_stats) *
+                                         k_bbc_hw_reg_stats_num);
+  }
 
   p_bbc->p_bbc = p_bbc;
   p_bbc->p_bbc_write_romsel_func = bbc_write_romsel;
 
   bbc_reset_callback_baselines(p_bbc);
 
-  /* We allocate 2 times the 6502 64k address space size. This is so we can
-   * place it in the middle of a 128k region and straddle a 64k boundary in the
-   * middle. We need that for a satisfactory mappings setup on Windows, which
-   * only has 64k allocation resolution. This way, the stuff that is usually
-   * RAM is below the boundary and the stuff that is usually ROM is above the
-   * boundary, permitting a high performance setup.
-   */
-  map_size = (k_6502_addr_space_size * 2);
-  half_map_size = (map_size / 2);
-  map_offset = (k_6502_addr_space_size / 2);
-  p_bbc->mem_handle = os_alloc_get_memory_handle(map_size);
-  if (p_bbc->mem_handle < 0) {
-    util_bail("os_alloc_get_memory_handle failed");
-  }
+  bbc_create_mappings(p_bbc);
 
   p_bbc->log_count_shadow_speed = 16;
   p_bbc->log_count_misc_unimplemented = 32;
 
-  p_bbc->p_mapping_raw =
-      os_alloc_get_mapping_from_handle(
-          p_bbc->mem_handle,
-          (void*) (size_t) (K_BBC_MEM_RAW_ADDR - map_offset),
-          0,
-          map_size);
-  p_mem_raw =
-      ((uint8_t*) os_alloc_get_mapping_addr(p_bbc->p_mapping_raw) + map_offset);
-  p_bbc->p_mem_raw = p_mem_raw;
-  os_alloc_make_mapping_none((p_mem_raw - map_offset), map_offset);
-  os_alloc_make_mapping_none((p_mem_raw + k_6502_addr_space_size), map_offset);
-
   /* Copy in the OS ROM. */
-  p_os_start = (p_mem_raw + k_bbc_os_rom_offset);
+  p_os_start = (p_bbc->p_mem_raw + k_bbc_os_rom_offset);
   (void) memcpy(p_os_start, p_bbc->p_os_rom, k_bbc_rom_size);
 
-  /* Runtime memory regions.
-   * The write regions differ from the read regions for 6502 ROM addresses.
-   * Writes to those in the writable region write to a dummy backing store to
-   * avoid a fault but also to avoid modifying 6502 ROM.
-   * The indirect regions are the same as the normal read / write regions
-   * except the page containing the hardware registers is marked inaccessible.
-   * This is used to enable a fast common case (no checks for hardware register
-   * access for indirect reads and writes) but work for the exceptional case
-   * via a fault + fixup.
-   */
-  if (asm_jit_uses_indirect_mappings()) {
-    bbc_setup_indirect_mappings(p_bbc, map_size, half_map_size, map_offset);
-  }
-
-  p_bbc->p_mapping_read =
-      os_alloc_get_mapping_from_handle(
-          p_bbc->mem_handle,
-          (void*) (size_t) (K_BBC_MEM_READ_FULL_ADDR - map_offset),
-          0,
-          map_size);
-  p_bbc->p_mem_read =
-      ((uint8_t*) os_alloc_get_mapping_addr(p_bbc->p_mapping_read) +
-       map_offset);
-  os_alloc_make_mapping_none((p_bbc->p_mem_read - map_offset), map_offset);
-  os_alloc_make_mapping_none((p_bbc->p_mem_read + k_6502_addr_space_size),
-                             map_offset);
-  /* TODO: we can widen what we make read-only? */
-  /* Make the ROM readonly in the read mapping used at runtime. */
-  os_alloc_make_mapping_read_only((p_bbc->p_mem_read + k_bbc_ram_size),
-                                  (k_6502_addr_space_size - k_bbc_ram_size));
-
-  p_bbc->p_mapping_write =
-      os_alloc_get_mapping_from_handle(
-          p_bbc->mem_handle,
-          (void*) (size_t) (K_BBC_MEM_WRITE_FULL_ADDR - map_offset),
-          0,
-          half_map_size);
-  /* Writeable dummy ROM region. */
-  p_bbc->p_mapping_write_2 =
-      os_alloc_get_mapping(
-          (void*) (size_t) (K_BBC_MEM_WRITE_FULL_ADDR + map_offset),
-          half_map_size);
-  p_bbc->p_mem_write =
-      ((uint8_t*) os_alloc_get_mapping_addr(p_bbc->p_mapping_write) +
-       map_offset);
-  os_alloc_make_mapping_none((p_bbc->p_mem_write - map_offset), map_offset);
-  os_alloc_make_mapping_none((p_bbc->p_mem_write + k_6502_addr_space_size),
-                             map_offset);
-
   p_bbc->p_mem_sideways = util_mallocz(k_bbc_rom_size * k_bbc_num_roms);
 
   /* Special memory chunks on a Master. */
@@ -2324,6 +2863,7 @@ bbc_create(int mode,
 
 void
 bbc_destroy(struct bbc_struct* p_bbc) {
+  uint32_t i;
   struct cpu_driver* p_cpu_driver = p_bbc->p_cpu_driver;
   volatile int* p_running = &p_bbc->running;
   volatile int* p_thread_allocated = &p_bbc->thread_allocated;
@@ -2335,12 +2875,20 @@ bbc_destroy(struct bbc_struct* p_bbc) {
     util_file_close(p_bbc->p_printer_file);
   }
 
+  if (p_bbc->p_hw_reg_stats != NULL) {
+    bbc_do_log_hw_reg_stats(p_bbc);
+    util_free(p_bbc->p_hw_reg_stats);
+  }
+
   if (*p_thread_allocated) {
     (void) os_thread_destroy(p_bbc->p_thread_cpu);
   }
 
   p_cpu_driver->p_funcs->destroy(p_cpu_driver);
 
+  if (p_bbc->p_tube != NULL) {
+    tube_destroy(p_bbc->p_tube);
+  }
   debug_destroy(p_bbc->p_debug);
   serial_ula_destroy(p_bbc->p_serial_ula);
   mc6850_destroy(p_bbc->p_serial);
@@ -2367,19 +2915,14 @@ bbc_destroy(struct bbc_struct* p_bbc) {
   disc_drive_destroy(p_bbc->p_drive_1);
   state_6502_destroy(p_bbc->p_state_6502);
   timing_destroy(p_bbc->p_timing);
-  os_alloc_free_mapping(p_bbc->p_mapping_raw);
-  os_alloc_free_mapping(p_bbc->p_mapping_read);
-  os_alloc_free_mapping(p_bbc->p_mapping_write);
-  os_alloc_free_mapping(p_bbc->p_mapping_write_2);
-  if (p_bbc->p_mapping_read_ind != NULL) {
-    os_alloc_free_mapping(p_bbc->p_mapping_read_ind);
-    os_alloc_free_mapping(p_bbc->p_mapping_write_ind);
-    os_alloc_free_mapping(p_bbc->p_mapping_write_ind_2);
-  }
-  os_alloc_free_memory_handle(p_bbc->mem_handle);
+  bbc_snapshot_destroy(p_bbc);
+  bbc_free_mappings(p_bbc);
 
   os_time_free_sleeper(p_bbc->p_sleeper);
 
+  for (i = 0; i < p_bbc->num_forks; ++i) {
+    util_free(p_bbc->p_fork_keys[i]);
+  }
   util_free(p_bbc->p_mem_sideways);
   util_free(p_bbc->p_mem_master);
   util_free(p_bbc);
@@ -2543,6 +3086,9 @@ bbc_power_on_reset(struct bbc_struct* p_bbc) {
   keyboard_power_on_reset(p_keyboard);
   video_power_on_reset(p_bbc->p_video);
   adc_power_on_reset(p_bbc->p_adc);
+  if (p_bbc->p_tube != NULL) {
+    tube_reset(p_bbc->p_tube);
+  }
 
   /* Not reset: teletext, render. They don't affect execution (only display) and
    * will resync to the new display output pretty immediately.
@@ -2868,10 +3414,35 @@ bbc_do_log_speed(struct bbc_struct* p_bbc, uint64_t curr_time_us) {
   p_bbc->last_c2 = curr_c2;
 }
 
+int
+bbc_replay_is_deterministic(struct bbc_struct* p_bbc) {
+  /* A replay runs fast, which only takes the same path as the original run
+   * with accurate timing. A power on reset doesn't undo disc writes.
+   */
+  struct disc_struct* p_disc_0 = disc_drive_get_disc(p_bbc->p_drive_0);
+  struct disc_struct* p_disc_1 = disc_drive_get_disc(p_bbc->p_drive_1);
+
+  if (!p_bbc->options.accurate) {
+    return 0;
+  }
+  if ((p_disc_0 != NULL) && !disc_is_write_protected(p_disc_0)) {
+    return 0;
+  }
+  if ((p_disc_1 != NULL) && !disc_is_write_protected(p_disc_1)) {
+    return 0;
+  }
+
+  return 1;
+}
+
 int
 bbc_replay_seek(struct bbc_struct* p_bbc, uint64_t seek_target) {
   struct cpu_driver* p_cpu_driver = p_bbc->p_cpu_driver;
 
+  /* A replay won't repeat the second processor's timing. */
+  if (p_bbc->p_tube != NULL) {
+    return 0;
+  }
   if (!keyboard_can_rewind(p_bbc->p_keyboard)) {
     return 0;
   }
@@ -3027,9 +3598,24 @@ bbc_cycles_timer_callback(void* p) {
 
   joystick_tick(p_bbc->p_joystick);
 
+  /* Recording and ring buffer playback run in virtual time, so they're fed
+   * in fast mode too.
+   */
+  if (sound_is_virtual_time(p_bbc->p_sound)) {
+    sound_virtual_time_tick(p_bbc->p_sound);
+  }
+
   if (p_bbc->log_speed) {
     bbc_do_log_speed(p_bbc, curr_time_us);
   }
+  if ((p_bbc->p_hw_reg_stats != NULL) &&
+      (curr_time_us >= (p_bbc->last_time_us_hw_reg_stats +
+                        k_bbc_hw_reg_stats_dump_us))) {
+    if (p_bbc->last_time_us_hw_reg_stats != 0) {
+      bbc_do_log_hw_reg_stats(p_bbc);
+    }
+    p_bbc->last_time_us_hw_reg_stats = curr_time_us;
+  }
 
   p_cpu_driver->p_funcs->housekeeping_tick(p_cpu_driver);
 }
@@ -3082,6 +3668,273 @@ bbc_start_timer_tick(struct bbc_struct* p_bbc) {
   p_bbc->last_time_us = os_time_get_us();
 }
 
+static void
+bbc_stop_cycles_timer_callback(void* p) {
+  struct bbc_struct* p_bbc = (struct bbc_struct*) p;
+  struct cpu_driver* p_cpu_driver = p_bbc->p_cpu_driver;
+
+  (void) timing_stop_timer(p_bbc->p_timing, p_bbc->timer_id_stop_cycles);
+
+  p_cpu_driver->p_funcs->apply_flags(p_cpu_driver, k_cpu_flag_exited, 0);
+  p_cpu_driver->p_funcs->set_exit_value(p_cpu_driver, 0xFFFFFFFE);
+}
+
+void
+bbc_set_stop_cycles(struct bbc_struct* p_bbc, uint64_t cycles) {
+  struct timing_struct* p_timing = p_bbc->p_timing;
+
+  if (p_bbc->timer_id_stop_cycles == -1) {
+    p_bbc->timer_id_stop_cycles =
+        timing_register_timer(p_timing,
+                              "bbc_stop_cycles",
+                              bbc_stop_cycles_timer_callback,
+                              p_bbc);
+  } else if (timing_timer_is_running(p_timing,
+                                     p_bbc->timer_id_stop_cycles)) {
+    (void) timing_stop_timer(p_timing, p_bbc->timer_id_stop_cycles);
+  }
+  (void) timing_start_timer_with_value(p_timing,
+                                       p_bbc->timer_id_stop_cycles,
+                                       cycles);
+}
+
+static void
+bbc_remap_memory_for_fork(struct bbc_struct* p_bbc) {
+  /* The 6502 address space is one shared memory object mapped several times
+   * over, which a forked child would go on sharing with its parent. Move the
+   * child to a private copy, mapped at the same addresses.
+   */
+  uint8_t* p_copy = util_malloc(k_6502_addr_space_size);
+  uint8_t effective_bank = bbc_get_effective_bank(p_bbc, p_bbc->romsel);
+  int is_ram = p_bbc->is_sideways_ram_bank[effective_bank];
+
+  (void) memcpy(p_copy, p_bbc->p_mem_raw, k_6502_addr_space_size);
+  bbc_free_mappings(p_bbc);
+  bbc_create_mappings(p_bbc);
+  (void) memcpy(p_bbc->p_mem_raw, p_copy, k_6502_addr_space_size);
+  util_free(p_copy);
+  /* The new mappings are not write protected. */
+  bbc_snapshot_mark_all_dirty(p_bbc);
+
+  if (is_ram && !p_bbc->is_master) {
+    bbc_map_sideways_writes(p_bbc, 1);
+  }
+}
+
+static void
+bbc_fork_timer_callback(void* p) {
+  /* Stop here, and bbc_run_forks() picks up once the CPU thread is gone. */
+  struct bbc_struct* p_bbc = (struct bbc_struct*) p;
+  struct cpu_driver* p_cpu_driver = p_bbc->p_cpu_driver;
+
+  (void) timing_stop_timer(p_bbc->p_timing, p_bbc->timer_id_fork);
+  p_bbc->is_at_fork_point = 1;
+
+  p_cpu_driver->p_funcs->apply_flags(p_cpu_driver, k_cpu_flag_exited, 0);
+  p_cpu_driver->p_funcs->set_exit_value(p_cpu_driver, 0xFFFFFFFE);
+}
+
+static void
+bbc_lockstep_get_record(struct bbc_struct* p_bbc,
+                        struct bbc_lockstep_record* p_record,
+                        int with_registers) {
+  uint64_t hash = 0;
+  uint32_t i;
+
+  (void) memset(p_record, '\0', sizeof(struct bbc_lockstep_record));
+  if (with_registers) {
+    state_6502_get_registers(p_bbc->p_state_6502,
+                             &p_record->a,
+                             &p_record->x,
+                             &p_record->y,
+                             &p_record->s,
+                             &p_record->flags,
+                             &p_record->pc);
+  }
+  p_record->ticks = timing_get_total_timer_ticks(p_bbc->p_timing);
+  p_record->hw_reg_hits = p_bbc->lockstep_hw_reg_hits;
+  p_record->hw_reg_hash = p_bbc->lockstep_hw_reg_hash;
+  for (i = 0; i < k_6502_addr_space_size; i += 8) {
+    uint64_t val;
+    (void) memcpy(&val, (p_bbc->p_mem_raw + i), sizeof(val));
+    hash = bbc_lockstep_hash_mix(hash, val);
+  }
+  p_record->mem_hash = hash;
+}
+
+static void
+bbc_lockstep_log_record(const char* p_name,
+                        struct bbc_lockstep_record* p_record) {
+  log_do_log(k_log_misc,
+             k_log_error,
+             "lockstep %s: ticks %"PRIu64" PC $%.4"PRIX16" A $%.2"PRIX8
+             " X $%.2"PRIX8" Y $%.2"PRIX8" S $%.2"PRIX8" F $%.2"PRIX8
+             " hw hits %"PRIu64" hw hash %.16"PRIX64" mem hash %.16"PRIX64,
+             p_name,
+             p_record->ticks,
+             p_record->pc,
+             p_record->a,
+             p_record->x,
+             p_record->y,
+             p_record->s,
+             p_record->flags,
+             p_record->hw_reg_hits,
+             p_record->hw_reg_hash,
+             p_record->mem_hash);
+}
+
+static void
+bbc_lockstep_timer_callback(void* p) {
+  struct bbc_lockstep_record record;
+  struct bbc_lockstep_record peer_record;
+  uint8_t response;
+
+  struct bbc_struct* p_bbc = (struct bbc_struct*) p;
+  struct cpu_driver* p_cpu_driver = p_bbc->p_cpu_driver;
+
+  (void) timing_adjust_timer_value(p_bbc->p_timing,
+                                   NULL,
+                                   p_bbc->timer_id_lockstep,
+                                   p_bbc->lockstep_cycles);
+
+  /* Timers fire part way through an instruction, with the registers possibly
+   * held privately by the CPU driver, so they're left out here and compared
+   * once the CPU has exited at an instruction boundary.
+   */
+  bbc_lockstep_get_record(p_bbc, &record, 0);
+
+  if (p_bbc->is_lockstep_checker) {
+    os_channel_read(p_bbc->lockstep_handle_read,
+                    &peer_record,
+                    sizeof(peer_record));
+    response = k_bbc_lockstep_continue;
+    if (memcmp(&record, &peer_record, sizeof(record))) {
+      response = k_bbc_lockstep_stop;
+    }
+    os_channel_write(p_bbc->lockstep_handle_write, &response, 1);
+  } else {
+    os_channel_write(p_bbc->lockstep_handle_write, &record, sizeof(record));
+    os_channel_read(p_bbc->lockstep_handle_read, &response, 1);
+  }
+  if (response == k_bbc_lockstep_continue) {
+    return;
+  }
+
+  /* Both sides stop for the full comparison. */
+  p_bbc->is_lockstep_diverged = 1;
+  p_cpu_driver->p_funcs->apply_flags(p_cpu_driver, k_cpu_flag_exited, 0);
+  p_cpu_driver->p_funcs->set_exit_value(p_cpu_driver, 0xFFFFFFFE);
+}
+
+static void
+bbc_lockstep_finish(struct bbc_struct* p_bbc) {
+  struct bbc_lockstep_record record;
+  struct bbc_lockstep_record peer_record;
+  struct bbc_lockstep_record compare_record;
+  uint8_t* p_peer_mem;
+  uint8_t* p_mem = p_bbc->p_mem_raw;
+  uint32_t num_diffs;
+  uint32_t i;
+
+  bbc_lockstep_get_record(p_bbc, &record, 1);
+
+  if (!p_bbc->is_lockstep_checker) {
+    os_channel_write(p_bbc->lockstep_handle_write, &record, sizeof(record));
+    os_channel_write(p_bbc->lockstep_handle_write,
+                     p_mem,
+                     k_6502_addr_space_size);
+    return;
+  }
+
+  p_peer_mem = util_malloc(k_6502_addr_space_size);
+  os_channel_read(p_bbc->lockstep_handle_read,
+                  &peer_record,
+                  sizeof(peer_record));
+  os_channel_read(p_bbc->lockstep_handle_read,
+                  p_peer_mem,
+                  k_6502_addr_space_size);
+
+  /* The JIT can leave flags stale if they're about to be overwritten, so
+   * flags alone differing at an arbitrary stop isn't necessarily a bug.
+   */
+  compare_record = peer_record;
+  compare_record.flags = record.flags;
+  if (!p_bbc->is_lockstep_diverged &&
+      !memcmp(&record, &compare_record, sizeof(record))) {
+    if (record.flags != peer_record.flags) {
+      log_do_log(k_log_misc,
+                 k_log_warning,
+                 "lockstep: flags differ at exit, $%.2"PRIX8" vs. $%.2"PRIX8,
+                 record.flags,
+                 peer_record.flags);
+    }
+    util_free(p_peer_mem);
+    return;
+  }
+
+  bbc_lockstep_log_record("checker", &record);
+  bbc_lockstep_log_record("peer", &peer_record);
+  num_diffs = 0;
+  for (i = 0; i < k_6502_addr_space_size; ++i) {
+    if (p_mem[i] == p_peer_mem[i]) {
+      continue;
+    }
+    if (num_diffs < k_bbc_lockstep_max_diffs) {
+      log_do_log(k_log_misc,
+                 k_log_error,
+                 "lockstep memory $%.4"PRIX32": $%.2"PRIX8" vs. $%.2"PRIX8,
+                 i,
+                 p_mem[i],
+                 p_peer_mem[i]);
+    }
+    num_diffs++;
+  }
+  log_do_log(k_log_misc,
+             k_log_error,
+             "lockstep memory: %"PRIu32" bytes differ",
+             num_diffs);
+  util_free(p_peer_mem);
+
+  util_bail("lockstep divergence");
+}
+
+static uint32_t
+bbc_get_ram_crc32(struct bbc_struct* p_bbc) {
+  uint32_t crc = util_crc32_init();
+  crc = util_crc32_add(crc, p_bbc->p_mem_read, k_bbc_ram_size);
+  return util_crc32_finish(crc);
+}
+
+static void
+bbc_log_fork_result(struct bbc_struct* p_bbc) {
+  uint8_t a;
+  uint8_t x;
+  uint8_t y;
+  uint8_t s;
+  uint8_t flags;
+  uint16_t pc;
+  uint32_t crc;
+
+  state_6502_get_registers(p_bbc->p_state_6502, &a, &x, &y, &s, &flags, &pc);
+  crc = bbc_get_ram_crc32(p_bbc);
+
+  log_do_log(k_log_misc,
+             k_log_info,
+             "fork %"PRId32" keys '%s': ticks %"PRIu64" PC $%.4"PRIX16
+             " A $%.2"PRIX8" X $%.2"PRIX8" Y $%.2"PRIX8" S $%.2"PRIX8
+             " F $%.2"PRIX8" RAM CRC32 %.8"PRIX32,
+             p_bbc->fork_index,
+             p_bbc->p_fork_keys[p_bbc->fork_index],
+             timing_get_total_timer_ticks(p_bbc->p_timing),
+             pc,
+             a,
+             x,
+             y,
+             s,
+             flags,
+             crc);
+}
+
 static void*
 bbc_cpu_thread(void* p) {
   int exited;
@@ -3103,6 +3956,10 @@ bbc_cpu_thread(void* p) {
   p_bbc->running = 0;
   p_bbc->exit_value = p_cpu_driver->p_funcs->get_exit_value(p_cpu_driver);
 
+  if (p_bbc->is_lockstep) {
+    bbc_lockstep_finish(p_bbc);
+  }
+
   message.data[0] = k_message_exited;
   bbc_cpu_send_message(p_bbc, &message);
 
@@ -3111,14 +3968,15 @@ bbc_cpu_thread(void* p) {
 
 void
 bbc_run_async(struct bbc_struct* p_bbc) {
-  p_bbc->p_thread_cpu = os_thread_create(bbc_cpu_thread, p_bbc);
-
   assert(!p_bbc->thread_allocated);
   assert(!p_bbc->running);
 
+  /* Set before the thread starts, as a short run can exit straight away. */
   p_bbc->thread_allocated = 1;
   p_bbc->running = 1;
 
+  p_bbc->p_thread_cpu = os_thread_create(bbc_cpu_thread, p_bbc);
+
   sound_start_playing(p_bbc->p_sound);
 }
 
@@ -3133,6 +3991,96 @@ bbc_get_run_result(struct bbc_struct* p_bbc) {
   return *p_ret;
 }
 
+static void
+bbc_run_fork_child(struct bbc_struct* p_bbc, uint32_t index) {
+  int exited;
+  const char* p_keys = p_bbc->p_fork_keys[index];
+  struct cpu_driver* p_cpu_driver = p_bbc->p_cpu_driver;
+
+  p_bbc->fork_index = index;
+  bbc_remap_memory_for_fork(p_bbc);
+
+  while (*p_keys != '\0') {
+    uint8_t key = (uint8_t) toupper(*p_keys);
+    keyboard_system_key_pressed(p_bbc->p_keyboard, key);
+    p_keys++;
+  }
+
+  bbc_set_stop_cycles(p_bbc, p_bbc->fork_run_cycles);
+
+  /* The child runs the CPU on its only thread. */
+  p_bbc->running = 1;
+  p_cpu_driver->p_funcs->apply_flags(p_cpu_driver, 0, k_cpu_flag_exited);
+  exited = p_cpu_driver->p_funcs->enter(p_cpu_driver);
+  (void) exited;
+  assert(exited == 1);
+  p_bbc->running = 0;
+
+  bbc_log_fork_result(p_bbc);
+  (void) fflush(NULL);
+  os_thread_exit_process(0);
+}
+
+void
+bbc_run_forks(struct bbc_struct* p_bbc) {
+  intptr_t child_ids[k_bbc_max_forks];
+  uint32_t i;
+  uint32_t crc;
+  uint64_t ticks;
+
+  assert(!p_bbc->running);
+
+  if (!p_bbc->is_at_fork_point) {
+    return;
+  }
+  p_bbc->is_at_fork_point = 0;
+
+  /* A child only gets the thread that forked it, so join the CPU thread and
+   * fork from a process with just the one thread.
+   */
+  assert(p_bbc->thread_allocated);
+  (void) os_thread_destroy(p_bbc->p_thread_cpu);
+  p_bbc->thread_allocated = 0;
+
+  crc = bbc_get_ram_crc32(p_bbc);
+  ticks = timing_get_total_timer_ticks(p_bbc->p_timing);
+  log_do_log(k_log_misc,
+             k_log_info,
+             "forking %"PRIu32" at ticks %"PRIu64", RAM CRC32 %.8"PRIX32,
+             p_bbc->num_forks,
+             ticks,
+             crc);
+
+  for (i = 0; i < p_bbc->num_forks; ++i) {
+    intptr_t id = os_thread_fork_process();
+    if (id == 0) {
+      /* Doesn't return. */
+      bbc_run_fork_child(p_bbc, i);
+    }
+    child_ids[i] = id;
+  }
+
+  for (i = 0; i < p_bbc->num_forks; ++i) {
+    int status = os_thread_wait_process(child_ids[i]);
+    if (status != 0) {
+      log_do_log(k_log_misc,
+                 k_log_warning,
+                 "fork %"PRIu32" exited with status %d",
+                 i,
+                 status);
+    }
+  }
+
+  /* The children run in copies of the parent's memory. Check that none of
+   * them wrote through to it.
+   */
+  if ((bbc_get_ram_crc32(p_bbc) != crc) ||
+      (timing_get_total_timer_ticks(p_bbc->p_timing) != ticks)) {
+    util_bail("fork parent state changed");
+  }
+  log_do_log(k_log_misc, k_log_info, "forks done, parent unchanged");
+}
+
 void
 bbc_set_channel_handles(struct bbc_struct* p_bbc,
                         intptr_t handle_channel_read_bbc,
@@ -3197,28 +4145,87 @@ bbc_add_tape(struct bbc_struct* p_bbc, const char* p_file_name) {
   tape_add_tape(p_bbc->p_tape, p_file_name);
 }
 
-static void
-bbc_stop_cycles_timer_callback(void* p) {
-  struct bbc_struct* p_bbc = (struct bbc_struct*) p;
-  struct cpu_driver* p_cpu_driver = p_bbc->p_cpu_driver;
+void
+bbc_add_tube(struct bbc_struct* p_bbc, uint8_t* p_rom, uint32_t rom_len) {
+  assert(p_bbc->p_tube == NULL);
+  p_bbc->p_tube = tube_create(p_bbc->p_timing,
+                              p_bbc->p_state_6502,
+                              p_rom,
+                              rom_len,
+                              &p_bbc->options);
+}
 
-  (void) timing_stop_timer(p_bbc->p_timing, p_bbc->timer_id_stop_cycles);
+void
+bbc_set_forks(struct bbc_struct* p_bbc,
+              uint64_t fork_cycles,
+              uint64_t run_cycles) {
+  struct timing_struct* p_timing = p_bbc->p_timing;
 
-  p_cpu_driver->p_funcs->apply_flags(p_cpu_driver, k_cpu_flag_exited, 0);
-  p_cpu_driver->p_funcs->set_exit_value(p_cpu_driver, 0xFFFFFFFE);
+  assert(p_bbc->timer_id_fork == -1);
+  assert(run_cycles > 0);
+
+  p_bbc->fork_run_cycles = run_cycles;
+  p_bbc->timer_id_fork = timing_register_timer(p_timing,
+                                               "bbc_fork",
+                                               bbc_fork_timer_callback,
+                                               p_bbc);
+  (void) timing_start_timer_with_value(p_timing,
+                                       p_bbc->timer_id_fork,
+                                       fork_cycles);
 }
 
 void
-bbc_set_stop_cycles(struct bbc_struct* p_bbc, uint64_t cycles) {
+bbc_set_lockstep(struct bbc_struct* p_bbc,
+                 uint64_t check_cycles,
+                 int is_checker,
+                 intptr_t handle_read,
+                 intptr_t handle_write) {
   struct timing_struct* p_timing = p_bbc->p_timing;
-  uint32_t id = timing_register_timer(p_bbc->p_timing,
-                                      "bbc_stop_cycles",
-                                      bbc_stop_cycles_timer_callback,
-                                      p_bbc);
-  p_bbc->timer_id_stop_cycles = id;
-  (void) timing_start_timer_with_value(p_timing, id, cycles);
+
+  assert(p_bbc->timer_id_lockstep == -1);
+  assert(check_cycles > 0);
+
+  p_bbc->is_lockstep = 1;
+  p_bbc->is_lockstep_checker = is_checker;
+  p_bbc->lockstep_cycles = check_cycles;
+  p_bbc->lockstep_handle_read = handle_read;
+  p_bbc->lockstep_handle_write = handle_write;
+  p_bbc->timer_id_lockstep = timing_register_timer(p_timing,
+                                                   "bbc_lockstep",
+                                                   bbc_lockstep_timer_callback,
+                                                   p_bbc);
+  (void) timing_start_timer_with_value(p_timing,
+                                       p_bbc->timer_id_lockstep,
+                                       check_cycles);
+}
+
+void
+bbc_set_trace(struct bbc_struct* p_bbc, struct trace_struct* p_trace) {
+  struct cpu_driver* p_cpu_driver = p_bbc->p_cpu_driver;
+
+  if (p_cpu_driver->p_extra->type != k_cpu_mode_interp) {
+    util_bail("tracing needs the interp CPU mode");
+  }
+  interp_set_trace((struct interp_struct*) p_cpu_driver, p_trace);
 }
 
+void
+bbc_add_fork(struct bbc_struct* p_bbc, const char* p_keys) {
+  const char* p_key;
+
+  if (p_bbc->num_forks == k_bbc_max_forks) {
+    util_bail("too many forks");
+  }
+  for (p_key = p_keys; *p_key != '\0'; ++p_key) {
+    if (!keyboard_is_bbc_key((uint8_t) toupper(*p_key))) {
+      util_bail("fork key '%c' isn't a BBC key", *p_key);
+    }
+  }
+  p_bbc->p_fork_keys[p_bbc->num_forks] = util_strdup(p_keys);
+  p_bbc->num_forks++;
+}
+
+
 static void
 bbc_autoboot_timer_callback(void* p) {
   struct bbc_struct* p_bbc = (struct bbc_struct*) p;
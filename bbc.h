@@ -11,6 +11,7 @@ struct serial_struct;
 struct serial_ula_struct;
 struct sound_struct;
 struct state_6502;
+struct trace_struct;
 struct via_struct;
 struct video_struct;
 
@@ -37,6 +38,7 @@ enum {
   k_bbc_max_dsd_disc_size = (256 * 10 * 80 * 2),
 };
 
+struct bbc_memory_snapshot;
 struct bbc_struct;
 
 struct bbc_struct* bbc_create(int mode,
@@ -83,7 +85,32 @@ void bbc_add_raw_disc(struct bbc_struct* p_bbc,
                       const char* p_file_name,
                       const char* p_spec);
 void bbc_add_tape(struct bbc_struct* p_bbc, const char* p_file_name);
+void bbc_add_tube(struct bbc_struct* p_bbc, uint8_t* p_rom, uint32_t rom_len);
 void bbc_set_stop_cycles(struct bbc_struct* p_bbc, uint64_t cycles);
+/* At fork_cycles, stops the run so that bbc_run_forks() can fork the process
+ * once per bbc_add_fork(). Each child holds down its keys (characters for
+ * BBC keys, letters case-insensitive), runs on for run_cycles and logs its
+ * final CPU state and a RAM checksum.
+ * Children don't have a main thread, so this needs a headless run.
+ */
+void bbc_set_forks(struct bbc_struct* p_bbc,
+                   uint64_t fork_cycles,
+                   uint64_t run_cycles);
+void bbc_add_fork(struct bbc_struct* p_bbc, const char* p_keys);
+/* Every check_cycles, compares a checksum of memory and a checksum of
+ * hardware register traffic with a peer process running the same machine,
+ * normally under a different CPU driver. On a mismatch, or when the run ends,
+ * both stop and the CPU registers and memory are compared in full. The
+ * checker bails after logging both states and the memory differences; the
+ * peer just sends its state.
+ */
+void bbc_set_lockstep(struct bbc_struct* p_bbc,
+                      uint64_t check_cycles,
+                      int is_checker,
+                      intptr_t handle_read,
+                      intptr_t handle_write);
+/* Traces every instruction run to p_trace. Needs the interp CPU mode. */
+void bbc_set_trace(struct bbc_struct* p_bbc, struct trace_struct* p_trace);
 void bbc_set_autoboot(struct bbc_struct* p_bbc, int autoboot_flag);
 void bbc_set_commands(struct bbc_struct* p_bbc, const char* p_commands);
 
@@ -92,8 +119,15 @@ void bbc_set_pc(struct bbc_struct* p_bbc, uint16_t pc);
 
 void bbc_run_async(struct bbc_struct* p_bbc);
 uint32_t bbc_get_run_result(struct bbc_struct* p_bbc);
+/* Once the CPU thread has exited at the fork point, forks the children from
+ * the thread left and waits for them. Does nothing if the run stopped before
+ * the fork point.
+ */
+void bbc_run_forks(struct bbc_struct* p_bbc);
 int bbc_check_do_break(struct bbc_struct* p_bbc);
 int bbc_replay_seek(struct bbc_struct* p_bbc, uint64_t seek_target);
+/* Whether a replay from power on retraces the run exactly. */
+int bbc_replay_is_deterministic(struct bbc_struct* p_bbc);
 
 struct state_6502* bbc_get_6502(struct bbc_struct* p_bbc);
 struct via_struct* bbc_get_sysvia(struct bbc_struct* p_bbc);
@@ -115,6 +149,17 @@ uint8_t bbc_get_IC32(struct bbc_struct* p_bbc);
 void bbc_set_IC32(struct bbc_struct* p_bbc, uint8_t val);
 
 uint8_t* bbc_get_mem_read(struct bbc_struct* p_bbc);
+/* Snapshots of main RAM. Pages that weren't written since the previous
+ * snapshot are shared with it rather than copied, using write protection to
+ * spot the writes. Restoring a snapshot doesn't touch ROM or device state.
+ */
+struct bbc_memory_snapshot* bbc_snapshot_memory(struct bbc_struct* p_bbc);
+void bbc_restore_memory(struct bbc_struct* p_bbc,
+                        struct bbc_memory_snapshot* p_snapshot);
+void bbc_free_memory_snapshot(struct bbc_memory_snapshot* p_snapshot);
+/* Copies the k_bbc_ram_size snapshotted bytes out to p_dest. */
+void bbc_copy_memory_snapshot(struct bbc_memory_snapshot* p_snapshot,
+                              uint8_t* p_dest);
 uint8_t* bbc_get_mem_write(struct bbc_struct* p_bbc);
 void bbc_set_memory_block(struct bbc_struct* p_bbc,
                           uint16_t addr,
@@ -25,11 +25,11 @@ clang -Wall -W -Werror \
       emit_6502.c interp.c inturbo.c state_6502.c sound.c timing.c \
       jit_compiler.c jit_metadata.c cpu_driver.c \
       jit_optimizer.c jit_opcode.c keyboard.c \
-      teletext.c render.c mc6850.c serial_ula.c \
-      log.c test.c adc.c cmos.c joystick.c \
+      teletext.c render.c mc6850.c serial_ula.c recorder.c disc_writer.c \
+      log.c test.c adc.c cmos.c joystick.c tube.c trace.c \
       tape.c tape_csw.c tape_uef.c \
       intel_fdc.c wd_fdc.c \
-      disc_drive.c disc.c ibm_disc_format.c disc_tool.c \
+      disc_drive.c disc.c ibm_disc_format.c disc_tool.c disc_index.c \
       disc_fsd.c disc_hfe.c disc_ssd.c disc_adl.c \
       disc_rfi.c disc_kryo.c disc_scp.c disc_dfi.c \
       debug.c expression.c jit.c \
@@ -36,6 +36,15 @@ enum {
   k_max_break = 16,
   k_max_input_len = 1024,
   k_max_temp_storage = (256 * 1024),
+  k_max_snapdiff_lines = 64,
+};
+
+enum {
+  k_debug_reverse_off = 0,
+  k_debug_reverse_search = 1,
+  k_debug_reverse_arrive = 2,
+  /* Every instruction is seen from this many ticks before a reverse target. */
+  k_debug_reverse_margin = 1000,
 };
 
 struct debug_breakpoint {
@@ -50,6 +59,9 @@ struct debug_breakpoint {
   int32_t exec_end;
   int32_t memory_start;
   int32_t memory_end;
+  /* A pc == or addr == constant that the expression needs, or -1. */
+  int32_t expr_pc;
+  int32_t expr_addr;
   int do_print;
   int do_stop;
   char* p_command_list_str;
@@ -94,6 +106,16 @@ struct debug_struct {
   int32_t next_or_finish_stop_addr;
   struct debug_breakpoint breakpoints[k_max_break];
   uint32_t max_breakpoint_used_plus_one;
+  /* Enabled breakpoints that only match at certain PCs or memory addresses
+   * are entered in these filters. Breakpoints are only checked if one of the
+   * filters is hit or some breakpoint isn't filterable.
+   */
+  uint32_t num_unfiltered_breakpoints;
+  uint32_t num_addr_filtered_breakpoints;
+  uint8_t break_pc_filter[k_6502_addr_space_size];
+  uint8_t break_addr_filter[k_6502_addr_space_size];
+  /* Bumped whenever the set of watched instructions changes. */
+  uint32_t watch_generation;
   struct util_buffer* p_temp_storage_buf;
   int is_sub_instruction_active;
   uint32_t timer_id_sub_instruction;
@@ -124,6 +146,20 @@ struct debug_struct {
   uint8_t warn_at_addr_count[k_6502_addr_space_size];
   int32_t timer_id_debug;
   char previous_commands[k_max_input_len];
+
+  /* Reverse execution. A search replay from power on finds the target ticks,
+   * then a second replay stops there.
+   */
+  int reverse_mode;
+  int reverse_is_step;
+  int reverse_is_rewound;
+  int reverse_is_armed;
+  uint64_t reverse_arm_ticks;
+  uint64_t reverse_end_ticks;
+  uint16_t reverse_end_pc;
+  int64_t reverse_found_ticks;
+  uint16_t reverse_found_pc;
+  struct bbc_memory_snapshot* p_snapshot;
 };
 
 static int s_interrupt_received;
@@ -149,6 +185,8 @@ debug_clear_breakpoint(struct debug_struct* p_debug, uint32_t i) {
   p_breakpoint->exec_end = -1;
   p_breakpoint->memory_start = -1;
   p_breakpoint->memory_end = -1;
+  p_breakpoint->expr_pc = -1;
+  p_breakpoint->expr_addr = -1;
 }
 
 static void
@@ -156,7 +194,11 @@ debug_timer_callback(void* p) {
   struct debug_struct* p_debug = (struct debug_struct*) p;
   (void) timing_stop_timer(p_debug->p_timing, p_debug->timer_id_debug);
 
-  s_interrupt_received = 1;
+  if (p_debug->reverse_mode != k_debug_reverse_off) {
+    p_debug->reverse_is_armed = 1;
+  } else {
+    s_interrupt_received = 1;
+  }
 }
 
 void
@@ -171,6 +213,9 @@ debug_init(struct debug_struct* p_debug) {
 
 void
 debug_destroy(struct debug_struct* p_debug) {
+  if (p_debug->p_snapshot != NULL) {
+    bbc_free_memory_snapshot(p_debug->p_snapshot);
+  }
   disc_tool_destroy(p_debug->p_tool);
   util_string_list_free(p_debug->p_command_strings);
   util_string_list_free(p_debug->p_pending_commands);
@@ -730,16 +775,62 @@ debug_get_free_breakpoint(struct debug_struct* p_debug) {
   return NULL;
 }
 
-static inline void
-debug_calculate_max_breakpoint(struct debug_struct* p_debug) {
+static void
+debug_filter_range(uint8_t* p_filter, int32_t start, int32_t end) {
+  int32_t i;
+
+  if (start < 0) {
+    start = 0;
+  }
+  if (end >= k_6502_addr_space_size) {
+    end = (k_6502_addr_space_size - 1);
+  }
+  for (i = start; i <= end; ++i) {
+    p_filter[i] = 1;
+  }
+}
+
+static void
+debug_calculate_breakpoints(struct debug_struct* p_debug) {
   uint32_t i;
 
   p_debug->max_breakpoint_used_plus_one = 0;
+  p_debug->num_unfiltered_breakpoints = 0;
+  p_debug->num_addr_filtered_breakpoints = 0;
+  p_debug->watch_generation++;
+  (void) memset(p_debug->break_pc_filter,
+                '\0',
+                sizeof(p_debug->break_pc_filter));
+  (void) memset(p_debug->break_addr_filter,
+                '\0',
+                sizeof(p_debug->break_addr_filter));
 
   for (i = 0; i < k_max_break; ++i) {
     struct debug_breakpoint* p_breakpoint = &p_debug->breakpoints[i];
-    if (p_breakpoint->is_in_use) {
-      p_debug->max_breakpoint_used_plus_one = (i + 1);
+    if (!p_breakpoint->is_in_use) {
+      continue;
+    }
+    p_debug->max_breakpoint_used_plus_one = (i + 1);
+    if (!p_breakpoint->is_enabled) {
+      continue;
+    }
+    /* Any one condition that must hold is enough to filter on. */
+    if (p_breakpoint->has_exec_range) {
+      debug_filter_range(&p_debug->break_pc_filter[0],
+                         p_breakpoint->exec_start,
+                         p_breakpoint->exec_end);
+    } else if (p_breakpoint->expr_pc != -1) {
+      p_debug->break_pc_filter[p_breakpoint->expr_pc] = 1;
+    } else if (p_breakpoint->has_memory_range) {
+      debug_filter_range(&p_debug->break_addr_filter[0],
+                         p_breakpoint->memory_start,
+                         p_breakpoint->memory_end);
+      p_debug->num_addr_filtered_breakpoints++;
+    } else if (p_breakpoint->expr_addr != -1) {
+      p_debug->break_addr_filter[p_breakpoint->expr_addr] = 1;
+      p_debug->num_addr_filtered_breakpoints++;
+    } else {
+      p_debug->num_unfiltered_breakpoints++;
     }
   }
 }
@@ -757,6 +848,13 @@ debug_check_breakpoints(struct debug_struct* p_debug,
     *p_out_stop = 1;
   }
 
+  if ((p_debug->num_unfiltered_breakpoints == 0) &&
+      !p_debug->break_pc_filter[p_debug->reg_pc] &&
+      ((p_debug->addr_6502 == -1) ||
+       !p_debug->break_addr_filter[p_debug->addr_6502])) {
+    return;
+  }
+
   for (i = 0; i < max_breakpoint_used_plus_one; ++i) {
     struct debug_breakpoint* p_breakpoint = &p_debug->breakpoints[i];
     if (!p_breakpoint->is_in_use) {
@@ -786,6 +884,14 @@ debug_check_breakpoints(struct debug_struct* p_debug,
         continue;
       }
     }
+    if ((p_breakpoint->expr_pc != -1) &&
+        (p_debug->reg_pc != p_breakpoint->expr_pc)) {
+      continue;
+    }
+    if ((p_breakpoint->expr_addr != -1) &&
+        (p_debug->addr_6502 != p_breakpoint->expr_addr)) {
+      continue;
+    }
     if (p_breakpoint->p_expression != NULL) {
       int64_t expression_ret = expression_execute(p_breakpoint->p_expression);
       if (expression_ret == 0) {
@@ -793,6 +899,11 @@ debug_check_breakpoints(struct debug_struct* p_debug,
       }
     }
     /* If we arrive here, it's a hit. */
+    if (p_debug->reverse_mode != k_debug_reverse_off) {
+      /* Replays for reverse execution only look for stopping hits. */
+      *p_out_stop |= p_breakpoint->do_stop;
+      continue;
+    }
     p_breakpoint->num_hits++;
     if (p_breakpoint->do_stop && p_breakpoint->do_print) {
       (void) printf("breakpoint %"PRIu32" hit %"PRIu64" times\n",
@@ -1121,6 +1232,31 @@ debug_save_raw(struct debug_struct* p_debug,
   util_file_close(p_file);
 }
 
+static void
+debug_snapshot_diff(struct debug_struct* p_debug) {
+  uint8_t buf[k_bbc_ram_size];
+  uint32_t i;
+  uint32_t num_diffs = 0;
+  uint8_t* p_mem_read = p_debug->p_mem_read;
+
+  if (p_debug->p_snapshot == NULL) {
+    (void) printf("no snapshot\n");
+    return;
+  }
+
+  bbc_copy_memory_snapshot(p_debug->p_snapshot, buf);
+  for (i = 0; i < k_bbc_ram_size; ++i) {
+    if (buf[i] == p_mem_read[i]) {
+      continue;
+    }
+    if (num_diffs < k_max_snapdiff_lines) {
+      (void) printf("%.4X: %.2X -> %.2X\n", i, buf[i], p_mem_read[i]);
+    }
+    num_diffs++;
+  }
+  (void) printf("%"PRIu32" bytes changed\n", num_diffs);
+}
+
 static void
 debug_print_registers(uint8_t reg_a,
                       uint8_t reg_x,
@@ -1730,6 +1866,27 @@ debug_setup_breakpoint(struct debug_struct* p_debug) {
   if (p_breakpoint->memory_end == -1) {
     p_breakpoint->memory_end = p_breakpoint->memory_start;
   }
+
+  if (p_breakpoint->p_expression != NULL) {
+    struct expression_struct* p_expression = p_breakpoint->p_expression;
+    int64_t required;
+    if (expression_get_required_value(p_expression,
+                                      debug_read_variable_pc,
+                                      &required) &&
+        (required >= 0) &&
+        (required < k_6502_addr_space_size)) {
+      p_breakpoint->expr_pc = required;
+    }
+    if (expression_get_required_value(p_expression,
+                                      debug_read_variable_addr,
+                                      &required) &&
+        (required >= 0) &&
+        (required < k_6502_addr_space_size)) {
+      p_breakpoint->expr_addr = required;
+    }
+  }
+
+  debug_calculate_breakpoints(p_debug);
 }
 
 static void
@@ -1868,6 +2025,260 @@ debug_print_status_line(struct debug_struct* p_debug,
   (void) fflush(stdout);
 }
 
+int
+debug_needs_every_instruction(struct debug_struct* p_debug) {
+  return (!p_debug->debug_running ||
+          p_debug->debug_running_print ||
+          p_debug->stats ||
+          p_debug->is_sub_instruction_active ||
+          (p_debug->num_unfiltered_breakpoints > 0) ||
+          p_debug->reverse_is_armed ||
+          s_interrupt_received);
+}
+
+static int
+debug_is_addr_range_watched(struct debug_struct* p_debug,
+                            uint16_t addr_6502,
+                            uint32_t len) {
+  uint32_t i;
+
+  for (i = 0; i < len; ++i) {
+    if (p_debug->break_addr_filter[(uint16_t) (addr_6502 + i)]) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+int
+debug_is_instruction_watched(struct debug_struct* p_debug,
+                             uint16_t addr_6502,
+                             uint8_t opcode,
+                             uint8_t operand1,
+                             uint8_t operand2) {
+  uint8_t opmode;
+  uint8_t optype;
+  uint16_t addr = (operand1 + (operand2 << 8));
+
+  if (debug_needs_every_instruction(p_debug) ||
+      p_debug->break_pc_filter[addr_6502] ||
+      (addr_6502 == p_debug->next_or_finish_stop_addr)) {
+    return 1;
+  }
+  if (p_debug->num_addr_filtered_breakpoints == 0) {
+    return 0;
+  }
+
+  /* Mirrors the addresses that debug_get_details() considers accessed. */
+  opmode = p_debug->p_opcode_modes[opcode];
+  optype = p_debug->p_opcode_types[opcode];
+  switch (opmode) {
+  case k_zpg:
+    return p_debug->break_addr_filter[operand1];
+  case k_zpx:
+  case k_zpy:
+    return debug_is_addr_range_watched(p_debug, 0, 0x100);
+  case k_abs:
+    if ((optype == k_jsr) || (optype == k_jmp)) {
+      return 0;
+    }
+    return p_debug->break_addr_filter[addr];
+  case k_abx:
+  case k_aby:
+    return debug_is_addr_range_watched(p_debug, addr, 0x100);
+  case k_idx:
+  case k_idy:
+  case k_id:
+    /* The address is only known at run time. */
+    return 1;
+  default:
+    break;
+  }
+  switch (optype) {
+  case k_php:
+  case k_pha:
+  case k_phx:
+  case k_phy:
+  case k_plp:
+  case k_pla:
+  case k_plx:
+  case k_ply:
+    return debug_is_addr_range_watched(p_debug, k_6502_stack_addr, 0x100);
+  default:
+    break;
+  }
+
+  return 0;
+}
+
+int
+debug_has_memory_watches(struct debug_struct* p_debug) {
+  return (p_debug->num_addr_filtered_breakpoints > 0);
+}
+
+uint32_t
+debug_get_watch_generation(struct debug_struct* p_debug) {
+  return p_debug->watch_generation;
+}
+
+static void
+debug_reverse_cancel(struct debug_struct* p_debug) {
+  struct timing_struct* p_timing = p_debug->p_timing;
+  uint32_t timer_id = p_debug->timer_id_debug;
+
+  if (timing_timer_is_running(p_timing, timer_id)) {
+    (void) timing_stop_timer(p_timing, timer_id);
+  }
+  p_debug->reverse_mode = k_debug_reverse_off;
+  p_debug->reverse_is_armed = 0;
+}
+
+static int
+debug_reverse_start(struct debug_struct* p_debug,
+                    int mode,
+                    uint64_t end_ticks,
+                    uint16_t end_pc) {
+  /* Replay from power on at full speed, seeing every instruction only for the
+   * last stretch before end_ticks. Arming waits for debug_replay_rewound().
+   */
+  uint64_t arm_ticks = 0;
+
+  debug_reverse_cancel(p_debug);
+  if (!bbc_replay_seek(p_debug->p_bbc, end_ticks)) {
+    return 0;
+  }
+
+  if (end_ticks > k_debug_reverse_margin) {
+    arm_ticks = (end_ticks - k_debug_reverse_margin);
+  }
+  p_debug->reverse_mode = mode;
+  p_debug->reverse_is_rewound = 0;
+  p_debug->reverse_arm_ticks = arm_ticks;
+  p_debug->reverse_end_ticks = end_ticks;
+  p_debug->reverse_end_pc = end_pc;
+
+  p_debug->next_or_finish_stop_addr = -1;
+  p_debug->breakpoint_continue = -1;
+  p_debug->watch_generation++;
+
+  return 1;
+}
+
+void
+debug_replay_rewound(struct debug_struct* p_debug) {
+  uint64_t ticks;
+  uint64_t arm_ticks = p_debug->reverse_arm_ticks;
+
+  if (p_debug->reverse_mode == k_debug_reverse_off) {
+    return;
+  }
+
+  /* Ticks count from the power on reset now, so arm on absolute ticks. */
+  ticks = timing_get_total_timer_ticks(p_debug->p_timing);
+  p_debug->reverse_is_rewound = 1;
+  if (arm_ticks > ticks) {
+    (void) timing_start_timer_with_value(p_debug->p_timing,
+                                         p_debug->timer_id_debug,
+                                         (arm_ticks - ticks));
+  } else {
+    p_debug->reverse_is_armed = 1;
+  }
+}
+
+static int
+debug_reverse_check_arrival(struct debug_struct* p_debug,
+                            uint64_t ticks,
+                            uint64_t expect_ticks,
+                            uint16_t expect_pc) {
+  /* A deterministic replay arrives exactly where it was asked to. */
+  uint16_t pc = p_debug->reg_pc;
+
+  if ((ticks == expect_ticks) && (pc == expect_pc)) {
+    return 1;
+  }
+  (void) printf("replay diverged: expected PC $%.4"PRIX16" ticks %"PRIu64
+                ", got PC $%.4"PRIX16" ticks %"PRIu64"\n",
+                expect_pc,
+                expect_ticks,
+                pc,
+                ticks);
+  return 0;
+}
+
+static int
+debug_reverse_is_before_end(struct debug_struct* p_debug, uint64_t ticks) {
+  /* Several stops can share a tick, so the PC tells them apart. */
+  uint64_t end_ticks = p_debug->reverse_end_ticks;
+
+  if (ticks < end_ticks) {
+    return 1;
+  }
+  return ((ticks == end_ticks) &&
+          (p_debug->reg_pc != p_debug->reverse_end_pc));
+}
+
+static int
+debug_reverse_check(struct debug_struct* p_debug, int is_break) {
+  /* Returns whether to stop at the current instruction. */
+  uint64_t ticks = timing_get_total_timer_ticks(p_debug->p_timing);
+  uint64_t end_ticks = p_debug->reverse_end_ticks;
+  int64_t found_ticks = p_debug->reverse_found_ticks;
+
+  /* Still running up to the seek's reset. */
+  if (!p_debug->reverse_is_rewound) {
+    return 0;
+  }
+
+  if (p_debug->reverse_mode == k_debug_reverse_arrive) {
+    if (debug_reverse_is_before_end(p_debug, ticks)) {
+      return 0;
+    }
+    debug_reverse_cancel(p_debug);
+    if (debug_reverse_check_arrival(p_debug,
+                                    ticks,
+                                    end_ticks,
+                                    p_debug->reverse_end_pc)) {
+      (void) printf("reversed to ticks %"PRIu64"\n", ticks);
+    }
+    return 1;
+  }
+
+  if (debug_reverse_is_before_end(p_debug, ticks)) {
+    if (p_debug->reverse_is_step || is_break) {
+      p_debug->reverse_found_ticks = ticks;
+      p_debug->reverse_found_pc = p_debug->reg_pc;
+    }
+    return 0;
+  }
+
+  /* The search must come back to where it started, or what it found can't be
+   * trusted.
+   */
+  if (!debug_reverse_check_arrival(p_debug,
+                                   ticks,
+                                   end_ticks,
+                                   p_debug->reverse_end_pc)) {
+    debug_reverse_cancel(p_debug);
+    return 1;
+  }
+  if (found_ticks == -1) {
+    debug_reverse_cancel(p_debug);
+    (void) printf("no earlier %s\n",
+                  p_debug->reverse_is_step ? "instruction" : "breakpoint hit");
+    return 1;
+  }
+  if (!debug_reverse_start(p_debug,
+                           k_debug_reverse_arrive,
+                           (uint64_t) found_ticks,
+                           p_debug->reverse_found_pc)) {
+    (void) printf("replay ended during reverse execution\n");
+    return 1;
+  }
+
+  return 0;
+}
+
 static void*
 debug_callback_common(struct debug_struct* p_debug,
                       struct cpu_driver* p_cpu_driver,
@@ -1899,6 +2310,13 @@ debug_callback_common(struct debug_struct* p_debug,
   volatile int* p_interrupt_received = &s_interrupt_received;
   int break_print = 0;
   int break_stop = 0;
+  struct cpu_driver* p_bbc_cpu_driver = bbc_get_cpu_driver(p_debug->p_bbc);
+
+  /* Quitting, so no more stops before the CPU notices. */
+  if (p_bbc_cpu_driver->p_funcs->get_flags(p_bbc_cpu_driver) &
+      k_cpu_flag_exited) {
+    return ret_intel_pc;
+  }
 
   state_6502_get_registers(p_state_6502,
                            &p_debug->reg_a,
@@ -2021,6 +2439,11 @@ debug_callback_common(struct debug_struct* p_debug,
     }
   }
 
+  if (p_debug->reverse_mode != k_debug_reverse_off) {
+    break_stop = debug_reverse_check(p_debug, break_stop);
+    break_print = break_stop;
+  }
+
   if (*p_interrupt_received || !p_debug->debug_running) {
     *p_interrupt_received = 0;
     break_print = 1;
@@ -2040,6 +2463,9 @@ debug_callback_common(struct debug_struct* p_debug,
 
   if (break_stop) {
     p_debug->debug_running = 0;
+    if (p_debug->reverse_mode != k_debug_reverse_off) {
+      debug_reverse_cancel(p_debug);
+    }
   }
 
   if (p_debug->debug_running) {
@@ -2163,7 +2589,17 @@ debug_callback_common(struct debug_struct* p_debug,
     }
 
     if (!strcmp(p_command, "q")) {
-      exit(0);
+      /* Stop the CPU rather than exit() here, so that the main thread shuts
+       * everything down and queued disc writes land. The CPU notices at its
+       * next timer expiry.
+       */
+      struct cpu_driver* p_quit_cpu_driver = bbc_get_cpu_driver(p_bbc);
+      p_quit_cpu_driver->p_funcs->apply_flags(p_quit_cpu_driver,
+                                              k_cpu_flag_exited,
+                                              0);
+      p_quit_cpu_driver->p_funcs->set_exit_value(p_quit_cpu_driver,
+                                                 0xFFFFFFFF);
+      break;
     } else if (!strcmp(p_command, "bail")) {
       util_bail("debug bail (command)");
     } else if (!strcmp(p_command, "p")) {
@@ -2201,6 +2637,7 @@ debug_callback_common(struct debug_struct* p_debug,
       break;
     } else if (!strcmp(p_command, "n") || !strcmp(p_command, "next")) {
       p_debug->next_or_finish_stop_addr = (p_debug->reg_pc + oplen);
+      p_debug->watch_generation++;
       p_debug->debug_running = 1;
       break;
     } else if (!strcmp(p_command, "f")) {
@@ -2212,6 +2649,7 @@ debug_callback_common(struct debug_struct* p_debug,
       finish_addr++;
       (void) printf("finish will stop at $%.4"PRIX16"\n", finish_addr);
       p_debug->next_or_finish_stop_addr = finish_addr;
+      p_debug->watch_generation++;
       p_debug->debug_running = 1;
       break;
     } else if (!strcmp(p_command, "m")) {
@@ -2236,6 +2674,25 @@ debug_callback_common(struct debug_struct* p_debug,
         ticks_delta = (parse_u64_int - ticks);
         (void) timing_start_timer_with_value(p_timing, timer_id, ticks_delta);
       }
+    } else if (!strcmp(p_command, "rs") || !strcmp(p_command, "rc")) {
+      uint64_t ticks = timing_get_total_timer_ticks(p_debug->p_timing);
+      p_debug->reverse_is_step = !strcmp(p_command, "rs");
+      p_debug->reverse_found_ticks = -1;
+      if (!p_debug->debug_active) {
+        (void) printf("reverse execution needs -debug\n");
+      } else if (!bbc_replay_is_deterministic(p_bbc)) {
+        (void) printf("reverse execution needs -accurate and no writeable "
+                      "discs\n");
+      } else if (debug_reverse_start(p_debug,
+                                     k_debug_reverse_search,
+                                     ticks,
+                                     p_debug->reg_pc)) {
+        p_debug->debug_running = 1;
+        break;
+      } else {
+        (void) printf("reverse execution needs a capture or replay, and no "
+                      "tube\n");
+      }
     } else if (!strcmp(p_command, "seek")) {
       (void) bbc_replay_seek(p_bbc, (parse_int * 2000000ull));
       p_debug->debug_running = 1;
@@ -2257,13 +2714,14 @@ debug_callback_common(struct debug_struct* p_debug,
                (parse_int >= 0) &&
                (parse_int < k_max_break)) {
       debug_clear_breakpoint(p_debug, parse_int);
-      debug_calculate_max_breakpoint(p_debug);
+      debug_calculate_breakpoints(p_debug);
     } else if (!strcmp(p_command, "enable") &&
                (parse_int >= 0) &&
                (parse_int < k_max_break)) {
       struct debug_breakpoint* p_breakpoint = &p_debug->breakpoints[parse_int];
       if (p_breakpoint->is_in_use) {
         p_breakpoint->is_enabled = 1;
+        debug_calculate_breakpoints(p_debug);
       }
     } else if (!strcmp(p_command, "disable") &&
                (parse_int >= 0) &&
@@ -2271,6 +2729,7 @@ debug_callback_common(struct debug_struct* p_debug,
       struct debug_breakpoint* p_breakpoint = &p_debug->breakpoints[parse_int];
       if (p_breakpoint->is_in_use) {
         p_breakpoint->is_enabled = 0;
+        debug_calculate_breakpoints(p_debug);
       }
     } else if (!strcmp(p_command, "eval") && (p_param_1_str != NULL)) {
       int64_t expression_ret;
@@ -2357,6 +2816,16 @@ debug_callback_common(struct debug_struct* p_debug,
                (parse_hex_int3 >= 0) &&
                (parse_hex_int3 < 65536)) {
       debug_save_raw(p_debug, p_param_1_str, parse_hex_int2, parse_hex_int3);
+    } else if (!strcmp(p_command, "snap")) {
+      if (p_debug->p_snapshot != NULL) {
+        bbc_free_memory_snapshot(p_debug->p_snapshot);
+      }
+      p_debug->p_snapshot = bbc_snapshot_memory(p_bbc);
+    } else if (!strcmp(p_command, "snapdiff")) {
+      debug_snapshot_diff(p_debug);
+    } else if (!strcmp(p_command, "snaprestore") &&
+               (p_debug->p_snapshot != NULL)) {
+      bbc_restore_memory(p_bbc, p_debug->p_snapshot);
     } else if (!strcmp(p_command, "ss")) {
       state_save(p_bbc, p_param_1_str);
     } else if (!strcmp(p_command, "d")) {
@@ -2526,6 +2995,9 @@ debug_callback_common(struct debug_struct* p_debug,
   "find <a> <l> ...   : find a byte sequence, starting at <a>, length <l>\n"
   "loadmem <f> <a>    : load memory to <a> from raw file <f>\n"
   "savemem <f> <a> <l>: save memory from <a>, length <l> to raw file <f>\n"
+  "snap               : take a snapshot of RAM\n"
+  "snapdiff           : list RAM changes since the snapshot\n"
+  "snaprestore        : restore RAM from the snapshot\n"
   "sys                : show system VIA registers\n"
   "user               : show user VIA registers\n"
   "r                  : show regular registers\n"
@@ -2560,6 +3032,8 @@ debug_callback_common(struct debug_struct* p_debug,
   "ss <f>             : save state to BEM file <f> (deprecated)\n"
   "fast               : toggle fast mode on/off\n"
   "seek <s>           : seek a replay file to <s> seconds\n"
+  "rs                 : reverse step, back one instruction (needs replay)\n"
+  "rc                 : reverse continue, back to the previous break\n"
   "bail               : exit emulator with failure code\n"
   "sn                 : dump SN76489 state\n"
   );
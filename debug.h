@@ -22,4 +22,23 @@ void debug_set_commands(struct debug_struct* p_debug, const char* p_commands);
 
 void* debug_callback(struct cpu_driver* p_cpu_driver, int do_irq);
 
+/* For CPU drivers that only call the debugger for instructions it is watching,
+ * instead of before every instruction.
+ * While debug_needs_every_instruction() is true, every instruction must be
+ * seen, e.g. when single stepping.
+ * debug_is_instruction_watched() is for compiling. It is conservative for
+ * memory breakpoints with addresses only known at run time. The answer stays
+ * valid until the watch generation changes.
+ */
+int debug_needs_every_instruction(struct debug_struct* p_debug);
+int debug_is_instruction_watched(struct debug_struct* p_debug,
+                                 uint16_t addr_6502,
+                                 uint8_t opcode,
+                                 uint8_t operand1,
+                                 uint8_t operand2);
+int debug_has_memory_watches(struct debug_struct* p_debug);
+uint32_t debug_get_watch_generation(struct debug_struct* p_debug);
+/* Called when a replay seek has reset the machine and rewound the replay. */
+void debug_replay_rewound(struct debug_struct* p_debug);
+
 #endif /* BEEBJIT_DEBUG_H */
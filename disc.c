@@ -10,24 +10,61 @@
 #include "disc_scp.h"
 #include "disc_ssd.h"
 #include "disc_tool.h"
+#include "disc_writer.h"
 #include "ibm_disc_format.h"
 #include "log.h"
+#include "os_lock.h"
+#include "os_thread.h"
+#include "os_time.h"
 #include "util.h"
+#include "util_compress.h"
 
 #include <assert.h>
+#include <inttypes.h>
 #include <math.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 
+enum {
+  /* Around 530kB of resident track data per disc. */
+  k_disc_default_max_resident_tracks = 40,
+  k_disc_min_resident_tracks = 4,
+  k_disc_max_convert_threads = 64,
+  k_disc_max_rev_cache_size = 16384,
+};
+
+/* What to look for in a bare zip. Raw KryoFlux needs its sibling files, so it
+ * can't come from an archive.
+ */
+static const char* s_p_disc_extensions[] = {
+  "ssd", "dsd", "adl", "fsd", "rfi", "scp", "dfi", "hfe", NULL,
+};
+
+/* For disc:auto-rev, the best scoring revolution of each track. Shared with
+ * the decode threads, which each write only the tracks they decode.
+ */
+struct disc_rev_choice {
+  int32_t rev;
+  int32_t score;
+};
+
+struct disc_rev_choices {
+  int is_final;
+  struct disc_rev_choice choices[2][k_ibm_disc_tracks_per_disc];
+  /* The cache of choices is keyed on the content of the image. */
+  uint32_t cache_crc;
+  uint64_t cache_size;
+};
+
 struct disc_track {
   uint32_t length;
+  /* Written tracks can't be re-decoded from the file, so are never evicted. */
+  int is_written;
+  uint64_t last_used;
   uint32_t pulses2us[k_disc_max_bytes_per_track];
 };
 
-struct disc_side {
-  struct disc_track tracks[k_ibm_disc_tracks_per_disc];
-};
-
 struct disc_struct {
   /* Options. */
   int log_protection;
@@ -38,15 +75,27 @@ struct disc_struct {
   int is_skip_upper_side;
   uint32_t rev;
   char rev_spec[256];
+  int is_auto_rev;
+  /* Where auto rev choices are cached, if anywhere. */
+  int is_rev_cache_beside;
+  char* p_rev_cache_dir;
+  uint32_t num_decode_threads;
 
   char* p_file_name;
+  /* Differs from the file name for compressed images. */
+  char* p_plain_file_name;
+  int is_compressed;
   struct util_file* p_file;
+  /* Set for writeable HFEs, which are written back block by block. */
+  struct disc_writer_struct* p_writer;
   uint8_t* p_format_metadata;
   void (*p_write_track_callback)(struct disc_struct* p_disc,
                                  int is_side_upper,
                                  uint32_t track,
                                  uint32_t length,
-                                 uint32_t* p_pulses);
+                                 uint32_t* p_pulses,
+                                 uint32_t dirty_start,
+                                 uint32_t dirty_end);
 
   /* State of the disc. */
   int is_ssd;
@@ -59,18 +108,40 @@ struct disc_struct {
   int is_scp;
   int is_dfi;
   int is_hfe;
-  struct disc_side lower_side;
-  struct disc_side upper_side;
+  /* Tracks are allocated on first access. Formats that can decode a single
+   * track register a loader, which lets decoding be deferred until the drive
+   * first seeks to the track, and lets clean tracks be evicted, LRU, to bound
+   * memory use.
+   */
+  struct disc_track* p_tracks[2][k_ibm_disc_tracks_per_disc];
+  uint8_t surface_byte;
+  void (*p_load_track_callback)(struct disc_struct* p_disc,
+                                int is_side_upper,
+                                uint32_t track);
+  uint32_t max_resident_tracks;
+  uint32_t num_resident_tracks;
+  uint64_t track_use_counter;
   int is_double_sided;
   uint32_t tracks_used;
   int is_writeable;
   int is_mutable_requested;
   int is_mutable;
   int had_first_load;
+  /* While probing, loaders record a bad file here instead of bailing. */
+  int is_load_probe;
+  int has_load_error;
+  char load_error[256];
 
   int is_dirty;
   int32_t dirty_side;
   int32_t dirty_track;
+  /* Range of written track positions, end exclusive. */
+  uint32_t dirty_start;
+  uint32_t dirty_end;
+
+  /* Revolution selection. */
+  struct disc_rev_choices* p_rev_choices;
+  struct disc_track* p_best_track;
 
   /* Track building. */
   struct disc_track* p_track;
@@ -81,28 +152,550 @@ struct disc_struct {
 };
 
 static void
-disc_init_surface(struct disc_struct* p_disc, uint8_t byte) {
-  uint32_t i;
-  for (i = 0; i < k_ibm_disc_tracks_per_disc; ++i) {
-    p_disc->lower_side.tracks[i].length = k_ibm_disc_bytes_per_track;
-    (void) memset(&p_disc->lower_side.tracks[i].pulses2us,
-                  byte,
-                  sizeof(p_disc->lower_side.tracks[i].pulses2us));
-    p_disc->upper_side.tracks[i].length = k_ibm_disc_bytes_per_track;
-    (void) memset(&p_disc->upper_side.tracks[i].pulses2us,
-                  byte,
-                  sizeof(p_disc->upper_side.tracks[i].pulses2us));
+disc_free_tracks(struct disc_struct* p_disc) {
+  uint32_t i_side;
+  uint32_t i_track;
+
+  for (i_side = 0; i_side < 2; ++i_side) {
+    for (i_track = 0; i_track < k_ibm_disc_tracks_per_disc; ++i_track) {
+      struct disc_track* p_track = p_disc->p_tracks[i_side][i_track];
+      if (p_track != NULL) {
+        util_free(p_track);
+        p_disc->p_tracks[i_side][i_track] = NULL;
+      }
+    }
   }
+  p_disc->num_resident_tracks = 0;
+}
+
+static void
+disc_init_surface(struct disc_struct* p_disc, uint8_t byte) {
+  disc_free_tracks(p_disc);
+  p_disc->surface_byte = byte;
+  p_disc->p_load_track_callback = NULL;
 
   p_disc->tracks_used = 0;
   p_disc->is_double_sided = 0;
 }
 
+static void
+disc_evict_track(struct disc_struct* p_disc) {
+  uint32_t i_side;
+  uint32_t i_track;
+  struct disc_track** p_p_victim = NULL;
+  uint64_t oldest = UINT64_MAX;
+
+  for (i_side = 0; i_side < 2; ++i_side) {
+    for (i_track = 0; i_track < k_ibm_disc_tracks_per_disc; ++i_track) {
+      struct disc_track* p_track = p_disc->p_tracks[i_side][i_track];
+      if ((p_track == NULL) || p_track->is_written) {
+        continue;
+      }
+      if (p_track->last_used < oldest) {
+        oldest = p_track->last_used;
+        p_p_victim = &p_disc->p_tracks[i_side][i_track];
+      }
+    }
+  }
+
+  if (p_p_victim == NULL) {
+    return;
+  }
+  util_free(*p_p_victim);
+  *p_p_victim = NULL;
+  p_disc->num_resident_tracks--;
+}
+
+static struct disc_track*
+disc_allocate_track(struct disc_struct* p_disc,
+                    int is_side_upper,
+                    uint32_t track) {
+  struct disc_track* p_track;
+
+  assert(track < k_ibm_disc_tracks_per_disc);
+
+  /* Only tracks that can be re-decoded are eligible for eviction. */
+  if ((p_disc->p_load_track_callback != NULL) &&
+      (p_disc->max_resident_tracks != 0) &&
+      (p_disc->num_resident_tracks >= p_disc->max_resident_tracks)) {
+    disc_evict_track(p_disc);
+  }
+
+  p_track = util_malloc(sizeof(struct disc_track));
+  p_track->length = k_ibm_disc_bytes_per_track;
+  p_track->is_written = 0;
+  p_track->last_used = p_disc->track_use_counter;
+  (void) memset(&p_track->pulses2us[0],
+                p_disc->surface_byte,
+                sizeof(p_track->pulses2us));
+  p_disc->p_tracks[!!is_side_upper][track] = p_track;
+  p_disc->num_resident_tracks++;
+
+  return p_track;
+}
+
+static struct disc_track*
+disc_materialize_track(struct disc_struct* p_disc,
+                       int is_side_upper,
+                       uint32_t track) {
+  struct disc_track* p_track = disc_allocate_track(p_disc,
+                                                   is_side_upper,
+                                                   track);
+
+  /* The loader builds into the track we just installed. */
+  if (p_disc->p_load_track_callback != NULL) {
+    p_disc->p_load_track_callback(p_disc, is_side_upper, track);
+  }
+
+  return p_track;
+}
+
+struct disc_load_job {
+  struct disc_struct* p_disc;
+  struct os_lock_struct* p_lock;
+  uint32_t num_todo;
+  uint32_t next_todo;
+  uint8_t todo_sides[2 * k_ibm_disc_tracks_per_disc];
+  uint8_t todo_tracks[2 * k_ibm_disc_tracks_per_disc];
+};
+
+static void*
+disc_load_thread(void* p) {
+  struct disc_load_job* p_job = (struct disc_load_job*) p;
+  struct disc_struct* p_parent = p_job->p_disc;
+  struct disc_struct* p_disc = util_malloc(sizeof(struct disc_struct));
+  uint8_t* p_mem;
+  uint64_t mem_size;
+
+  /* A private copy of the disc, with its own file handle and build state,
+   * that decodes straight into the parent's already allocated tracks. The
+   * format metadata is shared read only.
+   */
+  (void) memcpy(p_disc, p_parent, sizeof(struct disc_struct));
+  (void) memset(&p_disc->p_tracks[0][0], '\0', sizeof(p_disc->p_tracks));
+  p_disc->p_writer = NULL;
+  p_disc->p_best_track = NULL;
+  p_mem = util_file_get_memory(p_parent->p_file, &mem_size);
+  if (p_mem != NULL) {
+    p_disc->p_file = util_file_open_memory(p_mem, mem_size, 0);
+  } else {
+    p_disc->p_file = util_file_open(p_parent->p_file_name, 0, 0);
+  }
+
+  while (1) {
+    uint32_t index;
+    int is_side_upper;
+    uint32_t track;
+
+    os_lock_lock(p_job->p_lock);
+    index = p_job->next_todo;
+    if (index < p_job->num_todo) {
+      p_job->next_todo++;
+    }
+    os_lock_unlock(p_job->p_lock);
+    if (index == p_job->num_todo) {
+      break;
+    }
+
+    is_side_upper = p_job->todo_sides[index];
+    track = p_job->todo_tracks[index];
+    p_disc->p_tracks[is_side_upper][track] =
+        p_parent->p_tracks[is_side_upper][track];
+    p_disc->p_load_track_callback(p_disc, is_side_upper, track);
+    p_disc->p_tracks[is_side_upper][track] = NULL;
+  }
+
+  util_file_close(p_disc->p_file);
+  util_free(p_disc->p_best_track);
+  util_free(p_disc);
+
+  return NULL;
+}
+
+static void
+disc_load_tracks_in_parallel(struct disc_struct* p_disc, uint32_t num_threads) {
+  struct os_thread_struct* p_threads[k_disc_max_convert_threads];
+  struct disc_load_job job;
+  uint32_t i_track;
+  uint32_t i_side;
+  uint32_t i;
+
+  uint32_t num_tracks = p_disc->tracks_used;
+  uint32_t num_sides = (p_disc->is_double_sided ? 2 : 1);
+
+  /* Tracks are allocated up front by this thread, so the workers only ever
+   * touch their own track buffers.
+   */
+  (void) memset(&job, '\0', sizeof(job));
+  job.p_disc = p_disc;
+  for (i_track = 0; i_track < num_tracks; ++i_track) {
+    for (i_side = 0; i_side < num_sides; ++i_side) {
+      if (p_disc->p_tracks[i_side][i_track] != NULL) {
+        continue;
+      }
+      (void) disc_allocate_track(p_disc, i_side, i_track);
+      job.todo_sides[job.num_todo] = i_side;
+      job.todo_tracks[job.num_todo] = i_track;
+      job.num_todo++;
+    }
+  }
+
+  if (num_threads > job.num_todo) {
+    num_threads = job.num_todo;
+  }
+  if (num_threads == 0) {
+    return;
+  }
+
+  job.p_lock = os_lock_create();
+  for (i = 0; i < num_threads; ++i) {
+    p_threads[i] = os_thread_create(disc_load_thread, &job);
+  }
+  for (i = 0; i < num_threads; ++i) {
+    (void) os_thread_destroy(p_threads[i]);
+  }
+  os_lock_destroy(job.p_lock);
+}
+
+static void
+disc_load_all_tracks(struct disc_struct* p_disc) {
+  uint32_t i_track;
+  uint32_t num_tracks = p_disc->tracks_used;
+
+  /* Pin everything in memory, e.g. before the file is swapped out from under
+   * the track loader.
+   */
+  p_disc->max_resident_tracks = 0;
+  if ((p_disc->p_load_track_callback != NULL) &&
+      (p_disc->num_decode_threads > 1)) {
+    disc_load_tracks_in_parallel(p_disc, p_disc->num_decode_threads);
+  }
+  for (i_track = 0; i_track < num_tracks; ++i_track) {
+    (void) disc_get_raw_pulses_buffer(p_disc, 0, i_track);
+    if (p_disc->is_double_sided) {
+      (void) disc_get_raw_pulses_buffer(p_disc, 1, i_track);
+    }
+  }
+}
+
+static void
+disc_close_file(struct disc_struct* p_disc) {
+  /* Destroying the writer waits for any queued writes to land. */
+  if (p_disc->p_writer != NULL) {
+    disc_writer_destroy(p_disc->p_writer);
+    p_disc->p_writer = NULL;
+  }
+  if (p_disc->p_file != NULL) {
+    util_file_close(p_disc->p_file);
+    p_disc->p_file = NULL;
+  }
+}
+
+static int32_t
+disc_score_track(struct disc_struct* p_disc,
+                 int is_side_upper,
+                 uint32_t track) {
+  uint32_t i;
+  uint32_t num_sectors;
+  struct disc_tool_sector* p_sectors;
+  int32_t score = 0;
+  struct disc_tool_struct* p_tool = disc_tool_create();
+
+  /* Side and track first, so the tool doesn't touch any other track. */
+  disc_tool_set_is_quiet(p_tool, 1);
+  disc_tool_set_is_side_upper(p_tool, is_side_upper);
+  disc_tool_set_track(p_tool, track);
+  disc_tool_set_disc(p_tool, p_disc);
+  disc_tool_find_sectors(p_tool);
+  p_sectors = disc_tool_get_sectors(p_tool, &num_sectors);
+
+  /* Good sectors count most, with CRC errors as a tie break. */
+  for (i = 0; i < num_sectors; ++i) {
+    if (!p_sectors[i].has_header_crc_error &&
+        !p_sectors[i].has_data_crc_error) {
+      score += 256;
+    } else {
+      score--;
+    }
+  }
+
+  disc_tool_destroy(p_tool);
+
+  return score;
+}
+
+static uint32_t
+disc_add_file_to_crc(uint32_t crc, uint64_t* p_size, struct util_file* p_file) {
+  uint8_t buf[65536];
+  uint64_t len;
+
+  util_file_seek(p_file, 0);
+  do {
+    len = util_file_read(p_file, &buf[0], sizeof(buf));
+    crc = util_crc32_add(crc, &buf[0], len);
+    *p_size += len;
+  } while (len == sizeof(buf));
+  util_file_seek(p_file, 0);
+
+  return crc;
+}
+
+static void
+disc_get_rev_cache_key(struct disc_struct* p_disc,
+                       uint32_t* p_crc,
+                       uint64_t* p_size) {
+  uint32_t crc = util_crc32_init();
+  uint64_t size = 0;
+
+  crc = disc_add_file_to_crc(crc, &size, p_disc->p_file);
+  /* The disc's file is only track 0 of a KryoFlux image. */
+  if (p_disc->is_raw) {
+    uint32_t i_track;
+    char* p_file_name_base;
+    char* p_file_name;
+    util_file_name_split(&p_file_name_base,
+                         &p_file_name,
+                         p_disc->p_file_name);
+    for (i_track = 1; i_track < k_ibm_disc_tracks_per_disc; ++i_track) {
+      struct util_file* p_file = disc_kryo_try_open_track(p_file_name_base,
+                                                          i_track);
+      if (p_file == NULL) {
+        break;
+      }
+      crc = disc_add_file_to_crc(crc, &size, p_file);
+      util_file_close(p_file);
+    }
+    util_free(p_file_name_base);
+    util_free(p_file_name);
+  }
+
+  *p_crc = util_crc32_finish(crc);
+  *p_size = size;
+}
+
+static int
+disc_get_rev_cache_file_name(struct disc_struct* p_disc,
+                             char* p_buf,
+                             size_t size) {
+  /* Only when asked for: beside the image, or in a cache directory. The
+   * directory is shared by images of the same name, so the key is in the
+   * name.
+   */
+  if (p_disc->p_rev_cache_dir != NULL) {
+    char* p_file_name_base;
+    char* p_file_name;
+    char* p_path;
+    util_file_name_split(&p_file_name_base,
+                         &p_file_name,
+                         p_disc->p_plain_file_name);
+    p_path = util_file_name_join(p_disc->p_rev_cache_dir, p_file_name);
+    (void) snprintf(p_buf,
+                    size,
+                    "%s-%.8X.revs",
+                    p_path,
+                    p_disc->p_rev_choices->cache_crc);
+    util_free(p_path);
+    util_free(p_file_name_base);
+    util_free(p_file_name);
+    return 1;
+  }
+  if (p_disc->is_rev_cache_beside) {
+    (void) snprintf(p_buf, size, "%s.revs", p_disc->p_plain_file_name);
+    return 1;
+  }
+  return 0;
+}
+
+static int
+disc_read_rev_cache(struct disc_struct* p_disc) {
+  char file_name[4096];
+  char buf[k_disc_max_rev_cache_size];
+  struct util_file* p_file;
+  uint64_t len;
+  uint32_t cache_crc;
+  uint64_t cache_size;
+  char* p_line;
+  struct disc_rev_choices* p_rev_choices = p_disc->p_rev_choices;
+
+  if (!disc_get_rev_cache_file_name(p_disc,
+                                    &file_name[0],
+                                    sizeof(file_name))) {
+    return 0;
+  }
+  p_file = util_file_try_read_open(&file_name[0]);
+  if (p_file == NULL) {
+    return 0;
+  }
+  len = util_file_read(p_file, &buf[0], (sizeof(buf) - 1));
+  util_file_close(p_file);
+  buf[len] = '\0';
+
+  /* A cache for a different version of the image is ignored. */
+  if ((sscanf(buf,
+              "beebjit-revs %"SCNx32" %"SCNu64,
+              &cache_crc,
+              &cache_size) != 2) ||
+      (cache_crc != p_rev_choices->cache_crc) ||
+      (cache_size != p_rev_choices->cache_size)) {
+    return 0;
+  }
+  p_line = strchr(buf, '\n');
+  while (p_line != NULL) {
+    uint32_t side;
+    uint32_t track;
+    int32_t rev;
+    int32_t score;
+    p_line++;
+    if (sscanf(p_line,
+               "%"PRIu32" %"PRIu32" %"PRId32" %"PRId32,
+               &side,
+               &track,
+               &rev,
+               &score) == 4) {
+      if ((side < 2) && (track < k_ibm_disc_tracks_per_disc) && (rev >= 0)) {
+        p_rev_choices->choices[side][track].rev = rev;
+        p_rev_choices->choices[side][track].score = score;
+      }
+    }
+    p_line = strchr(p_line, '\n');
+  }
+
+  log_do_log(k_log_disc, k_log_info, "using cached revs: %s", file_name);
+
+  return 1;
+}
+
+static void
+disc_write_rev_cache(struct disc_struct* p_disc) {
+  char file_name[4096];
+  char line[64];
+  struct util_file* p_file;
+  uint32_t i_side;
+  uint32_t i_track;
+  int len;
+  struct disc_rev_choices* p_rev_choices = p_disc->p_rev_choices;
+
+  if (!disc_get_rev_cache_file_name(p_disc,
+                                    &file_name[0],
+                                    sizeof(file_name))) {
+    return;
+  }
+  p_file = util_file_try_open(&file_name[0], 1, 1);
+  if (p_file == NULL) {
+    log_do_log(k_log_disc,
+               k_log_warning,
+               "couldn't write rev cache %s",
+               file_name);
+    return;
+  }
+
+  len = snprintf(line,
+                 sizeof(line),
+                 "beebjit-revs %.8"PRIX32" %"PRIu64"\n",
+                 p_rev_choices->cache_crc,
+                 p_rev_choices->cache_size);
+  util_file_write(p_file, line, len);
+  for (i_side = 0; i_side < 2; ++i_side) {
+    for (i_track = 0; i_track < k_ibm_disc_tracks_per_disc; ++i_track) {
+      struct disc_rev_choice* p_choice =
+          &p_rev_choices->choices[i_side][i_track];
+      if (p_choice->rev < 0) {
+        continue;
+      }
+      len = snprintf(line,
+                     sizeof(line),
+                     "%"PRIu32" %"PRIu32" %"PRId32" %"PRId32"\n",
+                     i_side,
+                     i_track,
+                     p_choice->rev,
+                     p_choice->score);
+      util_file_write(p_file, line, len);
+    }
+  }
+  util_file_close(p_file);
+}
+
+static void
+disc_start_rev_choices(struct disc_struct* p_disc) {
+  uint32_t i_side;
+  uint32_t i_track;
+  struct disc_rev_choices* p_rev_choices = p_disc->p_rev_choices;
+
+  for (i_side = 0; i_side < 2; ++i_side) {
+    for (i_track = 0; i_track < k_ibm_disc_tracks_per_disc; ++i_track) {
+      p_rev_choices->choices[i_side][i_track].rev = -1;
+      p_rev_choices->choices[i_side][i_track].score = 0;
+    }
+  }
+  if (p_disc->is_rev_cache_beside || (p_disc->p_rev_cache_dir != NULL)) {
+    /* Leaves the file at the start, ready for the format loader. */
+    disc_get_rev_cache_key(p_disc,
+                           &p_rev_choices->cache_crc,
+                           &p_rev_choices->cache_size);
+    p_rev_choices->is_final = disc_read_rev_cache(p_disc);
+  }
+}
+
+static void
+disc_finish_rev_choices(struct disc_struct* p_disc) {
+  uint32_t i_side;
+  uint32_t i_track;
+  uint32_t num_tracks;
+  uint32_t num_changed;
+  uint32_t max_resident_tracks;
+  struct disc_rev_choices* p_rev_choices = p_disc->p_rev_choices;
+
+  if (p_rev_choices->is_final) {
+    return;
+  }
+
+  /* Formats that load lazily haven't seen any revolutions yet, so decode the
+   * whole disc now. Eager formats have already been through every
+   * revolution.
+   */
+  if (p_disc->p_load_track_callback != NULL) {
+    max_resident_tracks = p_disc->max_resident_tracks;
+    p_disc->max_resident_tracks = 0;
+    disc_load_tracks_in_parallel(p_disc, p_disc->num_decode_threads);
+    p_disc->max_resident_tracks = max_resident_tracks;
+    while ((max_resident_tracks != 0) &&
+           (p_disc->num_resident_tracks > max_resident_tracks)) {
+      disc_evict_track(p_disc);
+    }
+  }
+  p_rev_choices->is_final = 1;
+
+  num_tracks = 0;
+  num_changed = 0;
+  for (i_side = 0; i_side < 2; ++i_side) {
+    for (i_track = 0; i_track < k_ibm_disc_tracks_per_disc; ++i_track) {
+      int32_t rev = p_rev_choices->choices[i_side][i_track].rev;
+      if (rev < 0) {
+        continue;
+      }
+      num_tracks++;
+      if ((uint32_t) rev != p_disc->rev) {
+        num_changed++;
+      }
+    }
+  }
+  log_do_log(k_log_disc,
+             k_log_info,
+             "auto rev: %"PRIu32" tracks scored, %"PRIu32" not using rev "
+                 "%"PRIu32,
+             num_tracks,
+             num_changed,
+             p_disc->rev);
+
+  disc_write_rev_cache(p_disc);
+}
+
 static void
 disc_do_convert(struct disc_struct* p_disc,
                 int do_convert_to_hfe,
                 int do_convert_to_ssd,
-                int do_convert_to_adl) {
+                int do_convert_to_adl,
+                uint64_t start_us) {
   const char* p_file_name;
   int do_write_all_tracks;
 
@@ -111,8 +704,17 @@ disc_do_convert(struct disc_struct* p_disc,
   }
 
   disc_load(p_disc);
+  disc_load_all_tracks(p_disc);
+  /* The source format's loader and metadata are done with, and the HFE writer
+   * needs its own metadata.
+   */
+  p_disc->p_load_track_callback = NULL;
+  if (p_disc->p_format_metadata != NULL) {
+    util_free(p_disc->p_format_metadata);
+    p_disc->p_format_metadata = NULL;
+  }
 
-  p_file_name = p_disc->p_file_name;
+  p_file_name = p_disc->p_plain_file_name;
   do_write_all_tracks = 0;
 
   if (do_convert_to_hfe && !p_disc->is_hfe) {
@@ -122,9 +724,10 @@ disc_do_convert(struct disc_struct* p_disc,
                     "%s.hfe",
                     p_file_name);
     log_do_log(k_log_disc, k_log_info, "converting to HFE: %s", new_file_name);
-    util_file_close(p_disc->p_file);
+    disc_close_file(p_disc);
     p_disc->p_file = util_file_open(new_file_name, 1, 1);
     disc_hfe_create_header(p_disc);
+    p_disc->p_writer = disc_writer_create(p_disc->p_file);
     p_disc->p_write_track_callback = disc_hfe_write_track;
     do_write_all_tracks = 1;
   } else if (do_convert_to_ssd && !p_disc->is_ssd && !p_disc->is_dsd) {
@@ -137,7 +740,7 @@ disc_do_convert(struct disc_struct* p_disc,
                     p_file_name,
                     p_suffix);
     log_do_log(k_log_disc, k_log_info, "converting to SSD: %s", new_file_name);
-    util_file_close(p_disc->p_file);
+    disc_close_file(p_disc);
     p_disc->p_file = util_file_open(new_file_name, 1, 1);
     p_disc->p_write_track_callback = disc_ssd_write_track;
     do_write_all_tracks = 1;
@@ -148,7 +751,7 @@ disc_do_convert(struct disc_struct* p_disc,
                     "%s.adl",
                     p_file_name);
     log_do_log(k_log_disc, k_log_info, "converting to ADL: %s", new_file_name);
-    util_file_close(p_disc->p_file);
+    disc_close_file(p_disc);
     p_disc->p_file = util_file_open(new_file_name, 1, 1);
     p_disc->p_write_track_callback = disc_adl_write_track;
     do_write_all_tracks = 1;
@@ -157,6 +760,8 @@ disc_do_convert(struct disc_struct* p_disc,
     uint32_t i_track;
     uint32_t num_tracks = disc_get_num_tracks_used(p_disc);
     int is_double_sided = disc_is_double_sided(p_disc);
+    uint32_t num_converted;
+    double secs;
     p_disc->is_mutable = 1;
     for (i_track = 0; i_track < num_tracks; ++i_track) {
       disc_dirty_and_flush(p_disc, 0, i_track);
@@ -164,6 +769,20 @@ disc_do_convert(struct disc_struct* p_disc,
         disc_dirty_and_flush(p_disc, 1, i_track);
       }
     }
+    if (p_disc->p_writer != NULL) {
+      disc_writer_sync(p_disc->p_writer);
+    }
+
+    num_converted = (num_tracks * (is_double_sided ? 2 : 1));
+    secs = ((os_time_get_us() - start_us) / 1000000.0);
+    log_do_log(k_log_disc,
+               k_log_info,
+               "converted %"PRIu32" tracks in %.3fs, %.1f tracks/sec, "
+                   "%"PRIu32" threads",
+               num_converted,
+               secs,
+               ((secs > 0.0) ? (num_converted / secs) : 0.0),
+               p_disc->num_decode_threads);
   }
 }
 
@@ -180,8 +799,10 @@ disc_create(const char* p_file_name,
   int do_log_catalog;
   int do_dump_sector_data;
   int do_extract_files;
-  int do_check_for_crc_errors = 0;
+  int do_check_for_crc_errors;
   char* p_rev_spec = NULL;
+  const char* p_plain_file_name;
+  uint64_t convert_start_us = 0;
 
   struct disc_struct* p_disc = util_mallocz(sizeof(struct disc_struct));
 
@@ -197,6 +818,8 @@ disc_create(const char* p_file_name,
                                         "disc:dump-sector-data");
   do_extract_files = util_has_option(p_options->p_opt_flags,
                                      "disc:extract-files");
+  do_check_for_crc_errors = util_has_option(p_options->p_opt_flags,
+                                            "disc:check-crc");
   p_disc->expand_to_80 = util_has_option(p_options->p_opt_flags,
                                          "disc:expand-to-80");
   p_disc->is_quantize_fm = util_has_option(p_options->p_opt_flags,
@@ -205,6 +828,14 @@ disc_create(const char* p_file_name,
                                                "disc:skip-odd-tracks");
   p_disc->is_skip_upper_side = util_has_option(p_options->p_opt_flags,
                                                "disc:skip-upper-side");
+  p_disc->max_resident_tracks = k_disc_default_max_resident_tracks;
+  (void) util_get_u32_option(&p_disc->max_resident_tracks,
+                             p_options->p_opt_flags,
+                             "disc:max-tracks=");
+  if ((p_disc->max_resident_tracks != 0) &&
+      (p_disc->max_resident_tracks < k_disc_min_resident_tracks)) {
+    p_disc->max_resident_tracks = k_disc_min_resident_tracks;
+  }
   p_disc->rev = 0;
   (void) util_get_u32_option(&p_disc->rev, p_options->p_opt_flags, "disc:rev=");
   (void) util_get_str_option(&p_rev_spec,
@@ -218,6 +849,10 @@ disc_create(const char* p_file_name,
     util_free(p_rev_spec);
   }
   p_disc->p_file_name = util_strdup(p_file_name);
+  p_disc->is_compressed = util_compress_is_compressed_name(p_file_name);
+  p_disc->p_plain_file_name =
+      util_compress_get_plain_name(p_file_name, s_p_disc_extensions);
+  p_plain_file_name = p_disc->p_plain_file_name;
   p_disc->p_file = NULL;
   p_disc->is_dirty = 0;
   p_disc->dirty_side = -1;
@@ -225,34 +860,74 @@ disc_create(const char* p_file_name,
   p_disc->tracks_used = 0;
   p_disc->is_double_sided = 0;
 
-  if (util_is_extension(p_file_name, "ssd")) {
+  if (util_is_extension(p_plain_file_name, "ssd")) {
     p_disc->is_ssd = 1;
     p_disc->p_write_track_callback = disc_ssd_write_track;
-  } else if (util_is_extension(p_file_name, "dsd")) {
+  } else if (util_is_extension(p_plain_file_name, "dsd")) {
     p_disc->is_dsd = 1;
     p_disc->p_write_track_callback = disc_ssd_write_track;
-  } else if (util_is_extension(p_file_name, "adl")) {
+  } else if (util_is_extension(p_plain_file_name, "adl")) {
     p_disc->is_adl = 1;
     p_disc->p_write_track_callback = disc_adl_write_track;
-  } else if (util_is_extension(p_file_name, "fsd")) {
+  } else if (util_is_extension(p_plain_file_name, "fsd")) {
     p_disc->is_fsd = 1;
-  } else if (util_is_extension(p_file_name, "log")) {
+  } else if (util_is_extension(p_plain_file_name, "log")) {
     p_disc->is_log = 1;
-  } else if (util_is_extension(p_file_name, "rfi")) {
+  } else if (util_is_extension(p_plain_file_name, "rfi")) {
     p_disc->is_rfi = 1;
-  } else if (util_is_extension(p_file_name, "raw")) {
+  } else if (util_is_extension(p_plain_file_name, "raw")) {
     p_disc->is_raw = 1;
-  } else if (util_is_extension(p_file_name, "scp")) {
+  } else if (util_is_extension(p_plain_file_name, "scp")) {
     p_disc->is_scp = 1;
-  } else if (util_is_extension(p_file_name, "dfi")) {
+  } else if (util_is_extension(p_plain_file_name, "dfi")) {
     p_disc->is_dfi = 1;
-  } else if (util_is_extension(p_file_name, "hfe")) {
+  } else if (util_is_extension(p_plain_file_name, "hfe")) {
     p_disc->is_hfe = 1;
     p_disc->p_write_track_callback = disc_hfe_write_track;
   } else {
     util_bail("unknown disc filename extension");
   }
 
+  /* Only the flux formats have more than one revolution to choose from. */
+  if (p_disc->is_raw || p_disc->is_scp || p_disc->is_dfi) {
+    p_disc->is_auto_rev = util_has_option(p_options->p_opt_flags,
+                                          "disc:auto-rev");
+  }
+  if (p_disc->is_auto_rev) {
+    p_disc->p_rev_choices = util_mallocz(sizeof(struct disc_rev_choices));
+    p_disc->is_rev_cache_beside = util_has_option(p_options->p_opt_flags,
+                                                  "disc:rev-cache-beside");
+    (void) util_get_str_option(&p_disc->p_rev_cache_dir,
+                               p_options->p_opt_flags,
+                               "disc:rev-cache-dir=");
+  }
+
+  /* Decoding of a whole disc, for conversions or revolution selection, is
+   * spread across threads, one track per task.
+   */
+  p_disc->num_decode_threads = 1;
+  if (do_convert_to_hfe ||
+      do_convert_to_ssd ||
+      do_convert_to_adl ||
+      p_disc->is_auto_rev) {
+    p_disc->num_decode_threads = os_thread_get_num_cpus();
+    (void) util_get_u32_option(&p_disc->num_decode_threads,
+                               p_options->p_opt_flags,
+                               "disc:convert-threads=");
+    if (p_disc->num_decode_threads == 0) {
+      p_disc->num_decode_threads = 1;
+    } else if (p_disc->num_decode_threads > k_disc_max_convert_threads) {
+      p_disc->num_decode_threads = k_disc_max_convert_threads;
+    }
+  }
+
+  if (is_mutable && p_disc->is_compressed) {
+    log_do_log(k_log_disc,
+               k_log_warning,
+               "cannot writeback to compressed file, making read only");
+    is_writeable = 0;
+    is_mutable = 0;
+  }
   if (is_mutable && (p_disc->p_write_track_callback == NULL)) {
     log_do_log(k_log_disc,
                k_log_warning,
@@ -267,10 +942,22 @@ disc_create(const char* p_file_name,
   p_disc->is_mutable = 0;
 
   /* The raw flux formats are often "hot off the press" from a Greaseweazle or
-   * similar device, so always check for CRC errors.
+   * similar device, so checking for CRC errors is useful. It decodes every
+   * track, so it's on request, or as part of a conversion.
    */
   if (p_disc->is_rfi || p_disc->is_raw || p_disc->is_scp || p_disc->is_dfi) {
-    do_check_for_crc_errors = 1;
+    if (do_convert_to_hfe || do_convert_to_ssd || do_convert_to_adl) {
+      do_check_for_crc_errors = 1;
+    }
+  }
+
+  /* When converting, decode everything up front so that the checks below
+   * don't decode tracks one at a time.
+   */
+  if (do_convert_to_hfe || do_convert_to_ssd || do_convert_to_adl) {
+    convert_start_us = os_time_get_us();
+    disc_load(p_disc);
+    disc_load_all_tracks(p_disc);
   }
 
   if (do_check_for_crc_errors ||
@@ -288,13 +975,15 @@ disc_create(const char* p_file_name,
                           do_fingerprint_tracks,
                           do_log_catalog,
                           do_dump_sector_data,
-                          do_extract_files);
+                          do_extract_files,
+                          NULL);
   }
 
   disc_do_convert(p_disc,
                   do_convert_to_hfe,
                   do_convert_to_ssd,
-                  do_convert_to_adl);
+                  do_convert_to_adl,
+                  convert_start_us);
 
   return p_disc;
 }
@@ -318,10 +1007,7 @@ disc_load(struct disc_struct* p_disc) {
     util_free(p_disc->p_format_metadata);
     p_disc->p_format_metadata = NULL;
   }
-  if (p_disc->p_file != NULL) {
-    util_file_close(p_disc->p_file);
-    p_disc->p_file = NULL;
-  }
+  disc_close_file(p_disc);
 
   disc_init_surface(p_disc, 0x00);
 
@@ -329,7 +1015,11 @@ disc_load(struct disc_struct* p_disc) {
     is_file_writeable = 1;
   }
 
-  p_disc->p_file = util_file_try_open(p_file_name, is_file_writeable, 0);
+  if (p_disc->is_compressed) {
+    p_disc->p_file = util_compress_open(p_file_name, s_p_disc_extensions);
+  } else {
+    p_disc->p_file = util_file_try_open(p_file_name, is_file_writeable, 0);
+  }
   if ((p_disc->p_file == NULL) && is_file_writeable) {
     log_do_log(k_log_disc,
                k_log_warning,
@@ -341,10 +1031,17 @@ disc_load(struct disc_struct* p_disc) {
     p_disc->is_writeable = 0;
   }
   if (p_disc->p_file == NULL) {
-    util_bail("couldn't open %s", p_file_name);
+    disc_load_fail(p_disc, "couldn't open %s", p_file_name);
+    return;
   }
 
   p_disc->is_mutable = is_file_writeable;
+  if (p_disc->is_hfe && is_file_writeable) {
+    p_disc->p_writer = disc_writer_create(p_disc->p_file);
+  }
+  if (p_disc->is_auto_rev) {
+    disc_start_rev_choices(p_disc);
+  }
 
   if (p_disc->is_ssd) {
     disc_ssd_load(p_disc, 0);
@@ -367,6 +1064,46 @@ disc_load(struct disc_struct* p_disc) {
   } else if (p_disc->is_hfe) {
     disc_hfe_load(p_disc, p_disc->expand_to_80);
   }
+
+  if (p_disc->is_auto_rev && !p_disc->has_load_error) {
+    disc_finish_rev_choices(p_disc);
+  }
+}
+
+const char*
+disc_try_load(struct disc_struct* p_disc) {
+  p_disc->is_load_probe = 1;
+  disc_load(p_disc);
+  p_disc->is_load_probe = 0;
+
+  if (p_disc->has_load_error) {
+    return &p_disc->load_error[0];
+  }
+  return NULL;
+}
+
+void
+disc_load_fail(struct disc_struct* p_disc, const char* p_msg, ...) {
+  va_list args;
+  char msg[sizeof(p_disc->load_error)];
+
+  va_start(args, p_msg);
+  (void) vsnprintf(msg, sizeof(msg), p_msg, args);
+  va_end(args);
+
+  if (!p_disc->is_load_probe) {
+    util_bail("%s", msg);
+  }
+  /* The first error is the interesting one. */
+  if (!p_disc->has_load_error) {
+    (void) strcpy(&p_disc->load_error[0], &msg[0]);
+    p_disc->has_load_error = 1;
+  }
+}
+
+int
+disc_has_load_failed(struct disc_struct* p_disc) {
+  return p_disc->has_load_error;
 }
 
 struct disc_struct*
@@ -382,6 +1119,7 @@ disc_create_from_raw(const char* p_file_name, const char* p_raw_spec) {
   disc_init_surface(p_disc, 0xFF);
 
   p_disc->p_file_name = util_strdup(p_file_name);
+  p_disc->p_plain_file_name = util_strdup(p_file_name);
   p_disc->p_file = util_file_open(p_file_name, 1, 1);
   p_disc->is_writeable = 1;
   p_disc->is_mutable_requested = 1;
@@ -435,14 +1173,17 @@ disc_destroy(struct disc_struct* p_disc) {
   if (p_disc->p_format_metadata != NULL) {
     util_free(p_disc->p_format_metadata);
   }
-  if (p_disc->p_file != NULL) {
-    util_file_close(p_disc->p_file);
-  }
+  disc_close_file(p_disc);
+  disc_free_tracks(p_disc);
+  util_free(p_disc->p_rev_choices);
+  util_free(p_disc->p_rev_cache_dir);
+  util_free(p_disc->p_best_track);
   util_free(p_disc->p_file_name);
+  util_free(p_disc->p_plain_file_name);
   util_free(p_disc);
 }
 
-static void
+void
 disc_set_track_used(struct disc_struct* p_disc,
                     int is_side_upper,
                     uint32_t track) {
@@ -493,12 +1234,22 @@ disc_write_pulses(struct disc_struct* p_disc,
   if (p_disc->is_dirty) {
     assert(is_side_upper == p_disc->dirty_side);
     assert(track == (uint32_t) p_disc->dirty_track);
+    if (pos < p_disc->dirty_start) {
+      p_disc->dirty_start = pos;
+    }
+    if (pos >= p_disc->dirty_end) {
+      p_disc->dirty_end = (pos + 1);
+    }
+  } else {
+    p_disc->dirty_start = pos;
+    p_disc->dirty_end = (pos + 1);
   }
 
   p_disc->is_dirty = 1;
   p_disc->dirty_side = is_side_upper;
   p_disc->dirty_track = track;
 
+  p_disc->p_tracks[!!is_side_upper][track]->is_written = 1;
   p_pulses[pos] = pulses;
 }
 
@@ -506,9 +1257,14 @@ void
 disc_dirty_and_flush(struct disc_struct* p_disc,
                      int is_side_upper,
                      uint32_t track) {
+  (void) disc_get_raw_pulses_buffer(p_disc, is_side_upper, track);
+  p_disc->p_tracks[!!is_side_upper][track]->is_written = 1;
+
   p_disc->is_dirty = 1;
   p_disc->dirty_side = is_side_upper;
   p_disc->dirty_track = track;
+  p_disc->dirty_start = 0;
+  p_disc->dirty_end = disc_get_track_length(p_disc, is_side_upper, track);
 
   disc_flush_writes(p_disc);
 }
@@ -544,8 +1300,13 @@ disc_flush_writes(struct disc_struct* p_disc) {
                                  is_side_upper,
                                  track,
                                  length,
-                                 p_pulses);
-  util_file_flush(p_disc->p_file);
+                                 p_pulses,
+                                 p_disc->dirty_start,
+                                 p_disc->dirty_end);
+  /* The writer thread flushes once per batch of writes. */
+  if (p_disc->p_writer == NULL) {
+    util_file_flush(p_disc->p_file);
+  }
 
   /* Mark the track used after the write track callback, so that the file
    * handler can tell if this was a file extension or not.
@@ -555,13 +1316,12 @@ disc_flush_writes(struct disc_struct* p_disc) {
 
 static struct disc_track*
 disc_get_track(struct disc_struct* p_disc, int is_side_upper, uint32_t track) {
-  struct disc_track* p_track;
+  struct disc_track* p_track = p_disc->p_tracks[!!is_side_upper][track];
 
-  if (is_side_upper) {
-    p_track = &p_disc->upper_side.tracks[track];
-  } else {
-    p_track = &p_disc->lower_side.tracks[track];
+  if (p_track == NULL) {
+    p_track = disc_materialize_track(p_disc, is_side_upper, track);
   }
+  p_track->last_used = ++p_disc->track_use_counter;
 
   return p_track;
 }
@@ -779,19 +1539,24 @@ disc_build_append_pulse_delta(struct disc_struct* p_disc, float delta_us) {
   return 1;
 }
 
-void
-disc_build_track_from_pulses(struct disc_struct* p_disc,
-                             uint32_t rev,
-                             int is_side_upper,
-                             uint32_t track,
-                             float* p_pulse_deltas,
-                             uint32_t num_pulses) {
+static void
+disc_do_build_track_from_pulses(struct disc_struct* p_disc,
+                                int is_side_upper,
+                                uint32_t track,
+                                float* p_pulse_deltas,
+                                uint32_t num_pulses) {
   uint32_t i_pulses;
   int did_truncation_warning;
 
-  (void) rev;
-
   disc_build_track(p_disc, is_side_upper, track);
+  /* Pulses are OR'ed in, so each revolution under consideration needs a
+   * blank track.
+   */
+  if (p_disc->is_auto_rev) {
+    (void) memset(&p_disc->p_track->pulses2us[0],
+                  p_disc->surface_byte,
+                  sizeof(p_disc->p_track->pulses2us));
+  }
 
   did_truncation_warning = 0;
   for (i_pulses = 0; i_pulses < num_pulses; ++i_pulses) {
@@ -822,6 +1587,80 @@ disc_build_track_from_pulses(struct disc_struct* p_disc,
   disc_build_set_track_length(p_disc);
 }
 
+void
+disc_build_track_from_pulses(struct disc_struct* p_disc,
+                             uint32_t rev,
+                             int is_side_upper,
+                             uint32_t track,
+                             float* p_pulse_deltas,
+                             uint32_t num_pulses) {
+  struct disc_rev_choice* p_choice;
+  struct disc_track* p_track;
+  int32_t score;
+
+  if (!p_disc->is_auto_rev) {
+    disc_do_build_track_from_pulses(p_disc,
+                                    is_side_upper,
+                                    track,
+                                    p_pulse_deltas,
+                                    num_pulses);
+    return;
+  }
+
+  if (!disc_is_rev_needed(p_disc, is_side_upper, track, rev)) {
+    return;
+  }
+  disc_do_build_track_from_pulses(p_disc,
+                                  is_side_upper,
+                                  track,
+                                  p_pulse_deltas,
+                                  num_pulses);
+  if (p_disc->p_rev_choices->is_final) {
+    return;
+  }
+
+  /* Still choosing: keep whichever revolution scores best so far in the
+   * track.
+   */
+  p_choice = &p_disc->p_rev_choices->choices[!!is_side_upper][track];
+  p_track = p_disc->p_track;
+  score = disc_score_track(p_disc, is_side_upper, track);
+  if (p_disc->p_best_track == NULL) {
+    p_disc->p_best_track = util_malloc(sizeof(struct disc_track));
+  }
+  if ((p_choice->rev < 0) || (score > p_choice->score)) {
+    p_choice->rev = rev;
+    p_choice->score = score;
+    (void) memcpy(p_disc->p_best_track, p_track, sizeof(struct disc_track));
+  } else {
+    p_track->length = p_disc->p_best_track->length;
+    (void) memcpy(&p_track->pulses2us[0],
+                  &p_disc->p_best_track->pulses2us[0],
+                  sizeof(p_track->pulses2us));
+  }
+}
+
+int
+disc_is_rev_needed(struct disc_struct* p_disc,
+                   int is_side_upper,
+                   uint32_t track,
+                   uint32_t rev) {
+  int32_t chosen_rev;
+
+  if (!p_disc->is_auto_rev) {
+    return (rev == p_disc->rev);
+  }
+  /* Every revolution is needed while choosing. */
+  if (!p_disc->p_rev_choices->is_final) {
+    return 1;
+  }
+  chosen_rev = p_disc->p_rev_choices->choices[!!is_side_upper][track].rev;
+  if (chosen_rev < 0) {
+    chosen_rev = p_disc->rev;
+  }
+  return (rev == (uint32_t) chosen_rev);
+}
+
 void
 disc_build_set_track_length(struct disc_struct* p_disc) {
   uint32_t build_index = p_disc->build_index;
@@ -838,9 +1677,34 @@ disc_get_file_name(struct disc_struct* p_disc) {
 
 struct util_file*
 disc_get_file(struct disc_struct* p_disc) {
+  /* Direct file access must see any queued writes. */
+  if (p_disc->p_writer != NULL) {
+    disc_writer_sync(p_disc->p_writer);
+  }
   return p_disc->p_file;
 }
 
+void
+disc_write_file(struct disc_struct* p_disc,
+                uint64_t pos,
+                const void* p_buf,
+                uint32_t length) {
+  if (p_disc->p_writer != NULL) {
+    disc_writer_write(p_disc->p_writer, pos, p_buf, length);
+  } else {
+    util_file_seek(p_disc->p_file, pos);
+    util_file_write(p_disc->p_file, p_buf, length);
+  }
+}
+
+void
+disc_set_track_loader(struct disc_struct* p_disc,
+                      void (*p_load_track_callback)(struct disc_struct* p_disc,
+                                                    int is_side_upper,
+                                                    uint32_t track)) {
+  p_disc->p_load_track_callback = p_load_track_callback;
+}
+
 uint8_t*
 disc_allocate_format_metadata(struct disc_struct* p_disc, size_t num_bytes) {
   uint8_t* p_format_metadata;
@@ -27,6 +27,11 @@ struct disc_struct* disc_create(const char* p_filename,
 struct disc_struct* disc_create_from_raw(const char* p_file_name,
                                          const char* p_raw_spec);
 void disc_load(struct disc_struct* p_disc);
+/* Like disc_load(), but a bad ssd, dsd, adl, fsd or hfe file doesn't bail.
+ * Returns NULL on success, or else why the file couldn't be loaded. The disc
+ * is then unusable other than to destroy it.
+ */
+const char* disc_try_load(struct disc_struct* p_disc);
 void disc_destroy(struct disc_struct* p_disc);
 
 int disc_is_double_sided(struct disc_struct* p_disc);
@@ -34,15 +39,46 @@ uint32_t disc_get_num_tracks_used(struct disc_struct* p_disc);
 int disc_is_skip_upper_side(struct disc_struct* p_disc);
 int disc_is_skip_odd_tracks(struct disc_struct* p_disc);
 uint32_t disc_get_required_rev(struct disc_struct* p_disc);
+/* Whether a flux loader should decode the given revolution of a track. With
+ * disc:auto-rev, this is every revolution until the best one per track has
+ * been chosen.
+ */
+int disc_is_rev_needed(struct disc_struct* p_disc,
+                       int is_side_upper,
+                       uint32_t track,
+                       uint32_t rev);
+
+/* For loaders to report a bad file. This bails, unless the load came from
+ * disc_try_load(), in which case it returns and the loader must give up.
+ */
+void disc_load_fail(struct disc_struct* p_disc, const char* p_msg, ...);
+int disc_has_load_failed(struct disc_struct* p_disc);
 
 const char* disc_get_file_name(struct disc_struct* p_disc);
 struct util_file* disc_get_file(struct disc_struct* p_disc);
+/* Writes to the disc file, queued to a background writer where there is one. */
+void disc_write_file(struct disc_struct* p_disc,
+                     uint64_t pos,
+                     const void* p_buf,
+                     uint32_t length);
 uint8_t* disc_allocate_format_metadata(struct disc_struct* p_disc,
                                        size_t num_bytes);
 void disc_set_track_length(struct disc_struct* p_disc,
                            int is_side_upper,
                            uint32_t track,
                            uint32_t length);
+void disc_set_track_used(struct disc_struct* p_disc,
+                         int is_side_upper,
+                         uint32_t track);
+/* Defers decoding of each track until first access. The loader should build
+ * the track, e.g. via disc_build_track(), and may be called again for a track
+ * if it was evicted.
+ */
+void disc_set_track_loader(struct disc_struct* p_disc,
+                           void (*p_load_track_callback)(
+                               struct disc_struct* p_disc,
+                               int is_side_upper,
+                               uint32_t track));
 
 int disc_is_double_sided(struct disc_struct* p_disc);
 int disc_is_write_protected(struct disc_struct* p_disc);
@@ -19,7 +19,9 @@ disc_adl_write_track(struct disc_struct* p_disc,
                      int is_side_upper,
                      uint32_t track,
                      uint32_t pulses_length,
-                     uint32_t* p_pulses) {
+                     uint32_t* p_pulses,
+                     uint32_t dirty_start,
+                     uint32_t dirty_end) {
   uint64_t seek_pos;
   uint32_t num_sectors;
   uint32_t i_sectors;
@@ -31,6 +33,9 @@ disc_adl_write_track(struct disc_struct* p_disc,
 
   (void) pulses_length;
   (void) p_pulses;
+  /* Sectors are re-decoded from the whole track. */
+  (void) dirty_start;
+  (void) dirty_end;
 
   seek_pos = (track_size * track);
   seek_pos *= 2;
@@ -100,15 +105,21 @@ disc_adl_load(struct disc_struct* p_disc) {
 
   file_size = util_file_get_size(p_file);
   if (file_size > max_size) {
-    util_bail("adl file too large");
+    disc_load_fail(p_disc, "adl file too large");
+    util_free(p_file_buf);
+    return;
   }
   if ((file_size % k_disc_adl_sector_size) != 0) {
-    util_bail("adl file not a sector multiple");
+    disc_load_fail(p_disc, "adl file not a sector multiple");
+    util_free(p_file_buf);
+    return;
   }
 
   read_ret = util_file_read(p_file, p_file_buf, file_size);
   if (read_ret != file_size) {
-    util_bail("adl file short read");
+    disc_load_fail(p_disc, "adl file short read");
+    util_free(p_file_buf);
+    return;
   }
 
   for (i_track = 0; i_track < k_disc_adl_tracks_per_disc; ++i_track) {
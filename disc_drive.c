@@ -25,6 +25,14 @@ struct disc_drive_struct {
   void (*p_pulses_callback)(void*, uint32_t, uint32_t);
   void* p_pulses_callback_object;
   int is_32us_mode;
+  int is_pulses_wanted;
+  /* While the controller doesn't want pulses, the timer only fires at index
+   * pulse edges. head_position is then the edge position, and the real head
+   * position is derived from the time remaining until the edge.
+   */
+  int is_skipping;
+  uint32_t skip_from_step;
+  uint32_t skip_ticks;
 
   /* Properties of the drive. */
   uint32_t id;
@@ -43,6 +51,10 @@ struct disc_drive_struct {
   uint32_t head_position;
   /* Extra precision for head position, needed for MFM. */
   uint32_t pulse_position;
+  /* Writes are coalesced across revolutions and only flushed to the disc file
+   * once a revolution passes without any writes, or the head moves.
+   */
+  int is_written_this_rev;
 };
 
 struct disc_struct*
@@ -98,6 +110,188 @@ disc_drive_get_track_length(struct disc_drive_struct* p_drive) {
   return track_length;
 }
 
+static uint32_t
+disc_get_index_end_position(uint32_t track_length) {
+  /* EMU: the 8271 datasheet says that the index pulse must be held for over
+   * 0.5us. Most drives are in the milisecond range.
+   */
+  double index_end = (track_length * (k_disc_index_ms / (double) 200));
+  uint32_t ret = (uint32_t) index_end;
+
+  if (ret < index_end) {
+    ret++;
+  }
+  return ret;
+}
+
+/* A "step" is one timer callback's worth of head movement: a byte, or half a
+ * byte in 32us mode.
+ */
+static uint32_t
+disc_drive_get_steps_per_byte(struct disc_drive_struct* p_drive) {
+  return (p_drive->is_32us_mode ? 2 : 1);
+}
+
+static uint32_t
+disc_drive_get_time_for_step(struct disc_drive_struct* p_drive,
+                             uint32_t track_length,
+                             uint32_t step) {
+  uint32_t steps_per_byte = disc_drive_get_steps_per_byte(p_drive);
+  uint32_t head_position = (step / steps_per_byte);
+  uint32_t pulse_position = ((step % steps_per_byte) * 16);
+
+  return disc_get_time_for_position(track_length,
+                                    head_position,
+                                    pulse_position);
+}
+
+static void
+disc_drive_set_step(struct disc_drive_struct* p_drive, uint32_t step) {
+  uint32_t steps_per_byte = disc_drive_get_steps_per_byte(p_drive);
+  p_drive->head_position = (step / steps_per_byte);
+  p_drive->pulse_position = ((step % steps_per_byte) * 16);
+}
+
+static void
+disc_drive_check_track_needs_write(struct disc_drive_struct* p_drive) {
+  struct disc_struct* p_disc = disc_drive_get_disc(p_drive);
+  if (p_disc != NULL) {
+    disc_flush_writes(p_disc);
+  }
+}
+
+static void
+disc_drive_start_skip(struct disc_drive_struct* p_drive) {
+  uint32_t track_length;
+  uint32_t steps_per_byte;
+  uint32_t num_steps;
+  uint32_t step;
+  uint32_t index_end_step;
+  uint32_t target_step;
+  uint32_t ticks;
+
+  assert(!p_drive->is_skipping);
+
+  if (p_drive->is_pulses_wanted) {
+    return;
+  }
+  if (!disc_drive_is_spinning(p_drive)) {
+    return;
+  }
+  /* Wait for any 32us mode half byte left over from a mode change. */
+  if (!p_drive->is_32us_mode && (p_drive->pulse_position != 0)) {
+    return;
+  }
+
+  track_length = disc_drive_get_track_length(p_drive);
+  steps_per_byte = disc_drive_get_steps_per_byte(p_drive);
+  num_steps = (track_length * steps_per_byte);
+  step = ((p_drive->head_position * steps_per_byte) +
+          (p_drive->pulse_position / 16));
+  index_end_step = (disc_get_index_end_position(track_length) *
+                    steps_per_byte);
+
+  /* The only bytes an idle controller cares about are the two index pulse
+   * edges.
+   */
+  if ((step == 0) || (step == index_end_step)) {
+    return;
+  }
+  if (step < index_end_step) {
+    target_step = index_end_step;
+  } else {
+    target_step = num_steps;
+  }
+  /* Nothing gets written while the controller is idle, so it's a good time to
+   * flush.
+   */
+  disc_drive_check_track_needs_write(p_drive);
+
+  ticks = (disc_drive_get_time_for_step(p_drive, track_length, target_step) -
+           disc_drive_get_time_for_step(p_drive, track_length, step));
+  (void) timing_adjust_timer_value(p_drive->p_timing,
+                                   NULL,
+                                   p_drive->timer_id,
+                                   ticks);
+
+  p_drive->is_skipping = 1;
+  p_drive->skip_from_step = step;
+  p_drive->skip_ticks = ticks;
+  disc_drive_set_step(p_drive, (target_step % num_steps));
+}
+
+static int
+disc_drive_sync_skip(struct disc_drive_struct* p_drive) {
+  /* Puts the head back where the per-step timer would have it, with the timer
+   * firing at the time of the next step.
+   */
+  uint32_t track_length;
+  uint32_t num_steps;
+  uint32_t step;
+  uint32_t from_ticks;
+  uint32_t step_ticks;
+  int64_t remaining;
+  int64_t elapsed;
+  int64_t time;
+  int is_wrapped;
+
+  if (!p_drive->is_skipping) {
+    return 0;
+  }
+  p_drive->is_skipping = 0;
+
+  remaining = timing_get_timer_value(p_drive->p_timing, p_drive->timer_id);
+  if (remaining <= 0) {
+    /* Index edge is due right now. */
+    return 1;
+  }
+
+  track_length = disc_drive_get_track_length(p_drive);
+  num_steps = (track_length * disc_drive_get_steps_per_byte(p_drive));
+  from_ticks = disc_drive_get_time_for_step(p_drive,
+                                            track_length,
+                                            p_drive->skip_from_step);
+  elapsed = ((int64_t) p_drive->skip_ticks - remaining);
+  if (elapsed < 0) {
+    step = p_drive->skip_from_step;
+    step_ticks = from_ticks;
+    is_wrapped = 0;
+  } else {
+    /* Find the first step that the per-step timer would not have reached. */
+    time = (from_ticks + elapsed);
+    is_wrapped = 0;
+    if (time >= k_disc_drive_ticks_per_revolution) {
+      time -= k_disc_drive_ticks_per_revolution;
+      is_wrapped = 1;
+    }
+    step = (uint32_t) ((time * num_steps) / k_disc_drive_ticks_per_revolution);
+    while ((step > 0) &&
+           (disc_drive_get_time_for_step(p_drive, track_length, (step - 1)) >
+               time)) {
+      step--;
+    }
+    while (disc_drive_get_time_for_step(p_drive, track_length, step) <= time) {
+      step++;
+    }
+    step_ticks = disc_drive_get_time_for_step(p_drive, track_length, step);
+  }
+
+  /* Pull the timer in from the index edge to the step. */
+  elapsed = (step_ticks - from_ticks);
+  if (is_wrapped) {
+    elapsed += k_disc_drive_ticks_per_revolution;
+  }
+  assert(elapsed <= p_drive->skip_ticks);
+  (void) timing_adjust_timer_value(p_drive->p_timing,
+                                   NULL,
+                                   p_drive->timer_id,
+                                   -((int64_t) p_drive->skip_ticks - elapsed));
+
+  disc_drive_set_step(p_drive, (step % num_steps));
+
+  return 1;
+}
+
 uint32_t
 disc_drive_get_quasi_random_pulses(struct disc_drive_struct* p_drive) {
   uint64_t ticks = timing_get_total_timer_ticks(p_drive->p_timing);
@@ -124,6 +318,9 @@ disc_drive_timer_callback(void* p) {
   uint32_t head_position = p_drive->head_position;
   uint32_t pulse_position = p_drive->pulse_position;
 
+  /* Any skip ends exactly on the index edge it was aiming for. */
+  p_drive->is_skipping = 0;
+
   if (p_disc != NULL) {
     pulses = disc_read_pulses(p_disc, is_side_upper, track, head_position);
   }
@@ -187,9 +384,10 @@ disc_drive_timer_callback(void* p) {
     assert(pulse_position == 0);
     head_position = 0;
 
-    if (p_disc != NULL) {
-      disc_flush_writes(p_disc);
+    if (!p_drive->is_written_this_rev) {
+      disc_drive_check_track_needs_write(p_drive);
     }
+    p_drive->is_written_this_rev = 0;
   }
 
   p_drive->head_position = head_position;
@@ -200,6 +398,8 @@ disc_drive_timer_callback(void* p) {
   (void) timing_set_timer_value(p_drive->p_timing,
                                 p_drive->timer_id,
                                 (next_ticks - this_ticks));
+
+  disc_drive_start_skip(p_drive);
 }
 
 struct disc_drive_struct*
@@ -211,6 +411,7 @@ disc_drive_create(uint32_t id,
 
   p_drive->id = id;
   p_drive->p_timing = p_timing;
+  p_drive->is_pulses_wanted = 1;
 
   if (id == 0) {
     p_drive->is_40_track = util_has_option(p_options->p_opt_flags,
@@ -237,7 +438,7 @@ disc_drive_destroy(struct disc_drive_struct* p_drive) {
   for (i = 0; i < k_disc_max_discs_per_drive; ++i) {
     struct disc_struct* p_disc = p_drive->p_discs[i];
     if (p_disc != NULL) {
-      util_free(p_disc);
+      disc_destroy(p_disc);
     }
   }
 
@@ -249,6 +450,7 @@ disc_drive_power_on_reset(struct disc_drive_struct* p_drive) {
   uint32_t i_disc;
 
   assert(!disc_drive_is_spinning(p_drive));
+  assert(!p_drive->is_skipping);
 
   p_drive->is_side_upper = 0;
   p_drive->track = 0;
@@ -304,7 +506,9 @@ disc_drive_cycle_disc(struct disc_drive_struct* p_drive) {
   struct disc_struct* p_disc;
   const char* p_file_name;
   uint32_t disc_index = p_drive->disc_index;
+  int was_skipping = disc_drive_sync_skip(p_drive);
   double fraction = disc_drive_get_position_fraction(p_drive);
+  disc_drive_check_track_needs_write(p_drive);
 
   if (disc_index == p_drive->discs_added) {
     disc_index = 0;
@@ -327,6 +531,10 @@ disc_drive_cycle_disc(struct disc_drive_struct* p_drive) {
              p_file_name);
 
   disc_drive_set_position_fraction(p_drive, fraction);
+
+  if (was_skipping) {
+    disc_drive_start_skip(p_drive);
+  }
 }
 
 void
@@ -339,9 +547,29 @@ disc_drive_set_pulses_callback(struct disc_drive_struct* p_drive,
   p_drive->p_pulses_callback_object = p_pulses_callback_object;
 }
 
+void
+disc_drive_set_pulses_wanted(struct disc_drive_struct* p_drive, int wanted) {
+  if (wanted == p_drive->is_pulses_wanted) {
+    return;
+  }
+  p_drive->is_pulses_wanted = wanted;
+  /* Dropping back to per-step callbacks happens now; starting to skip waits
+   * for the next callback.
+   */
+  if (wanted) {
+    (void) disc_drive_sync_skip(p_drive);
+  }
+}
+
 void
 disc_drive_set_32us_mode(struct disc_drive_struct* p_drive, int on) {
+  int was_skipping = disc_drive_sync_skip(p_drive);
+
   p_drive->is_32us_mode = on;
+
+  if (was_skipping) {
+    disc_drive_start_skip(p_drive);
+  }
 }
 
 uint32_t
@@ -352,6 +580,8 @@ disc_drive_get_track(struct disc_drive_struct* p_drive) {
 int
 disc_drive_is_index_pulse(struct disc_drive_struct* p_drive) {
   uint32_t track_length;
+  int was_skipping;
+  int ret;
   struct disc_struct* p_disc = disc_drive_get_disc(p_drive);
 
   if (p_disc == NULL) {
@@ -359,20 +589,28 @@ disc_drive_is_index_pulse(struct disc_drive_struct* p_drive) {
     return 1;
   }
 
-  /* EMU: the 8271 datasheet says that the index pulse must be held for over
-   * 0.5us. Most drives are in the milisecond range.
-   */
+  was_skipping = disc_drive_sync_skip(p_drive);
+
   track_length = disc_drive_get_track_length(p_drive);
-  if (p_drive->head_position <
-          (track_length * (k_disc_index_ms / (double) 200))) {
-    return 1;
+  ret = (p_drive->head_position < disc_get_index_end_position(track_length));
+
+  if (was_skipping) {
+    disc_drive_start_skip(p_drive);
   }
-  return 0;
+  return ret;
 }
 
 uint32_t
 disc_drive_get_head_position(struct disc_drive_struct* p_drive) {
-  return p_drive->head_position;
+  uint32_t ret;
+  int was_skipping = disc_drive_sync_skip(p_drive);
+
+  ret = p_drive->head_position;
+
+  if (was_skipping) {
+    disc_drive_start_skip(p_drive);
+  }
+  return ret;
 }
 
 int
@@ -397,16 +635,9 @@ disc_drive_start_spinning(struct disc_drive_struct* p_drive) {
   (void) timing_start_timer_with_value(p_drive->p_timing, p_drive->timer_id, 1);
 }
 
-static void
-disc_drive_check_track_needs_write(struct disc_drive_struct* p_drive) {
-  struct disc_struct* p_disc = disc_drive_get_disc(p_drive);
-  if (p_disc != NULL) {
-    disc_flush_writes(p_disc);
-  }
-}
-
 void
 disc_drive_stop_spinning(struct disc_drive_struct* p_drive) {
+  (void) disc_drive_sync_skip(p_drive);
   disc_drive_check_track_needs_write(p_drive);
 
   (void) timing_stop_timer(p_drive->p_timing, p_drive->timer_id);
@@ -414,16 +645,22 @@ disc_drive_stop_spinning(struct disc_drive_struct* p_drive) {
 
 void
 disc_drive_select_side(struct disc_drive_struct* p_drive, int side) {
+  int was_skipping = disc_drive_sync_skip(p_drive);
   double fraction = disc_drive_get_position_fraction(p_drive);
   disc_drive_check_track_needs_write(p_drive);
 
   p_drive->is_side_upper = side;
 
   disc_drive_set_position_fraction(p_drive, fraction);
+
+  if (was_skipping) {
+    disc_drive_start_skip(p_drive);
+  }
 }
 
 void
 disc_drive_select_track(struct disc_drive_struct* p_drive, int32_t track) {
+  int was_skipping = disc_drive_sync_skip(p_drive);
   double fraction = disc_drive_get_position_fraction(p_drive);
   disc_drive_check_track_needs_write(p_drive);
 
@@ -439,6 +676,10 @@ disc_drive_select_track(struct disc_drive_struct* p_drive, int32_t track) {
   p_drive->track = track;
 
   disc_drive_set_position_fraction(p_drive, fraction);
+
+  if (was_skipping) {
+    disc_drive_start_skip(p_drive);
+  }
 }
 
 void
@@ -459,6 +700,8 @@ disc_drive_write_pulses(struct disc_drive_struct* p_drive, uint32_t pulses) {
   uint32_t track = p_drive->track;
   uint32_t head_position = p_drive->head_position;
 
+  assert(!p_drive->is_skipping);
+
   if (p_disc == NULL) {
     return;
   }
@@ -481,4 +724,7 @@ disc_drive_write_pulses(struct disc_drive_struct* p_drive, uint32_t pulses) {
     }
   }
   disc_write_pulses(p_disc, is_side_upper, track, head_position, pulses);
+  p_drive->is_written_this_rev = 1;
 }
+
+#include "test-disc_drive.c"
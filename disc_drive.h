@@ -22,6 +22,11 @@ void disc_drive_set_pulses_callback(struct disc_drive_struct* p_drive,
  * This selects 32us worth (16x 2us each), suitable for MFM.
  */
 void disc_drive_set_32us_mode(struct disc_drive_struct* p_drive, int on);
+/* Pulses are wanted by default. An idle controller can turn them off, after
+ * which callbacks are only made for the bytes at the index pulse edges.
+ */
+void disc_drive_set_pulses_wanted(struct disc_drive_struct* p_drive,
+                                  int wanted);
 
 void disc_drive_power_on_reset(struct disc_drive_struct* p_drive);
 
@@ -107,8 +107,9 @@ disc_fsd_sector_has_weak_bits(uint32_t* p_out_weak_bits_start,
   }
 }
 
-static void
-disc_fsd_parse_sectors(struct disc_fsd_sector* p_sectors,
+static int
+disc_fsd_parse_sectors(struct disc_struct* p_disc,
+                       struct disc_fsd_sector* p_sectors,
                        uint32_t* p_track_data_bytes,
                        uint32_t* p_track_truncatable_bytes,
                        uint32_t* p_track_truncatable_sectors,
@@ -130,18 +131,21 @@ disc_fsd_parse_sectors(struct disc_fsd_sector* p_sectors,
   *p_track_truncatable_sectors = 0;
 
   if (fsd_sectors > k_disc_fsd_max_sectors) {
-    util_bail("fsd file excessive sectors");
+    disc_load_fail(p_disc, "fsd file excessive sectors");
+    return 0;
   }
 
   if (file_remaining == 0) {
-    util_bail("fsd file missing readable flag");
+    disc_load_fail(p_disc, "fsd file missing readable flag");
+    return 0;
   }
 
   if (*p_buf == 0) {
     /* "unreadable" track. */
     readable = 0;
   } else if (*p_buf != 0xFF) {
-    util_bail("fsd file unknown readable byte value");
+    disc_load_fail(p_disc, "fsd file unknown readable byte value");
+    return 0;
   }
   p_buf++;
   file_remaining--;
@@ -156,7 +160,8 @@ disc_fsd_parse_sectors(struct disc_fsd_sector* p_sectors,
     struct disc_fsd_sector* p_sector = &p_sectors[i_sector];
 
     if (file_remaining < 4) {
-      util_bail("fsd file missing sector header");
+      disc_load_fail(p_disc, "fsd file missing sector header");
+      return 0;
     }
 
     p_sector->logical_track = p_buf[0];
@@ -192,7 +197,8 @@ disc_fsd_parse_sectors(struct disc_fsd_sector* p_sectors,
     }
 
     if (file_remaining < 2) {
-      util_bail("fsd file missing sector header");
+      disc_load_fail(p_disc, "fsd file missing sector header");
+      return 0;
     }
 
     actual_size_bytes = p_buf[0];
@@ -202,14 +208,16 @@ disc_fsd_parse_sectors(struct disc_fsd_sector* p_sectors,
     file_remaining -= 2;
 
     if (actual_size_bytes > 4) {
-      util_bail("fsd file excessive sector size");
+      disc_load_fail(p_disc, "fsd file excessive sector size");
+      return 0;
     }
     actual_size_bytes = (1 << (7 + actual_size_bytes));
     p_sector->actual_size_bytes = actual_size_bytes;
     p_sector->truncated_size_bytes = actual_size_bytes;
     p_sector->write_size_bytes = actual_size_bytes;
     if (file_remaining < actual_size_bytes) {
-      util_bail("fsd file missing sector data");
+      disc_load_fail(p_disc, "fsd file missing sector data");
+      return 0;
     }
     p_sector->p_data = p_buf;
     p_buf += actual_size_bytes;
@@ -243,12 +251,14 @@ disc_fsd_parse_sectors(struct disc_fsd_sector* p_sectors,
         p_sector->truncated_size_bytes = 128;
       } else if (sector_error == 0xE1) {
         if (p_sector->actual_size_bytes < 256) {
-          util_bail("bad size for sector error $E1");
+          disc_load_fail(p_disc, "bad size for sector error $E1");
+          return 0;
         }
         p_sector->truncated_size_bytes = 256;
       } else {
         if (p_sector->actual_size_bytes < 512) {
-          util_bail("bad size for sector error $E2");
+          disc_load_fail(p_disc, "bad size for sector error $E2");
+          return 0;
         }
         p_sector->truncated_size_bytes = 512;
       }
@@ -257,7 +267,10 @@ disc_fsd_parse_sectors(struct disc_fsd_sector* p_sectors,
        * Example: 571 Philosopher's Quest 40track.FSD
        */
     } else if (sector_error != 0) {
-      util_bail("fsd file sector error %d unsupported", sector_error);
+      disc_load_fail(p_disc,
+                     "fsd file sector error %d unsupported",
+                     sector_error);
+      return 0;
     }
 
     if (p_sector->truncated_size_bytes != p_sector->actual_size_bytes) {
@@ -269,10 +282,13 @@ disc_fsd_parse_sectors(struct disc_fsd_sector* p_sectors,
 
   *p_p_buf = p_buf;
   *p_file_remaining = file_remaining;
+
+  return 1;
 }
 
-static void
-disc_fsd_perform_track_adjustments(struct disc_fsd_sector* p_sectors,
+static int
+disc_fsd_perform_track_adjustments(struct disc_struct* p_disc,
+                                   struct disc_fsd_sector* p_sectors,
                                    uint32_t* p_gap1_ff_count,
                                    uint32_t* p_gap3_ff_count,
                                    uint32_t gap2_ff_count,
@@ -293,7 +309,7 @@ disc_fsd_perform_track_adjustments(struct disc_fsd_sector* p_sectors,
                                                            *p_gap3_ff_count);
 
   if (track_total_bytes <= k_ibm_disc_bytes_per_track) {
-    return;
+    return 1;
   }
 
   log_do_log(k_log_disc,
@@ -335,7 +351,7 @@ disc_fsd_perform_track_adjustments(struct disc_fsd_sector* p_sectors,
                                                            gap2_ff_count,
                                                            *p_gap3_ff_count);
   if (track_total_bytes <= k_ibm_disc_bytes_per_track) {
-    return;
+    return 1;
   }
 
   log_do_log(k_log_disc,
@@ -345,7 +361,8 @@ disc_fsd_perform_track_adjustments(struct disc_fsd_sector* p_sectors,
 
   num_bytes_over = (track_total_bytes - k_ibm_disc_bytes_per_track);
   if (num_bytes_over >= track_truncatable_bytes) {
-    util_bail("fsd sectors really cannot fit");
+    disc_load_fail(p_disc, "fsd sectors really cannot fit");
+    return 0;
   }
 
   track_total_bytes -= track_truncatable_bytes;
@@ -371,6 +388,8 @@ disc_fsd_perform_track_adjustments(struct disc_fsd_sector* p_sectors,
     p_sector->write_size_bytes += overread_bytes_per_sector;
     p_sector->is_crc_included = 1;
   }
+
+  return 1;
 }
 
 void
@@ -395,23 +414,31 @@ disc_fsd_load(struct disc_struct* p_disc, int has_file_name) {
   len = util_file_read(p_file, p_file_buf, k_max_fsd_size);
 
   if (len == k_max_fsd_size) {
-    util_bail("fsd file too large");
+    disc_load_fail(p_disc, "fsd file too large");
+    util_free(p_file_buf);
+    return;
   }
 
   p_buf = p_file_buf;
   file_remaining = len;
   if (file_remaining < 8) {
-    util_bail("fsd file no header");
+    disc_load_fail(p_disc, "fsd file no header");
+    util_free(p_file_buf);
+    return;
   }
   if (memcmp(p_buf, "FSD", 3) != 0) {
-    util_bail("fsd file incorrect header");
+    disc_load_fail(p_disc, "fsd file incorrect header");
+    util_free(p_file_buf);
+    return;
   }
   p_buf += 8;
   file_remaining -= 8;
   if (has_file_name) {
     do {
       if (file_remaining == 0) {
-        util_bail("fsd file missing title");
+        disc_load_fail(p_disc, "fsd file missing title");
+        util_free(p_file_buf);
+        return;
       }
       title_char = *p_buf;
       p_buf++;
@@ -420,7 +447,9 @@ disc_fsd_load(struct disc_struct* p_disc, int has_file_name) {
   }
 
   if (file_remaining == 0) {
-    util_bail("fsd file missing tracks");
+    disc_load_fail(p_disc, "fsd file missing tracks");
+    util_free(p_file_buf);
+    return;
   }
   /* This appears to actually be "max zero-indexed track ID" so we add 1. */
   fsd_tracks = *p_buf;
@@ -428,7 +457,9 @@ disc_fsd_load(struct disc_struct* p_disc, int has_file_name) {
   p_buf++;
   file_remaining--;
   if (fsd_tracks > k_ibm_disc_tracks_per_disc) {
-    util_bail("fsd file too many tracks: %d", fsd_tracks);
+    disc_load_fail(p_disc, "fsd file too many tracks: %d", fsd_tracks);
+    util_free(p_file_buf);
+    return;
   }
 
   for (i_track = 0; i_track < fsd_tracks; ++i_track) {
@@ -458,10 +489,14 @@ disc_fsd_load(struct disc_struct* p_disc, int has_file_name) {
     }
 
     if (file_remaining < 2) {
-      util_bail("fsd file missing track header");
+      disc_load_fail(p_disc, "fsd file missing track header");
+      util_free(p_file_buf);
+      return;
     }
     if (p_buf[0] != i_track) {
-      util_bail("fsd file unmatched track id");
+      disc_load_fail(p_disc, "fsd file unmatched track id");
+      util_free(p_file_buf);
+      return;
     }
 
     disc_build_track(p_disc, 0, i_track);
@@ -486,13 +521,17 @@ disc_fsd_load(struct disc_struct* p_disc, int has_file_name) {
     }
 
     (void) memset(sectors, '\0', sizeof(sectors));
-    disc_fsd_parse_sectors(sectors,
-                           &track_data_bytes,
-                           &track_truncatable_bytes,
-                           &track_truncatable_sectors,
-                           &p_buf,
-                           &file_remaining,
-                           fsd_sectors);
+    if (!disc_fsd_parse_sectors(p_disc,
+                                sectors,
+                                &track_data_bytes,
+                                &track_truncatable_bytes,
+                                &track_truncatable_sectors,
+                                &p_buf,
+                                &file_remaining,
+                                fsd_sectors)) {
+      util_free(p_file_buf);
+      return;
+    }
 
     if (fsd_sectors > 18) {
       /* 256 VECTOR 2 V140 ACORN 1770.FSD uses 19 sectors; make it fit. */
@@ -505,15 +544,19 @@ disc_fsd_load(struct disc_struct* p_disc, int has_file_name) {
       gap3_ff_count = 11;
     }
 
-    disc_fsd_perform_track_adjustments(sectors,
-                                       &gap1_ff_count,
-                                       &gap3_ff_count,
-                                       gap2_ff_count,
-                                       fsd_sectors,
-                                       track_data_bytes,
-                                       track_truncatable_bytes,
-                                       track_truncatable_sectors,
-                                       i_track);
+    if (!disc_fsd_perform_track_adjustments(p_disc,
+                                            sectors,
+                                            &gap1_ff_count,
+                                            &gap3_ff_count,
+                                            gap2_ff_count,
+                                            fsd_sectors,
+                                            track_data_bytes,
+                                            track_truncatable_bytes,
+                                            track_truncatable_sectors,
+                                            i_track)) {
+      util_free(p_file_buf);
+      return;
+    }
 
     /* Sync pattern at start of track, as the index pulse starts, aka GAP 1.
      * Note that GAP 5 (with index address mark) is typically not used in BBC
@@ -532,7 +575,10 @@ disc_fsd_load(struct disc_struct* p_disc, int has_file_name) {
       uint8_t sector_mark = k_ibm_disc_data_mark_data_pattern;
 
       if (track_remaining < (7 + (gap2_ff_count + 6))) {
-        util_bail("fsd file track no space for sector header and gap");
+        disc_load_fail(p_disc,
+                       "fsd file track no space for sector header and gap");
+        util_free(p_file_buf);
+        return;
       }
       /* Sector header, aka. ID. */
       disc_build_reset_crc(p_disc);
@@ -555,7 +601,9 @@ disc_fsd_load(struct disc_struct* p_disc, int has_file_name) {
       }
 
       if (track_remaining < (write_size_bytes + 3)) {
-        util_bail("fsd file track no space for sector data");
+        disc_load_fail(p_disc, "fsd file track no space for sector data");
+        util_free(p_file_buf);
+        return;
       }
 
       disc_build_reset_crc(p_disc);
@@ -614,7 +662,10 @@ disc_fsd_load(struct disc_struct* p_disc, int has_file_name) {
       if (i_sector != (fsd_sectors - 1)) {
         /* Sync pattern between sectors, aka. GAP 3. */
         if (track_remaining < (gap3_ff_count + 6)) {
-          util_bail("fsd file track no space for inter sector gap");
+          disc_load_fail(p_disc,
+                         "fsd file track no space for inter sector gap");
+          util_free(p_file_buf);
+          return;
         }
         disc_build_append_repeat_fm_byte(p_disc, 0xFF, gap3_ff_count);
         disc_build_append_repeat_fm_byte(p_disc, 0x00, 6);
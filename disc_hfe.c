@@ -75,8 +75,6 @@ disc_hfe_zero_track_in_file(struct disc_struct* p_disc, uint32_t track) {
   uint32_t written = 0;
   uint8_t zero_chunk[512];
 
-  struct util_file* p_file = disc_get_file(p_disc);
-
   (void) memset(zero_chunk, '\0', sizeof(zero_chunk));
 
 
@@ -85,10 +83,8 @@ disc_hfe_zero_track_in_file(struct disc_struct* p_disc, uint32_t track) {
                                        &hfe_track_length,
                                        track);
 
-  util_file_seek(p_file, hfe_track_offset);
-
   while (written < hfe_track_length) {
-    util_file_write(p_file, zero_chunk, 512);
+    disc_write_file(p_disc, (hfe_track_offset + written), zero_chunk, 512);
     written += 512;
   }
 }
@@ -98,21 +94,25 @@ disc_hfe_write_track(struct disc_struct* p_disc,
                      int is_side_upper,
                      uint32_t track,
                      uint32_t length,
-                     uint32_t* p_pulses) {
+                     uint32_t* p_pulses,
+                     uint32_t dirty_start,
+                     uint32_t dirty_end) {
   uint32_t hfe_track_offset;
   uint32_t hfe_track_length;
   uint32_t i_byte;
+  uint32_t dirty_buffer_start;
+  uint32_t dirty_buffer_end;
   uint8_t buffer[(k_disc_max_bytes_per_track * 4) + 3];
   uint8_t hfe_chunk[256];
 
-  struct util_file* p_file = disc_get_file(p_disc);
   uint8_t* p_metadata = disc_get_format_metadata(p_disc);
   uint8_t version = p_metadata[k_hfe_format_metadata_offset_version];
   uint32_t buffer_index = 0;
   uint32_t write_pos = 0;
   uint32_t num_tracks = disc_get_num_tracks_used(p_disc);
 
-  assert(p_file != NULL);
+  assert(dirty_start < dirty_end);
+  assert(dirty_end <= length);
 
   disc_hfe_get_track_offset_and_length(p_disc,
                                        &hfe_track_offset,
@@ -131,10 +131,11 @@ disc_hfe_write_track(struct disc_struct* p_disc,
    */
   if (track >= num_tracks) {
     uint8_t new_num_tracks = (uint8_t) (track + 1);
-    util_file_seek(p_file, 9);
-    util_file_write(p_file, &new_num_tracks, 1);
+    disc_write_file(p_disc, 9, &new_num_tracks, 1);
 
     disc_hfe_zero_track_in_file(p_disc, track);
+    dirty_start = 0;
+    dirty_end = length;
   }
 
   if (version == 3) {
@@ -175,6 +176,17 @@ disc_hfe_write_track(struct disc_struct* p_disc,
     buffer_index += 4;
   }
 
+  /* Only the 256 byte chunks covering written pulses are rewritten. Any HFEv3
+   * opcodes at the start of the buffer go with the first pulses.
+   */
+  dirty_buffer_start = (buffer_index - (length * 4));
+  dirty_buffer_end = (dirty_buffer_start + (dirty_end * 4));
+  if (dirty_start == 0) {
+    dirty_buffer_start = 0;
+  } else {
+    dirty_buffer_start += (dirty_start * 4);
+  }
+
   i_byte = 0;
   write_pos = 0;
   if (is_side_upper) {
@@ -189,10 +201,11 @@ disc_hfe_write_track(struct disc_struct* p_disc,
       (void) memset(hfe_chunk, '\0', 256);
     }
 
-    (void) memcpy(hfe_chunk, &buffer[i_byte], chunk_len);
-
-    util_file_seek(p_file, (hfe_track_offset + write_pos));
-    util_file_write(p_file, hfe_chunk, 256);
+    if (((i_byte + chunk_len) > dirty_buffer_start) &&
+        (i_byte < dirty_buffer_end)) {
+      (void) memcpy(hfe_chunk, &buffer[i_byte], chunk_len);
+      disc_write_file(p_disc, (hfe_track_offset + write_pos), hfe_chunk, 256);
+    }
     write_pos += 512;
     if (write_pos >= hfe_track_length) {
       break;
@@ -232,11 +245,15 @@ disc_hfe_load(struct disc_struct* p_disc, int expand_to_80) {
   file_len = util_file_read(p_file, p_file_buf, k_max_hfe_size);
 
   if (file_len == k_max_hfe_size) {
-    util_bail("hfe file too large");
+    disc_load_fail(p_disc, "hfe file too large");
+    util_free(p_file_buf);
+    return;
   }
 
   if (file_len < 512) {
-    util_bail("hfe file no header");
+    disc_load_fail(p_disc, "hfe file no header");
+    util_free(p_file_buf);
+    return;
   }
   if (memcmp(p_file_buf, k_hfe_header_v1, 8) == 0) {
     /* HFE v1. */
@@ -246,10 +263,14 @@ disc_hfe_load(struct disc_struct* p_disc, int expand_to_80) {
     is_v3 = 1;
     p_metadata[k_hfe_format_metadata_offset_version] = 3;
   } else {
-    util_bail("HFE file incorrect header");
+    disc_load_fail(p_disc, "HFE file incorrect header");
+    util_free(p_file_buf);
+    return;
   }
   if (p_file_buf[8] != '\0') {
-    util_bail("hfe file revision not 0");
+    disc_load_fail(p_disc, "hfe file revision not 0");
+    util_free(p_file_buf);
+    return;
   }
   if ((p_file_buf[11] != 2) && (p_file_buf[11] != 0)) {
     if (p_file_buf[11] == 0xFF) {
@@ -258,8 +279,11 @@ disc_hfe_load(struct disc_struct* p_disc, int expand_to_80) {
                  "unknown HFE encoding %d, trying anyway",
                  p_file_buf[11]);
     } else {
-      util_bail("HFE encoding not ISOIBM_(M)FM_ENCODING: %d",
-                (int) p_file_buf[11]);
+      disc_load_fail(p_disc,
+                     "HFE encoding not ISOIBM_(M)FM_ENCODING: %d",
+                     (int) p_file_buf[11]);
+      util_free(p_file_buf);
+      return;
     }
   }
   if (p_file_buf[10] == 1) {
@@ -267,12 +291,18 @@ disc_hfe_load(struct disc_struct* p_disc, int expand_to_80) {
   } else if (p_file_buf[10] == 2) {
     num_sides = 2;
   } else {
-    util_bail("hfe invalid number of sides: %d", (int) p_file_buf[10]);
+    disc_load_fail(p_disc,
+                   "hfe invalid number of sides: %d",
+                   (int) p_file_buf[10]);
+    util_free(p_file_buf);
+    return;
   }
 
   hfe_tracks = p_file_buf[9];
   if (hfe_tracks > k_ibm_disc_tracks_per_disc) {
-    util_bail("hfe excessive tracks: %d", (int) hfe_tracks);
+    disc_load_fail(p_disc, "hfe excessive tracks: %d", (int) hfe_tracks);
+    util_free(p_file_buf);
+    return;
   }
   if (expand_to_80 && ((hfe_tracks * 2) <= k_ibm_disc_tracks_per_disc)) {
     expand_multiplier = 2;
@@ -290,7 +320,9 @@ disc_hfe_load(struct disc_struct* p_disc, int expand_to_80) {
   lut_offset *= 512;
 
   if ((lut_offset + 512) > file_len) {
-    util_bail("hfe LUT doesn't fit");
+    disc_load_fail(p_disc, "hfe LUT doesn't fit");
+    util_free(p_file_buf);
+    return;
   }
 
   (void) memcpy(p_metadata, (p_file_buf + lut_offset), 512);
@@ -317,11 +349,14 @@ disc_hfe_load(struct disc_struct* p_disc, int expand_to_80) {
                                          i_track);
 
     if ((hfe_track_offset + hfe_track_length) > file_len) {
-      util_bail("hfe track %d doesn't fit (length %d offset %d file length %d)",
-                i_track,
-                hfe_track_length,
-                hfe_track_offset,
-                file_len);
+      disc_load_fail(p_disc,
+                     "hfe track %d doesn't fit (length %d offset %d file "
+                         "length %d)",
+                     i_track,
+                     hfe_track_length,
+                     hfe_track_offset,
+                     file_len);
+      break;
     }
 
     p_track_data = (p_file_buf + hfe_track_offset);
@@ -381,7 +416,8 @@ disc_hfe_load(struct disc_struct* p_disc, int expand_to_80) {
         } else if (is_skipbits) {
           is_skipbits = 0;
           if ((byte == 0) || (byte >= 8)) {
-            util_bail("HFE v3 invalid skipbits %d", (int) byte);
+            disc_load_fail(p_disc, "HFE v3 invalid skipbits %d", (int) byte);
+            break;
           }
           skipbits_length = byte;
           continue;
@@ -414,7 +450,10 @@ disc_hfe_load(struct disc_struct* p_disc, int expand_to_80) {
             is_skipbits = 1;
             continue;
           default:
-            util_bail("HFE v3 unknown opcode 0x%X", (int) byte);
+            disc_load_fail(p_disc, "HFE v3 unknown opcode 0x%X", (int) byte);
+            break;
+          }
+          if (disc_has_load_failed(p_disc)) {
             break;
           }
         }
@@ -433,8 +472,14 @@ disc_hfe_load(struct disc_struct* p_disc, int expand_to_80) {
           shift_counter = 0;
         }
       }
+      if (disc_has_load_failed(p_disc)) {
+        break;
+      }
       disc_set_track_length(p_disc, i_side, actual_track, bytes_written);
     }
+    if (disc_has_load_failed(p_disc)) {
+      break;
+    }
   }
 
   util_free(p_file_buf);
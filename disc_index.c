@@ -0,0 +1,356 @@
+#include "disc_index.h"
+
+#include "bbc_options.h"
+#include "disc.h"
+#include "disc_tool.h"
+#include "log.h"
+#include "os_dir.h"
+#include "os_lock.h"
+#include "os_thread.h"
+#include "os_time.h"
+#include "util.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  k_disc_index_max_threads = 64,
+};
+
+struct disc_index_entry {
+  char* p_file_name;
+  struct disc_tool_summary summary;
+};
+
+struct disc_index_side {
+  struct disc_index_entry* p_entry;
+  uint32_t side;
+};
+
+struct disc_index_struct {
+  const char* p_opt_flags;
+  struct disc_index_entry* p_entries;
+  uint32_t num_entries;
+  uint32_t alloc_entries;
+
+  struct os_lock_struct* p_lock;
+  uint32_t next_entry;
+  uint32_t num_skipped;
+};
+
+struct disc_index_walk {
+  struct disc_index_struct* p_index;
+  const char* p_dir_name;
+};
+
+static void disc_index_walk_dir(struct disc_index_struct* p_index,
+                                const char* p_dir_name);
+
+static int
+disc_index_is_disc_file(const char* p_file_name) {
+  return (util_is_extension(p_file_name, "ssd") ||
+          util_is_extension(p_file_name, "dsd") ||
+          util_is_extension(p_file_name, "adl") ||
+          util_is_extension(p_file_name, "fsd") ||
+          util_is_extension(p_file_name, "hfe"));
+}
+
+static void
+disc_index_walk_callback(void* p, const char* p_name, int is_dir) {
+  struct disc_index_walk* p_walk = (struct disc_index_walk*) p;
+  struct disc_index_struct* p_index = p_walk->p_index;
+  char* p_path = util_file_name_join(p_walk->p_dir_name, p_name);
+
+  if (is_dir) {
+    disc_index_walk_dir(p_index, p_path);
+    util_free(p_path);
+    return;
+  }
+  if (!disc_index_is_disc_file(p_name)) {
+    util_free(p_path);
+    return;
+  }
+
+  if (p_index->num_entries == p_index->alloc_entries) {
+    p_index->alloc_entries = ((p_index->alloc_entries * 2) + 64);
+    p_index->p_entries = util_realloc(
+        p_index->p_entries,
+        (p_index->alloc_entries * sizeof(struct disc_index_entry)));
+  }
+  p_index->p_entries[p_index->num_entries].p_file_name = p_path;
+  p_index->num_entries++;
+}
+
+static void
+disc_index_walk_dir(struct disc_index_struct* p_index, const char* p_dir_name) {
+  struct disc_index_walk walk;
+
+  walk.p_index = p_index;
+  walk.p_dir_name = p_dir_name;
+  if (!os_dir_list(p_dir_name, disc_index_walk_callback, &walk)) {
+    log_do_log(k_log_disc,
+               k_log_warning,
+               "couldn't open directory %s",
+               p_dir_name);
+  }
+}
+
+static int
+disc_index_compare_entries(const void* p_a, const void* p_b) {
+  const struct disc_index_entry* p_entry_a = p_a;
+  const struct disc_index_entry* p_entry_b = p_b;
+
+  return strcmp(p_entry_a->p_file_name, p_entry_b->p_file_name);
+}
+
+static int
+disc_index_compare_sides(const void* p_a, const void* p_b) {
+  const struct disc_index_side* p_side_a = p_a;
+  const struct disc_index_side* p_side_b = p_b;
+  uint32_t fingerprint_a =
+      p_side_a->p_entry->summary.sides[p_side_a->side].fingerprint;
+  uint32_t fingerprint_b =
+      p_side_b->p_entry->summary.sides[p_side_b->side].fingerprint;
+
+  if (fingerprint_a != fingerprint_b) {
+    return ((fingerprint_a < fingerprint_b) ? -1 : 1);
+  }
+  /* Entries are already sorted by name, so this keeps the order stable. */
+  if (p_side_a->p_entry != p_side_b->p_entry) {
+    return ((p_side_a->p_entry < p_side_b->p_entry) ? -1 : 1);
+  }
+  return ((int) p_side_a->side - (int) p_side_b->side);
+}
+
+static void*
+disc_index_thread(void* p) {
+  struct disc_index_struct* p_index = (struct disc_index_struct*) p;
+  struct bbc_options options;
+
+  /* Plain loads only: no conversions and no per-disc logging. */
+  (void) memset(&options, '\0', sizeof(options));
+  options.p_opt_flags = p_index->p_opt_flags;
+  options.p_log_flags = "";
+
+  while (1) {
+    struct disc_struct* p_disc;
+    struct disc_index_entry* p_entry;
+    uint32_t index;
+    const char* p_error;
+
+    os_lock_lock(p_index->p_lock);
+    index = p_index->next_entry;
+    if (index < p_index->num_entries) {
+      p_index->next_entry++;
+    }
+    os_lock_unlock(p_index->p_lock);
+    if (index == p_index->num_entries) {
+      break;
+    }
+
+    p_entry = &p_index->p_entries[index];
+    p_disc = disc_create(p_entry->p_file_name, 0, 0, 0, 0, 0, &options);
+    p_error = disc_try_load(p_disc);
+    if (p_error == NULL) {
+      disc_tool_log_summary(p_disc, 0, 0, 0, 0, 0, 0, 0, &p_entry->summary);
+    } else {
+      /* Left with no sides, so it isn't in the index. */
+      log_do_log(k_log_disc,
+                 k_log_warning,
+                 "skipping %s: %s",
+                 p_entry->p_file_name,
+                 p_error);
+      os_lock_lock(p_index->p_lock);
+      p_index->num_skipped++;
+      os_lock_unlock(p_index->p_lock);
+    }
+    disc_destroy(p_disc);
+  }
+
+  return NULL;
+}
+
+static void
+disc_index_write(struct disc_index_struct* p_index,
+                 const char* p_index_file_name,
+                 uint32_t* p_num_sides,
+                 uint32_t* p_num_duplicates) {
+  struct disc_index_side* p_sides;
+  struct util_file* p_file;
+  uint32_t num_sides;
+  uint32_t i;
+  char line[256];
+  int len;
+
+  num_sides = 0;
+  for (i = 0; i < p_index->num_entries; ++i) {
+    num_sides += p_index->p_entries[i].summary.num_sides;
+  }
+  p_sides = util_malloc((num_sides + 1) * sizeof(struct disc_index_side));
+  num_sides = 0;
+  for (i = 0; i < p_index->num_entries; ++i) {
+    uint32_t i_side;
+    struct disc_index_entry* p_entry = &p_index->p_entries[i];
+    for (i_side = 0; i_side < p_entry->summary.num_sides; ++i_side) {
+      p_sides[num_sides].p_entry = p_entry;
+      p_sides[num_sides].side = i_side;
+      num_sides++;
+    }
+  }
+  qsort(p_sides,
+        num_sides,
+        sizeof(struct disc_index_side),
+        disc_index_compare_sides);
+
+  p_file = util_file_open(p_index_file_name, 1, 1);
+  len = snprintf(line,
+                 sizeof(line),
+                 "# fingerprint\tfingerprint-40t\tside\ttitle\tfile\n"
+                 "# \tfile\tload\texec\tlength\tcrc32\n");
+  util_file_write(p_file, line, len);
+
+  *p_num_duplicates = 0;
+  for (i = 0; i < num_sides; ++i) {
+    uint32_t i_files;
+    struct disc_index_entry* p_entry = p_sides[i].p_entry;
+    struct disc_tool_summary* p_summary = &p_entry->summary;
+    struct disc_tool_side_summary* p_side = &p_summary->sides[p_sides[i].side];
+    char fingerprint_40t[9];
+
+    if (i > 0) {
+      struct disc_index_side* p_prev = &p_sides[i - 1];
+      uint32_t prev_fingerprint =
+          p_prev->p_entry->summary.sides[p_prev->side].fingerprint;
+      if (prev_fingerprint == p_side->fingerprint) {
+        (*p_num_duplicates)++;
+        log_do_log(k_log_disc,
+                   k_log_info,
+                   "fingerprint %.8X: %s side %"PRIu32" matches %s",
+                   p_side->fingerprint,
+                   p_entry->p_file_name,
+                   p_sides[i].side,
+                   p_prev->p_entry->p_file_name);
+      }
+    }
+
+    if (p_summary->is_80t) {
+      (void) snprintf(fingerprint_40t,
+                      sizeof(fingerprint_40t),
+                      "%.8X",
+                      p_side->fingerprint_40t);
+    } else {
+      (void) snprintf(fingerprint_40t, sizeof(fingerprint_40t), "-");
+    }
+    len = snprintf(line,
+                   sizeof(line),
+                   "%.8X\t%s\t%"PRIu32"\t%s\t",
+                   p_side->fingerprint,
+                   fingerprint_40t,
+                   p_sides[i].side,
+                   &p_side->dfs_title[0]);
+    util_file_write(p_file, line, len);
+    util_file_write(p_file,
+                    p_entry->p_file_name,
+                    strlen(p_entry->p_file_name));
+    util_file_write(p_file, "\n", 1);
+
+    for (i_files = 0; i_files < p_side->num_dfs_files; ++i_files) {
+      struct disc_tool_dfs_file* p_dfs_file = &p_side->dfs_files[i_files];
+      char name[sizeof(p_dfs_file->name)];
+      size_t name_len;
+      (void) memcpy(&name[0], &p_dfs_file->name[0], sizeof(name));
+      /* DFS pads names with spaces. */
+      name_len = strlen(name);
+      while ((name_len > 0) && (name[name_len - 1] == ' ')) {
+        name[--name_len] = '\0';
+      }
+      len = snprintf(line,
+                     sizeof(line),
+                     "\t%c.%s\t%.6X\t%.6X\t%.6X\t%.8X\n",
+                     p_dfs_file->dir,
+                     &name[0],
+                     p_dfs_file->load_addr,
+                     p_dfs_file->exec_addr,
+                     p_dfs_file->length,
+                     p_dfs_file->crc32);
+      util_file_write(p_file, line, len);
+    }
+  }
+
+  util_file_close(p_file);
+  util_free(p_sides);
+
+  *p_num_sides = num_sides;
+}
+
+void
+disc_index_build(const char* p_dir_name,
+                 const char* p_index_file_name,
+                 const char* p_opt_flags) {
+  struct os_thread_struct* p_threads[k_disc_index_max_threads];
+  struct disc_index_struct index;
+  uint32_t num_threads;
+  uint32_t num_sides;
+  uint32_t num_duplicates;
+  uint32_t i;
+  double secs;
+  uint64_t start_us = os_time_get_us();
+
+  (void) memset(&index, '\0', sizeof(index));
+  index.p_opt_flags = p_opt_flags;
+
+  disc_index_walk_dir(&index, p_dir_name);
+  /* Sorting by name first makes the index independent of directory order and
+   * thread scheduling.
+   */
+  qsort(index.p_entries,
+        index.num_entries,
+        sizeof(struct disc_index_entry),
+        disc_index_compare_entries);
+
+  num_threads = os_thread_get_num_cpus();
+  (void) util_get_u32_option(&num_threads,
+                             p_opt_flags,
+                             "disc:index-threads=");
+  if (num_threads > k_disc_index_max_threads) {
+    num_threads = k_disc_index_max_threads;
+  }
+  if (num_threads > index.num_entries) {
+    num_threads = index.num_entries;
+  }
+  if (num_threads == 0) {
+    num_threads = 1;
+  }
+
+  index.p_lock = os_lock_create();
+  for (i = 0; i < num_threads; ++i) {
+    p_threads[i] = os_thread_create(disc_index_thread, &index);
+  }
+  for (i = 0; i < num_threads; ++i) {
+    (void) os_thread_destroy(p_threads[i]);
+  }
+  os_lock_destroy(index.p_lock);
+
+  disc_index_write(&index, p_index_file_name, &num_sides, &num_duplicates);
+
+  secs = ((os_time_get_us() - start_us) / 1000000.0);
+  log_do_log(k_log_disc,
+             k_log_info,
+             "indexed %"PRIu32" images (%"PRIu32" skipped), %"PRIu32" sides, "
+                 "%"PRIu32" duplicate sides, in %.3fs with %"PRIu32" "
+                 "threads: %s",
+             (index.num_entries - index.num_skipped),
+             index.num_skipped,
+             num_sides,
+             num_duplicates,
+             secs,
+             num_threads,
+             p_index_file_name);
+
+  for (i = 0; i < index.num_entries; ++i) {
+    util_free(index.p_entries[i].p_file_name);
+  }
+  util_free(index.p_entries);
+}
@@ -0,0 +1,12 @@
+#ifndef BEEBJIT_DISC_INDEX_H
+#define BEEBJIT_DISC_INDEX_H
+
+/* Walks p_dir_name recursively for disc images, decodes their fingerprints
+ * and DFS catalogs in parallel, and writes a text index to p_index_file_name.
+ * The index is sorted by fingerprint, so identical discs are adjacent.
+ */
+void disc_index_build(const char* p_dir_name,
+                      const char* p_index_file_name,
+                      const char* p_opt_flags);
+
+#endif /* BEEBJIT_DISC_INDEX_H */
@@ -13,6 +13,23 @@ enum {
   k_kryo_max_index_pulses = 16,
 };
 
+struct util_file*
+disc_kryo_try_open_track(const char* p_file_name_base, uint32_t track) {
+  char file_name_buf[32];
+  char* p_track_file_name;
+  struct util_file* p_file;
+
+  (void) snprintf(file_name_buf,
+                  sizeof(file_name_buf),
+                  "track%02d.0.raw",
+                  (int) track);
+  p_track_file_name = util_file_name_join(p_file_name_base, &file_name_buf[0]);
+  p_file = util_file_try_read_open(p_track_file_name);
+  util_free(p_track_file_name);
+
+  return p_file;
+}
+
 void
 disc_kryo_load(struct disc_struct* p_disc, const char* p_full_file_name) {
   static const size_t k_max_kryo_track_size = (1024 * 1024);
@@ -45,21 +62,11 @@ disc_kryo_load(struct disc_struct* p_disc, const char* p_full_file_name) {
     uint32_t next_index_pulse = 0;
 
     if (i_track > 0) {
-      char file_name_buf[32];
-      char* p_extra_file_name;
-
       if (p_extra_file != NULL) {
         util_file_close(p_extra_file);
       }
 
-      (void) snprintf(file_name_buf,
-                      sizeof(file_name_buf),
-                      "track%02d.0.raw",
-                      i_track);
-      p_extra_file_name = util_file_name_join(p_file_name_base,
-                                              &file_name_buf[0]);
-      p_extra_file = util_file_try_read_open(p_extra_file_name);
-      util_free(p_extra_file_name);
+      p_extra_file = disc_kryo_try_open_track(p_file_name_base, i_track);
       if (p_extra_file == NULL) {
         /* Finished if the next track file doesn't exist. */
         break;
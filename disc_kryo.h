@@ -1,8 +1,14 @@
 #ifndef BEEBJIT_DISC_KRYO_H
 #define BEEBJIT_DISC_KRYO_H
 
+#include <stdint.h>
+
 struct disc_struct;
+struct util_file;
 
 void disc_kryo_load(struct disc_struct* p_disc, const char* p_full_file_name);
+/* A KryoFlux image is a file per track: track00.0.raw, track01.0.raw, ... */
+struct util_file* disc_kryo_try_open_track(const char* p_file_name_base,
+                                           uint32_t track);
 
 #endif /* BEEBJIT_DISC_KRYO_H */
@@ -8,12 +8,149 @@
 #include <assert.h>
 #include <string.h>
 
+enum {
+  k_disc_scp_max_track_size = (1024 * 1024),
+};
+
+struct disc_scp_metadata {
+  uint32_t num_revs;
+  /* File offset of each track's TRK header, or 0 if absent. */
+  uint32_t track_offsets[2][k_ibm_disc_tracks_per_disc];
+};
+
+static int
+disc_scp_read_rev_meta(struct util_file* p_file,
+                       uint32_t track_offset,
+                       uint32_t rev,
+                       uint32_t* p_data_offset,
+                       uint32_t* p_data_length) {
+  uint32_t len;
+  uint8_t chunk[12];
+
+  util_file_seek(p_file, (track_offset + 4 + (rev * 12)));
+  len = util_file_read(p_file, &chunk[0], 12);
+  if (len != 12) {
+    return 0;
+  }
+  *p_data_offset = (track_offset + util_read_le32(&chunk[8]));
+  *p_data_length = (util_read_le32(&chunk[4]) * 2);
+
+  return 1;
+}
+
+static void
+disc_scp_check_track_revs(struct util_file* p_file,
+                          uint32_t track_offset,
+                          uint32_t num_revs) {
+  /* Checked at insert, so that decoding a track later, mid emulation, has
+   * nothing left to object to.
+   */
+  uint32_t rev;
+  uint64_t file_size = util_file_get_size(p_file);
+
+  for (rev = 0; rev < num_revs; ++rev) {
+    uint32_t data_offset;
+    uint32_t data_length;
+    if (!disc_scp_read_rev_meta(p_file,
+                                track_offset,
+                                rev,
+                                &data_offset,
+                                &data_length)) {
+      util_bail("SCP can't read rev meta");
+    }
+    if (data_length > k_disc_scp_max_track_size) {
+      util_bail("SCP track too large");
+    }
+    if (((uint64_t) data_offset + data_length) > file_size) {
+      util_bail("SCP can't read track data");
+    }
+  }
+}
+
+static void
+disc_scp_load_track_rev(struct disc_struct* p_disc,
+                        int is_side_upper,
+                        uint32_t track,
+                        uint32_t track_offset,
+                        uint32_t rev) {
+  uint32_t len;
+  uint32_t track_data_offset;
+  uint32_t track_length;
+  uint32_t i_data;
+  uint32_t num_pulses;
+  uint8_t* p_scp_track_data;
+  float* p_pulses;
+
+  struct util_file* p_file = disc_get_file(p_disc);
+
+  /* The file was checked at insert. If it has changed underneath us since,
+   * leave the track unformatted rather than stop the emulation.
+   */
+  if (!disc_scp_read_rev_meta(p_file,
+                              track_offset,
+                              rev,
+                              &track_data_offset,
+                              &track_length) ||
+      (track_length > k_disc_scp_max_track_size)) {
+    log_do_log(k_log_disc, k_log_error, "SCP can't read rev meta");
+    return;
+  }
+
+  p_scp_track_data = util_malloc(track_length);
+  util_file_seek(p_file, track_data_offset);
+  len = util_file_read(p_file, p_scp_track_data, track_length);
+  if (len != track_length) {
+    log_do_log(k_log_disc, k_log_error, "SCP can't read track data");
+    util_free(p_scp_track_data);
+    return;
+  }
+
+  p_pulses = util_malloc((track_length / 2) * sizeof(float));
+  num_pulses = 0;
+  for (i_data = 0; i_data < track_length; i_data += 2) {
+    uint16_t sample = util_read_be16(&p_scp_track_data[i_data]);
+    float delta_us = (sample / 40.0);
+    p_pulses[num_pulses] = delta_us;
+    num_pulses++;
+  }
+
+  disc_build_track_from_pulses(p_disc,
+                               rev,
+                               is_side_upper,
+                               track,
+                               p_pulses,
+                               num_pulses);
+
+  util_free(p_scp_track_data);
+  util_free(p_pulses);
+}
+
+static void
+disc_scp_load_track(struct disc_struct* p_disc,
+                    int is_side_upper,
+                    uint32_t track) {
+  uint32_t rev;
+  struct disc_scp_metadata* p_metadata =
+      (struct disc_scp_metadata*) disc_get_format_metadata(p_disc);
+  uint32_t track_offset = p_metadata->track_offsets[is_side_upper][track];
+
+  if (track_offset == 0) {
+    return;
+  }
+  assert(disc_get_required_rev(p_disc) < p_metadata->num_revs);
+
+  for (rev = 0; rev < p_metadata->num_revs; ++rev) {
+    if (disc_is_rev_needed(p_disc, is_side_upper, track, rev)) {
+      disc_scp_load_track_rev(p_disc, is_side_upper, track, track_offset, rev);
+    }
+  }
+}
+
 void
 disc_scp_load(struct disc_struct* p_disc) {
-  static const size_t k_max_scp_track_size = (1024 * 1024);
   uint32_t len;
   uint8_t header[16];
-  uint8_t chunk[12];
+  uint8_t chunk[4];
   uint32_t i_tracks;
   uint32_t max_track;
   uint32_t num_tracks;
@@ -21,8 +158,7 @@ disc_scp_load(struct disc_struct* p_disc) {
   uint32_t heads_byte;
   uint32_t num_sides;
   uint8_t scp_flags;
-  uint8_t* p_scp_track_data;
-  float* p_pulses;
+  struct disc_scp_metadata* p_metadata;
   int is_one_side_only = 0;
 
   struct util_file* p_file = disc_get_file(p_disc);
@@ -80,16 +216,17 @@ disc_scp_load(struct disc_struct* p_disc) {
              num_tracks,
              num_revs);
 
-  p_scp_track_data = util_malloc(k_max_scp_track_size);
-  p_pulses = util_malloc(k_max_scp_track_size / 2 * 4);
+  p_metadata = (struct disc_scp_metadata*) disc_allocate_format_metadata(
+      p_disc, sizeof(struct disc_scp_metadata));
+  p_metadata->num_revs = num_revs;
 
+  /* Only the track index is read up front. Pulses are decoded as the drive
+   * first seeks to each track.
+   */
   for (i_tracks = 0; i_tracks < num_tracks; ++i_tracks) {
     uint32_t track_offset;
-    uint32_t track_data_offset;
-    uint32_t track_length;
     uint32_t actual_track;
     int side;
-    uint32_t i_revs;
 
     util_file_seek(p_file, ((i_tracks * 4) + 16));
     len = util_file_read(p_file, &chunk[0], 4);
@@ -144,50 +281,13 @@ disc_scp_load(struct disc_struct* p_disc) {
       util_bail("SCP track mismatch");
     }
 
-    for (i_revs = 0; i_revs < num_revs; ++i_revs) {
-      uint32_t i_data;
-      uint32_t num_pulses;
-
-      if (i_revs != rev) {
-        continue;
-      }
-
-      util_file_seek(p_file, (track_offset + 4 + (i_revs * 12)));
-      len = util_file_read(p_file, &chunk[0], 12);
-      if (len != 12) {
-        util_bail("SCP can't read rev meta");
-      }
-      track_data_offset = (track_offset + util_read_le32(&chunk[8]));
-      track_length = util_read_le32(&chunk[4]);
-      track_length *= 2;
-      if (track_length > k_max_scp_track_size) {
-        util_bail("SCP track too large");
-      }
-
-      util_file_seek(p_file, track_data_offset);
-      len = util_file_read(p_file, p_scp_track_data, track_length);
-      if (len != track_length) {
-        util_bail("SCP can't read track data");
-      }
-
-      i_data = 0;
-      num_pulses = 0;
-      for (i_data = 0; i_data < track_length; i_data += 2) {
-        uint16_t sample = util_read_be16(&p_scp_track_data[i_data]);
-        float delta_us = (sample / 40.0);
-        p_pulses[num_pulses] = delta_us;
-        num_pulses++;
-      }
-
-      disc_build_track_from_pulses(p_disc,
-                                   i_revs,
-                                   side,
-                                   actual_track,
-                                   p_pulses,
-                                   num_pulses);
+    if (rev >= num_revs) {
+      continue;
     }
+    disc_scp_check_track_revs(p_file, track_offset, num_revs);
+    p_metadata->track_offsets[side][actual_track] = track_offset;
+    disc_set_track_used(p_disc, side, actual_track);
   }
 
-  util_free(p_scp_track_data);
-  util_free(p_pulses);
+  disc_set_track_loader(p_disc, disc_scp_load_track);
 }
@@ -10,6 +10,8 @@ void disc_ssd_write_track(struct disc_struct* p_disc,
                           int is_side_upper,
                           uint32_t track,
                           uint32_t length,
-                          uint32_t* p_pulses);
+                          uint32_t* p_pulses,
+                          uint32_t dirty_start,
+                          uint32_t dirty_end);
 
 #endif /* BEEBJIT_DISC_SSD_H */
@@ -22,6 +22,7 @@ struct disc_tool_struct {
   uint32_t pos;
   struct disc_tool_sector sectors[k_max_sectors];
   uint32_t num_sectors;
+  int is_quiet;
 };
 
 struct disc_tool_struct*
@@ -75,6 +76,11 @@ disc_tool_set_track(struct disc_tool_struct* p_tool, uint32_t track) {
                                                p_tool->track);
 }
 
+void
+disc_tool_set_is_quiet(struct disc_tool_struct* p_tool, int is_quiet) {
+  p_tool->is_quiet = is_quiet;
+}
+
 void
 disc_tool_set_byte_pos(struct disc_tool_struct* p_tool, uint32_t pos) {
   if (pos >= p_tool->track_length) {
@@ -325,12 +331,14 @@ disc_tool_find_sectors(struct disc_tool_struct* p_tool) {
         mark_detector_prev_copy >>= 4;
       }
       if (num_0s <= 16) {
-        log_do_log(k_log_disc,
-                   k_log_unusual,
-                   "short zeros sync side %d track %d: %d",
-                   p_tool->is_side_upper,
-                   p_tool->track,
-                   num_0s);
+        if (!p_tool->is_quiet) {
+          log_do_log(k_log_disc,
+                     k_log_unusual,
+                     "short zeros sync side %d track %d: %d",
+                     p_tool->is_side_upper,
+                     p_tool->track,
+                     num_0s);
+        }
       }
     } else if (mark_detector == 0xAAAA448944894489) {
       /* Next byte is MFM marker. */
@@ -360,11 +368,13 @@ disc_tool_find_sectors(struct disc_tool_struct* p_tool) {
     } else if ((data == k_ibm_disc_data_mark_data_pattern) ||
                (data == k_ibm_disc_deleted_data_mark_data_pattern)) {
       if ((p_sector == NULL) || (p_sector->bit_pos_data != 0)) {
-        log_do_log(k_log_disc,
-                   k_log_unusual,
-                   "sector data without header side %d track %d",
-                   p_tool->is_side_upper,
-                   p_tool->track);
+        if (!p_tool->is_quiet) {
+          log_do_log(k_log_disc,
+                     k_log_unusual,
+                     "sector data without header side %d track %d",
+                     p_tool->is_side_upper,
+                     p_tool->track);
+        }
       } else {
         assert(p_sector->bit_pos_header != 0);
         p_sector->bit_pos_data = (i_pulses + 1);
@@ -375,12 +385,14 @@ disc_tool_find_sectors(struct disc_tool_struct* p_tool) {
         num_shifts = 0;
       }
     } else {
-      log_do_log(k_log_disc,
-                 k_log_unusual,
-                 "encountered marker byte %.2X side %d track %d",
-                 data,
-                 p_tool->is_side_upper,
-                 p_tool->track);
+      if (!p_tool->is_quiet) {
+        log_do_log(k_log_disc,
+                   k_log_unusual,
+                   "encountered marker byte %.2X side %d track %d",
+                   data,
+                   p_tool->is_side_upper,
+                   p_tool->track);
+      }
     }
   }
 
@@ -415,11 +427,13 @@ disc_tool_find_sectors(struct disc_tool_struct* p_tool) {
                              &is_iffy_pulse,
                              6);
       if (is_iffy_pulse) {
-        log_do_log(k_log_disc,
-                   k_log_unusual,
-                   "iffy pulse in sector header side %d track %d",
-                   p_tool->is_side_upper,
-                   p_tool->track);
+        if (!p_tool->is_quiet) {
+          log_do_log(k_log_disc,
+                     k_log_unusual,
+                     "iffy pulse in sector header side %d track %d",
+                     p_tool->is_side_upper,
+                     p_tool->track);
+        }
       }
     }
     crc = ibm_disc_format_crc_init(0);
@@ -437,11 +451,13 @@ disc_tool_find_sectors(struct disc_tool_struct* p_tool) {
     }
 
     if (p_sector->bit_pos_data == 0) {
-      log_do_log(k_log_disc,
-                 k_log_unusual,
-                 "sector header without data side %d track %d",
-                 p_tool->is_side_upper,
-                 p_tool->track);
+      if (!p_tool->is_quiet) {
+        log_do_log(k_log_disc,
+                   k_log_unusual,
+                   "sector header without data side %d track %d",
+                   p_tool->is_side_upper,
+                   p_tool->track);
+      }
       continue;
     }
 
@@ -505,11 +521,13 @@ disc_tool_find_sectors(struct disc_tool_struct* p_tool) {
     } while (sector_size >= 128);
 
     if (has_iffy_pulse) {
-      log_do_log(k_log_disc,
-                 k_log_unusual,
-                 "iffy pulse in sector data side %d track %d",
-                 p_tool->is_side_upper,
-                 p_tool->track);
+      if (!p_tool->is_quiet) {
+        log_do_log(k_log_disc,
+                   k_log_unusual,
+                   "iffy pulse in sector data side %d track %d",
+                   p_tool->is_side_upper,
+                   p_tool->track);
+      }
     }
   }
 
@@ -652,7 +670,9 @@ disc_tool_handle_dfs_catalog(struct disc_tool_struct* p_tool,
                              int32_t dfs_catalog_count,
                              uint8_t* p_sector_t0s0,
                              uint8_t* p_sector_t0s1,
-                             int do_extract_files) {
+                             int do_extract_files,
+                             int do_log,
+                             struct disc_tool_side_summary* p_side_summary) {
   uint32_t i_files;
   uint16_t num_sectors;
   uint8_t num_files = p_sector_t0s1[5];
@@ -661,29 +681,38 @@ disc_tool_handle_dfs_catalog(struct disc_tool_struct* p_tool,
   num_sectors |= ((p_sector_t0s1[6] & 0x03) << 8);
 
   if ((num_files % 8) != 0) {
-    log_do_log(k_log_disc,
-               k_log_info,
-               "DFS catalog bad number files %d",
-               num_files);
+    if (do_log) {
+      log_do_log(k_log_disc,
+                 k_log_info,
+                 "DFS catalog bad number files %d",
+                 num_files);
+    }
     return;
   }
   num_files /= 8;
 
   if ((num_sectors != 400) && (num_sectors != 800)) {
-    log_do_log(k_log_disc,
-               k_log_info,
-               "DFS catalog bad number sectors %d",
-               num_sectors);
+    if (do_log) {
+      log_do_log(k_log_disc,
+                 k_log_info,
+                 "DFS catalog bad number sectors %d",
+                 num_sectors);
+    }
     return;
   }
 
-  log_do_log(k_log_disc,
-             k_log_info,
-             "DFS catalog, %d files %d sectors cycle count %.2X title '%s'",
-             num_files,
-             num_sectors,
-             dfs_catalog_count,
-             p_dfs_title);
+  if (do_log) {
+    log_do_log(k_log_disc,
+               k_log_info,
+               "DFS catalog, %d files %d sectors cycle count %.2X title '%s'",
+               num_files,
+               num_sectors,
+               dfs_catalog_count,
+               p_dfs_title);
+  }
+  if (p_side_summary != NULL) {
+    p_side_summary->has_dfs_catalog = 1;
+  }
 
   for (i_files = 0; i_files < num_files; ++i_files) {
     uint8_t* p_file_buf;
@@ -747,7 +776,7 @@ disc_tool_handle_dfs_catalog(struct disc_tool_struct* p_tool,
         util_file_close(p_file);
       }
       util_free(p_file_buf);
-    } else {
+    } else if (do_log) {
       log_do_log(k_log_disc,
                  k_log_warning,
                  "can't read file %c.%s",
@@ -755,17 +784,31 @@ disc_tool_handle_dfs_catalog(struct disc_tool_struct* p_tool,
                  filename);
     }
 
-    log_do_log(k_log_disc,
-               k_log_info,
-               "file: %c.%s  %c  %.6X %.6X %.6X %.3X  (CRC32 %.8X)",
-               dirname,
-               filename,
-               (is_locked ? 'L' : ' '),
-               load_addr,
-               exec_addr,
-               file_len,
-               file_sector,
-               crc32);
+    if (do_log) {
+      log_do_log(k_log_disc,
+                 k_log_info,
+                 "file: %c.%s  %c  %.6X %.6X %.6X %.3X  (CRC32 %.8X)",
+                 dirname,
+                 filename,
+                 (is_locked ? 'L' : ' '),
+                 load_addr,
+                 exec_addr,
+                 file_len,
+                 file_sector,
+                 crc32);
+    }
+    if (p_side_summary != NULL) {
+      struct disc_tool_dfs_file* p_dfs_file =
+          &p_side_summary->dfs_files[p_side_summary->num_dfs_files++];
+      (void) memcpy(&p_dfs_file->name[0], &filename[0], sizeof(filename));
+      p_dfs_file->dir = dirname;
+      p_dfs_file->is_locked = is_locked;
+      p_dfs_file->load_addr = load_addr;
+      p_dfs_file->exec_addr = exec_addr;
+      p_dfs_file->length = file_len;
+      p_dfs_file->start_sector = file_sector;
+      p_dfs_file->crc32 = crc32;
+    }
   }
 }
 
@@ -777,11 +820,17 @@ disc_tool_log_summary(struct disc_struct* p_disc,
                       int log_fingerprint_tracks,
                       int log_catalog,
                       int do_dump_sector_data,
-                      int do_extract_files) {
+                      int do_extract_files,
+                      struct disc_tool_summary* p_summary) {
   uint32_t i_sides;
   struct disc_tool_struct* p_tool = disc_tool_create();
   uint32_t max_track = disc_get_num_tracks_used(p_disc);
-  int is_fingerprinting = (log_fingerprint || log_fingerprint_tracks);
+  int is_fingerprinting = (log_fingerprint ||
+                           log_fingerprint_tracks ||
+                           (p_summary != NULL));
+  int is_reading_catalog = (log_catalog ||
+                            do_extract_files ||
+                            (p_summary != NULL));
   struct util_file* p_raw_dump_file = NULL;
   uint32_t num_sides = 1;
   int is_80t = 0;
@@ -808,8 +857,15 @@ disc_tool_log_summary(struct disc_struct* p_disc,
     }
   }
 
+  if (p_summary != NULL) {
+    (void) memset(p_summary, '\0', sizeof(struct disc_tool_summary));
+    p_summary->num_sides = num_sides;
+    p_summary->is_80t = is_80t;
+  }
+
   disc_tool_set_disc(p_tool, p_disc);
   for (i_sides = 0; i_sides < num_sides; ++i_sides) {
+    struct disc_tool_side_summary* p_side_summary = NULL;
     uint8_t sector_t0s0[256];
     uint8_t sector_t0s1[256];
     char dfs_title[13];
@@ -821,6 +877,9 @@ disc_tool_log_summary(struct disc_struct* p_disc,
     int have_t0s1 = 0;
 
     (void) memset(&dfs_title[0], '\0', sizeof(dfs_title));
+    if (p_summary != NULL) {
+      p_side_summary = &p_summary->sides[i_sides];
+    }
 
     disc_tool_set_is_side_upper(p_tool, (i_sides == 1));
 
@@ -953,8 +1012,7 @@ disc_tool_log_summary(struct disc_struct* p_disc,
           }
         }
         if (is_fingerprinting ||
-            log_catalog ||
-            do_extract_files ||
+            is_reading_catalog ||
             (p_raw_dump_file != NULL)) {
           disc_tool_read_sector(p_tool, NULL, &sector_data[0], i_sectors, 1);
         }
@@ -980,7 +1038,7 @@ disc_tool_log_summary(struct disc_struct* p_disc,
                                        (p_sectors->byte_length + 1));
           }
         }
-        if (is_fingerprinting || log_catalog || do_extract_files) {
+        if (is_fingerprinting || is_reading_catalog) {
           /* Keep track of DFS metadata for logging. */
           if ((i_tracks == 0) &&
               (sector_track == 0) &&
@@ -1043,9 +1101,19 @@ disc_tool_log_summary(struct disc_struct* p_disc,
       }
     }
 
-    if (log_fingerprint) {
+    if (is_fingerprinting) {
       disc_crc = util_crc32_finish(disc_crc);
-
+      disc_crc_even = util_crc32_finish(disc_crc_even);
+    }
+    if (p_side_summary != NULL) {
+      p_side_summary->fingerprint = disc_crc;
+      p_side_summary->fingerprint_40t = disc_crc_even;
+      (void) memcpy(&p_side_summary->dfs_title[0],
+                    &dfs_title[0],
+                    sizeof(dfs_title));
+      p_side_summary->dfs_catalog_count = dfs_catalog_count;
+    }
+    if (log_fingerprint) {
       log_do_log(k_log_disc,
                  k_log_info,
                  "disc side %d CRC32 fingerprint %.8X title %s count %.2X",
@@ -1054,7 +1122,6 @@ disc_tool_log_summary(struct disc_struct* p_disc,
                  &dfs_title[0],
                  dfs_catalog_count);
       if (is_80t) {
-        disc_crc_even = util_crc32_finish(disc_crc_even);
         log_do_log(k_log_disc,
                    k_log_info,
                    "disc side %d, as 40 track, CRC32 fingerprint %.8X",
@@ -1063,7 +1130,7 @@ disc_tool_log_summary(struct disc_struct* p_disc,
       }
     }
 
-    if (log_catalog || do_extract_files) {
+    if (is_reading_catalog) {
       if (have_t0s0 && have_t0s1) {
         int is_upper_side = (i_sides == 1);
         disc_tool_handle_dfs_catalog(p_tool,
@@ -1072,7 +1139,9 @@ disc_tool_log_summary(struct disc_struct* p_disc,
                                      dfs_catalog_count,
                                      &sector_t0s0[0],
                                      &sector_t0s1[0],
-                                     do_extract_files);
+                                     do_extract_files,
+                                     (log_catalog || do_extract_files),
+                                     p_side_summary);
       }
     }
 
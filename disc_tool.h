@@ -20,10 +20,46 @@ struct disc_tool_sector {
   int has_data_crc_error;
 };
 
+enum {
+  k_disc_tool_max_dfs_files = 31,
+};
+
+struct disc_tool_dfs_file {
+  char name[8];
+  char dir;
+  int is_locked;
+  uint32_t load_addr;
+  uint32_t exec_addr;
+  uint32_t length;
+  uint16_t start_sector;
+  /* 0 if the file couldn't be read. */
+  uint32_t crc32;
+};
+
+struct disc_tool_side_summary {
+  uint32_t fingerprint;
+  /* Only meaningful for 80 track discs. */
+  uint32_t fingerprint_40t;
+  int has_dfs_catalog;
+  char dfs_title[13];
+  int32_t dfs_catalog_count;
+  uint32_t num_dfs_files;
+  struct disc_tool_dfs_file dfs_files[k_disc_tool_max_dfs_files];
+};
+
+struct disc_tool_summary {
+  uint32_t num_sides;
+  int is_80t;
+  struct disc_tool_side_summary sides[2];
+};
+
 struct disc_tool_struct;
 
 struct disc_struct;
 
+/* If p_summary is not NULL, it is filled with the fingerprints and DFS
+ * catalogs, independent of what is logged.
+ */
 void disc_tool_log_summary(struct disc_struct* p_disc,
                            int log_crc_errors,
                            int log_protection,
@@ -31,7 +67,8 @@ void disc_tool_log_summary(struct disc_struct* p_disc,
                            int log_fingerprint_tracks,
                            int log_catalog,
                            int do_dump_sector_data,
-                           int do_extract_files);
+                           int do_extract_files,
+                           struct disc_tool_summary* p_summary);
 
 struct disc_tool_struct* disc_tool_create();
 void disc_tool_destroy(struct disc_tool_struct* p_tool);
@@ -45,6 +82,8 @@ void disc_tool_set_is_side_upper(struct disc_tool_struct* p_tool,
                                  int is_side_upper);
 void disc_tool_set_track(struct disc_tool_struct* p_tool, uint32_t track);
 void disc_tool_set_byte_pos(struct disc_tool_struct* p_tool, uint32_t pos);
+/* Suppresses logging of oddities found by disc_tool_find_sectors(). */
+void disc_tool_set_is_quiet(struct disc_tool_struct* p_tool, int is_quiet);
 
 void disc_tool_read_fm_data(struct disc_tool_struct* p_tool,
                             uint8_t* p_clocks,
@@ -0,0 +1,187 @@
+#include "disc_writer.h"
+
+#include "os_channel.h"
+#include "os_lock.h"
+#include "os_thread.h"
+#include "util.h"
+
+#include <assert.h>
+#include <string.h>
+
+enum {
+  k_disc_writer_message_work = 1,
+  k_disc_writer_message_sync = 2,
+  k_disc_writer_message_exit = 3,
+};
+
+struct disc_writer_record {
+  uint64_t pos;
+  uint32_t length;
+};
+
+struct disc_writer_struct {
+  struct util_file* p_file;
+  struct os_thread_struct* p_thread;
+  /* Messages go to the thread one way, sync acknowledgements come back. */
+  intptr_t handle_message_read;
+  intptr_t handle_message_write;
+  intptr_t handle_ack_read;
+  intptr_t handle_ack_write;
+
+  /* Records are appended under the lock and swapped out by the writer thread.
+   * A work message is only sent when the pending queue goes non-empty.
+   * is_thread_writing is also under the lock, and is set while swapped out
+   * records are still on their way to the file.
+   */
+  struct os_lock_struct* p_lock;
+  int is_thread_writing;
+  uint8_t* p_pending;
+  uint32_t pending_count;
+  uint32_t pending_alloc;
+  uint8_t* p_spare;
+  uint32_t spare_alloc;
+};
+
+static void
+disc_writer_do_pending(struct disc_writer_struct* p_writer) {
+  uint8_t* p_records;
+  uint32_t alloc;
+  uint32_t count;
+  uint32_t offset;
+
+  os_lock_lock(p_writer->p_lock);
+  p_records = p_writer->p_pending;
+  alloc = p_writer->pending_alloc;
+  count = p_writer->pending_count;
+  p_writer->p_pending = p_writer->p_spare;
+  p_writer->pending_alloc = p_writer->spare_alloc;
+  p_writer->pending_count = 0;
+  p_writer->is_thread_writing = (count > 0);
+  os_lock_unlock(p_writer->p_lock);
+
+  offset = 0;
+  while (offset < count) {
+    struct disc_writer_record record;
+    (void) memcpy(&record, (p_records + offset), sizeof(record));
+    offset += sizeof(record);
+    util_file_seek(p_writer->p_file, record.pos);
+    util_file_write(p_writer->p_file, (p_records + offset), record.length);
+    offset += record.length;
+  }
+  if (count > 0) {
+    util_file_flush(p_writer->p_file);
+  }
+
+  os_lock_lock(p_writer->p_lock);
+  p_writer->is_thread_writing = 0;
+  os_lock_unlock(p_writer->p_lock);
+
+  p_writer->p_spare = p_records;
+  p_writer->spare_alloc = alloc;
+}
+
+static void*
+disc_writer_thread(void* p) {
+  struct disc_writer_struct* p_writer = (struct disc_writer_struct*) p;
+
+  while (1) {
+    uint8_t message;
+    os_channel_read(p_writer->handle_message_read, &message, 1);
+    disc_writer_do_pending(p_writer);
+    if (message == k_disc_writer_message_sync) {
+      os_channel_write(p_writer->handle_ack_write, &message, 1);
+    } else if (message == k_disc_writer_message_exit) {
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+struct disc_writer_struct*
+disc_writer_create(struct util_file* p_file) {
+  struct disc_writer_struct* p_writer =
+      util_mallocz(sizeof(struct disc_writer_struct));
+
+  p_writer->p_file = p_file;
+  p_writer->p_lock = os_lock_create();
+  os_channel_get_handles(&p_writer->handle_message_read,
+                         &p_writer->handle_message_write,
+                         &p_writer->handle_ack_read,
+                         &p_writer->handle_ack_write);
+  p_writer->p_thread = os_thread_create(disc_writer_thread, p_writer);
+
+  return p_writer;
+}
+
+void
+disc_writer_destroy(struct disc_writer_struct* p_writer) {
+  uint8_t message = k_disc_writer_message_exit;
+
+  os_channel_write(p_writer->handle_message_write, &message, 1);
+  (void) os_thread_destroy(p_writer->p_thread);
+  assert(p_writer->pending_count == 0);
+
+  os_channel_free_handles(p_writer->handle_message_read,
+                          p_writer->handle_message_write,
+                          p_writer->handle_ack_read,
+                          p_writer->handle_ack_write);
+  os_lock_destroy(p_writer->p_lock);
+  util_free(p_writer->p_pending);
+  util_free(p_writer->p_spare);
+  util_free(p_writer);
+}
+
+void
+disc_writer_write(struct disc_writer_struct* p_writer,
+                  uint64_t pos,
+                  const void* p_buf,
+                  uint32_t length) {
+  struct disc_writer_record record;
+  uint32_t new_count;
+  int was_empty;
+
+  record.pos = pos;
+  record.length = length;
+
+  os_lock_lock(p_writer->p_lock);
+  was_empty = (p_writer->pending_count == 0);
+  new_count = (p_writer->pending_count + sizeof(record) + length);
+  if (new_count > p_writer->pending_alloc) {
+    uint32_t new_alloc = (new_count * 2);
+    p_writer->p_pending = util_realloc(p_writer->p_pending, new_alloc);
+    p_writer->pending_alloc = new_alloc;
+  }
+  (void) memcpy((p_writer->p_pending + p_writer->pending_count),
+                &record,
+                sizeof(record));
+  (void) memcpy((p_writer->p_pending + p_writer->pending_count +
+                     sizeof(record)),
+                p_buf,
+                length);
+  p_writer->pending_count = new_count;
+  os_lock_unlock(p_writer->p_lock);
+
+  if (was_empty) {
+    uint8_t message = k_disc_writer_message_work;
+    os_channel_write(p_writer->handle_message_write, &message, 1);
+  }
+}
+
+void
+disc_writer_sync(struct disc_writer_struct* p_writer) {
+  uint8_t message = k_disc_writer_message_sync;
+  int is_idle;
+
+  os_lock_lock(p_writer->p_lock);
+  is_idle = ((p_writer->pending_count == 0) && !p_writer->is_thread_writing);
+  os_lock_unlock(p_writer->p_lock);
+  /* Nothing queued or in flight, so the file is already up to date. */
+  if (is_idle) {
+    return;
+  }
+
+  os_channel_write(p_writer->handle_message_write, &message, 1);
+  os_channel_read(p_writer->handle_ack_read, &message, 1);
+  assert(message == k_disc_writer_message_sync);
+}
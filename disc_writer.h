@@ -0,0 +1,29 @@
+#ifndef BEEBJIT_DISC_WRITER_H
+#define BEEBJIT_DISC_WRITER_H
+
+#include <stdint.h>
+
+struct disc_writer_struct;
+
+struct util_file;
+
+/* Writes blocks to a disc file on a background thread. Writes are applied in
+ * order, and the file is flushed once per batch of queued writes rather than
+ * once per write.
+ * The file must not be touched by anyone else unless disc_writer_sync() has
+ * been called since the last disc_writer_write().
+ */
+struct disc_writer_struct* disc_writer_create(struct util_file* p_file);
+/* Lands all queued writes before returning. Nothing is flushed at exit(), so
+ * the owner must destroy the writer on the way out.
+ */
+void disc_writer_destroy(struct disc_writer_struct* p_writer);
+
+void disc_writer_write(struct disc_writer_struct* p_writer,
+                       uint64_t pos,
+                       const void* p_buf,
+                       uint32_t length);
+/* Waits until all queued writes are in the file. Cheap if there are none. */
+void disc_writer_sync(struct disc_writer_struct* p_writer);
+
+#endif /* BEEBJIT_DISC_WRITER_H */
@@ -10,6 +10,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+struct expression_op {
+  int32_t type;
+  uint32_t jump;
+  int64_t value;
+  expression_var_read_func_t p_read_func;
+  expression_var_write_func_t p_write_func;
+};
+
 struct expression_struct {
   expression_var_read_lookup_func_t p_var_read_lookup_func;
   expression_var_write_lookup_func_t p_var_write_lookup_func;
@@ -17,6 +25,16 @@ struct expression_struct {
   char* p_expr_str;
   struct util_tree_struct* p_tree;
   struct util_tree_node_struct* p_current_node;
+
+  /* The tree is compiled to a flat stack machine program after parsing, so
+   * that breakpoint conditions don't walk the tree on every instruction.
+   */
+  struct expression_op* p_ops;
+  uint32_t num_ops;
+  uint32_t ops_alloc;
+  int64_t* p_stack;
+  uint32_t stack_depth;
+  uint32_t max_stack_depth;
 };
 
 struct expression_variable_funcs_struct {
@@ -48,6 +66,31 @@ enum {
   k_expression_node_assign = 21,
 };
 
+enum {
+  k_expression_op_push = 1,
+  k_expression_op_pop = 2,
+  k_expression_op_read = 3,
+  k_expression_op_read_index = 4,
+  k_expression_op_write = 5,
+  k_expression_op_write_index = 6,
+  /* Short circuits by jumping with the deciding value left as the result. */
+  k_expression_op_logical_and = 7,
+  k_expression_op_logical_or = 8,
+  k_expression_op_bool = 9,
+  k_expression_op_equal = 10,
+  k_expression_op_not_equal = 11,
+  k_expression_op_greater_than = 12,
+  k_expression_op_greater_than_equal = 13,
+  k_expression_op_less_than = 14,
+  k_expression_op_less_than_equal = 15,
+  k_expression_op_plus = 16,
+  k_expression_op_minus = 17,
+  k_expression_op_multiply = 18,
+  k_expression_op_divide = 19,
+  k_expression_op_bitwise_and = 20,
+  k_expression_op_bitwise_or = 21,
+};
+
 struct expression_struct*
 expression_create(expression_var_read_lookup_func_t p_var_read_lookup_func,
                   expression_var_write_lookup_func_t p_var_write_lookup_func,
@@ -66,6 +109,8 @@ void
 expression_destroy(struct expression_struct* p_expression) {
   util_free(p_expression->p_expr_str);
   util_tree_free(p_expression->p_tree);
+  util_free(p_expression->p_ops);
+  util_free(p_expression->p_stack);
   util_free(p_expression);
 }
 
@@ -76,6 +121,11 @@ expression_clear(struct expression_struct* p_expression) {
   util_tree_free(p_expression->p_tree);
   p_expression->p_tree = util_tree_alloc();
   p_expression->p_current_node = NULL;
+  util_free(p_expression->p_stack);
+  p_expression->p_stack = NULL;
+  p_expression->num_ops = 0;
+  p_expression->stack_depth = 0;
+  p_expression->max_stack_depth = 0;
 }
 
 static int32_t
@@ -304,6 +354,185 @@ expression_process_token(struct expression_struct* p_expression,
   p_expression->p_current_node = p_new_node;
 }
 
+static struct expression_op*
+expression_emit(struct expression_struct* p_expression,
+                int32_t type,
+                int32_t stack_change) {
+  struct expression_op* p_op;
+
+  if (p_expression->num_ops == p_expression->ops_alloc) {
+    uint32_t new_alloc = ((p_expression->ops_alloc * 2) + 16);
+    p_expression->p_ops = util_realloc(p_expression->p_ops,
+                                       (new_alloc * sizeof(*p_op)));
+    p_expression->ops_alloc = new_alloc;
+  }
+  p_op = &p_expression->p_ops[p_expression->num_ops++];
+  (void) memset(p_op, '\0', sizeof(*p_op));
+  p_op->type = type;
+
+  p_expression->stack_depth += stack_change;
+  if (p_expression->stack_depth > p_expression->max_stack_depth) {
+    p_expression->max_stack_depth = p_expression->stack_depth;
+  }
+
+  return p_op;
+}
+
+static void
+expression_compile_node(struct expression_struct* p_expression,
+                        struct util_tree_node_struct* p_node) {
+  struct expression_variable_funcs_struct* p_funcs;
+  struct expression_op* p_op;
+  uint32_t jump_op;
+  int32_t op_type = 0;
+  int32_t type = util_tree_node_get_type(p_node);
+  uint32_t num_children = util_tree_node_get_num_children(p_node);
+  struct util_tree_node_struct* p_child_node_1 = NULL;
+  struct util_tree_node_struct* p_child_node_2 = NULL;
+
+  if (num_children > 0) {
+    p_child_node_1 = util_tree_node_get_child(p_node, 0);
+  }
+  if (num_children > 1) {
+    p_child_node_2 = util_tree_node_get_child(p_node, 1);
+  }
+
+  switch (type) {
+  case k_expression_node_integer:
+    p_op = expression_emit(p_expression, k_expression_op_push, 1);
+    p_op->value = util_tree_node_get_int_value(p_node);
+    return;
+  case k_expression_node_var:
+    p_funcs = (struct expression_variable_funcs_struct*)
+        util_tree_node_get_object_value(p_node);
+    if (num_children == 1) {
+      expression_compile_node(p_expression, p_child_node_1);
+      if (p_funcs->p_var_read_func != NULL) {
+        p_op = expression_emit(p_expression, k_expression_op_read_index, 0);
+        p_op->p_read_func = p_funcs->p_var_read_func;
+        return;
+      }
+      (void) expression_emit(p_expression, k_expression_op_pop, -1);
+    } else if (p_funcs->p_var_read_func != NULL) {
+      p_op = expression_emit(p_expression, k_expression_op_read, 1);
+      p_op->p_read_func = p_funcs->p_var_read_func;
+      return;
+    }
+    break;
+  case k_expression_node_logical_and:
+  case k_expression_node_logical_or:
+    if (num_children != 2) {
+      break;
+    }
+    expression_compile_node(p_expression, p_child_node_1);
+    jump_op = p_expression->num_ops;
+    if (type == k_expression_node_logical_and) {
+      (void) expression_emit(p_expression, k_expression_op_logical_and, -1);
+    } else {
+      (void) expression_emit(p_expression, k_expression_op_logical_or, -1);
+    }
+    expression_compile_node(p_expression, p_child_node_2);
+    (void) expression_emit(p_expression, k_expression_op_bool, 0);
+    p_expression->p_ops[jump_op].jump = p_expression->num_ops;
+    return;
+  case k_expression_node_paren_close:
+  case k_expression_node_square_close:
+    if (num_children == 1) {
+      expression_compile_node(p_expression, p_child_node_1);
+      return;
+    }
+    break;
+  case k_expression_node_assign:
+    if (num_children != 2) {
+      break;
+    }
+    expression_compile_node(p_expression, p_child_node_2);
+    if (util_tree_node_get_type(p_child_node_1) != k_expression_node_var) {
+      return;
+    }
+    p_funcs = (struct expression_variable_funcs_struct*)
+        util_tree_node_get_object_value(p_child_node_1);
+    if (util_tree_node_get_num_children(p_child_node_1) == 1) {
+      struct util_tree_node_struct* p_index_node =
+          util_tree_node_get_child(p_child_node_1, 0);
+      expression_compile_node(p_expression, p_index_node);
+      if (p_funcs->p_var_write_func != NULL) {
+        p_op = expression_emit(p_expression, k_expression_op_write_index, -1);
+        p_op->p_write_func = p_funcs->p_var_write_func;
+      } else {
+        (void) expression_emit(p_expression, k_expression_op_pop, -1);
+      }
+    } else if (p_funcs->p_var_write_func != NULL) {
+      p_op = expression_emit(p_expression, k_expression_op_write, 0);
+      p_op->p_write_func = p_funcs->p_var_write_func;
+    }
+    return;
+  case k_expression_node_equal:
+    op_type = k_expression_op_equal;
+    break;
+  case k_expression_node_not_equal:
+    op_type = k_expression_op_not_equal;
+    break;
+  case k_expression_node_greater_than:
+    op_type = k_expression_op_greater_than;
+    break;
+  case k_expression_node_greater_than_equal:
+    op_type = k_expression_op_greater_than_equal;
+    break;
+  case k_expression_node_less_than:
+    op_type = k_expression_op_less_than;
+    break;
+  case k_expression_node_less_than_equal:
+    op_type = k_expression_op_less_than_equal;
+    break;
+  case k_expression_node_plus:
+    op_type = k_expression_op_plus;
+    break;
+  case k_expression_node_minus:
+    op_type = k_expression_op_minus;
+    break;
+  case k_expression_node_multiply:
+    op_type = k_expression_op_multiply;
+    break;
+  case k_expression_node_divide:
+    op_type = k_expression_op_divide;
+    break;
+  case k_expression_node_bitwise_and:
+    op_type = k_expression_op_bitwise_and;
+    break;
+  case k_expression_node_bitwise_or:
+    op_type = k_expression_op_bitwise_or;
+    break;
+  default:
+    break;
+  }
+
+  if ((op_type != 0) && (num_children == 2)) {
+    expression_compile_node(p_expression, p_child_node_1);
+    expression_compile_node(p_expression, p_child_node_2);
+    (void) expression_emit(p_expression, op_type, -1);
+    return;
+  }
+
+  /* Anything malformed evaluates to 0. */
+  p_op = expression_emit(p_expression, k_expression_op_push, 1);
+  p_op->value = 0;
+}
+
+static void
+expression_compile(struct expression_struct* p_expression) {
+  struct util_tree_node_struct* p_node = util_tree_get_root(
+      p_expression->p_tree);
+
+  if (p_node == NULL) {
+    return;
+  }
+  expression_compile_node(p_expression, p_node);
+  assert(p_expression->stack_depth == 1);
+  p_expression->p_stack =
+      util_malloc(p_expression->max_stack_depth * sizeof(int64_t));
+}
+
 int64_t
 expression_parse(struct expression_struct* p_expression,
                  const char* p_expr_str) {
@@ -378,177 +607,83 @@ expression_parse(struct expression_struct* p_expression,
     }
   }
 
+  expression_compile(p_expression);
+
   return 0;
 }
 
-static int64_t
-expression_execute_node(struct expression_struct* p_expression,
-                        struct util_tree_node_struct* p_node) {
+static int
+expression_is_var_node(struct util_tree_node_struct* p_node,
+                       expression_var_read_func_t p_read_func) {
   struct expression_variable_funcs_struct* p_funcs;
-  expression_var_read_func_t p_read_func;
-  expression_var_write_func_t p_write_func;
-  int64_t lhs;
-  int64_t rhs;
-  uint32_t index;
-  int64_t ret = 0;
-  int32_t type = util_tree_node_get_type(p_node);
-  uint32_t num_children = util_tree_node_get_num_children(p_node);
-  struct util_tree_node_struct* p_child_node_1 = NULL;
-  struct util_tree_node_struct* p_child_node_2 = NULL;
 
-  if (num_children > 0) {
-    p_child_node_1 = util_tree_node_get_child(p_node, 0);
-  }
-  if (num_children > 1) {
-    p_child_node_2 = util_tree_node_get_child(p_node, 1);
+  if ((util_tree_node_get_type(p_node) != k_expression_node_var) ||
+      (util_tree_node_get_num_children(p_node) != 0)) {
+    return 0;
   }
+  p_funcs = (struct expression_variable_funcs_struct*)
+      util_tree_node_get_object_value(p_node);
+  return (p_funcs->p_var_read_func == p_read_func);
+}
 
-  switch (type) {
-  case k_expression_node_integer:
-    ret = util_tree_node_get_int_value(p_node);
-    break;
-  case k_expression_node_var:
-    index = 0;
-    if (num_children == 1) {
-      index = expression_execute_node(p_expression, p_child_node_1);
-    }
-    p_funcs = (struct expression_variable_funcs_struct*)
-        util_tree_node_get_object_value(p_node);
-    p_read_func = p_funcs->p_var_read_func;
-    if (p_read_func != NULL) {
-      ret = p_read_func(p_expression->p_variable_object, index);
-    }
-    break;
-  case k_expression_node_plus:
-    if (num_children == 2) {
-      ret = expression_execute_node(p_expression, p_child_node_1);
-      ret += expression_execute_node(p_expression, p_child_node_2);
-    }
-    break;
-  case k_expression_node_minus:
-    if (num_children == 2) {
-      ret = expression_execute_node(p_expression, p_child_node_1);
-      ret -= expression_execute_node(p_expression, p_child_node_2);
-    }
-    break;
-  case k_expression_node_multiply:
-    if (num_children == 2) {
-      ret = expression_execute_node(p_expression, p_child_node_1);
-      ret *= expression_execute_node(p_expression, p_child_node_2);
-    }
-    break;
-  case k_expression_node_divide:
-    if (num_children == 2) {
-      ret = expression_execute_node(p_expression, p_child_node_1);
-      ret /= expression_execute_node(p_expression, p_child_node_2);
-    }
-    break;
-  case k_expression_node_equal:
-    if (num_children == 2) {
-      lhs = expression_execute_node(p_expression, p_child_node_1);
-      rhs = expression_execute_node(p_expression, p_child_node_2);
-      ret = (lhs == rhs);
-    }
-    break;
-  case k_expression_node_not_equal:
-    if (num_children == 2) {
-      lhs = expression_execute_node(p_expression, p_child_node_1);
-      rhs = expression_execute_node(p_expression, p_child_node_2);
-      ret = (lhs != rhs);
-    }
-    break;
-  case k_expression_node_less_than:
-    if (num_children == 2) {
-      lhs = expression_execute_node(p_expression, p_child_node_1);
-      rhs = expression_execute_node(p_expression, p_child_node_2);
-      ret = (lhs < rhs);
-    }
-    break;
-  case k_expression_node_less_than_equal:
-    if (num_children == 2) {
-      lhs = expression_execute_node(p_expression, p_child_node_1);
-      rhs = expression_execute_node(p_expression, p_child_node_2);
-      ret = (lhs <= rhs);
-    }
-    break;
-  case k_expression_node_greater_than:
-    if (num_children == 2) {
-      lhs = expression_execute_node(p_expression, p_child_node_1);
-      rhs = expression_execute_node(p_expression, p_child_node_2);
-      ret = (lhs > rhs);
-    }
-    break;
-  case k_expression_node_greater_than_equal:
-    if (num_children == 2) {
-      lhs = expression_execute_node(p_expression, p_child_node_1);
-      rhs = expression_execute_node(p_expression, p_child_node_2);
-      ret = (lhs >= rhs);
-    }
-    break;
-  case k_expression_node_logical_and:
-    if (num_children == 2) {
-      lhs = expression_execute_node(p_expression, p_child_node_1);
-      rhs = 0;
-      if (lhs) {
-        rhs = expression_execute_node(p_expression, p_child_node_2);
-      }
-      ret = (lhs && rhs);
-    }
-    break;
-  case k_expression_node_logical_or:
-    if (num_children == 2) {
-      lhs = expression_execute_node(p_expression, p_child_node_1);
-      rhs = 0;
-      if (!lhs) {
-        rhs = expression_execute_node(p_expression, p_child_node_2);
-      }
-      ret = (lhs || rhs);
-    }
-    break;
-  case k_expression_node_bitwise_and:
-    if (num_children == 2) {
-      ret = expression_execute_node(p_expression, p_child_node_1);
-      ret &= expression_execute_node(p_expression, p_child_node_2);
-    }
-    break;
-  case k_expression_node_bitwise_or:
-    if (num_children == 2) {
-      ret = expression_execute_node(p_expression, p_child_node_1);
-      ret |= expression_execute_node(p_expression, p_child_node_2);
-    }
-    break;
-  case k_expression_node_paren_close:
-  case k_expression_node_square_close:
-    if (num_children == 1) {
-      ret = expression_execute_node(p_expression, p_child_node_1);
-    }
-    break;
-  case k_expression_node_assign:
-    if (num_children != 2) {
-      break;
-    }
-    rhs = expression_execute_node(p_expression, p_child_node_2);
-    ret = rhs;
-    if (util_tree_node_get_type(p_child_node_1) == k_expression_node_var) {
-      index = 0;
-      if (util_tree_node_get_num_children(p_child_node_1) == 1) {
-        struct util_tree_node_struct* p_index_node =
-            util_tree_node_get_child(p_child_node_1, 0);
-        index = expression_execute_node(p_expression, p_index_node);
-      }
-      p_funcs = (struct expression_variable_funcs_struct*)
-          util_tree_node_get_object_value(p_child_node_1);
-      p_write_func = p_funcs->p_var_write_func;
-      if (p_write_func != NULL) {
-        p_write_func(p_expression->p_variable_object, index, rhs);
-      }
+static int
+expression_has_assign(struct util_tree_node_struct* p_node) {
+  uint32_t i;
+  uint32_t num_children = util_tree_node_get_num_children(p_node);
+
+  if (util_tree_node_get_type(p_node) == k_expression_node_assign) {
+    return 1;
+  }
+  for (i = 0; i < num_children; ++i) {
+    if (expression_has_assign(util_tree_node_get_child(p_node, i))) {
+      return 1;
     }
-    break;
-  default:
-    assert(0);
   }
+  return 0;
+}
 
-  return ret;
+static int
+expression_find_required_value(struct util_tree_node_struct* p_node,
+                               expression_var_read_func_t p_read_func,
+                               int64_t* p_value) {
+  struct util_tree_node_struct* p_child_node_1;
+  struct util_tree_node_struct* p_child_node_2;
+  int32_t type = util_tree_node_get_type(p_node);
+  uint32_t num_children = util_tree_node_get_num_children(p_node);
+
+  if ((type == k_expression_node_paren_close) && (num_children == 1)) {
+    return expression_find_required_value(util_tree_node_get_child(p_node, 0),
+                                          p_read_func,
+                                          p_value);
+  }
+  if (num_children != 2) {
+    return 0;
+  }
+  p_child_node_1 = util_tree_node_get_child(p_node, 0);
+  p_child_node_2 = util_tree_node_get_child(p_node, 1);
+  /* For a && b, either side being false is enough. */
+  if (type == k_expression_node_logical_and) {
+    return (expression_find_required_value(p_child_node_1,
+                                           p_read_func,
+                                           p_value) ||
+            expression_find_required_value(p_child_node_2,
+                                           p_read_func,
+                                           p_value));
+  }
+  if (type != k_expression_node_equal) {
+    return 0;
+  }
+  if (expression_is_var_node(p_child_node_1, p_read_func) &&
+      (util_tree_node_get_type(p_child_node_2) == k_expression_node_integer)) {
+    *p_value = util_tree_node_get_int_value(p_child_node_2);
+    return 1;
+  }
+  if (expression_is_var_node(p_child_node_2, p_read_func) &&
+      (util_tree_node_get_type(p_child_node_1) == k_expression_node_integer)) {
+    *p_value = util_tree_node_get_int_value(p_child_node_1);
+    return 1;
+  }
+  return 0;
 }
 
 const char*
@@ -561,17 +696,128 @@ expression_get_tree_size(struct expression_struct* p_expression) {
   return util_tree_get_tree_size(p_expression->p_tree);
 }
 
+int
+expression_get_required_value(struct expression_struct* p_expression,
+                              expression_var_read_func_t p_read_func,
+                              int64_t* p_value) {
+  struct util_tree_node_struct* p_node = util_tree_get_root(
+      p_expression->p_tree);
+  if (p_node == NULL) {
+    return 0;
+  }
+  /* Filtering would skip assignments the expression makes on every run. */
+  if (expression_has_assign(p_node)) {
+    return 0;
+  }
+  return expression_find_required_value(p_node,
+                                        p_read_func,
+                                        p_value);
+}
+
 int64_t
 expression_execute(struct expression_struct* p_expression) {
-  struct util_tree_node_struct* p_node;
-  if (p_expression->p_tree == NULL) {
+  int64_t rhs;
+  uint32_t index;
+  struct expression_op* p_ops = p_expression->p_ops;
+  uint32_t num_ops = p_expression->num_ops;
+  void* p_object = p_expression->p_variable_object;
+  /* Points at the next free slot. */
+  int64_t* p_top = p_expression->p_stack;
+  uint32_t i = 0;
+
+  if (num_ops == 0) {
     return 0;
   }
-  p_node = util_tree_get_root(p_expression->p_tree);
-  if (p_node == NULL) {
-    return 0;
+
+  while (i < num_ops) {
+    struct expression_op* p_op = &p_ops[i++];
+    switch (p_op->type) {
+    case k_expression_op_push:
+      *p_top++ = p_op->value;
+      break;
+    case k_expression_op_pop:
+      p_top--;
+      break;
+    case k_expression_op_read:
+      *p_top++ = p_op->p_read_func(p_object, 0);
+      break;
+    case k_expression_op_read_index:
+      p_top[-1] = p_op->p_read_func(p_object, (uint32_t) p_top[-1]);
+      break;
+    case k_expression_op_write:
+      p_op->p_write_func(p_object, 0, p_top[-1]);
+      break;
+    case k_expression_op_write_index:
+      index = (uint32_t) *--p_top;
+      p_op->p_write_func(p_object, index, p_top[-1]);
+      break;
+    case k_expression_op_logical_and:
+      if (p_top[-1] == 0) {
+        i = p_op->jump;
+      } else {
+        p_top--;
+      }
+      break;
+    case k_expression_op_logical_or:
+      if (p_top[-1] != 0) {
+        p_top[-1] = 1;
+        i = p_op->jump;
+      } else {
+        p_top--;
+      }
+      break;
+    case k_expression_op_bool:
+      p_top[-1] = !!p_top[-1];
+      break;
+    default:
+      rhs = *--p_top;
+      switch (p_op->type) {
+      case k_expression_op_equal:
+        p_top[-1] = (p_top[-1] == rhs);
+        break;
+      case k_expression_op_not_equal:
+        p_top[-1] = (p_top[-1] != rhs);
+        break;
+      case k_expression_op_greater_than:
+        p_top[-1] = (p_top[-1] > rhs);
+        break;
+      case k_expression_op_greater_than_equal:
+        p_top[-1] = (p_top[-1] >= rhs);
+        break;
+      case k_expression_op_less_than:
+        p_top[-1] = (p_top[-1] < rhs);
+        break;
+      case k_expression_op_less_than_equal:
+        p_top[-1] = (p_top[-1] <= rhs);
+        break;
+      case k_expression_op_plus:
+        p_top[-1] += rhs;
+        break;
+      case k_expression_op_minus:
+        p_top[-1] -= rhs;
+        break;
+      case k_expression_op_multiply:
+        p_top[-1] *= rhs;
+        break;
+      case k_expression_op_divide:
+        p_top[-1] /= rhs;
+        break;
+      case k_expression_op_bitwise_and:
+        p_top[-1] &= rhs;
+        break;
+      case k_expression_op_bitwise_or:
+        p_top[-1] |= rhs;
+        break;
+      default:
+        assert(0);
+        break;
+      }
+      break;
+    }
   }
-  return expression_execute_node(p_expression, p_node);
+
+  assert(p_top == (p_expression->p_stack + 1));
+  return p_top[-1];
 }
 
 #include "test-expression.c"
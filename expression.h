@@ -27,5 +27,13 @@ const char* expression_get_original_string(
     struct expression_struct* p_expression);
 uint32_t expression_get_tree_size(struct expression_struct* p_expression);
 int64_t expression_execute(struct expression_struct* p_expression);
+/* If the expression can only be non-zero while the variable read by
+ * p_read_func equals a constant, returns 1 and that constant. Callers use
+ * this to filter cheaply before executing. Expressions with assignments are
+ * never filtered, because the assignments must still happen.
+ */
+int expression_get_required_value(struct expression_struct* p_expression,
+                                  expression_var_read_func_t p_read_func,
+                                  int64_t* p_value);
 
 #endif /* BEEBJIT_EXPRESSION_H */
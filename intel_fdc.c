@@ -484,6 +484,24 @@ intel_fdc_set_state(struct intel_fdc_struct* p_fdc, int state) {
   }
 }
 
+static void
+intel_fdc_update_pulses_wanted(struct intel_fdc_struct* p_fdc) {
+  /* Outside of a command, the bit processor only needs the index pulse edges,
+   * unless the write gate is open or the MMIO data register needs refreshing.
+   */
+  int wanted = ((p_fdc->state != k_intel_fdc_state_idle) ||
+                (p_fdc->drive_out & k_intel_fdc_drive_out_write_enable) ||
+                (p_fdc->mmio_data !=
+                    p_fdc->regs[k_intel_fdc_register_internal_data]));
+
+  if (p_fdc->p_drive_0 != NULL) {
+    disc_drive_set_pulses_wanted(p_fdc->p_drive_0, wanted);
+  }
+  if (p_fdc->p_drive_1 != NULL) {
+    disc_drive_set_pulses_wanted(p_fdc->p_drive_1, wanted);
+  }
+}
+
 static void
 intel_fdc_clear_callbacks(struct intel_fdc_struct* p_fdc) {
   p_fdc->parameter_callback = k_intel_fdc_parameter_accept_none;
@@ -860,6 +878,8 @@ intel_fdc_timer_fired(void* p) {
     assert(0);
     break;
   }
+
+  intel_fdc_update_pulses_wanted(p_fdc);
 }
 
 struct intel_fdc_struct*
@@ -1375,6 +1395,8 @@ intel_fdc_write(struct intel_fdc_struct* p_fdc,
     assert(0);
     break;
   }
+
+  intel_fdc_update_pulses_wanted(p_fdc);
 }
 
 void
@@ -1870,11 +1892,58 @@ intel_fdc_byte_callback_writing(struct intel_fdc_struct* p_fdc) {
   }
 }
 
+static uint8_t
+intel_fdc_gather_odd_bits(uint32_t bits) {
+  /* Packs bits 14, 12, ..., 0 of a 16-bit value into a byte. */
+  bits &= 0x5555;
+  bits = ((bits | (bits >> 1)) & 0x3333);
+  bits = ((bits | (bits >> 2)) & 0x0F0F);
+  bits = ((bits | (bits >> 4)) & 0x00FF);
+  return (uint8_t) bits;
+}
+
+static int
+intel_fdc_is_byte_shifting_state(int state) {
+  switch (state) {
+  case k_intel_fdc_state_check_id_marker:
+  case k_intel_fdc_state_in_id:
+  case k_intel_fdc_state_in_id_crc:
+  case k_intel_fdc_state_check_data_marker:
+  case k_intel_fdc_state_in_data:
+  case k_intel_fdc_state_in_data_crc:
+  case k_intel_fdc_state_skip_gap_2:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+static void
+intel_fdc_shift_register_full(struct intel_fdc_struct* p_fdc) {
+  uint32_t shift_register = p_fdc->shift_register;
+  uint8_t clocks_byte = intel_fdc_gather_odd_bits(shift_register >> 1);
+  uint8_t data_byte = intel_fdc_gather_odd_bits(shift_register);
+  int state = p_fdc->state;
+
+  assert(p_fdc->num_shifts == 16);
+
+  if ((clocks_byte != 0xFF) &&
+      (state != k_intel_fdc_state_check_id_marker) &&
+      (state != k_intel_fdc_state_check_data_marker) &&
+      (state != k_intel_fdc_state_skip_gap_2)) {
+    /* Nothing. From testing, the 8271 doesn't deliver bytes with missing
+     * clock bits in the middle of a synced byte stream.
+     */
+  } else {
+    intel_fdc_byte_callback_reading(p_fdc, data_byte, clocks_byte);
+  }
+
+  p_fdc->shift_register = 0;
+  p_fdc->num_shifts = 0;
+}
+
 static void
 intel_fdc_shift_data_bit(struct intel_fdc_struct* p_fdc, int bit) {
-  uint8_t clocks_byte;
-  uint8_t data_byte;
-  uint32_t shift_register;
   uint32_t state_count;
   int state = p_fdc->state;
 
@@ -1922,47 +1991,12 @@ intel_fdc_shift_data_bit(struct intel_fdc_struct* p_fdc, int bit) {
   case k_intel_fdc_state_in_data:
   case k_intel_fdc_state_in_data_crc:
   case k_intel_fdc_state_skip_gap_2:
-    shift_register = p_fdc->shift_register;
-    shift_register <<= 1;
-    shift_register |= bit;
-    p_fdc->shift_register = shift_register;
+    p_fdc->shift_register <<= 1;
+    p_fdc->shift_register |= bit;
     p_fdc->num_shifts++;
-
-    if (p_fdc->num_shifts != 16) {
-      break;
-    }
-    clocks_byte = 0;
-    data_byte = 0;
-    if (shift_register & 0x8000) clocks_byte |= 0x80;
-    if (shift_register & 0x2000) clocks_byte |= 0x40;
-    if (shift_register & 0x0800) clocks_byte |= 0x20;
-    if (shift_register & 0x0200) clocks_byte |= 0x10;
-    if (shift_register & 0x0080) clocks_byte |= 0x08;
-    if (shift_register & 0x0020) clocks_byte |= 0x04;
-    if (shift_register & 0x0008) clocks_byte |= 0x02;
-    if (shift_register & 0x0002) clocks_byte |= 0x01;
-    if (shift_register & 0x4000) data_byte |= 0x80;
-    if (shift_register & 0x1000) data_byte |= 0x40;
-    if (shift_register & 0x0400) data_byte |= 0x20;
-    if (shift_register & 0x0100) data_byte |= 0x10;
-    if (shift_register & 0x0040) data_byte |= 0x08;
-    if (shift_register & 0x0010) data_byte |= 0x04;
-    if (shift_register & 0x0004) data_byte |= 0x02;
-    if (shift_register & 0x0001) data_byte |= 0x01;
-
-    if ((clocks_byte != 0xFF) &&
-        (state != k_intel_fdc_state_check_id_marker) &&
-        (state != k_intel_fdc_state_check_data_marker) &&
-        (state != k_intel_fdc_state_skip_gap_2)) {
-      /* Nothing. From testing, the 8271 doesn't deliver bytes with missing
-       * clock bits in the middle of a synced byte stream.
-       */
-    } else {
-      intel_fdc_byte_callback_reading(p_fdc, data_byte, clocks_byte);
+    if (p_fdc->num_shifts == 16) {
+      intel_fdc_shift_register_full(p_fdc);
     }
-
-    p_fdc->shift_register = 0;
-    p_fdc->num_shifts = 0;
     break;
   /* These happen for a few bits after the end of the command if the disc
    * surface data isn't byte aligned.
@@ -1976,6 +2010,47 @@ intel_fdc_shift_data_bit(struct intel_fdc_struct* p_fdc, int bit) {
   }
 }
 
+static uint32_t
+intel_fdc_pulses_to_bits(uint32_t pulses) {
+  /* Each pair of 2us pulses is one 4us FM bit. Fold pairs together and pack
+   * them into 16 bits, first bit highest.
+   */
+  uint32_t bits = ((pulses | (pulses >> 1)) & 0x55555555);
+  bits = ((bits | (bits >> 1)) & 0x33333333);
+  bits = ((bits | (bits >> 2)) & 0x0F0F0F0F);
+  bits = ((bits | (bits >> 4)) & 0x00FF00FF);
+  bits = ((bits | (bits >> 8)) & 0x0000FFFF);
+  return bits;
+}
+
+static void
+intel_fdc_shift_data_bits(struct intel_fdc_struct* p_fdc, uint32_t pulses) {
+  uint32_t bits = intel_fdc_pulses_to_bits(pulses);
+  uint32_t num_bits = 16;
+
+  /* Inside a byte, shift as many bits as the byte needs in one go. Syncing is
+   * still bit by bit, because state can change on any bit.
+   */
+  while (num_bits > 0) {
+    if (intel_fdc_is_byte_shifting_state(p_fdc->state)) {
+      uint32_t take = (16 - p_fdc->num_shifts);
+      if (take > num_bits) {
+        take = num_bits;
+      }
+      num_bits -= take;
+      p_fdc->shift_register <<= take;
+      p_fdc->shift_register |= ((bits >> num_bits) & ((1 << take) - 1));
+      p_fdc->num_shifts += take;
+      if (p_fdc->num_shifts == 16) {
+        intel_fdc_shift_register_full(p_fdc);
+      }
+    } else {
+      num_bits--;
+      intel_fdc_shift_data_bit(p_fdc, ((bits >> num_bits) & 1));
+    }
+  }
+}
+
 static void
 intel_fdc_check_index_pulse(struct intel_fdc_struct* p_fdc) {
   int was_index_pulse =  p_fdc->state_is_index_pulse;
@@ -2051,7 +2126,6 @@ intel_fdc_check_index_pulse(struct intel_fdc_struct* p_fdc) {
 
 static void
 intel_fdc_pulses_callback(void* p, uint32_t pulses, uint32_t count) {
-  uint32_t i;
   uint8_t data_register;
 
   (void) count;
@@ -2103,11 +2177,7 @@ intel_fdc_pulses_callback(void* p, uint32_t pulses, uint32_t count) {
   case k_intel_fdc_state_check_data_marker:
   case k_intel_fdc_state_in_data:
   case k_intel_fdc_state_in_data_crc:
-    for (i = 0; i < 16; ++i) {
-      int bit = !!(pulses & 0xC0000000);
-      pulses <<= 2;
-      intel_fdc_shift_data_bit(p_fdc, bit);
-    }
+    intel_fdc_shift_data_bits(p_fdc, pulses);
     break;
   case k_intel_fdc_state_write_run:
   case k_intel_fdc_state_write_data_mark:
@@ -2128,6 +2198,8 @@ intel_fdc_pulses_callback(void* p, uint32_t pulses, uint32_t count) {
     assert(0);
     break;
   }
+
+  intel_fdc_update_pulses_wanted(p_fdc);
 }
 
 void
@@ -2142,3 +2214,5 @@ intel_fdc_set_drives(struct intel_fdc_struct* p_fdc,
   disc_drive_set_pulses_callback(p_drive_0, intel_fdc_pulses_callback, p_fdc);
   disc_drive_set_pulses_callback(p_drive_1, intel_fdc_pulses_callback, p_fdc);
 }
+
+#include "test-intel_fdc.c"
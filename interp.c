@@ -8,6 +8,7 @@
 #include "memory_access.h"
 #include "state_6502.h"
 #include "timing.h"
+#include "trace.h"
 #include "util.h"
 
 #include <assert.h>
@@ -21,6 +22,7 @@ enum {
   k_interp_special_entry = 16,
   k_interp_special_memory_written_callback = 32,
   k_interp_special_KIL = 64,
+  k_interp_special_trace = 128,
 };
 
 struct interp_struct {
@@ -42,11 +44,17 @@ struct interp_struct {
   uint8_t* p_mem_write;
   int debug_subsystem_active;
   volatile int* p_debug_interrupt;
+  struct trace_struct* p_trace;
 
   uint8_t callback_intf;
   int callback_do_irq;
 
   uint64_t counter_bcd;
+
+  /* Drivers without a debugger, such as a second processor, never
+   * interrupt.
+   */
+  volatile int no_interrupt;
 };
 
 static void
@@ -126,8 +134,12 @@ interp_init(struct cpu_driver* p_cpu_driver) {
   p_memory_access->memory_client_last_tick_callback = interp_last_tick_callback;
   p_memory_access->p_last_tick_callback_obj = p_interp;
 
-  p_interp->debug_subsystem_active = debug_subsystem_active(p_debug);
-  p_interp->p_debug_interrupt = debug_get_interrupt(p_debug);
+  if (p_debug != NULL) {
+    p_interp->debug_subsystem_active = debug_subsystem_active(p_debug);
+    p_interp->p_debug_interrupt = debug_get_interrupt(p_debug);
+  } else {
+    p_interp->p_debug_interrupt = &p_interp->no_interrupt;
+  }
 
   p_cpu_driver->p_funcs->get_opcode_maps(p_cpu_driver,
                                          NULL,
@@ -1183,6 +1195,9 @@ interp_enter_with_countdown(struct interp_struct* p_interp, int64_t countdown) {
   if (p_interp->p_memory_written_callback) {
     special_checks |= k_interp_special_memory_written_callback;
   }
+  if (p_interp->p_trace) {
+    special_checks |= k_interp_special_trace;
+  }
 
   /* Jump in at the checks / fetch. Checking for countdown==0 on entry is
    * required because e.g. JIT mode will bounce in this way sometimes.
@@ -3009,6 +3024,26 @@ check_irq:
       }
     }
 
+    /* The trace sees the previous instruction's effective address and the
+     * value read or written, which is still in v.
+     */
+    if (special_checks & k_interp_special_trace) {
+      INTERP_TIMING_ADVANCE(0);
+      trace_instruction(p_interp->p_trace,
+                        p_mem_read,
+                        pc,
+                        do_irq,
+                        a,
+                        x,
+                        y,
+                        s,
+                        interp_get_flags(zf, nf, cf, of, df, intf),
+                        !(special_checks & k_interp_special_entry),
+                        addr,
+                        v,
+                        timing_get_total_timer_ticks(p_timing));
+    }
+
     special_checks &= ~k_interp_special_entry;
 
     if (do_irq) {
@@ -3065,6 +3100,11 @@ interp_set_instruction_callback(struct interp_struct* p_interp,
   p_interp->p_callback_context = p_callback_context;
 }
 
+void
+interp_set_trace(struct interp_struct* p_interp, struct trace_struct* p_trace) {
+  p_interp->p_trace = p_trace;
+}
+
 void
 interp_testing_unexit(struct interp_struct* p_interp) {
   p_interp->driver.flags &= ~k_cpu_flag_exited;
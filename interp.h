@@ -6,6 +6,7 @@
 struct cpu_driver;
 struct cpu_driver_funcs;
 struct interp_struct;
+struct trace_struct;
 
 struct cpu_driver* interp_create(struct cpu_driver_funcs* p_funcs,
                                  int is_65c12);
@@ -19,6 +20,9 @@ void interp_set_instruction_callback(
                                 int next_is_irq,
                                 int irq_pending),
     void* p_callback_context);
+/* Every instruction run from the next entry on is passed to the trace. */
+void interp_set_trace(struct interp_struct* p_interp,
+                      struct trace_struct* p_trace);
 
 int64_t interp_enter_with_countdown(struct interp_struct* p_interp,
                                     int64_t countdown);
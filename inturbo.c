@@ -31,6 +31,7 @@ struct inturbo_struct {
   int is_ret_mode;
   int do_write_invalidations;
   int debug_subsystem_active;
+  int is_no_debug;
   struct os_alloc_mapping* p_mapping_base;
   uint8_t* p_inturbo_base;
   uint8_t use_interp_for_opcode[256];
@@ -863,6 +864,9 @@ inturbo_init(struct cpu_driver* p_cpu_driver) {
   }
 
   p_inturbo->debug_subsystem_active = debug_subsystem_active(p_debug);
+  if (p_inturbo->is_no_debug) {
+    p_inturbo->debug_subsystem_active = 0;
+  }
 
   /* The inturbo mode uses an interpreter to handle complicated situations,
    * such as IRQs, hardware accesses, etc.
@@ -936,6 +940,11 @@ inturbo_set_do_write_invalidation(struct inturbo_struct* p_inturbo,
   p_inturbo->driver.abi.p_util_private = p_code_ptrs;
 }
 
+void
+inturbo_set_no_debug(struct inturbo_struct* p_inturbo) {
+  p_inturbo->is_no_debug = 1;
+}
+
 void
 inturbo_set_use_interp_for_opcode(struct inturbo_struct* p_inturbo,
                                   uint8_t opcode) {
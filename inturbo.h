@@ -21,6 +21,10 @@ void inturbo_set_ret_mode(struct inturbo_struct* p_inturbo);
  */
 void inturbo_set_do_write_invalidation(struct inturbo_struct* p_inturbo,
                                        uint32_t* p_code_ptrs);
+/* If set, don't call the debugger even if it is active.
+ * Used when the JIT routes the instructions the debugger wants via the interp.
+ */
+void inturbo_set_no_debug(struct inturbo_struct* p_inturbo);
 /* Used to force a certain opcode to use the interpretet. */
 void inturbo_set_use_interp_for_opcode(struct inturbo_struct* p_inturbo,
                                        uint8_t opcode);
@@ -66,6 +66,9 @@ struct jit_struct {
   uint8_t* p_opcode_mem;
   uint8_t* p_opcode_cycles;
   uint64_t last_housekeeping_cycles;
+  /* Set if only watched instructions go to the debugger, via the interp. */
+  struct debug_struct* p_debug;
+  uint32_t debug_watch_generation;
 
   int log_compile;
   int log_fault;
@@ -112,6 +115,25 @@ jit_interp_instruction_callback(void* p,
     return 0;
   }
 
+  /* Watched instructions are compiled as bounces into the interp, which calls
+   * the debugger. If the watches changed, drop all compiled code before
+   * heading back. Some debugger states, such as single stepping, need to stay
+   * in the interp.
+   */
+  if (p_jit->p_debug != NULL) {
+    uint32_t generation = debug_get_watch_generation(p_jit->p_debug);
+    if (generation != p_jit->debug_watch_generation) {
+      struct cpu_driver* p_cpu_driver = &p_jit->driver;
+      p_jit->debug_watch_generation = generation;
+      p_cpu_driver->p_funcs->memory_range_invalidate(p_cpu_driver,
+                                                     0,
+                                                     k_6502_addr_space_size);
+    }
+    if (debug_needs_every_instruction(p_jit->p_debug)) {
+      return 0;
+    }
+  }
+
   /* We stay in interp indefinitely if we're syncing the 6502 writes to video
    * 6845 reads. This is denoted by the presence of a memory written handler.
    */
@@ -816,6 +838,12 @@ jit_init(struct cpu_driver* p_cpu_driver) {
   struct cpu_driver_funcs* p_funcs = p_cpu_driver->p_funcs;
   struct inturbo_struct* p_inturbo = NULL;
 
+  if (debug &&
+      !util_has_option(p_options->p_opt_flags, "jit:debug-every-instruction")) {
+    p_jit->p_debug = p_debug;
+    p_jit->debug_watch_generation = debug_get_watch_generation(p_debug);
+  }
+
   p_jit->log_compile = util_has_option(p_options->p_log_flags, "jit:compile");
   p_jit->log_fault = util_has_option(p_options->p_log_flags, "jit:fault");
   p_funcs->get_opcode_maps(p_cpu_driver,
@@ -882,6 +910,9 @@ jit_init(struct cpu_driver* p_cpu_driver) {
      * arbitrarily.
      */
     inturbo_set_use_interp_for_opcode(p_inturbo, 0x40);
+    if (p_jit->p_debug != NULL) {
+      inturbo_set_no_debug(p_inturbo);
+    }
     cpu_driver_init(p_inturbo_driver);
   }
   p_jit->p_inturbo = p_inturbo;
@@ -947,6 +978,7 @@ jit_init(struct cpu_driver* p_cpu_driver) {
       p_jit->p_metadata,
       p_options,
       debug,
+      p_jit->p_debug,
       p_jit->p_opcode_types,
       p_jit->p_opcode_modes,
       p_jit->p_opcode_mem,
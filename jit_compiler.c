@@ -1,6 +1,7 @@
 #include "jit_compiler.h"
 
 #include "bbc_options.h"
+#include "debug.h"
 #include "defs_6502.h"
 #include "jit_metadata.h"
 #include "jit_opcode.h"
@@ -54,6 +55,10 @@ struct jit_compiler {
   struct jit_metadata* p_metadata;
   uint8_t* p_mem_read;
   int debug;
+  /* If set, only instructions the debugger watches go to it, via the interp,
+   * instead of a debug uop per instruction.
+   */
+  struct debug_struct* p_debug;
   int log_dynamic;
   uint8_t* p_opcode_types;
   uint8_t* p_opcode_modes;
@@ -105,6 +110,7 @@ jit_compiler_create(struct asm_jit_struct* p_asm,
                     struct jit_metadata* p_metadata,
                     struct bbc_options* p_options,
                     int debug,
+                    struct debug_struct* p_debug,
                     uint8_t* p_opcode_types,
                     uint8_t* p_opcode_modes,
                     uint8_t* p_opcode_mem,
@@ -127,6 +133,7 @@ jit_compiler_create(struct asm_jit_struct* p_asm,
   p_compiler->p_metadata = p_metadata;
   p_compiler->p_mem_read = p_memory_access->p_mem_read;
   p_compiler->debug = debug;
+  p_compiler->p_debug = p_debug;
   p_compiler->p_opcode_types = p_opcode_types;
   p_compiler->p_opcode_modes = p_opcode_modes;
   p_compiler->p_opcode_mem = p_opcode_mem;
@@ -229,6 +236,7 @@ jit_compiler_get_opcode_details(struct jit_compiler* p_compiler,
   struct asm_uop* p_uop = &p_details->uops[0];
   struct asm_uop* p_first_post_debug_uop = p_uop;
   int use_interp = 0;
+  int use_debug_interp = 0;
   int use_inturbo = 0;
   int uses_callback = 0;
   int could_page_cross = 1;
@@ -286,7 +294,13 @@ jit_compiler_get_opcode_details(struct jit_compiler* p_compiler,
   p_details->c_flag_location = 0;
   p_details->v_flag_location = 0;
 
-  if (p_compiler->debug) {
+  if (p_compiler->p_debug != NULL) {
+    use_debug_interp = debug_is_instruction_watched(p_compiler->p_debug,
+                                                    addr_6502,
+                                                    opcode_6502,
+                                                    p_mem_read[addr_plus_1],
+                                                    p_mem_read[addr_plus_2]);
+  } else if (p_compiler->debug) {
     asm_make_uop1(p_uop, k_opcode_debug, addr_6502);
     p_uop++;
     p_first_post_debug_uop = p_uop;
@@ -742,7 +756,7 @@ jit_compiler_get_opcode_details(struct jit_compiler* p_compiler,
     }
   }
 
-  if (use_interp) {
+  if (use_interp || use_debug_interp) {
     p_uop = p_first_post_debug_uop;
 
     asm_make_uop1(p_uop, k_opcode_interp, addr_6502);
@@ -930,9 +944,14 @@ jit_compiler_get_dynamic_history(struct jit_compiler* p_compiler,
     if (old_opcode == -1) {
       break;
     }
+    /* Stop counting at events from before a power on reset rewound the tick
+     * count, as happens when seeking a replay.
+     */
+    if (p_history->times[index] > ticks) {
+      break;
+    }
     /* Stop counting if the events are over a second old. */
     /* TODO: the comment says a second but the constant is 100 seconds. */
-    assert(p_history->times[index] <= ticks);
     if ((ticks - p_history->times[index]) > (100 * 2000000)) {
       break;
     }
@@ -1168,6 +1187,7 @@ jit_compiler_check_dynamics(struct jit_compiler* p_compiler) {
     uint32_t any_opcode_invalidate_count;
     int is_self_modify_invalidated = 0;
     int is_dynamic_operand_match = 0;
+    int32_t index;
 
     opcode_6502_len = p_details->num_bytes_6502;
     assert(opcode_6502_len > 0);
@@ -1197,6 +1217,15 @@ jit_compiler_check_dynamics(struct jit_compiler* p_compiler) {
     }
     p_details->self_modify_invalidated = is_self_modify_invalidated;
 
+    /* A dynamic opcode or operand would escape the debugger's watches, which
+     * were checked against the opcode and operand seen at compile time.
+     */
+    if ((p_compiler->p_debug != NULL) &&
+        (debug_has_memory_watches(p_compiler->p_debug) ||
+         (jit_opcode_find_uop(p_details, &index, k_opcode_interp) != NULL))) {
+      continue;
+    }
+
     jit_compiler_get_dynamic_history(p_compiler,
                                      &new_opcode_count,
                                      &new_opcode_invalidate_count,
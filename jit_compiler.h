@@ -5,6 +5,7 @@
 
 struct asm_jit_struct;
 struct bbc_options;
+struct debug_struct;
 struct jit_metadata;
 struct jit_opcode_details;
 struct memory_access;
@@ -21,6 +22,7 @@ struct jit_compiler* jit_compiler_create(
     struct jit_metadata* p_metadata,
     struct bbc_options* p_options,
     int debug,
+    struct debug_struct* p_debug,
     uint8_t* p_opcode_types,
     uint8_t* p_opcode_modes,
     uint8_t* p_opcode_mem,
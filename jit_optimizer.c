@@ -459,6 +459,17 @@ jit_optimizer_collapse_indefinite_loops(struct jit_opcode_details* p_opcodes,
    * E9BA: SEI
    * E9BB: CMP $0240
    * E9BE: BEQ $E9B9
+   * 6) Polling a VIA interrupt flag, such as waiting for vsync or a timer
+   * 1000: LDA $FE4D
+   * 1003: AND #$02
+   * 1005: BEQ $1000
+   * or
+   * 1000: BIT $FE6D
+   * 1003: BVC $1000
+   * Hardware registers are fine as long as the read is an inlined plain load
+   * and doesn't end the block, which in practice means non-accurate mode.
+   * Such registers only change when a timer fires, so fast-forwarding to the
+   * next timer expiry doesn't miss anything.
    */
   for (p_opcode = p_opcodes;
        p_opcode->addr_6502 != -1;
@@ -469,6 +480,9 @@ jit_optimizer_collapse_indefinite_loops(struct jit_opcode_details* p_opcodes,
     switch (optype) {
     case k_lda:
     case k_cmp:
+    case k_and:
+    case k_bit:
+      /* All idempotent: A and flags are the same every time around. */
       opmode = p_opcode->opmode_6502;
       if ((opmode != k_imm) && (opmode != k_zpg) && (opmode != k_abs)) {
         is_collapsible = 0;
@@ -477,10 +491,29 @@ jit_optimizer_collapse_indefinite_loops(struct jit_opcode_details* p_opcodes,
       if (p_opcode->ends_block) {
         is_collapsible = 0;
       }
+      /* Inlined register reads that call out can have side effects, such as
+       * an ORB or ORA read clearing CB1 or CA1. Every iteration counts.
+       */
+      if (jit_opcode_find_uop(p_opcode,
+                              &index,
+                              k_opcode_call_scratch_param) != NULL) {
+        is_collapsible = 0;
+      }
+      /* Accurate register reads fix up their cycle count mid-instruction, so
+       * the loop length isn't simply the sum of the opcode cycles.
+       */
+      if (jit_opcode_find_uop(p_opcode, &index, k_opcode_add_cycles) != NULL) {
+        is_collapsible = 0;
+      }
       break;
     case k_bcc:
+    case k_bcs:
     case k_beq:
     case k_bne:
+    case k_bmi:
+    case k_bpl:
+    case k_bvc:
+    case k_bvs:
       addr_next = (p_opcode->addr_6502 + 2);
       target_addr = (addr_next + (int8_t) p_opcode->operand_6502);
       if (target_addr != start_addr_6502) {
@@ -535,6 +568,10 @@ jit_optimizer_collapse_indefinite_loops(struct jit_opcode_details* p_opcodes,
     find_uop = k_opcode_BCC;
     replace_uop = k_opcode_BCS;
     break;
+  case k_bcs:
+    find_uop = k_opcode_BCS;
+    replace_uop = k_opcode_BCC;
+    break;
   case k_beq:
     find_uop = k_opcode_BEQ;
     replace_uop = k_opcode_BNE;
@@ -543,6 +580,22 @@ jit_optimizer_collapse_indefinite_loops(struct jit_opcode_details* p_opcodes,
     find_uop = k_opcode_BNE;
     replace_uop = k_opcode_BEQ;
     break;
+  case k_bmi:
+    find_uop = k_opcode_BMI;
+    replace_uop = k_opcode_BPL;
+    break;
+  case k_bpl:
+    find_uop = k_opcode_BPL;
+    replace_uop = k_opcode_BMI;
+    break;
+  case k_bvc:
+    find_uop = k_opcode_BVC;
+    replace_uop = k_opcode_BVS;
+    break;
+  case k_bvs:
+    find_uop = k_opcode_BVS;
+    replace_uop = k_opcode_BVC;
+    break;
   default:
     assert(0);
     break;
@@ -950,6 +950,15 @@ keyboard_rewind(struct keyboard_struct* p_keyboard, uint64_t stop_cycles) {
   }
 }
 
+int
+keyboard_is_bbc_key(uint8_t key) {
+  int32_t row;
+  int32_t col;
+
+  keyboard_bbc_key_to_rowcol(key, &row, &col);
+  return ((row >= 0) && (col >= 0));
+}
+
 int
 keyboard_bbc_is_key_pressed(struct keyboard_struct* p_keyboard,
                             uint8_t row,
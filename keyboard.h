@@ -72,6 +72,8 @@ void keyboard_rewind(struct keyboard_struct* p_keyboard, uint64_t stop_cycles);
 
 void keyboard_read_queue(struct keyboard_struct* p_keyboard);
 
+/* Whether a system key maps onto a key of the BBC keyboard matrix. */
+int keyboard_is_bbc_key(uint8_t key);
 int keyboard_bbc_is_key_pressed(struct keyboard_struct* p_keyboard,
                                 uint8_t row,
                                 uint8_t col);
@@ -1,6 +1,7 @@
 #include "bbc.h"
 #include "config.h"
 #include "cpu_driver.h"
+#include "disc_index.h"
 #include "keyboard.h"
 #include "log.h"
 #include "os_channel.h"
@@ -10,11 +11,13 @@
 #include "os_terminal.h"
 #include "os_thread.h"
 #include "os_window.h"
+#include "recorder.h"
 #include "render.h"
 #include "serial_ula.h"
 #include "sound.h"
 #include "state.h"
 #include "test.h"
+#include "trace.h"
 #include "util.h"
 #include "version.h"
 #include "video.h"
@@ -34,11 +37,24 @@ enum {
   k_max_discs_per_drive = 4,
   k_max_tapes = 4,
   k_max_keyboard_remaps = 16,
+  k_max_forks = 64,
 };
 
 static int s_argc;
 static const char** s_argv;
 
+static void
+main_stop_bbc(struct bbc_struct* p_bbc) {
+  /* Asks the CPU thread to stop. The main loop carries on until it hears the
+   * BBC thread has exited, and then shuts everything down.
+   */
+  struct cpu_driver* p_cpu_driver = bbc_get_cpu_driver(p_bbc);
+  if (!(p_cpu_driver->p_funcs->get_flags(p_cpu_driver) & k_cpu_flag_exited)) {
+    p_cpu_driver->p_funcs->apply_flags(p_cpu_driver, k_cpu_flag_exited, 0);
+    p_cpu_driver->p_funcs->set_exit_value(p_cpu_driver, 0xFFFFFFFF);
+  }
+}
+
 static void
 main_save_frame(const char* p_frames_dir,
                 uint32_t save_frame_count,
@@ -63,6 +79,19 @@ main_save_frame(const char* p_frames_dir,
   util_file_close(p_file);
 }
 
+static int
+main_parse_cpu_mode(const char* p_mode) {
+  if (!strcmp(p_mode, "jit")) {
+    return k_cpu_mode_jit;
+  } else if (!strcmp(p_mode, "interp")) {
+    return k_cpu_mode_interp;
+  } else if (!strcmp(p_mode, "inturbo")) {
+    return k_cpu_mode_inturbo;
+  }
+  util_bail("unknown mode");
+  return -1;
+}
+
 static void
 beebjit_main(void) {
   int i_args;
@@ -90,6 +119,7 @@ beebjit_main(void) {
   int sideways_ram[k_bbc_num_roms] = { 0 };
   const char* disc_names[2][k_max_discs_per_drive] = { { NULL } };
   const char* p_tape_file_names[k_max_tapes] = { NULL };
+  const char* p_fork_keys[k_max_forks] = { NULL };
 
   struct os_window_struct* p_window = NULL;
   struct os_sound_struct* p_sound_driver = NULL;
@@ -100,7 +130,15 @@ beebjit_main(void) {
   const char* replay_name = NULL;
   const char* p_create_hfe_file = NULL;
   const char* p_create_hfe_spec = NULL;
+  const char* p_index_dir = NULL;
+  const char* p_index_file = NULL;
   const char* p_frames_dir = ".";
+  const char* p_record_name = NULL;
+  const char* p_tube_rom_name = NULL;
+  const char* p_trace_name = NULL;
+  const char* p_decode_trace_name = NULL;
+  struct trace_struct* p_trace = NULL;
+  struct recorder_struct* p_recorder = NULL;
   const char* p_commands = NULL;
   int debug_flag = 0;
   int run_flag = 0;
@@ -134,11 +172,23 @@ beebjit_main(void) {
   uint32_t num_discs_0 = 0;
   uint32_t num_discs_1 = 0;
   uint32_t num_tapes = 0;
+  uint32_t num_forks = 0;
+  uint64_t fork_cycles = 0;
+  uint64_t fork_run_cycles = 0;
+  int lockstep_mode = -1;
+  uint64_t lockstep_cycles = 10000;
+  intptr_t lockstep_peer_id = -1;
+  int is_lockstep_checker = 0;
+  intptr_t handle_lockstep_read1 = -1;
+  intptr_t handle_lockstep_write1 = -1;
+  intptr_t handle_lockstep_read2 = -1;
+  intptr_t handle_lockstep_write2 = -1;
   int keyboard_links = -1;
   uint32_t save_frame_count = 0;
   uint64_t frame_cycles = 0;
   uint32_t max_frames = 1;
   int is_exit_on_max_frames_flag = 0;
+  int is_stop_requested = 0;
   uint32_t keyboard_num_remaps = 0;
   uint8_t keyboard_remap_from[k_max_keyboard_remaps];
   uint8_t keyboard_remap_to[k_max_keyboard_remaps];
@@ -179,6 +229,10 @@ beebjit_main(void) {
       p_create_hfe_file = val1;
       p_create_hfe_spec = val2;
       i_args += 2;
+    } else if (has_2 && (!strcmp(arg, "-index-discs"))) {
+      p_index_dir = val1;
+      p_index_file = val2;
+      i_args += 2;
     } else if (has_2 && (!strcmp(arg, "-key-remap"))) {
       if (keyboard_num_remaps < k_max_keyboard_remaps) {
         uint8_t from = (uint8_t) util_parse_u64(val1, 0);
@@ -224,6 +278,9 @@ beebjit_main(void) {
       p_tape_file_names[num_tapes] = val1;
       ++num_tapes;
       ++i_args;
+    } else if (has_1 && !strcmp(arg, "-tube")) {
+      p_tube_rom_name = val1;
+      ++i_args;
     } else if (has_1 && !strcmp(arg, "-opt")) {
       char* p_old_opt_flags = p_opt_flags;
       p_opt_flags = util_strdup2(p_opt_flags, ",");
@@ -244,15 +301,13 @@ beebjit_main(void) {
       pc = (uint16_t) util_parse_u64(val1, 1);
       ++i_args;
     } else if (has_1 && !strcmp(arg, "-mode")) {
-      if (!strcmp(val1, "jit")) {
-        mode = k_cpu_mode_jit;
-      } else if (!strcmp(val1, "interp")) {
-        mode = k_cpu_mode_interp;
-      } else if (!strcmp(val1, "inturbo")) {
-        mode = k_cpu_mode_inturbo;
-      } else {
-        util_bail("unknown mode");
-      }
+      mode = main_parse_cpu_mode(val1);
+      ++i_args;
+    } else if (has_1 && !strcmp(arg, "-lockstep")) {
+      lockstep_mode = main_parse_cpu_mode(val1);
+      ++i_args;
+    } else if (has_1 && !strcmp(arg, "-lockstep-cycles")) {
+      lockstep_cycles = util_parse_u64(val1, 0);
       ++i_args;
     } else if (has_1 && !strcmp(arg, "-swram")) {
       int32_t bank = (int32_t) util_parse_u64(val1, 1);
@@ -265,6 +320,19 @@ beebjit_main(void) {
     } else if (has_1 && !strcmp(arg, "-cycles")) {
       stop_cycles = util_parse_u64(val1, 0);
       ++i_args;
+    } else if (has_1 && !strcmp(arg, "-fork")) {
+      if (num_forks == k_max_forks) {
+        util_bail("too many forks");
+      }
+      p_fork_keys[num_forks] = val1;
+      ++num_forks;
+      ++i_args;
+    } else if (has_1 && !strcmp(arg, "-fork-at")) {
+      fork_cycles = util_parse_u64(val1, 0);
+      ++i_args;
+    } else if (has_1 && !strcmp(arg, "-fork-cycles")) {
+      fork_run_cycles = util_parse_u64(val1, 0);
+      ++i_args;
     } else if (has_1 && !strcmp(arg, "-frame-cycles")) {
       frame_cycles = util_parse_u64(val1, 0);
       ++i_args;
@@ -274,6 +342,15 @@ beebjit_main(void) {
     } else if (has_1 && !strcmp(arg, "-frames-dir")) {
       p_frames_dir = val1;
       ++i_args;
+    } else if (has_1 && !strcmp(arg, "-record")) {
+      p_record_name = val1;
+      ++i_args;
+    } else if (has_1 && !strcmp(arg, "-trace")) {
+      p_trace_name = val1;
+      ++i_args;
+    } else if (has_1 && !strcmp(arg, "-decode-trace")) {
+      p_decode_trace_name = val1;
+      ++i_args;
     } else if (has_1 && !strcmp(arg, "-expect")) {
       expect = (uint32_t) util_parse_u64(val1, 1);
       ++i_args;
@@ -394,11 +471,21 @@ beebjit_main(void) {
 "-max-frames     <m>: max frame images to save, default 1.\n"
 "-exit-on-max-frames: exit the process once max-frames is hit.\n"
 "-frames-dir     <d>: directory for frame files, default '.'.\n"
+"-record         <f>: record every frame to <f>.y4m and sound to <f>.wav.\n"
 "-watford           : for a model B with a 1770, load Watford DDFS ROM.\n"
 "-opus              : for a model B with a 1770, load Opus DDOS ROM.\n"
 "-dfs12             : for a model B with an 8271, load newer DFS v1.2 ROM.\n"
+"-tube           <f>: add a 6502 second processor with client ROM <f>.\n"
+"-fork        <keys>: fork a child holding down <keys>; repeat for more.\n"
+"-fork-at        <c>: fork the children at <c> cycles (needs -headless).\n"
+"-fork-cycles    <c>: each child runs for <c> cycles then logs its state.\n"
+"-lockstep       <m>: check against a peer process in CPU mode <m>.\n"
+"-lockstep-cycles <c>: cycles between lockstep checks, default 10000.\n"
+"-trace          <f>: write a binary trace of every instruction to <f>.\n"
+"-decode-trace   <f>: print binary trace <f> as text, then exit.\n"
 "-extended-roms     : disable ROM slot aliasing.\n"
 "-key-remap  <f> <t>: remap physical key from / to. See EXAMPLES.\n"
+"-index-discs <d> <f>: index disc images under <d> into <f>, then exit.\n"
 "-nula              : use a VideoNuLA (early support).\n"
 "");
       exit(0);
@@ -410,10 +497,28 @@ beebjit_main(void) {
     }
   }
 
+  if (p_index_dir != NULL) {
+    disc_index_build(p_index_dir, p_index_file, p_opt_flags);
+    exit(0);
+  }
+  if (p_decode_trace_name != NULL) {
+    trace_decode(p_decode_trace_name);
+    exit(0);
+  }
+
   if (is_master_flag) {
     has_sideways_ram = 1;
   }
 
+  if (p_record_name != NULL) {
+    /* Recording wants every frame, not just those that line up with wall time
+     * in fast mode.
+     */
+    char* p_old_opt_flags = p_opt_flags;
+    p_opt_flags = util_strdup2(p_opt_flags, ",video:always-render");
+    util_free(p_old_opt_flags);
+  }
+
   if (util_has_option(p_log_flags, "os:addrs")) {
     log_do_log(k_log_misc,
                k_log_info,
@@ -454,6 +559,23 @@ beebjit_main(void) {
   if (test_flag) {
     mode = k_cpu_mode_jit;
   }
+  if (p_trace_name != NULL) {
+    /* Only the interpreter stops between every instruction. */
+    if ((lockstep_mode != -1) ||
+        (num_forks > 0) ||
+        (p_tube_rom_name != NULL)) {
+      util_bail("-trace can't be used with -lockstep, -fork or -tube");
+    }
+    mode = k_cpu_mode_interp;
+  }
+
+  if ((p_tube_rom_name != NULL) &&
+      ((capture_name != NULL) || (replay_name != NULL))) {
+    /* The second processor runs on its own thread, so its timing against the
+     * host isn't repeatable.
+     */
+    util_bail("-tube can't be used with -capture or -replay");
+  }
 
   if (!util_has_option(p_opt_flags, "os:no-hi-res")) {
     /* This tries to coax better resolution out of the system wake ups. Gives a
@@ -462,6 +584,41 @@ beebjit_main(void) {
     os_time_setup_hi_res();
   }
 
+  if (lockstep_mode != -1) {
+    /* Two processes run the same machine from here on, so anything with
+     * outside effects or input would be doubled up.
+     */
+    if (!headless_flag ||
+        debug_flag ||
+        (frame_cycles > 0) ||
+        (p_record_name != NULL) ||
+        (capture_name != NULL) ||
+        disc_writeable_flag) {
+      util_bail("-lockstep needs -headless and no debug, frame saving, "
+                "recording, capture or writeable discs");
+    }
+    if ((p_tube_rom_name != NULL) || (num_forks > 0)) {
+      util_bail("-lockstep can't be used with -tube or -fork");
+    }
+    if (!accurate_flag || (lockstep_cycles == 0)) {
+      util_bail("-lockstep needs -accurate and non-zero -lockstep-cycles");
+    }
+    os_channel_get_handles(&handle_lockstep_read1,
+                           &handle_lockstep_write1,
+                           &handle_lockstep_read2,
+                           &handle_lockstep_write2);
+    lockstep_peer_id = os_thread_fork_process();
+    is_lockstep_checker = (lockstep_peer_id != 0);
+    os_channel_free_peer_handles(handle_lockstep_read1,
+                                 handle_lockstep_write1,
+                                 handle_lockstep_read2,
+                                 handle_lockstep_write2,
+                                 is_lockstep_checker);
+    if (!is_lockstep_checker) {
+      mode = lockstep_mode;
+    }
+  }
+
   p_bbc = bbc_create(mode,
                      is_master_flag,
                      has_sideways_ram,
@@ -492,6 +649,43 @@ beebjit_main(void) {
   if (stop_cycles != 0) {
     bbc_set_stop_cycles(p_bbc, stop_cycles);
   }
+  if (p_trace_name != NULL) {
+    p_trace = trace_create(p_trace_name, is_master_flag, p_opt_flags);
+    bbc_set_trace(p_bbc, p_trace);
+  }
+  if (lockstep_mode != -1) {
+    if (is_lockstep_checker) {
+      bbc_set_lockstep(p_bbc,
+                       lockstep_cycles,
+                       1,
+                       handle_lockstep_read1,
+                       handle_lockstep_write2);
+    } else {
+      bbc_set_lockstep(p_bbc,
+                       lockstep_cycles,
+                       0,
+                       handle_lockstep_read2,
+                       handle_lockstep_write1);
+    }
+  }
+  if (num_forks > 0) {
+    /* The children have no main thread, and must not fight over files or a
+     * window.
+     */
+    if (!headless_flag || (frame_cycles > 0) || (p_record_name != NULL)) {
+      util_bail("-fork needs -headless and no frame saving or recording");
+    }
+    if (disc_mutable_flag || (p_tube_rom_name != NULL)) {
+      util_bail("-fork can't be used with -mutable or -tube");
+    }
+    if (fork_run_cycles == 0) {
+      util_bail("-fork needs -fork-cycles");
+    }
+    for (i = 0; i < num_forks; ++i) {
+      bbc_add_fork(p_bbc, p_fork_keys[i]);
+    }
+    bbc_set_forks(p_bbc, fork_cycles, fork_run_cycles);
+  }
   if (p_commands != NULL) {
     bbc_set_commands(p_bbc, p_commands);
   }
@@ -516,7 +710,8 @@ beebjit_main(void) {
     } else {
       if (watford_flag) {
         p_dfs_rom_name = "roms/WDFS144";
-      } else if (dfs12_flag) {
+      } else if (dfs12_flag || (p_tube_rom_name != NULL)) {
+        /* DNFS carries the host side of the Tube. */
         p_dfs_rom_name = "roms/acorn_dnfs.rom";
       } else {
         p_dfs_rom_name = "roms/DFS-0.9.rom";
@@ -566,6 +761,15 @@ beebjit_main(void) {
     }
   }
 
+  if (p_tube_rom_name != NULL) {
+    uint64_t tube_rom_len;
+    (void) memset(load_rom, '\0', k_bbc_rom_size);
+    tube_rom_len = util_file_read_fully(p_tube_rom_name,
+                                        load_rom,
+                                        k_bbc_rom_size);
+    bbc_add_tube(p_bbc, load_rom, tube_rom_len);
+  }
+
   /* Set autoboot before calling bbc_power_on_reset().
    * Currently, autoboot is handled by resetting the autoboot timer in this
    * function.
@@ -594,7 +798,7 @@ beebjit_main(void) {
     render_set_buffer(p_render, p_render_buffer);
 
     window_handle = os_window_get_handle(p_window);
-  } else if (frame_cycles > 0) {
+  } else if ((frame_cycles > 0) || (p_record_name != NULL)) {
     /* TODO: push this down into video.c. */
     render_create_internal_buffer(p_render);
   }
@@ -654,7 +858,24 @@ beebjit_main(void) {
     util_bail("os_poller_create failed");
   }
 
-  if (!headless_flag && !util_has_option(p_opt_flags, "sound:off")) {
+  if (p_record_name != NULL) {
+    /* Sound is generated in virtual time for the recording, so it can't also
+     * be played out.
+     */
+    uint32_t record_sample_rate = 44100;
+    (void) util_get_u32_option(&record_sample_rate,
+                               p_opt_flags,
+                               "sound:rate=");
+    p_recorder = recorder_create(p_record_name,
+                                 render_get_width(p_render),
+                                 render_get_height(p_render),
+                                 video_get_us_per_vsync(),
+                                 record_sample_rate);
+    sound_set_record_callback(bbc_get_sound(p_bbc),
+                              record_sample_rate,
+                              recorder_add_audio,
+                              p_recorder);
+  } else if (!headless_flag && !util_has_option(p_opt_flags, "sound:off")) {
     int ret;
     char* p_device_name = NULL;
     uint32_t sound_sample_rate = os_sound_get_default_sample_rate();
@@ -745,12 +966,16 @@ beebjit_main(void) {
       if (window_open) {
         os_window_sync_buffer_to_screen(p_window);
       }
+      if (p_recorder != NULL) {
+        recorder_add_frame(p_recorder, render_get_buffer(p_render));
+      }
       if (save_frame) {
         main_save_frame(p_frames_dir, save_frame_count, p_render);
         save_frame_count++;
         if (is_exit_on_max_frames_flag && (save_frame_count == max_frames)) {
           log_do_log(k_log_misc, k_log_info, "save frame count exit");
-          exit(0);
+          main_stop_bbc(p_bbc);
+          is_stop_requested = 1;
         }
       }
       if (do_clear_after_paint) {
@@ -765,32 +990,43 @@ beebjit_main(void) {
     if (window_open && os_poller_handle_triggered(p_poller, 1)) {
       os_window_process_events(p_window);
       if (os_window_is_closed(p_window)) {
-        struct cpu_driver* p_cpu_driver = bbc_get_cpu_driver(p_bbc);
         log_do_log(k_log_misc, k_log_info, "OS window closed");
         window_open = 0;
-        if (!(p_cpu_driver->p_funcs->get_flags(p_cpu_driver) &
-              k_cpu_flag_exited)) {
-          p_cpu_driver->p_funcs->apply_flags(p_cpu_driver,
-                                             k_cpu_flag_exited,
-                                             0);
-          p_cpu_driver->p_funcs->set_exit_value(p_cpu_driver, 0xFFFFFFFF);
-        }
+        main_stop_bbc(p_bbc);
       }
     }
   }
 
+  if (num_forks > 0) {
+    bbc_run_forks(p_bbc);
+  }
+
   run_result = bbc_get_run_result(p_bbc);
-  if (expect) {
+  if (expect && !is_stop_requested) {
     if (run_result != expect) {
       util_bail("run result %X is not as expected (%X)", run_result, expect);
     }
   }
+  if (is_lockstep_checker) {
+    int status = os_thread_wait_process(lockstep_peer_id);
+    if (status != 0) {
+      util_bail("lockstep peer exited with status %d", status);
+    }
+    log_do_log(k_log_misc, k_log_info, "lockstep: no divergence");
+  }
 
   os_poller_destroy(p_poller);
   if (p_window != NULL) {
     os_window_destroy(p_window);
   }
   bbc_destroy(p_bbc);
+  if (p_trace != NULL) {
+    trace_destroy(p_trace);
+  }
+
+  if (p_recorder != NULL) {
+    recorder_destroy(p_recorder);
+  }
 
   os_channel_free_handles(handle_channel_read_ui,
                           handle_channel_write_bbc,
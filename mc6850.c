@@ -262,8 +262,13 @@ mc6850_transfer_sr_to_receive(struct mc6850_struct* p_serial) {
   mc6850_update_irq_and_status_read(p_serial);
 }
 
-void
-mc6850_receive_bit(struct mc6850_struct* p_serial, int bit) {
+/* Clocks a bit into the receive state machine. Returns 1 if it completes a
+ * byte, which the caller must then transfer.
+ */
+static int
+mc6850_clock_receive_bit(struct mc6850_struct* p_serial,
+                         int bit,
+                         int is_dry_run) {
   /* Implement 300 baud tapes here by skipping bits if our clock divider is 64
    * instead of the usual 16.
    */
@@ -272,7 +277,7 @@ mc6850_receive_bit(struct mc6850_struct* p_serial, int bit) {
   if ((p_serial->acia_control & k_serial_acia_control_clock_divider_mask) ==
           k_serial_acia_control_clock_divider_64) {
     if (p_serial->clock_divide_counter != 0) {
-      return;
+      return 0;
     }
   }
 
@@ -313,23 +318,55 @@ mc6850_receive_bit(struct mc6850_struct* p_serial, int bit) {
     }
     if (p_serial->parity_accumulator !=
             ((p_serial->acia_control & 0x04) >> 2)) {
-      log_do_log(k_log_serial, k_log_warning, "incorrect parity bit");
+      if (!is_dry_run) {
+        log_do_log(k_log_serial, k_log_warning, "incorrect parity bit");
+      }
       p_serial->is_sr_parity_error = 1;
     }
     p_serial->state = k_mc6850_state_need_stop;
     break;
   case k_mc6850_state_need_stop:
     if (bit != 1) {
-      log_do_log(k_log_serial, k_log_warning, "incorrect stop bit");
+      if (!is_dry_run) {
+        log_do_log(k_log_serial, k_log_warning, "incorrect stop bit");
+      }
       p_serial->is_sr_framing_error = 1;
     }
-    mc6850_transfer_sr_to_receive(p_serial);
     p_serial->state = k_mc6850_state_need_start;
-    break;
+    return 1;
   default:
     assert(0);
     break;
   }
+
+  return 0;
+}
+
+void
+mc6850_receive_bit(struct mc6850_struct* p_serial, int bit) {
+  if (mc6850_clock_receive_bit(p_serial, bit, 0)) {
+    mc6850_transfer_sr_to_receive(p_serial);
+  }
+}
+
+uint32_t
+mc6850_get_quiet_receive_bits(struct mc6850_struct* p_serial,
+                              const int8_t* p_bits,
+                              uint32_t num_bits) {
+  uint32_t i;
+  /* Dry run on a copy. */
+  struct mc6850_struct serial = *p_serial;
+
+  for (i = 0; i < num_bits; ++i) {
+    if (p_bits[i] < 0) {
+      continue;
+    }
+    if (mc6850_clock_receive_bit(&serial, p_bits[i], 1)) {
+      break;
+    }
+  }
+
+  return i;
 }
 
 uint8_t
@@ -29,6 +29,13 @@ int mc6850_get_RTS(struct mc6850_struct* p_serial);
 int mc6850_is_transmit_ready(struct mc6850_struct* p_serial);
 
 void mc6850_receive_bit(struct mc6850_struct* p_serial, int bit);
+/* Returns how many of the bits can be received before one completes a byte,
+ * i.e. before the CPU could see anything. Negative values are gaps where no
+ * bit is clocked in.
+ */
+uint32_t mc6850_get_quiet_receive_bits(struct mc6850_struct* p_serial,
+                                       const int8_t* p_bits,
+                                       uint32_t num_bits);
 
 int mc6850_receive(struct mc6850_struct* p_serial, uint8_t byte);
 uint8_t mc6850_transmit(struct mc6850_struct* p_serial);
@@ -5,6 +5,7 @@
 
 #include "os_alloc_posix.c"
 #include "os_channel_posix.c"
+#include "os_dir_posix.c"
 #include "os_fault_posix.c"
 #include "os_poller_posix.c"
 #include "os_terminal_posix.c"
@@ -47,6 +48,7 @@
 
 #include "os_alloc_windows.c"
 #include "os_channel_windows.c"
+#include "os_dir_windows.c"
 #include "os_fault_windows.c"
 #include "os_poller_windows.c"
 #include "os_sound_windows.c"
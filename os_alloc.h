@@ -27,4 +27,7 @@ void os_alloc_make_mapping_read_write_exec(void* p_addr, size_t size);
 void os_alloc_make_mapping_read_exec(void* p_addr, size_t size);
 void os_alloc_make_mapping_none(void* p_addr, size_t size);
 
+/* The granularity of the make_mapping_* protection calls. */
+size_t os_alloc_get_page_size(void);
+
 #endif /* BEEBJIT_OS_ALLOC_H */
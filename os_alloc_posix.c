@@ -191,3 +191,13 @@ os_alloc_make_mapping_none(void* p_addr, size_t size) {
     util_bail("mprotect N failed @%p", p_addr);
   }
 }
+
+size_t
+os_alloc_get_page_size(void) {
+  long ret = sysconf(_SC_PAGESIZE);
+  if (ret < 1) {
+    util_bail("sysconf _SC_PAGESIZE failed");
+  }
+
+  return (size_t) ret;
+}
@@ -165,3 +165,11 @@ os_alloc_make_mapping_none(void* p_addr, size_t size) {
     util_bail("VirtualProtect PAGE_NOACCESS failed");
   }
 }
+
+size_t
+os_alloc_get_page_size(void) {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+
+  return (size_t) info.dwPageSize;
+}
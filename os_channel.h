@@ -12,6 +12,15 @@ void os_channel_free_handles(intptr_t read1,
                              intptr_t read2,
                              intptr_t write2);
 
+/* After a fork, frees the handles that only the other process uses. The first
+ * side reads read1 and writes write2; the second side uses the other two.
+ */
+void os_channel_free_peer_handles(intptr_t read1,
+                                  intptr_t write1,
+                                  intptr_t read2,
+                                  intptr_t write2,
+                                  int is_first_side);
+
 void os_channel_read(intptr_t handle, void* p_message, uint32_t length);
 void os_channel_write(intptr_t handle, const void* p_message, uint32_t length);
 
@@ -45,6 +45,30 @@ os_channel_free_handles(intptr_t read1,
   }
 }
 
+void
+os_channel_free_peer_handles(intptr_t read1,
+                             intptr_t write1,
+                             intptr_t read2,
+                             intptr_t write2,
+                             int is_first_side) {
+  int ret;
+
+  /* Both ends of the socket pair are bidirectional. */
+  assert(read1 == write2);
+  assert(write1 == read2);
+  (void) read2;
+  (void) write2;
+
+  if (is_first_side) {
+    ret = close((int) write1);
+  } else {
+    ret = close((int) read1);
+  }
+  if (ret != 0) {
+    util_bail("close failed");
+  }
+}
+
 void
 os_channel_read(intptr_t handle, void* p_buf, uint32_t length) {
   int fd = (int) handle;
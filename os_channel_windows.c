@@ -52,6 +52,30 @@ os_channel_free_handles(intptr_t read1,
   }
 }
 
+void
+os_channel_free_peer_handles(intptr_t read1,
+                             intptr_t write1,
+                             intptr_t read2,
+                             intptr_t write2,
+                             int is_first_side) {
+  BOOL ret;
+  HANDLE handle_1 = (HANDLE) write1;
+  HANDLE handle_2 = (HANDLE) read2;
+
+  if (!is_first_side) {
+    handle_1 = (HANDLE) read1;
+    handle_2 = (HANDLE) write2;
+  }
+  ret = CloseHandle(handle_1);
+  if (ret == 0) {
+    util_bail("CloseHandle failed");
+  }
+  ret = CloseHandle(handle_2);
+  if (ret == 0) {
+    util_bail("CloseHandle failed");
+  }
+}
+
 void
 os_channel_read(intptr_t h, void* p_message, uint32_t length) {
   DWORD bytes_read;
@@ -0,0 +1,13 @@
+#ifndef BEEBJIT_OS_DIR_H
+#define BEEBJIT_OS_DIR_H
+
+/* Calls p_callback for every entry in the directory, other than "." and "..",
+ * and symlinked directories. Returns 0 if the directory couldn't be opened.
+ */
+int os_dir_list(const char* p_dir_name,
+                void (*p_callback)(void* p,
+                                   const char* p_name,
+                                   int is_dir),
+                void* p);
+
+#endif /* BEEBJIT_OS_DIR_H */
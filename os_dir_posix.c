@@ -0,0 +1,52 @@
+#include "os_dir.h"
+
+#include "util.h"
+
+#include <dirent.h>
+#include <string.h>
+#include <sys/stat.h>
+
+int
+os_dir_list(const char* p_dir_name,
+            void (*p_callback)(void* p, const char* p_name, int is_dir),
+            void* p) {
+  struct dirent* p_entry;
+  DIR* p_dir = opendir(p_dir_name);
+
+  if (p_dir == NULL) {
+    return 0;
+  }
+
+  while ((p_entry = readdir(p_dir)) != NULL) {
+    struct stat st;
+    char* p_path;
+    int is_dir;
+    int is_link_to_dir;
+    const char* p_name = p_entry->d_name;
+
+    if (!strcmp(p_name, ".") || !strcmp(p_name, "..")) {
+      continue;
+    }
+    /* d_type isn't filled in by all filesystems. */
+    p_path = util_file_name_join(p_dir_name, p_name);
+    is_dir = 0;
+    is_link_to_dir = 0;
+    if (lstat(p_path, &st) == 0) {
+      is_dir = S_ISDIR(st.st_mode);
+      if (S_ISLNK(st.st_mode)) {
+        is_link_to_dir = ((stat(p_path, &st) == 0) && S_ISDIR(st.st_mode));
+      }
+    }
+    util_free(p_path);
+
+    /* Symlinked directories are skipped, so a walk can't loop. */
+    if (is_link_to_dir) {
+      continue;
+    }
+    p_callback(p, p_name, is_dir);
+  }
+
+  (void) closedir(p_dir);
+
+  return 1;
+}
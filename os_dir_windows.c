@@ -0,0 +1,40 @@
+#include "os_dir.h"
+
+#include "util.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <windows.h>
+
+int
+os_dir_list(const char* p_dir_name,
+            void (*p_callback)(void* p, const char* p_name, int is_dir),
+            void* p) {
+  char pattern[4096];
+  WIN32_FIND_DATAA find_data;
+  HANDLE handle;
+
+  (void) snprintf(pattern, sizeof(pattern), "%s\\*", p_dir_name);
+  handle = FindFirstFileA(pattern, &find_data);
+  if (handle == INVALID_HANDLE_VALUE) {
+    return 0;
+  }
+
+  do {
+    const char* p_name = find_data.cFileName;
+    DWORD attributes = find_data.dwFileAttributes;
+    int is_dir = !!(attributes & FILE_ATTRIBUTE_DIRECTORY);
+    if (!strcmp(p_name, ".") || !strcmp(p_name, "..")) {
+      continue;
+    }
+    /* Directory junctions and symlinks are skipped, so a walk can't loop. */
+    if (is_dir && (attributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+      continue;
+    }
+    p_callback(p, p_name, is_dir);
+  } while (FindNextFileA(handle, &find_data));
+
+  (void) FindClose(handle);
+
+  return 1;
+}
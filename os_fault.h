@@ -10,6 +10,13 @@ void os_fault_register_handler(
                              int is_exec,
                              int is_write,
                              uintptr_t host_rdi));
+/* Registers a handler that gets first look at memory access faults, from
+ * any code, not just the JIT. If it returns non-zero, it resolved the fault,
+ * for example by changing page protections, and the faulting instruction is
+ * retried.
+ */
+void os_fault_register_access_handler(
+    int (*p_access_callback)(uintptr_t host_fault_addr));
 void os_fault_bail(void);
 
 void os_debug_trap(void);
@@ -13,6 +13,8 @@ static void (*s_p_fault_callback)(uintptr_t*,
                                   int,
                                   int,
                                   uintptr_t);
+static int (*s_p_access_callback)(uintptr_t);
+static int s_is_installed;
 
 static void
 posix_fault_handler(int signum, siginfo_t* p_siginfo, void* p_void) {
@@ -43,6 +45,15 @@ posix_fault_handler(int signum, siginfo_t* p_siginfo, void* p_void) {
     os_fault_bail();
   }
 
+  if (!is_illegal_fault && (s_p_access_callback != NULL)) {
+    if (s_p_access_callback((uintptr_t) p_siginfo->si_addr)) {
+      return;
+    }
+  }
+  if (s_p_fault_callback == NULL) {
+    os_fault_bail();
+  }
+
   host_pc = os_fault_get_pc(p_void);
   host_context = os_fault_get_jit_context(p_void);
   if (!is_illegal_fault) {
@@ -82,6 +93,19 @@ install_handler(int signal) {
   }
 }
 
+static void
+install_handlers(void) {
+  if (s_is_installed) {
+    return;
+  }
+  s_is_installed = 1;
+
+  install_handler(SIGSEGV);
+  /* On macOS, a write fault to our JIT mapping comes in as SIGBUS. */
+  install_handler(SIGBUS);
+  install_handler(SIGILL);
+}
+
 void
 os_fault_register_handler(
     void (*p_fault_callback)(uintptr_t* p_host_rip,
@@ -91,11 +115,14 @@ os_fault_register_handler(
                              int is_write,
                              uintptr_t host_rdi)) {
   s_p_fault_callback = p_fault_callback;
+  install_handlers();
+}
 
-  install_handler(SIGSEGV);
-  /* On macOS, a write fault to our JIT mapping comes in as SIGBUS. */
-  install_handler(SIGBUS);
-  install_handler(SIGILL);
+void
+os_fault_register_access_handler(
+    int (*p_access_callback)(uintptr_t host_fault_addr)) {
+  s_p_access_callback = p_access_callback;
+  install_handlers();
 }
 
 void
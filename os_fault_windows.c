@@ -12,17 +12,31 @@ static void (*s_p_fault_callback)(uintptr_t*,
                                   int,
                                   int,
                                   uintptr_t);
+static int (*s_p_access_callback)(uintptr_t);
+static int s_is_installed;
 
 static LONG
 VectoredHandler(struct _EXCEPTION_POINTERS* p_info) {
   EXCEPTION_RECORD* p_record = p_info->ExceptionRecord;
   CONTEXT* p_context = p_info->ContextRecord;
-  DWORD64 flags = p_record->ExceptionInformation[0];
+  DWORD64 flags;
 
+  /* Only an access violation carries a fault address to look at. */
+  if ((p_record->ExceptionCode == EXCEPTION_ACCESS_VIOLATION) &&
+      (s_p_access_callback != NULL) &&
+      s_p_access_callback((uintptr_t) p_record->ExceptionInformation[1])) {
+    return EXCEPTION_CONTINUE_EXECUTION;
+  }
+  if (s_p_fault_callback == NULL) {
+    /* No JIT, so it's not ours. */
+    return EXCEPTION_CONTINUE_SEARCH;
+  }
   if (p_record->ExceptionCode != EXCEPTION_ACCESS_VIOLATION) {
     os_fault_bail();
   }
 
+  flags = p_record->ExceptionInformation[0];
+
   s_p_fault_callback((uintptr_t*) &p_context->Rip,
                      (uintptr_t) p_record->ExceptionInformation[1],
                      0,
@@ -33,6 +47,22 @@ VectoredHandler(struct _EXCEPTION_POINTERS* p_info) {
   return EXCEPTION_CONTINUE_EXECUTION;
 }
 
+static void
+install_handler(void) {
+  void* p_ret;
+
+  if (s_is_installed) {
+    return;
+  }
+  s_is_installed = 1;
+
+  /* 1 is for CALL_FIRST. */
+  p_ret = AddVectoredExceptionHandler(1, VectoredHandler);
+  if (p_ret == NULL) {
+    util_bail("AddVectoredExceptionHandler failed");
+  }
+}
+
 void
 os_fault_register_handler(
     void (*p_fault_callback)(uintptr_t* p_host_rip,
@@ -41,15 +71,15 @@ os_fault_register_handler(
                              int is_exec,
                              int is_write,
                              uintptr_t host_rdi)) {
-  void* p_ret;
-
   s_p_fault_callback = p_fault_callback;
+  install_handler();
+}
 
-  /* 1 is for CALL_FIRST. */
-  p_ret = AddVectoredExceptionHandler(1, VectoredHandler);
-  if (p_ret == NULL) {
-    util_bail("AddVectoredExceptionHandler failed");
-  }
+void
+os_fault_register_access_handler(
+    int (*p_access_callback)(uintptr_t host_fault_addr)) {
+  s_p_access_callback = p_access_callback;
+  install_handler();
 }
 
 void
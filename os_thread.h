@@ -1,9 +1,26 @@
 #ifndef BEEBJIT_OS_THREAD_H
 #define BEEBJIT_OS_THREAD_H
 
+#include <stdint.h>
+
 struct os_thread_struct;
 
 struct os_thread_struct* os_thread_create(void* p_func, void* p_arg);
 intptr_t os_thread_destroy(struct os_thread_struct* p_thread_struct);
 
+uint32_t os_thread_get_num_cpus(void);
+
+/* Forks the whole process. Only the calling thread carries on in the child.
+ * Returns 0 in the child, and an id for the child in the parent.
+ */
+intptr_t os_thread_fork_process(void);
+/* Waits for a forked child to exit and returns its exit status, or -1 if it
+ * didn't exit normally.
+ */
+int os_thread_wait_process(intptr_t id);
+/* Exits a forked child without running exit handlers or flushing buffers it
+ * shares with the parent.
+ */
+void os_thread_exit_process(int status);
+
 #endif /* BEEBJIT_OS_THREAD_H */
@@ -3,6 +3,9 @@
 #include "util.h"
 
 #include <pthread.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 struct os_thread_struct {
   pthread_t thread;
@@ -33,3 +36,46 @@ os_thread_destroy(struct os_thread_struct* p_thread_struct) {
 
   return (intptr_t) p_retval;
 }
+
+uint32_t
+os_thread_get_num_cpus(void) {
+  long ret = sysconf(_SC_NPROCESSORS_ONLN);
+  if (ret < 1) {
+    return 1;
+  }
+  return (uint32_t) ret;
+}
+
+intptr_t
+os_thread_fork_process(void) {
+  pid_t ret;
+
+  /* Don't let buffered output get written out twice. */
+  (void) fflush(NULL);
+
+  ret = fork();
+  if (ret < 0) {
+    util_bail("fork failed");
+  }
+
+  return (intptr_t) ret;
+}
+
+int
+os_thread_wait_process(intptr_t id) {
+  int status;
+  pid_t ret = waitpid((pid_t) id, &status, 0);
+  if (ret != (pid_t) id) {
+    util_bail("waitpid failed");
+  }
+  if (!WIFEXITED(status)) {
+    return -1;
+  }
+
+  return WEXITSTATUS(status);
+}
+
+void
+os_thread_exit_process(int status) {
+  _exit(status);
+}
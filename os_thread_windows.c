@@ -66,6 +66,35 @@ os_thread_destroy(struct os_thread_struct* p_thread_struct) {
   return ret;
 }
 
+uint32_t
+os_thread_get_num_cpus(void) {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  if (info.dwNumberOfProcessors < 1) {
+    return 1;
+  }
+  return (uint32_t) info.dwNumberOfProcessors;
+}
+
+intptr_t
+os_thread_fork_process(void) {
+  util_bail("process forking not supported on Windows");
+  return -1;
+}
+
+int
+os_thread_wait_process(intptr_t id) {
+  (void) id;
+  util_bail("process forking not supported on Windows");
+  return -1;
+}
+
+void
+os_thread_exit_process(int status) {
+  (void) status;
+  util_bail("process forking not supported on Windows");
+}
+
 struct os_lock_struct*
 os_lock_create() {
   struct os_lock_struct* p_lock = util_mallocz(sizeof(struct os_lock_struct));
@@ -0,0 +1,286 @@
+#include "recorder.h"
+
+#include "log.h"
+#include "os_channel.h"
+#include "os_lock.h"
+#include "os_thread.h"
+#include "util.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+enum {
+  k_recorder_num_frame_slots = 8,
+  k_recorder_slot_exit = 0xFFFFFFFF,
+  k_recorder_wav_header_size = 44,
+};
+
+/* The RIFF size fields must fit in 32 bits. */
+static const uint64_t k_recorder_wav_max_data_size = 0xFFFFFF00;
+
+struct recorder_struct {
+  uint32_t width;
+  uint32_t height;
+  uint32_t sample_rate;
+  struct util_file* p_video_file;
+  struct util_file* p_audio_file;
+
+  /* Frames are handed to the writer thread via a bounded set of slots. Slot
+   * indexes are passed over a channel pair: filled slots one way, free slots
+   * back. The producer blocks in os_channel_read() if all slots are in use.
+   */
+  struct os_thread_struct* p_thread;
+  intptr_t handle_filled_read;
+  intptr_t handle_filled_write;
+  intptr_t handle_free_read;
+  intptr_t handle_free_write;
+  uint32_t* p_frame_slots[k_recorder_num_frame_slots];
+  uint8_t* p_yuv_buf;
+  uint64_t num_frames;
+
+  /* Audio is appended under the lock and swapped out by the writer thread. */
+  struct os_lock_struct* p_audio_lock;
+  int16_t* p_audio_pending;
+  uint32_t audio_pending_count;
+  uint32_t audio_pending_alloc;
+  int16_t* p_audio_spare;
+  uint32_t audio_spare_alloc;
+  uint64_t audio_bytes_written;
+};
+
+static void
+recorder_write_wav_header(struct recorder_struct* p_recorder) {
+  uint8_t header[k_recorder_wav_header_size];
+  uint32_t data_size = (uint32_t) p_recorder->audio_bytes_written;
+  uint32_t sample_rate = p_recorder->sample_rate;
+
+  (void) memcpy(&header[0], "RIFF", 4);
+  util_write_le32(&header[4], (data_size + k_recorder_wav_header_size - 8));
+  (void) memcpy(&header[8], "WAVE", 4);
+  (void) memcpy(&header[12], "fmt ", 4);
+  util_write_le32(&header[16], 16);
+  /* PCM, 1 channel, 16-bit. */
+  util_write_le16(&header[20], 1);
+  util_write_le16(&header[22], 1);
+  util_write_le32(&header[24], sample_rate);
+  util_write_le32(&header[28], (sample_rate * 2));
+  util_write_le16(&header[32], 2);
+  util_write_le16(&header[34], 16);
+  (void) memcpy(&header[36], "data", 4);
+  util_write_le32(&header[40], data_size);
+
+  util_file_seek(p_recorder->p_audio_file, 0);
+  util_file_write(p_recorder->p_audio_file, &header[0], sizeof(header));
+}
+
+static void
+recorder_write_frame(struct recorder_struct* p_recorder,
+                     const uint32_t* p_pixels) {
+  uint32_t i;
+  uint32_t num_pixels = (p_recorder->width * p_recorder->height);
+  uint8_t* p_y = p_recorder->p_yuv_buf;
+  uint8_t* p_u = (p_y + num_pixels);
+  uint8_t* p_v = (p_u + num_pixels);
+
+  /* BT.601 studio range, which is what Y4M consumers assume. */
+  for (i = 0; i < num_pixels; ++i) {
+    uint32_t pixel = p_pixels[i];
+    int32_t r = ((pixel >> 16) & 0xFF);
+    int32_t g = ((pixel >> 8) & 0xFF);
+    int32_t b = (pixel & 0xFF);
+    p_y[i] = (((66 * r) + (129 * g) + (25 * b) + 128) >> 8) + 16;
+    p_u[i] = (((-38 * r) - (74 * g) + (112 * b) + 128) >> 8) + 128;
+    p_v[i] = (((112 * r) - (94 * g) - (18 * b) + 128) >> 8) + 128;
+  }
+
+  util_file_write(p_recorder->p_video_file, "FRAME\n", 6);
+  util_file_write(p_recorder->p_video_file,
+                  p_recorder->p_yuv_buf,
+                  (num_pixels * 3));
+}
+
+static void
+recorder_write_pending_audio(struct recorder_struct* p_recorder) {
+  int16_t* p_audio;
+  uint32_t alloc;
+  uint32_t count;
+  uint32_t i;
+  uint8_t* p_bytes;
+
+  os_lock_lock(p_recorder->p_audio_lock);
+  p_audio = p_recorder->p_audio_pending;
+  alloc = p_recorder->audio_pending_alloc;
+  count = p_recorder->audio_pending_count;
+  p_recorder->p_audio_pending = p_recorder->p_audio_spare;
+  p_recorder->audio_pending_alloc = p_recorder->audio_spare_alloc;
+  p_recorder->audio_pending_count = 0;
+  os_lock_unlock(p_recorder->p_audio_lock);
+
+  /* Samples are host endian; WAV is little endian. */
+  if ((p_recorder->audio_bytes_written + (count * 2)) >
+      k_recorder_wav_max_data_size) {
+    if (p_recorder->audio_bytes_written < k_recorder_wav_max_data_size) {
+      log_do_log(k_log_misc,
+                 k_log_warning,
+                 "WAV size limit reached, audio recording stopped");
+    }
+    count = ((k_recorder_wav_max_data_size - p_recorder->audio_bytes_written) /
+             2);
+  }
+
+  p_bytes = (uint8_t*) p_audio;
+  for (i = 0; i < count; ++i) {
+    util_write_le16(&p_bytes[i * 2], (uint16_t) p_audio[i]);
+  }
+  util_file_write(p_recorder->p_audio_file, p_audio, (count * 2));
+  p_recorder->audio_bytes_written += (count * 2);
+
+  p_recorder->p_audio_spare = p_audio;
+  p_recorder->audio_spare_alloc = alloc;
+}
+
+static void*
+recorder_thread(void* p) {
+  struct recorder_struct* p_recorder = (struct recorder_struct*) p;
+
+  while (1) {
+    uint32_t slot;
+    os_channel_read(p_recorder->handle_filled_read, &slot, sizeof(slot));
+    if (slot == k_recorder_slot_exit) {
+      break;
+    }
+    assert(slot < k_recorder_num_frame_slots);
+    recorder_write_frame(p_recorder, p_recorder->p_frame_slots[slot]);
+    recorder_write_pending_audio(p_recorder);
+    os_channel_write(p_recorder->handle_free_write, &slot, sizeof(slot));
+  }
+
+  recorder_write_pending_audio(p_recorder);
+
+  return NULL;
+}
+
+struct recorder_struct*
+recorder_create(const char* p_file_name_base,
+                uint32_t width,
+                uint32_t height,
+                uint32_t us_per_frame,
+                uint32_t sample_rate) {
+  uint32_t i;
+  char file_name[256];
+  char header[128];
+  int header_len;
+  struct recorder_struct* p_recorder =
+      util_mallocz(sizeof(struct recorder_struct));
+
+  p_recorder->width = width;
+  p_recorder->height = height;
+  p_recorder->sample_rate = sample_rate;
+
+  (void) snprintf(file_name, sizeof(file_name), "%s.y4m", p_file_name_base);
+  p_recorder->p_video_file = util_file_open(&file_name[0], 1, 1);
+  (void) snprintf(file_name, sizeof(file_name), "%s.wav", p_file_name_base);
+  p_recorder->p_audio_file = util_file_open(&file_name[0], 1, 1);
+
+  /* A frame is recorded per vsync, so the rate matches the virtual time of
+   * the audio. 4:4:4 avoids chroma smearing on pixel art.
+   */
+  header_len = snprintf(header,
+                        sizeof(header),
+                        "YUV4MPEG2 W%"PRIu32" H%"PRIu32" F1000000:%"PRIu32" "
+                        "Ip A1:1 C444\n",
+                        width,
+                        height,
+                        us_per_frame);
+  util_file_write(p_recorder->p_video_file, header, header_len);
+  /* Placeholder, rewritten with the final sizes at destroy time. */
+  recorder_write_wav_header(p_recorder);
+
+  p_recorder->p_yuv_buf = util_malloc(width * height * 3);
+  for (i = 0; i < k_recorder_num_frame_slots; ++i) {
+    p_recorder->p_frame_slots[i] = util_malloc(width * height * 4);
+  }
+
+  p_recorder->p_audio_lock = os_lock_create();
+
+  os_channel_get_handles(&p_recorder->handle_filled_read,
+                         &p_recorder->handle_filled_write,
+                         &p_recorder->handle_free_read,
+                         &p_recorder->handle_free_write);
+  for (i = 0; i < k_recorder_num_frame_slots; ++i) {
+    os_channel_write(p_recorder->handle_free_write, &i, sizeof(i));
+  }
+
+  p_recorder->p_thread = os_thread_create(recorder_thread, p_recorder);
+
+  return p_recorder;
+}
+
+void
+recorder_destroy(struct recorder_struct* p_recorder) {
+  uint32_t i;
+  uint32_t slot = k_recorder_slot_exit;
+
+  os_channel_write(p_recorder->handle_filled_write, &slot, sizeof(slot));
+  (void) os_thread_destroy(p_recorder->p_thread);
+
+  recorder_write_wav_header(p_recorder);
+  util_file_close(p_recorder->p_video_file);
+  util_file_close(p_recorder->p_audio_file);
+
+  log_do_log(k_log_misc,
+             k_log_info,
+             "recorded %"PRIu64" frames, %"PRIu64" audio samples",
+             p_recorder->num_frames,
+             (p_recorder->audio_bytes_written / 2));
+
+  os_channel_free_handles(p_recorder->handle_filled_read,
+                          p_recorder->handle_filled_write,
+                          p_recorder->handle_free_read,
+                          p_recorder->handle_free_write);
+  os_lock_destroy(p_recorder->p_audio_lock);
+
+  for (i = 0; i < k_recorder_num_frame_slots; ++i) {
+    util_free(p_recorder->p_frame_slots[i]);
+  }
+  util_free(p_recorder->p_yuv_buf);
+  util_free(p_recorder->p_audio_pending);
+  util_free(p_recorder->p_audio_spare);
+  util_free(p_recorder);
+}
+
+void
+recorder_add_frame(struct recorder_struct* p_recorder,
+                   const uint32_t* p_pixels) {
+  uint32_t slot;
+  uint32_t size = (p_recorder->width * p_recorder->height * 4);
+
+  os_channel_read(p_recorder->handle_free_read, &slot, sizeof(slot));
+  assert(slot < k_recorder_num_frame_slots);
+  (void) memcpy(p_recorder->p_frame_slots[slot], p_pixels, size);
+  os_channel_write(p_recorder->handle_filled_write, &slot, sizeof(slot));
+
+  p_recorder->num_frames++;
+}
+
+void
+recorder_add_audio(void* p, int16_t* p_frames, uint32_t num_frames) {
+  uint32_t new_count;
+  struct recorder_struct* p_recorder = (struct recorder_struct*) p;
+
+  os_lock_lock(p_recorder->p_audio_lock);
+  new_count = (p_recorder->audio_pending_count + num_frames);
+  if (new_count > p_recorder->audio_pending_alloc) {
+    uint32_t new_alloc = (new_count * 2);
+    p_recorder->p_audio_pending = util_realloc(p_recorder->p_audio_pending,
+                                               (new_alloc * sizeof(int16_t)));
+    p_recorder->audio_pending_alloc = new_alloc;
+  }
+  (void) memcpy((p_recorder->p_audio_pending + p_recorder->audio_pending_count),
+                p_frames,
+                (num_frames * sizeof(int16_t)));
+  p_recorder->audio_pending_count = new_count;
+  os_lock_unlock(p_recorder->p_audio_lock);
+}
@@ -0,0 +1,24 @@
+#ifndef BEEBJIT_RECORDER_H
+#define BEEBJIT_RECORDER_H
+
+#include <stdint.h>
+
+struct recorder_struct;
+
+/* The video frame rate is 1000000 / us_per_frame Hz. */
+struct recorder_struct* recorder_create(const char* p_file_name_base,
+                                        uint32_t width,
+                                        uint32_t height,
+                                        uint32_t us_per_frame,
+                                        uint32_t sample_rate);
+void recorder_destroy(struct recorder_struct* p_recorder);
+
+/* Called on the UI thread with a fully rendered BGRA frame. */
+void recorder_add_frame(struct recorder_struct* p_recorder,
+                        const uint32_t* p_pixels);
+/* Called on the BBC thread with mono 16-bit samples. Matches the sound record
+ * callback signature.
+ */
+void recorder_add_audio(void* p, int16_t* p_frames, uint32_t num_frames);
+
+#endif /* BEEBJIT_RECORDER_H */
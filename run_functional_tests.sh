@@ -105,4 +105,45 @@ echo 'Checking NuLA palette.'
     -fast -accurate -mode jit \
     -commands "breakat 2110319378;c;eval '(pc==0xCFB7)||bail';eval '(a==0xE8)||bail';q"
 
+# This checks that stepping back from the middle of the same replay lands on
+# the instruction before, at the tick it originally ran at.
+./beebjit -0 test/games/Disc012-Nightworld.ssd \
+    -replay test/caps/nw16.cap \
+    -debug -fast -accurate -mode jit \
+    -commands "breakat 5000000;c;rs;eval '(pc==0x0D11)||bail';eval '(ticks==4999998)||bail';q"
+
+echo 'Checking JIT against the interpreter in lockstep.'
+# This runs the 6502 timing test in JIT mode against an interpreter peer. Any
+# difference in registers, cycles or memory bails with a divergence report.
+lockstep_log=$(./beebjit -0 test/misc/6502timing1M.ssd \
+    -mode jit -lockstep interp -lockstep-cycles 1000 \
+    -headless -fast -accurate \
+    -autoboot \
+    -cycles 40000000 2>&1) || true
+if ! echo "$lockstep_log" | grep -q 'lockstep: no divergence'; then
+  echo "$lockstep_log"
+  echo 'Lockstep run diverged.'
+  exit 1
+fi
+
+echo 'Checking forked runs.'
+# This forks three children once Frogger is running. The two holding no keys
+# must end identically, and the one holding Z must diverge from them. The
+# parent bails by itself if its own state changed while the children ran.
+fork_log=$(./beebjit -0 test/games/Disc108-FroggerRSCB.ssd \
+    -mode jit \
+    -headless -fast -accurate \
+    -autoboot \
+    -fork-at 24000000 -fork-cycles 20000000 -fork '' -fork '' -fork Z 2>&1)
+echo "$fork_log" | grep -q 'forks done, parent unchanged'
+fork_none=$(echo "$fork_log" | grep "keys '':" | sed 's/.*keys .*: //' | sort -u)
+fork_z=$(echo "$fork_log" | grep "keys 'Z':" | sed 's/.*keys .*: //')
+if [ $(echo "$fork_log" | grep -c "keys '':") -ne 2 ] || \
+   [ $(echo "$fork_none" | wc -l) -ne 1 ] || [ -z "$fork_z" ] || \
+   [ "$fork_none" = "$fork_z" ]; then
+  echo "$fork_log"
+  echo 'Forked runs not as expected.'
+  exit 1
+fi
+
 echo 'Functional tests OK.'
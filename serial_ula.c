@@ -14,6 +14,10 @@ enum {
   k_serial_ula_motor = 0x80,
 };
 
+enum {
+  k_serial_ula_carrier_bits_for_DCD = 240,
+};
+
 struct serial_ula_struct {
   struct mc6850_struct* p_serial;
   struct tape_struct* p_tape;
@@ -173,6 +177,9 @@ serial_ula_write(struct serial_ula_struct* p_serial_ula, uint8_t val) {
   int is_rs423_selected = !!(val & k_serial_ula_rs423);
   int is_motor_on = !!(val & k_serial_ula_motor);
 
+  /* Tape bits already due must arrive under the old settings. */
+  tape_sync(p_serial_ula->p_tape);
+
   if (p_serial_ula->log_state) {
     log_do_log(k_log_serial,
                k_log_info,
@@ -222,7 +229,7 @@ serial_ula_receive_tape_bit(struct serial_ula_struct* p_serial_ula,
     p_serial_ula->tape_carrier_count = 0;
   }
 
-  if (p_serial_ula->tape_carrier_count == 240) {
+  if (p_serial_ula->tape_carrier_count == k_serial_ula_carrier_bits_for_DCD) {
     /* The tape hardware doesn't raise DCD until the carrier tone has persisted
      * for a while. The BBC service manual opines,
      * "The DCD flag in the 6850 should change 0.1 to 0.4 seconds after a
@@ -255,6 +262,40 @@ serial_ula_receive_tape_bit(struct serial_ula_struct* p_serial_ula,
   }
 }
 
+uint32_t
+serial_ula_get_quiet_tape_bits(struct serial_ula_struct* p_serial_ula,
+                               const int8_t* p_bits,
+                               uint32_t num_bits) {
+  uint32_t i;
+  uint64_t carrier_count = p_serial_ula->tape_carrier_count;
+  int is_DCD = p_serial_ula->is_tape_DCD;
+
+  /* DCD edges are visible, in either direction. */
+  for (i = 0; i < num_bits; ++i) {
+    int is_new_DCD;
+    carrier_count++;
+    if (p_bits[i] != k_tape_bit_1) {
+      carrier_count = 0;
+    }
+    is_new_DCD = (carrier_count == k_serial_ula_carrier_bits_for_DCD);
+    if (is_new_DCD != is_DCD) {
+      break;
+    }
+  }
+  num_bits = i;
+
+  /* As are received bytes. Tape bit values match serial bit values, with
+   * silence not clocking the ACIA.
+   */
+  if (!p_serial_ula->is_rs423_selected) {
+    num_bits = mc6850_get_quiet_receive_bits(p_serial_ula->p_serial,
+                                             p_bits,
+                                             num_bits);
+  }
+
+  return num_bits;
+}
+
 void
 serial_ula_tick(struct serial_ula_struct* p_serial_ula) {
   struct mc6850_struct* p_serial;
@@ -31,6 +31,12 @@ void serial_ula_write(struct serial_ula_struct* p_serial_ula, uint8_t val);
 
 void serial_ula_receive_tape_bit(struct serial_ula_struct* p_serial_ula,
                                  int8_t value);
+/* Returns how many of the tape bits can be received before one makes a change
+ * visible to the CPU.
+ */
+uint32_t serial_ula_get_quiet_tape_bits(struct serial_ula_struct* p_serial_ula,
+                                        const int8_t* p_bits,
+                                        uint32_t num_bits);
 
 void serial_ula_tick(struct serial_ula_struct* p_serial_ula);
 
@@ -20,11 +20,36 @@ static const uint32_t k_sound_clock_divider = 8;
 enum {
   /* 0-2 square wave tone channels, 3 noise channel. */
   k_sound_num_channels = 4,
+  /* Host frames resampled per record callback, at most. */
+  k_sound_record_buffer_size = 4096,
 };
 
+/* Max resample ratio adjustment used to steer the ring buffer fill level. */
+static const double k_sound_ring_max_drift = 0.005;
+
 struct sound_struct {
   /* Underylying driver. */
   struct os_sound_struct* p_driver;
+  /* Or, a recording sink, fed in virtual time. */
+  void (*p_record_callback)(void* p, int16_t* p_frames, uint32_t num_frames);
+  void* p_record_object;
+
+  /* Single producer, single consumer ring of host rate frames. The emulation
+   * thread synthesizes in virtual time and pushes without ever blocking; the
+   * sound thread pulls and blocks in the driver. Each position is only ever
+   * written by its own side.
+   */
+  int is_ring;
+  int16_t* p_ring_frames;
+  uint32_t ring_size;
+  uint32_t ring_target_fill;
+  uint32_t ring_write_pos;
+  uint32_t ring_read_pos;
+  int16_t* p_ring_pull_frames;
+  int16_t ring_last_frame;
+  uint64_t ring_dropped_frames;
+  uint64_t ring_underrun_frames;
+  int is_fast_mode;
 
   /* Configuration. */
   int synchronous;
@@ -133,6 +158,86 @@ iir_lowpass_apply(double new_sample,
   return new_output;
 }
 
+static inline void
+sound_add_sn_run(int16_t* p_frames, uint32_t num_frames, int16_t value) {
+  uint32_t i;
+  /* Simple enough for the compiler to vectorize. */
+  for (i = 0; i < num_frames; ++i) {
+    p_frames[i] += value;
+  }
+}
+
+static void
+sound_filter_sn_frames(struct sound_struct* p_sound,
+                       int16_t* p_frames,
+                       uint32_t num_frames) {
+  uint32_t i;
+  double input_coefficients[3];
+  double output_coefficients[3];
+  double first_input_history[2];
+  double first_output_history[2];
+  double second_input_history[2];
+  double second_output_history[2];
+
+  /* The filter is recursive so it can't be batched across samples, but it
+   * runs as its own pass over the mixed frames, with its state held locally
+   * so the compiler can keep it in registers.
+   */
+  (void) memcpy(input_coefficients,
+                p_sound->iir_input_coefficients,
+                sizeof(input_coefficients));
+  (void) memcpy(output_coefficients,
+                p_sound->iir_output_coefficients,
+                sizeof(output_coefficients));
+  (void) memcpy(first_input_history,
+                p_sound->iir_first_pass_input_history,
+                sizeof(first_input_history));
+  (void) memcpy(first_output_history,
+                p_sound->iir_first_pass_output_history,
+                sizeof(first_output_history));
+  (void) memcpy(second_input_history,
+                p_sound->iir_second_pass_input_history,
+                sizeof(second_input_history));
+  (void) memcpy(second_output_history,
+                p_sound->iir_second_pass_output_history,
+                sizeof(second_output_history));
+
+  for (i = 0; i < num_frames; ++i) {
+    int32_t sample;
+    double output_sample = (double) p_frames[i];
+    output_sample = iir_lowpass_apply(output_sample,
+                                      &first_input_history[0],
+                                      &first_output_history[0],
+                                      &input_coefficients[0],
+                                      &output_coefficients[0]);
+    output_sample = iir_lowpass_apply(output_sample,
+                                      &second_input_history[0],
+                                      &second_output_history[0],
+                                      &input_coefficients[0],
+                                      &output_coefficients[0]);
+    sample = (int32_t) output_sample;
+    if (sample > INT16_MAX) {
+      sample = INT16_MAX;
+    } else if (sample < INT16_MIN) {
+      sample = INT16_MIN;
+    }
+    p_frames[i] = sample;
+  }
+
+  (void) memcpy(p_sound->iir_first_pass_input_history,
+                first_input_history,
+                sizeof(first_input_history));
+  (void) memcpy(p_sound->iir_first_pass_output_history,
+                first_output_history,
+                sizeof(first_output_history));
+  (void) memcpy(p_sound->iir_second_pass_input_history,
+                second_input_history,
+                sizeof(second_input_history));
+  (void) memcpy(p_sound->iir_second_pass_output_history,
+                second_output_history,
+                sizeof(second_output_history));
+}
+
 static void
 sound_fill_sn76489_buffer(struct sound_struct* p_sound,
                           uint32_t num_frames,
@@ -140,7 +245,6 @@ sound_fill_sn76489_buffer(struct sound_struct* p_sound,
                           uint16_t* p_periods,
                           uint16_t noise_rng,
                           int noise_type) {
-  uint32_t i;
   uint8_t channel;
 
   int16_t* p_sn_frames = p_sound->p_sn_frames;
@@ -154,79 +258,76 @@ sound_fill_sn76489_buffer(struct sound_struct* p_sound,
     util_bail("p_sn_frames overflowed");
   }
 
-  for (i = 0; i < num_frames; ++i) {
-    int32_t sample = 0;
-    for (channel = 0; channel < 4; ++channel) {
-      /* Tick the sn76489 clock and see if any timers expire. Flip the flip
-       * flops if they do.
-       */
-      int16_t sample_component = volume_silence;
-      uint16_t counter = p_counters[channel];
-      uint8_t output = p_outputs[channel];
-      int is_noise = 0;
-      if (channel == 3) {
-        is_noise = 1;
+  p_sn_frames += sn_frames_filled;
+  (void) memset(p_sn_frames, '\0', (num_frames * sizeof(int16_t)));
+
+  /* Rather than tick all 4 channels for every 250kHz sample, each channel is
+   * rendered in turn as runs of constant output between counter expiries.
+   * At max volume, 4 channels sum to at most 4 * (INT16_MAX / 4), so the mix
+   * is accumulated directly in the 16-bit frame buffer.
+   */
+  for (channel = 0; channel < k_sound_num_channels; ++channel) {
+    uint32_t index = 0;
+    uint16_t counter = p_counters[channel];
+    uint8_t output = p_outputs[channel];
+    int16_t volume_on = p_sound->volume_outputs[p_volumes[channel]];
+    int is_noise = (channel == 3);
+
+    while (1) {
+      uint32_t num_remaining = (num_frames - index);
+      /* Ticks until the one on which the counter expires. */
+      uint32_t num_steady = ((counter - 1) & 0x3ff);
+      uint8_t level = output;
+      if (is_noise) {
+        level = (noise_rng & 1);
       }
 
-      counter = ((counter - 1) & 0x3ff);
-      if (counter == 0) {
-        counter = p_periods[channel];
-        output = !output;
-        p_outputs[channel] = output;
-
-        if (is_noise && output) {
-          /* NOTE: we do this like jsbeeb: we only update the random number
-           * every two counter expiries, and we have the period values half what
-           * they really are. This might mirror the real silicon? It avoids
-           * needing more than 10 bits to store the period.
-           */
-          if (noise_type == 0) {
-            noise_rng >>= 1;
-            if (noise_rng == 0) {
-              noise_rng = (1 << 14);
-            }
-          } else {
-            int bit = ((noise_rng & 1) ^ ((noise_rng & 2) >> 1));
-            noise_rng = ((noise_rng >> 1) | (bit << 14));
+      if (num_steady >= num_remaining) {
+        sound_add_sn_run((p_sn_frames + index),
+                         num_remaining,
+                         (level ? volume_on : volume_silence));
+        counter = ((counter - num_remaining) & 0x3ff);
+        break;
+      }
+      sound_add_sn_run((p_sn_frames + index),
+                       num_steady,
+                       (level ? volume_on : volume_silence));
+      index += num_steady;
+
+      /* Counter expiry. Flip the flip flop. */
+      counter = p_periods[channel];
+      output = !output;
+      if (is_noise && output) {
+        /* NOTE: we do this like jsbeeb: we only update the random number
+         * every two counter expiries, and we have the period values half what
+         * they really are. This might mirror the real silicon? It avoids
+         * needing more than 10 bits to store the period.
+         */
+        if (noise_type == 0) {
+          noise_rng >>= 1;
+          if (noise_rng == 0) {
+            noise_rng = (1 << 14);
           }
-          p_sound->noise_rng = noise_rng;
+        } else {
+          int bit = ((noise_rng & 1) ^ ((noise_rng & 2) >> 1));
+          noise_rng = ((noise_rng >> 1) | (bit << 14));
         }
+        p_sound->noise_rng = noise_rng;
       }
-
+      level = output;
       if (is_noise) {
-        output = (noise_rng & 1);
+        level = (noise_rng & 1);
       }
+      p_sn_frames[index] += (level ? volume_on : volume_silence);
+      index++;
+    }
 
-      p_counters[channel] = counter;
+    p_counters[channel] = counter;
+    p_outputs[channel] = output;
+  }
 
-      if (output) {
-        uint8_t sn_value = p_volumes[channel];
-        sample_component = p_sound->volume_outputs[sn_value];
-      }
-      sample += sample_component;
-    }
-    if (p_sound->filter_cutoff != 0) {
-      double output_sample = (double) sample;
-      output_sample = iir_lowpass_apply(
-          output_sample,
-          &p_sound->iir_first_pass_input_history[0],
-          &p_sound->iir_first_pass_output_history[0],
-          &p_sound->iir_input_coefficients[0],
-          &p_sound->iir_output_coefficients[0]);
-      output_sample = iir_lowpass_apply(
-          output_sample,
-          &p_sound->iir_second_pass_input_history[0],
-          &p_sound->iir_second_pass_output_history[0],
-          &p_sound->iir_input_coefficients[0],
-          &p_sound->iir_output_coefficients[0]);
-      sample = (int32_t) output_sample;
-      if (sample > INT16_MAX) {
-        sample = INT16_MAX;
-      } else if (sample < INT16_MIN) {
-        sample = INT16_MIN;
-      }
-    }
-    p_sn_frames[sn_frames_filled + i] = sample;
+  if (p_sound->filter_cutoff != 0) {
+    sound_filter_sn_frames(p_sound, p_sn_frames, num_frames);
   }
 
   p_sound->sn_frames_filled += num_frames;
@@ -253,11 +354,39 @@ sound_resample_to_driver_buffer(struct sound_struct* p_sound) {
    * so even the splitting of the border sample value into fractions is
    * important.
    */
-  for (sn_frames_index = 0;
-       (sn_frames_index < num_sn_frames);
-       ++sn_frames_index) {
+  sn_frames_index = 0;
+  while (sn_frames_index < num_sn_frames) {
     double leftover;
-    double this_sample_value = p_sn_frames[sn_frames_index];
+    double this_sample_value;
+    /* The samples wholly inside this output frame are summed as integers. */
+    double num_whole_double = (resample_count - accumulated_count);
+    uint32_t num_whole = 0;
+    if (num_whole_double > 0.0) {
+      num_whole = (uint32_t) num_whole_double;
+      if ((double) num_whole == num_whole_double) {
+        num_whole--;
+      }
+    }
+    if (num_whole > (num_sn_frames - sn_frames_index)) {
+      num_whole = (num_sn_frames - sn_frames_index);
+    }
+    if (num_whole > 0) {
+      uint32_t i;
+      int32_t sum = 0;
+      for (i = 0; i < num_whole; ++i) {
+        sum += p_sn_frames[sn_frames_index + i];
+      }
+      accumulated_value += sum;
+      accumulated_count += num_whole;
+      sn_frames_index += num_whole;
+      if (sn_frames_index == num_sn_frames) {
+        break;
+      }
+    }
+
+    /* The border sample. */
+    this_sample_value = p_sn_frames[sn_frames_index];
+    sn_frames_index++;
     accumulated_count++;
     if (accumulated_count < resample_count) {
       accumulated_value += this_sample_value;
@@ -362,6 +491,110 @@ sound_play_thread(void* p) {
   return NULL;
 }
 
+static uint32_t
+sound_ring_get_fill(struct sound_struct* p_sound) {
+  uint32_t write_pos = __atomic_load_n(&p_sound->ring_write_pos,
+                                       __ATOMIC_ACQUIRE);
+  uint32_t read_pos = __atomic_load_n(&p_sound->ring_read_pos,
+                                      __ATOMIC_ACQUIRE);
+  return (write_pos - read_pos);
+}
+
+static void
+sound_ring_push(struct sound_struct* p_sound,
+                int16_t* p_frames,
+                uint32_t num_frames) {
+  uint32_t i;
+  uint32_t num_free;
+
+  int16_t* p_ring_frames = p_sound->p_ring_frames;
+  uint32_t ring_mask = (p_sound->ring_size - 1);
+  uint32_t write_pos = p_sound->ring_write_pos;
+
+  /* Never block the emulation thread. If the sound thread isn't keeping up,
+   * e.g. in fast mode, frames are dropped.
+   */
+  num_free = (p_sound->ring_size - sound_ring_get_fill(p_sound));
+  if (num_frames > num_free) {
+    p_sound->ring_dropped_frames += (num_frames - num_free);
+    num_frames = num_free;
+  }
+  for (i = 0; i < num_frames; ++i) {
+    p_ring_frames[(write_pos + i) & ring_mask] = p_frames[i];
+  }
+
+  __atomic_store_n(&p_sound->ring_write_pos,
+                   (write_pos + num_frames),
+                   __ATOMIC_RELEASE);
+}
+
+static void
+sound_ring_pull(struct sound_struct* p_sound,
+                int16_t* p_frames,
+                uint32_t num_frames) {
+  uint32_t i;
+  uint32_t num_available;
+
+  int16_t* p_ring_frames = p_sound->p_ring_frames;
+  uint32_t ring_mask = (p_sound->ring_size - 1);
+  uint32_t read_pos = p_sound->ring_read_pos;
+  int16_t last_frame = p_sound->ring_last_frame;
+
+  num_available = sound_ring_get_fill(p_sound);
+  if (num_available > num_frames) {
+    num_available = num_frames;
+  }
+  for (i = 0; i < num_available; ++i) {
+    last_frame = p_ring_frames[(read_pos + i) & ring_mask];
+    p_frames[i] = last_frame;
+  }
+  /* On underrun, hold the last level rather than clicking to zero. */
+  for (; i < num_frames; ++i) {
+    p_frames[i] = last_frame;
+  }
+  p_sound->ring_underrun_frames += (num_frames - num_available);
+  p_sound->ring_last_frame = last_frame;
+
+  __atomic_store_n(&p_sound->ring_read_pos,
+                   (read_pos + num_available),
+                   __ATOMIC_RELEASE);
+}
+
+static void
+sound_ring_adjust_resample_ratio(struct sound_struct* p_sound) {
+  /* Dynamic rate control: the host and emulated clocks drift, so rather than
+   * let the ring slowly fill or drain, nudge the resample ratio to steer the
+   * fill level back towards the target. The tiny pitch change is inaudible.
+   */
+  double base_ratio = ((double) k_sound_clock_rate / p_sound->sample_rate);
+  double target_fill = p_sound->ring_target_fill;
+  double error = ((sound_ring_get_fill(p_sound) - target_fill) / target_fill);
+
+  if (error > 1.0) {
+    error = 1.0;
+  } else if (error < -1.0) {
+    error = -1.0;
+  }
+  /* Fuller than the target means more emulated samples per host frame. */
+  p_sound->sn_frames_per_driver_frame =
+      (base_ratio * (1.0 + (error * k_sound_ring_max_drift)));
+}
+
+static void*
+sound_ring_play_thread(void* p) {
+  struct sound_struct* p_sound = (struct sound_struct*) p;
+  uint32_t period_frames = p_sound->driver_period_size;
+  int16_t* p_frames = p_sound->p_ring_pull_frames;
+  volatile int* p_do_exit = &p_sound->do_exit;
+
+  while (!*p_do_exit) {
+    sound_ring_pull(p_sound, p_frames, period_frames);
+    os_sound_write(p_sound->p_driver, p_frames, period_frames);
+  }
+
+  return NULL;
+}
+
 struct sound_struct*
 sound_create(int synchronous,
              struct timing_struct* p_timing,
@@ -406,6 +639,7 @@ sound_create(int synchronous,
 
   positive_silence = util_has_option(p_options->p_opt_flags,
                                      "sound:positive-silence");
+  p_sound->is_ring = util_has_option(p_options->p_opt_flags, "sound:ring");
 
   if (p_sound->filter_cutoff != 0) {
     double q = (1.0 / sqrt(2.0));
@@ -456,6 +690,15 @@ sound_destroy(struct sound_struct* p_sound) {
   if (p_sound->p_sn_frames) {
     util_free(p_sound->p_sn_frames);
   }
+  if (p_sound->p_ring_frames) {
+    log_do_log(k_log_audio,
+               k_log_info,
+               "ring dropped %"PRIu64" frames, underran %"PRIu64" frames",
+               p_sound->ring_dropped_frames,
+               p_sound->ring_underrun_frames);
+    util_free(p_sound->p_ring_frames);
+    util_free(p_sound->p_ring_pull_frames);
+  }
   os_time_free_sleeper(p_sound->p_sleeper);
   util_free(p_sound);
 }
@@ -508,6 +751,61 @@ sound_set_driver(struct sound_struct* p_sound,
   p_sound->p_driver_frames = util_mallocz(driver_buffer_size * sizeof(int16_t));
   p_sound->p_sn_frames = util_mallocz(
       p_sound->sn_frames_per_driver_buffer_size * sizeof(int16_t));
+
+  if (p_sound->is_ring) {
+    uint32_t ring_size = 1;
+    /* Aim to keep a driver period queued, plus slack for the emulation
+     * thread's wakeup jitter.
+     */
+    p_sound->ring_target_fill = (p_sound->driver_period_size +
+                                 ((uint64_t) sample_rate *
+                                  p_sound->target_latency *
+                                  2 /
+                                  1000000));
+    while (ring_size < (p_sound->ring_target_fill * 4)) {
+      ring_size *= 2;
+    }
+    while (ring_size < (driver_buffer_size * 2)) {
+      ring_size *= 2;
+    }
+    p_sound->ring_size = ring_size;
+    p_sound->p_ring_frames = util_mallocz(ring_size * sizeof(int16_t));
+    p_sound->p_ring_pull_frames = util_mallocz(
+        p_sound->driver_period_size * sizeof(int16_t));
+    log_do_log(k_log_audio,
+               k_log_info,
+               "ring size %"PRIu32" target fill %"PRIu32,
+               ring_size,
+               p_sound->ring_target_fill);
+  }
+}
+
+void
+sound_set_record_callback(struct sound_struct* p_sound,
+                          uint32_t sample_rate,
+                          void (*p_record_callback)(void* p,
+                                                    int16_t* p_frames,
+                                                    uint32_t num_frames),
+                          void* p_record_object) {
+  uint32_t driver_buffer_size = k_sound_record_buffer_size;
+
+  assert(p_sound->p_driver == NULL);
+  assert(p_sound->p_record_callback == NULL);
+
+  p_sound->p_record_callback = p_record_callback;
+  p_sound->p_record_object = p_record_object;
+
+  p_sound->sample_rate = sample_rate;
+  p_sound->driver_buffer_size = driver_buffer_size;
+  p_sound->sn_frames_per_driver_frame = ((double) k_sound_clock_rate /
+                                         (double) sample_rate);
+  /* Leave a frame of headroom for the resampler's carried over fraction. */
+  p_sound->sn_frames_per_driver_buffer_size =
+      floor((driver_buffer_size - 1) * p_sound->sn_frames_per_driver_frame);
+
+  p_sound->p_driver_frames = util_mallocz(driver_buffer_size * sizeof(int16_t));
+  p_sound->p_sn_frames = util_mallocz(
+      p_sound->sn_frames_per_driver_buffer_size * sizeof(int16_t));
 }
 
 void
@@ -518,11 +816,17 @@ sound_start_playing(struct sound_struct* p_sound) {
     return;
   }
 
+  assert(!p_sound->thread_running);
+  if (p_sound->is_ring) {
+    p_sound->p_thread_sound = os_thread_create(sound_ring_play_thread, p_sound);
+    p_sound->thread_running = 1;
+    return;
+  }
+
   if (p_sound->synchronous) {
     return;
   }
 
-  assert(!p_sound->thread_running);
   p_sound->p_thread_sound = os_thread_create(sound_play_thread, p_sound);
   p_sound->thread_running = 1;
 }
@@ -593,7 +897,96 @@ sound_is_active(struct sound_struct* p_sound) {
 
 int
 sound_is_synchronous(struct sound_struct* p_sound) {
-  return sound_is_active(p_sound) && p_sound->synchronous;
+  return (sound_is_active(p_sound) &&
+          p_sound->synchronous &&
+          !p_sound->is_ring);
+}
+
+int
+sound_is_virtual_time(struct sound_struct* p_sound) {
+  if (p_sound->p_record_callback != NULL) {
+    return 1;
+  }
+  return (sound_is_active(p_sound) && p_sound->is_ring);
+}
+
+void
+sound_set_fast_mode(struct sound_struct* p_sound, int is_fast_mode) {
+  p_sound->is_fast_mode = is_fast_mode;
+}
+
+void
+sound_virtual_time_tick(struct sound_struct* p_sound) {
+  uint64_t prev_sn_ticks;
+  uint64_t curr_sn_ticks;
+  uint64_t delta_sn_ticks;
+  uint32_t chunk_size;
+
+  uint64_t curr_system_ticks =
+      timing_get_scaled_total_timer_ticks(p_sound->p_timing);
+  int is_recording = (p_sound->p_record_callback != NULL);
+
+  assert(sound_is_virtual_time(p_sound));
+
+  prev_sn_ticks = (p_sound->prev_system_ticks / k_sound_clock_divider);
+  curr_sn_ticks = (curr_system_ticks / k_sound_clock_divider);
+  delta_sn_ticks = (curr_sn_ticks - prev_sn_ticks);
+
+  chunk_size = p_sound->sn_frames_per_driver_buffer_size;
+  if (!is_recording) {
+    uint64_t max_sn_ticks;
+    /* Leave room for the rate control to produce a few more host frames. */
+    chunk_size /= 2;
+    /* In fast mode, only the most recent sound is worth playing. Otherwise,
+     * synthesize everything the ring has room for, so that a late tick
+     * doesn't leave a gap. Only the excess that would be dropped at the full
+     * ring anyway is skipped.
+     */
+    if (p_sound->is_fast_mode) {
+      max_sn_ticks = chunk_size;
+    } else {
+      uint32_t num_free = (p_sound->ring_size - sound_ring_get_fill(p_sound));
+      max_sn_ticks = (num_free * p_sound->sn_frames_per_driver_frame);
+    }
+    if (delta_sn_ticks > max_sn_ticks) {
+      p_sound->ring_dropped_frames +=
+          ((delta_sn_ticks - max_sn_ticks) /
+           p_sound->sn_frames_per_driver_frame);
+      delta_sn_ticks = max_sn_ticks;
+    }
+  }
+
+  /* It may have been a long time since the last tick, so work through it in
+   * buffer sized chunks.
+   */
+  while (delta_sn_ticks > 0) {
+    uint32_t num_sn_frames = chunk_size;
+    if (num_sn_frames > delta_sn_ticks) {
+      num_sn_frames = delta_sn_ticks;
+    }
+    sound_fill_sn76489_buffer(p_sound,
+                              num_sn_frames,
+                              &p_sound->volume[0],
+                              &p_sound->period[0],
+                              p_sound->noise_rng,
+                              p_sound->noise_type);
+    p_sound->driver_buffer_index = 0;
+    if (is_recording) {
+      (void) sound_resample_to_driver_buffer(p_sound);
+      p_sound->p_record_callback(p_sound->p_record_object,
+                                 p_sound->p_driver_frames,
+                                 p_sound->driver_buffer_index);
+    } else {
+      sound_ring_adjust_resample_ratio(p_sound);
+      (void) sound_resample_to_driver_buffer(p_sound);
+      sound_ring_push(p_sound,
+                      p_sound->p_driver_frames,
+                      p_sound->driver_buffer_index);
+    }
+    delta_sn_ticks -= num_sn_frames;
+  }
+
+  p_sound->prev_system_ticks = curr_system_ticks;
 }
 
 static void
@@ -723,8 +1116,10 @@ sound_sn_set_bus_value(struct sound_struct* p_sound, uint8_t value) {
 
   new_period = -1;
 
-  if (sound_is_active(p_sound) && p_sound->synchronous) {
+  if (sound_is_synchronous(p_sound)) {
     sound_advance_sn_timing(p_sound);
+  } else if (sound_is_virtual_time(p_sound)) {
+    sound_virtual_time_tick(p_sound);
   }
 
   if (value & 0x80) {
@@ -820,3 +1215,5 @@ sound_set_state(struct sound_struct* p_sound,
   p_sound->noise_frequency = noise_frequency;
   p_sound->noise_rng = noise_rng;
 }
+
+#include "test-sound.c"
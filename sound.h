@@ -17,12 +17,22 @@ void sound_destroy(struct sound_struct* p_sound);
 void sound_set_driver(struct sound_struct* p_sound,
                       struct os_sound_struct* p_driver);
 void sound_start_playing(struct sound_struct* p_sound);
+void sound_set_record_callback(struct sound_struct* p_sound,
+                               uint32_t sample_rate,
+                               void (*p_record_callback)(void* p,
+                                                         int16_t* p_frames,
+                                                         uint32_t num_frames),
+                               void* p_record_object);
 
 void sound_power_on_reset(struct sound_struct* p_sound);
 
 int sound_is_active(struct sound_struct* p_sound);
 int sound_is_synchronous(struct sound_struct* p_sound);
 void sound_tick(struct sound_struct* p_sound, uint64_t curr_time_us);
+/* Recording, and ring buffer playback, synthesize in virtual time. */
+int sound_is_virtual_time(struct sound_struct* p_sound);
+void sound_set_fast_mode(struct sound_struct* p_sound, int is_fast_mode);
+void sound_virtual_time_tick(struct sound_struct* p_sound);
 
 void sound_get_state(struct sound_struct* p_sound,
                      uint8_t* p_volumes,
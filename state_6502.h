@@ -8,6 +8,7 @@ enum {
   k_state_6502_irq_via_2 = 2,
   k_state_6502_irq_serial_acia = 4,
   k_state_6502_irq_nmi = 8,
+  k_state_6502_irq_tube = 16,
 };
 
 enum {
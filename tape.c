@@ -7,6 +7,7 @@
 #include "tape_uef.h"
 #include "timing.h"
 #include "util.h"
+#include "util_compress.h"
 
 #include <assert.h>
 #include <inttypes.h>
@@ -17,6 +18,29 @@ enum {
   k_tape_system_tick_rate = 2000000,
   k_tape_bit_rate = 1200,
   k_tape_ticks_per_bit = (k_tape_system_tick_rate / k_tape_bit_rate),
+  /* Bound on how far ahead a batch of bits looks. */
+  k_tape_max_batch_bits = 4096,
+  /* A window of bits that ends this far into a carrier tone has left behind
+   * the serial ULA's DCD delay and any ACIA frame, so the rest of the tone is
+   * quiet too.
+   */
+  k_tape_settled_carrier_bits = 256,
+};
+
+/* Tapes are stored as 32-bit chunks: the top two bits are the type, and the
+ * rest are either a run length or the data bits of an 8N1 frame.
+ */
+enum {
+  k_tape_chunk_type_shift = 30,
+  k_tape_chunk_max_run = 0x3FFFFFFF,
+  k_tape_chunk_frame_bits = 10,
+};
+
+enum {
+  k_tape_chunk_run_0 = 0,
+  k_tape_chunk_run_1 = 1,
+  k_tape_chunk_run_silence = 2,
+  k_tape_chunk_frame = 3,
 };
 
 struct tape_struct {
@@ -27,30 +51,367 @@ struct tape_struct {
   uint32_t tick_rate;
 
   char* p_tape_file_names[k_tape_max_tapes + 1];
-  int8_t* p_tape_buffers[k_tape_max_tapes + 1];
-  uint32_t num_tape_values[k_tape_max_tapes + 1];
+  uint32_t* p_tape_chunks[k_tape_max_tapes + 1];
+  uint32_t num_tape_chunks[k_tape_max_tapes + 1];
+  uint64_t num_tape_bits[k_tape_max_tapes + 1];
 
   int is_tape_running;
   uint32_t tapes_added;
   uint32_t tape_index;
   uint64_t tape_buffer_pos;
-
-  int8_t* p_build_buf;
+  uint32_t chunk_index;
+  uint32_t chunk_offset;
+  /* With fast load, bits that change nothing the CPU can see are delivered in
+   * a batch, at the time of the last bit in the batch, which does. The timer
+   * then only fires once per batch.
+   */
+  uint64_t batch_end_pos;
+  uint64_t run_bits;
+  uint64_t run_batches;
+  /* Per block of bytes: how many bits went out in batches, and how many had
+   * to go one at a time because the CPU could see every one.
+   */
+  uint32_t block_bytes;
+  uint64_t block_batched_bits;
+  uint64_t block_single_bits;
+  int8_t batch_bits[k_tape_max_batch_bits];
+
+  uint32_t* p_build_chunks;
+  uint32_t build_num_chunks;
+  uint32_t build_alloc_chunks;
+  uint64_t build_num_bits;
+  int8_t build_frame[k_tape_chunk_frame_bits];
+  uint32_t build_frame_bits;
 
   int log_uef;
   int opt_do_check_csw_bits;
+  int opt_fast_load;
 };
 
+static uint32_t
+tape_chunk_get_type(uint32_t chunk) {
+  return (chunk >> k_tape_chunk_type_shift);
+}
+
+static uint32_t
+tape_chunk_get_num_bits(uint32_t chunk) {
+  if (tape_chunk_get_type(chunk) == k_tape_chunk_frame) {
+    return k_tape_chunk_frame_bits;
+  }
+  return (chunk & k_tape_chunk_max_run);
+}
+
+static int8_t
+tape_chunk_get_bit(uint32_t chunk, uint32_t offset) {
+  switch (tape_chunk_get_type(chunk)) {
+  case k_tape_chunk_run_0:
+    return k_tape_bit_0;
+  case k_tape_chunk_run_1:
+    return k_tape_bit_1;
+  case k_tape_chunk_run_silence:
+    return k_tape_bit_silence;
+  default:
+    break;
+  }
+  /* Start bit, 8 data bits LSB first, stop bit. */
+  if (offset == 0) {
+    return k_tape_bit_0;
+  } else if (offset == (k_tape_chunk_frame_bits - 1)) {
+    return k_tape_bit_1;
+  }
+  return ((chunk >> (offset - 1)) & 1);
+}
+
+static int8_t
+tape_next_bit(struct tape_struct* p_tape) {
+  uint32_t* p_chunks = p_tape->p_tape_chunks[p_tape->tape_index];
+  uint32_t chunk = p_chunks[p_tape->chunk_index];
+  int8_t bit = tape_chunk_get_bit(chunk, p_tape->chunk_offset);
+
+  p_tape->chunk_offset++;
+  if (p_tape->chunk_offset == tape_chunk_get_num_bits(chunk)) {
+    p_tape->chunk_index++;
+    p_tape->chunk_offset = 0;
+  }
+  p_tape->tape_buffer_pos++;
+
+  return bit;
+}
+
+static uint32_t
+tape_peek_bits(struct tape_struct* p_tape,
+               int8_t* p_bits,
+               uint32_t max_bits,
+               uint32_t* p_last_chunk,
+               uint32_t* p_last_offset) {
+  uint32_t i;
+  uint32_t* p_chunks = p_tape->p_tape_chunks[p_tape->tape_index];
+  uint32_t num_chunks = p_tape->num_tape_chunks[p_tape->tape_index];
+  uint32_t chunk_index = p_tape->chunk_index;
+  uint32_t chunk_offset = p_tape->chunk_offset;
+
+  for (i = 0; (i < max_bits) && (chunk_index < num_chunks); ++i) {
+    uint32_t chunk = p_chunks[chunk_index];
+    p_bits[i] = tape_chunk_get_bit(chunk, chunk_offset);
+    *p_last_chunk = chunk_index;
+    *p_last_offset = chunk_offset;
+    chunk_offset++;
+    if (chunk_offset == tape_chunk_get_num_bits(chunk)) {
+      chunk_index++;
+      chunk_offset = 0;
+    }
+  }
+
+  return i;
+}
+
+static void
+tape_log_block(struct tape_struct* p_tape) {
+  if (p_tape->opt_fast_load && (p_tape->block_bytes > 0)) {
+    log_do_log(k_log_tape,
+               k_log_info,
+               "block: %"PRIu32" bytes, %"PRIu64" bits in batches, "
+               "%"PRIu64" bits one at a time",
+               p_tape->block_bytes,
+               p_tape->block_batched_bits,
+               p_tape->block_single_bits);
+  }
+  p_tape->block_bytes = 0;
+  p_tape->block_batched_bits = 0;
+  p_tape->block_single_bits = 0;
+}
+
+static void
+tape_deliver_bits(struct tape_struct* p_tape, uint64_t end_pos) {
+  uint32_t* p_chunks = p_tape->p_tape_chunks[p_tape->tape_index];
+  int is_batched = ((end_pos - p_tape->tape_buffer_pos) > 1);
+
+  assert(end_pos <= p_tape->num_tape_bits[p_tape->tape_index]);
+
+  p_tape->run_bits += (end_pos - p_tape->tape_buffer_pos);
+  while (p_tape->tape_buffer_pos < end_pos) {
+    int8_t bit;
+    uint32_t chunk_offset = p_tape->chunk_offset;
+    uint32_t type = tape_chunk_get_type(p_chunks[p_tape->chunk_index]);
+
+    /* A block is the bytes between settled carrier tones or silences. */
+    if (type == k_tape_chunk_frame) {
+      if (chunk_offset == (k_tape_chunk_frame_bits - 1)) {
+        p_tape->block_bytes++;
+      }
+    } else if ((type == k_tape_chunk_run_silence) ||
+               ((type == k_tape_chunk_run_1) &&
+                (chunk_offset == k_tape_settled_carrier_bits))) {
+      if (p_tape->block_bytes > 0) {
+        tape_log_block(p_tape);
+      }
+    }
+    if (is_batched) {
+      p_tape->block_batched_bits++;
+    } else {
+      p_tape->block_single_bits++;
+    }
+
+    bit = tape_next_bit(p_tape);
+    if (p_tape->p_serial_ula) {
+      serial_ula_receive_tape_bit(p_tape->p_serial_ula, bit);
+    }
+  }
+}
+
+static void
+tape_start_batch(struct tape_struct* p_tape) {
+  uint64_t pos = p_tape->tape_buffer_pos;
+  uint64_t num_tape_bits = p_tape->num_tape_bits[p_tape->tape_index];
+  uint64_t num_batch = 1;
+
+  if (p_tape->opt_fast_load &&
+      (p_tape->p_serial_ula != NULL) &&
+      (pos < num_tape_bits)) {
+    uint32_t num_bits;
+    uint32_t num_quiet;
+    uint32_t last_chunk = 0;
+    uint32_t last_offset = 0;
+    num_bits = tape_peek_bits(p_tape,
+                              &p_tape->batch_bits[0],
+                              k_tape_max_batch_bits,
+                              &last_chunk,
+                              &last_offset);
+    num_quiet = serial_ula_get_quiet_tape_bits(p_tape->p_serial_ula,
+                                               &p_tape->batch_bits[0],
+                                               num_bits);
+    if (num_quiet < num_bits) {
+      /* Up to and including the bit that isn't quiet. */
+      num_batch = (num_quiet + 1);
+    } else {
+      /* All quiet. Long silences and carrier tones continue to be quiet, so
+       * are skipped in one go.
+       */
+      uint32_t chunk = p_tape->p_tape_chunks[p_tape->tape_index][last_chunk];
+      uint32_t type = tape_chunk_get_type(chunk);
+      num_batch = num_bits;
+      if ((type == k_tape_chunk_run_silence) ||
+          ((type == k_tape_chunk_run_1) &&
+           (last_offset >= k_tape_settled_carrier_bits))) {
+        num_batch += (tape_chunk_get_num_bits(chunk) - last_offset - 1);
+      }
+    }
+  }
+
+  p_tape->batch_end_pos = (pos + num_batch);
+  p_tape->run_batches++;
+  (void) timing_set_timer_value(p_tape->p_timing,
+                                p_tape->timer_id,
+                                ((int64_t) p_tape->tick_rate * num_batch));
+}
+
+static void
+tape_build_append(struct tape_struct* p_tape, uint32_t chunk) {
+  if (p_tape->build_num_chunks == p_tape->build_alloc_chunks) {
+    p_tape->build_alloc_chunks *= 2;
+    p_tape->p_build_chunks = util_realloc(
+        p_tape->p_build_chunks,
+        (p_tape->build_alloc_chunks * sizeof(uint32_t)));
+  }
+  p_tape->p_build_chunks[p_tape->build_num_chunks++] = chunk;
+}
+
+static void
+tape_build_run(struct tape_struct* p_tape, int8_t bit, uint32_t num_bits) {
+  uint32_t type;
+
+  if (bit == k_tape_bit_0) {
+    type = k_tape_chunk_run_0;
+  } else if (bit == k_tape_bit_1) {
+    type = k_tape_chunk_run_1;
+  } else {
+    type = k_tape_chunk_run_silence;
+  }
+
+  /* Extend the previous run if possible. */
+  if (p_tape->build_num_chunks > 0) {
+    uint32_t* p_last = &p_tape->p_build_chunks[p_tape->build_num_chunks - 1];
+    if (tape_chunk_get_type(*p_last) == type) {
+      uint32_t space = k_tape_chunk_max_run;
+      space -= (*p_last & k_tape_chunk_max_run);
+      if (space > num_bits) {
+        space = num_bits;
+      }
+      *p_last += space;
+      num_bits -= space;
+    }
+  }
+  while (num_bits > 0) {
+    uint32_t len = num_bits;
+    if (len > k_tape_chunk_max_run) {
+      len = k_tape_chunk_max_run;
+    }
+    tape_build_append(p_tape, ((type << k_tape_chunk_type_shift) | len));
+    num_bits -= len;
+  }
+}
+
+static void
+tape_build_flush_frame(struct tape_struct* p_tape) {
+  uint32_t i;
+  for (i = 0; i < p_tape->build_frame_bits; ++i) {
+    tape_build_run(p_tape, p_tape->build_frame[i], 1);
+  }
+  p_tape->build_frame_bits = 0;
+}
+
+static void
+tape_build_bit(struct tape_struct* p_tape, int8_t bit) {
+  uint32_t i;
+  int8_t rest[k_tape_chunk_frame_bits - 1];
+  uint32_t num_frame_bits = p_tape->build_frame_bits;
+
+  /* Any 0 bit might start an 8N1 frame, which is stored as a byte. Anything
+   * else is stored as runs.
+   */
+  if (num_frame_bits == 0) {
+    if (bit == k_tape_bit_0) {
+      p_tape->build_frame[0] = bit;
+      p_tape->build_frame_bits = 1;
+    } else {
+      tape_build_run(p_tape, bit, 1);
+    }
+    return;
+  }
+  if (bit == k_tape_bit_silence) {
+    tape_build_flush_frame(p_tape);
+    tape_build_run(p_tape, bit, 1);
+    return;
+  }
+
+  p_tape->build_frame[num_frame_bits++] = bit;
+  p_tape->build_frame_bits = num_frame_bits;
+  if (num_frame_bits < k_tape_chunk_frame_bits) {
+    return;
+  }
+
+  p_tape->build_frame_bits = 0;
+  if (bit == k_tape_bit_1) {
+    uint32_t byte = 0;
+    for (i = 0; i < 8; ++i) {
+      if (p_tape->build_frame[i + 1] == k_tape_bit_1) {
+        byte |= (1 << i);
+      }
+    }
+    tape_build_append(
+        p_tape,
+        (((uint32_t) k_tape_chunk_frame << k_tape_chunk_type_shift) | byte));
+    return;
+  }
+
+  /* No stop bit, so no frame starts at the first bit. Try from the next. */
+  (void) memcpy(rest, &p_tape->build_frame[1], sizeof(rest));
+  tape_build_run(p_tape, p_tape->build_frame[0], 1);
+  for (i = 0; i < (k_tape_chunk_frame_bits - 1); ++i) {
+    tape_build_bit(p_tape, rest[i]);
+  }
+}
+
+static void
+tape_build_start(struct tape_struct* p_tape) {
+  p_tape->build_alloc_chunks = 1024;
+  p_tape->p_build_chunks = util_malloc(p_tape->build_alloc_chunks *
+                                       sizeof(uint32_t));
+  p_tape->build_num_chunks = 0;
+  p_tape->build_num_bits = 0;
+  p_tape->build_frame_bits = 0;
+}
+
+static void
+tape_build_finish(struct tape_struct* p_tape, const char* p_file_name) {
+  uint32_t tapes_added = p_tape->tapes_added;
+
+  tape_build_flush_frame(p_tape);
+
+  log_do_log(k_log_tape,
+             k_log_info,
+             "loaded %"PRIu64" bits as %"PRIu32" chunks",
+             p_tape->build_num_bits,
+             p_tape->build_num_chunks);
+
+  p_tape->p_tape_file_names[tapes_added] = util_strdup(p_file_name);
+  p_tape->p_tape_chunks[tapes_added] = p_tape->p_build_chunks;
+  p_tape->num_tape_chunks[tapes_added] = p_tape->build_num_chunks;
+  p_tape->num_tape_bits[tapes_added] = p_tape->build_num_bits;
+  p_tape->p_build_chunks = NULL;
+
+  /* Always end with an empty slot. */
+  p_tape->p_tape_chunks[tapes_added + 1] = NULL;
+  p_tape->tapes_added++;
+}
+
 static void
 tape_timer_callback(struct tape_struct* p_tape) {
-  uint32_t tape_index = p_tape->tape_index;
-  uint64_t tape_buffer_pos = p_tape->tape_buffer_pos;
-  uint32_t num_tape_values = p_tape->num_tape_values[tape_index];
-  int8_t* p_tape_buffer = p_tape->p_tape_buffers[tape_index];
+  uint64_t num_tape_bits = p_tape->num_tape_bits[p_tape->tape_index];
 
   assert(p_tape->is_tape_running);
 
-  if (p_tape->tape_buffer_pos >= num_tape_values) {
+  if (p_tape->tape_buffer_pos >= num_tape_bits) {
     /* Stops the timer and indicates silence to the ULA. We don't need the
      * timer to continually indicate silence.
      */
@@ -58,17 +419,9 @@ tape_timer_callback(struct tape_struct* p_tape) {
     p_tape->is_tape_running = 1;
     return;
   }
- 
-  (void) timing_set_timer_value(p_tape->p_timing,
-                                p_tape->timer_id,
-                                p_tape->tick_rate);
 
-  if (p_tape->p_serial_ula) {
-    int32_t tape_value = p_tape_buffer[tape_buffer_pos];
-    serial_ula_receive_tape_bit(p_tape->p_serial_ula, tape_value);
-  }
-
-  p_tape->tape_buffer_pos++;
+  tape_deliver_bits(p_tape, p_tape->batch_end_pos);
+  tape_start_batch(p_tape);
 }
 
 struct tape_struct*
@@ -85,7 +438,7 @@ tape_create(struct timing_struct* p_timing, struct bbc_options* p_options) {
   p_tape->tapes_added = 0;
   p_tape->tape_index = 0;
   p_tape->tape_buffer_pos = 0;
-  p_tape->p_tape_buffers[0] = NULL;
+  p_tape->p_tape_chunks[0] = NULL;
 
   p_tape->tick_rate = k_tape_ticks_per_bit;
   (void) util_get_u32_option(&p_tape->tick_rate,
@@ -95,6 +448,8 @@ tape_create(struct timing_struct* p_timing, struct bbc_options* p_options) {
   p_tape->log_uef = util_has_option(p_options->p_log_flags, "tape:uef");
   p_tape->opt_do_check_csw_bits = util_has_option(p_options->p_opt_flags,
                                                   "tape:csw-check-bits");
+  p_tape->opt_fast_load = util_has_option(p_options->p_opt_flags,
+                                          "tape:fast-load");
 
   return p_tape;
 }
@@ -107,7 +462,7 @@ tape_destroy(struct tape_struct* p_tape) {
   assert(!timing_timer_is_running(p_tape->p_timing, p_tape->timer_id));
   for (i = 0; i < p_tape->tapes_added; ++i) {
     util_free(p_tape->p_tape_file_names[i]);
-    util_free(p_tape->p_tape_buffers[i]);
+    util_free(p_tape->p_tape_chunks[i]);
   }
   util_free(p_tape);
 }
@@ -125,12 +480,14 @@ tape_power_on_reset(struct tape_struct* p_tape) {
   tape_rewind(p_tape);
 }
 
+static const char* s_p_tape_extensions[] = { "uef", "csw", NULL };
+
 void
 tape_add_tape(struct tape_struct* p_tape, const char* p_file_name) {
   uint8_t* p_in_file_buf;
   size_t len;
   struct util_file* p_file;
-  int8_t* p_tape_buffer;
+  char* p_plain_file_name;
 
   uint32_t tapes_added = p_tape->tapes_added;
 
@@ -139,9 +496,13 @@ tape_add_tape(struct tape_struct* p_tape, const char* p_file_name) {
   }
 
   p_in_file_buf = util_malloc(k_tape_max_file_size);
-  p_tape->p_build_buf = util_malloc(k_tape_max_file_size);
+  tape_build_start(p_tape);
 
-  p_file = util_file_open(p_file_name, 0, 0);
+  if (util_compress_is_compressed_name(p_file_name)) {
+    p_file = util_compress_open(p_file_name, s_p_tape_extensions);
+  } else {
+    p_file = util_file_open(p_file_name, 0, 0);
+  }
 
   len = util_file_read(p_file, p_in_file_buf, k_tape_max_file_size);
   if (len == k_tape_max_file_size) {
@@ -150,34 +511,26 @@ tape_add_tape(struct tape_struct* p_tape, const char* p_file_name) {
 
   util_file_close(p_file);
 
-  p_tape->tape_buffer_pos = 0;
-  if (util_is_extension(p_file_name, "csw")) {
+  p_plain_file_name = util_compress_get_plain_name(p_file_name,
+                                                   s_p_tape_extensions);
+  if (util_is_extension(p_plain_file_name, "csw")) {
     tape_csw_load(p_tape, p_in_file_buf, len, p_tape->opt_do_check_csw_bits);
   } else {
     tape_uef_load(p_tape, p_in_file_buf, len, p_tape->log_uef);
   }
-
-  p_tape_buffer = util_malloc(p_tape->tape_buffer_pos);
-
-  p_tape->p_tape_file_names[tapes_added] = util_strdup(p_file_name);
-  p_tape->p_tape_buffers[tapes_added] = p_tape_buffer;
-  p_tape->num_tape_values[tapes_added] = p_tape->tape_buffer_pos;
-
-  (void) memcpy(p_tape_buffer, p_tape->p_build_buf, p_tape->tape_buffer_pos);
-
-  /* Always end with an empty slot. */
-  p_tape->p_tape_buffers[tapes_added + 1] = NULL;
-  p_tape->tapes_added++;
+  util_free(p_plain_file_name);
+  tape_build_finish(p_tape, p_file_name);
 
   util_free(p_in_file_buf);
-  util_free(p_tape->p_build_buf);
-  p_tape->p_build_buf = NULL;
 }
 
 void
 tape_play(struct tape_struct* p_tape) {
   assert(!p_tape->is_tape_running);
   p_tape->is_tape_running = 1;
+  p_tape->batch_end_pos = (p_tape->tape_buffer_pos + 1);
+  p_tape->run_bits = 0;
+  p_tape->run_batches = 0;
   (void) timing_start_timer_with_value(p_tape->p_timing,
                                        p_tape->timer_id,
                                        p_tape->tick_rate);
@@ -186,6 +539,17 @@ tape_play(struct tape_struct* p_tape) {
 void
 tape_stop(struct tape_struct* p_tape) {
   assert(p_tape->is_tape_running);
+  tape_sync(p_tape);
+  tape_log_block(p_tape);
+  if (p_tape->opt_fast_load && (p_tape->run_bits > 0)) {
+    log_do_log(k_log_tape,
+               k_log_info,
+               "motor run: %"PRIu64" bits in %"PRIu64" timer expiries",
+               p_tape->run_bits,
+               p_tape->run_batches);
+    p_tape->run_bits = 0;
+    p_tape->run_batches = 0;
+  }
   p_tape->is_tape_running = 0;
   /* The timer won't be running if we ran out of tape data. */
   if (timing_timer_is_running(p_tape->p_timing, p_tape->timer_id)) {
@@ -198,11 +562,12 @@ tape_stop(struct tape_struct* p_tape) {
 
 void
 tape_cycle_tape(struct tape_struct* p_tape) {
-  int8_t* p_tape_buffer;
   char* p_file_name;
 
   uint32_t tape_index = p_tape->tape_index;
 
+  tape_sync(p_tape);
+
   if (tape_index == p_tape->tapes_added) {
     tape_index = 0;
   } else {
@@ -210,8 +575,7 @@ tape_cycle_tape(struct tape_struct* p_tape) {
   }
 
   p_tape->tape_index = tape_index;
-  p_tape_buffer = p_tape->p_tape_buffers[tape_index];
-  if (p_tape_buffer == NULL) {
+  if (p_tape->p_tape_chunks[tape_index] == NULL) {
     p_file_name = "<none>";
   } else {
     p_file_name = p_tape->p_tape_file_names[tape_index];
@@ -222,8 +586,49 @@ tape_cycle_tape(struct tape_struct* p_tape) {
   tape_rewind(p_tape);
 }
 
+void
+tape_sync(struct tape_struct* p_tape) {
+  int64_t ticks_to_batch_end;
+  uint64_t num_pending;
+  uint64_t num_due;
+  uint64_t batch_last_pos;
+  uint32_t tick_rate = p_tape->tick_rate;
+
+  if (!timing_timer_is_running(p_tape->p_timing, p_tape->timer_id)) {
+    return;
+  }
+  batch_last_pos = (p_tape->batch_end_pos - 1);
+  if (batch_last_pos == p_tape->tape_buffer_pos) {
+    return;
+  }
+
+  /* Deliver the bits in the batch that are already due, then time the next
+   * bit on its own, so the rest of the batch is reconsidered after whatever
+   * change is coming.
+   */
+  ticks_to_batch_end = timing_get_timer_value(p_tape->p_timing,
+                                              p_tape->timer_id);
+  num_pending = 0;
+  if (ticks_to_batch_end > 0) {
+    num_pending = (((uint64_t) ticks_to_batch_end + tick_rate - 1) / tick_rate);
+  }
+  num_due = (p_tape->batch_end_pos - p_tape->tape_buffer_pos);
+  assert(num_pending <= num_due);
+  num_due -= num_pending;
+
+  tape_deliver_bits(p_tape, (p_tape->tape_buffer_pos + num_due));
+  p_tape->batch_end_pos = (p_tape->tape_buffer_pos + 1);
+  /* Pull the timer back from the batch's last bit to the next bit. */
+  (void) timing_adjust_timer_value(p_tape->p_timing,
+                                   NULL,
+                                   p_tape->timer_id,
+                                   (((int64_t) p_tape->tape_buffer_pos -
+                                     (int64_t) batch_last_pos) * tick_rate));
+}
+
 void
 tape_rewind(struct tape_struct* p_tape) {
+  tape_sync(p_tape);
   if (p_tape->is_tape_running) {
     if (!timing_timer_is_running(p_tape->p_timing, p_tape->timer_id)) {
       /* Tape is running but we stopped the timer due to lack of data. */
@@ -232,21 +637,28 @@ tape_rewind(struct tape_struct* p_tape) {
     }
   }
   p_tape->tape_buffer_pos = 0;
+  p_tape->chunk_index = 0;
+  p_tape->chunk_offset = 0;
+  p_tape->batch_end_pos = 1;
 }
 
 void
 tape_add_bit(struct tape_struct* p_tape, int8_t bit) {
-  if (p_tape->tape_buffer_pos == k_tape_max_file_size) {
-    util_bail("tape build buffer full");
-  }
-  p_tape->p_build_buf[p_tape->tape_buffer_pos++] = bit;
+  p_tape->build_num_bits++;
+  tape_build_bit(p_tape, bit);
 }
 
 void
 tape_add_bits(struct tape_struct* p_tape, int8_t bit, uint32_t num_bits) {
-  uint32_t i_bits;
-  for (i_bits = 0; i_bits < num_bits; ++i_bits) {
-    tape_add_bit(p_tape, bit);
+  p_tape->build_num_bits += num_bits;
+  /* Bits that might be part of a frame go one at a time. */
+  while ((num_bits > 0) &&
+         ((p_tape->build_frame_bits > 0) || (bit == k_tape_bit_0))) {
+    tape_build_bit(p_tape, bit);
+    num_bits--;
+  }
+  if (num_bits > 0) {
+    tape_build_run(p_tape, bit, num_bits);
   }
 }
 
@@ -267,3 +679,5 @@ tape_add_byte(struct tape_struct* p_tape, uint8_t byte) {
   /* Stop bit. */
   tape_add_bit(p_tape, k_tape_bit_1);
 }
+
+#include "test-tape.c"
@@ -34,6 +34,10 @@ void tape_cycle_tape(struct tape_struct* p_tape);
 void tape_play(struct tape_struct* p_tape);
 void tape_stop(struct tape_struct* p_tape);
 void tape_rewind(struct tape_struct* p_tape);
+/* Catches up on tape bits that are due, before something changes how they
+ * would be received.
+ */
+void tape_sync(struct tape_struct* p_tape);
 
 void tape_add_bit(struct tape_struct* p_tape, int8_t bit);
 void tape_add_bits(struct tape_struct* p_tape, int8_t bit, uint32_t num_bits);
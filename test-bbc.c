@@ -3,6 +3,7 @@
 #include "test.h"
 
 #include "adc.h"
+#include "emit_6502.h"
 #include "mc6850.h"
 #include "state_6502.h"
 
@@ -54,7 +55,75 @@ bbc_test_power_on_reset(struct bbc_struct* p_bbc) {
   test_expect_u32(0xE0, val);
 }
 
+static uint32_t
+bbc_test_count_dirty_pages(struct bbc_struct* p_bbc) {
+  uint32_t count = 0;
+  uint32_t i;
+
+  for (i = 0; i < p_bbc->snapshot_num_pages; ++i) {
+    count += p_bbc->p_snapshot_dirty[i];
+  }
+  return count;
+}
+
+static void
+bbc_test_run_6502(struct bbc_struct* p_bbc, uint16_t addr) {
+  struct cpu_driver* p_cpu_driver = p_bbc->p_cpu_driver;
+
+  state_6502_set_pc(p_bbc->p_state_6502, addr);
+  (void) p_cpu_driver->p_funcs->enter(p_cpu_driver);
+  p_cpu_driver->p_funcs->apply_flags(p_cpu_driver, 0, k_cpu_flag_exited);
+}
+
+static void
+bbc_test_memory_snapshot(struct bbc_struct* p_bbc) {
+  /* One page written from C and one from 6502 code are the only ones that
+   * dirty, and a restore puts both back.
+   */
+  uint8_t ram[k_bbc_ram_size];
+  uint8_t ram_snapshot[k_bbc_ram_size];
+  struct bbc_memory_snapshot* p_snapshot;
+  struct util_buffer* p_buf = util_buffer_create();
+  uint16_t code_addr = (k_bbc_ram_size - 0x100);
+  uint16_t write_addr = (k_bbc_ram_size - 0x10);
+
+  util_buffer_setup(p_buf, (p_bbc->p_mem_raw + code_addr), 0x10);
+  emit_LDA(p_buf, k_imm, 0x5A);
+  emit_STA(p_buf, k_abs, write_addr);
+  emit_EXIT(p_buf);
+  util_buffer_destroy(p_buf);
+  p_bbc->p_mem_raw[0x70] = 0x00;
+  p_bbc->p_mem_raw[write_addr] = 0x00;
+  (void) memcpy(&ram[0], p_bbc->p_mem_read, k_bbc_ram_size);
+
+  p_snapshot = bbc_snapshot_memory(p_bbc);
+  test_expect_u32(0, bbc_test_count_dirty_pages(p_bbc));
+  bbc_copy_memory_snapshot(p_snapshot, &ram_snapshot[0]);
+  test_expect_binary(&ram[0], &ram_snapshot[0], k_bbc_ram_size);
+
+  /* Zero page and the top of RAM are always in different host pages. */
+  p_bbc->p_mem_raw[0x70] = 0xA5;
+  test_expect_u32(1, bbc_test_count_dirty_pages(p_bbc));
+  bbc_test_run_6502(p_bbc, code_addr);
+  test_expect_u32(0x5A, p_bbc->p_mem_read[write_addr]);
+  test_expect_u32(2, bbc_test_count_dirty_pages(p_bbc));
+
+  bbc_restore_memory(p_bbc, p_snapshot);
+  test_expect_u32(0, bbc_test_count_dirty_pages(p_bbc));
+  test_expect_binary(&ram[0], p_bbc->p_mem_read, k_bbc_ram_size);
+
+  /* Restored pages are write protected again, and the restored code runs. */
+  bbc_test_run_6502(p_bbc, code_addr);
+  test_expect_u32(0x5A, p_bbc->p_mem_read[write_addr]);
+  test_expect_u32(1, bbc_test_count_dirty_pages(p_bbc));
+
+  bbc_free_memory_snapshot(p_snapshot);
+  bbc_snapshot_protect_range(p_bbc, 0, k_bbc_ram_size, 0);
+  bbc_snapshot_destroy(p_bbc);
+}
+
 void
 bbc_test(struct bbc_struct* p_bbc) {
   bbc_test_power_on_reset(p_bbc);
+  bbc_test_memory_snapshot(p_bbc);
 }
@@ -0,0 +1,121 @@
+/* Appends at the end of disc_drive.c. */
+
+#include "test.h"
+
+#include "bbc_options.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char* k_disc_drive_test_file_name = "test_disc_drive.hfe";
+
+enum {
+  k_disc_drive_test_num_samples = 200,
+  /* Prime, so the samples land all around the track. */
+  k_disc_drive_test_sample_ticks = 7919,
+  k_disc_drive_test_max_edges = 16,
+};
+
+struct disc_drive_test_trace {
+  uint32_t index[k_disc_drive_test_num_samples];
+  uint32_t head_position[k_disc_drive_test_num_samples];
+  uint64_t edge_ticks[k_disc_drive_test_max_edges];
+  uint32_t num_edges;
+  uint32_t num_callbacks;
+};
+
+static struct disc_drive_test_trace* s_p_disc_drive_test_trace;
+
+static void
+disc_drive_test_pulses_callback(void* p, uint32_t pulses, uint32_t count) {
+  struct disc_drive_struct* p_drive = (struct disc_drive_struct*) p;
+  struct disc_drive_test_trace* p_trace = s_p_disc_drive_test_trace;
+
+  (void) pulses;
+  (void) count;
+
+  p_trace->num_callbacks++;
+  /* The head hasn't advanced yet, so this is the byte at the track wrap. */
+  if ((p_drive->head_position == 0) && (p_drive->pulse_position == 0)) {
+    test_expect_neq(k_disc_drive_test_max_edges, p_trace->num_edges);
+    p_trace->edge_ticks[p_trace->num_edges] =
+        timing_get_total_timer_ticks(p_drive->p_timing);
+    p_trace->num_edges++;
+  }
+}
+
+static void
+disc_drive_test_run(struct disc_drive_test_trace* p_trace,
+                    int is_pulses_wanted,
+                    int is_32us_mode) {
+  uint32_t i;
+  struct bbc_options options;
+  struct timing_struct* p_timing;
+  struct disc_drive_struct* p_drive;
+  struct disc_struct* p_disc;
+
+  (void) memset(&options, '\0', sizeof(options));
+  options.p_opt_flags = "";
+  options.p_log_flags = "";
+
+  (void) memset(p_trace, '\0', sizeof(struct disc_drive_test_trace));
+  s_p_disc_drive_test_trace = p_trace;
+
+  p_timing = timing_create(1);
+  p_drive = disc_drive_create(0, p_timing, &options);
+  p_disc = disc_create_from_raw(k_disc_drive_test_file_name, "");
+  disc_drive_add_disc(p_drive, p_disc);
+  disc_drive_set_pulses_callback(p_drive,
+                                 disc_drive_test_pulses_callback,
+                                 p_drive);
+  disc_drive_set_32us_mode(p_drive, is_32us_mode);
+  disc_drive_set_pulses_wanted(p_drive, is_pulses_wanted);
+
+  disc_drive_start_spinning(p_drive);
+  for (i = 0; i < k_disc_drive_test_num_samples; ++i) {
+    (void) timing_advance_time_delta(p_timing, k_disc_drive_test_sample_ticks);
+    p_trace->index[i] = disc_drive_is_index_pulse(p_drive);
+    p_trace->head_position[i] = disc_drive_get_head_position(p_drive);
+  }
+  disc_drive_stop_spinning(p_drive);
+
+  disc_drive_destroy(p_drive);
+  timing_destroy(p_timing);
+  (void) remove(k_disc_drive_test_file_name);
+}
+
+static void
+disc_drive_test_skip_matches(int is_32us_mode) {
+  /* An idle controller lets the drive skip from index edge to index edge,
+   * including across the track wrap. Index pulse timing and head position
+   * must match the per-byte path exactly.
+   */
+  uint32_t i;
+  struct disc_drive_test_trace per_byte;
+  struct disc_drive_test_trace skipping;
+
+  disc_drive_test_run(&per_byte, 1, is_32us_mode);
+  disc_drive_test_run(&skipping, 0, is_32us_mode);
+
+  /* About 4 revolutions. */
+  test_expect_u32(4, per_byte.num_edges);
+  test_expect_u32(per_byte.num_edges, skipping.num_edges);
+  for (i = 0; i < per_byte.num_edges; ++i) {
+    test_expect_u32((uint32_t) per_byte.edge_ticks[i],
+                    (uint32_t) skipping.edge_ticks[i]);
+  }
+  for (i = 0; i < k_disc_drive_test_num_samples; ++i) {
+    test_expect_u32(per_byte.index[i], skipping.index[i]);
+    test_expect_u32(per_byte.head_position[i], skipping.head_position[i]);
+  }
+  /* Both index edges per revolution, plus the first byte. */
+  test_expect_u32(1,
+                  (skipping.num_callbacks <= ((skipping.num_edges * 2) + 1)));
+  test_expect_u32(1, (per_byte.num_callbacks > 10000));
+}
+
+void
+disc_drive_test(void) {
+  disc_drive_test_skip_matches(0);
+  disc_drive_test_skip_matches(1);
+}
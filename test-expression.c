@@ -272,6 +272,58 @@ expression_test_parens(void) {
   expression_destroy(p_expression);
 }
 
+static void
+expression_test_short_circuit(void) {
+  struct expression_struct* p_expression = expression_test_get_expression();
+
+  s_test_var = 1;
+  expression_parse(p_expression, "0 && (var = 5)");
+  test_expect_u32(0, expression_execute(p_expression));
+  test_expect_u32(1, s_test_var);
+  expression_parse(p_expression, "2 || (var = 6)");
+  test_expect_u32(1, expression_execute(p_expression));
+  test_expect_u32(1, s_test_var);
+  expression_parse(p_expression, "(var = 3) && (1 + 1) * two");
+  test_expect_u32(1, expression_execute(p_expression));
+  test_expect_u32(3, s_test_var);
+  expression_parse(p_expression, "0 || 0 || two");
+  test_expect_u32(1, expression_execute(p_expression));
+
+  expression_destroy(p_expression);
+}
+
+static void
+expression_test_required_value(void) {
+  int64_t value = 0;
+  struct expression_struct* p_expression = expression_test_get_expression();
+
+  expression_parse(p_expression, "var == 0x10 && one");
+  test_expect_u32(1, expression_get_required_value(
+                         p_expression, expression_test_read_var_func, &value));
+  test_expect_u32(16, value);
+  expression_parse(p_expression, "one && (7 == var)");
+  test_expect_u32(1, expression_get_required_value(
+                         p_expression, expression_test_read_var_func, &value));
+  test_expect_u32(7, value);
+  expression_parse(p_expression, "one || var == 7");
+  test_expect_u32(0, expression_get_required_value(
+                         p_expression, expression_test_read_var_func, &value));
+  expression_parse(p_expression, "var != 7");
+  test_expect_u32(0, expression_get_required_value(
+                         p_expression, expression_test_read_var_func, &value));
+  expression_parse(p_expression, "one == 7");
+  test_expect_u32(0, expression_get_required_value(
+                         p_expression, expression_test_read_var_func, &value));
+  expression_parse(p_expression, "(buf[0] = 3) && var == 7");
+  test_expect_u32(0, expression_get_required_value(
+                         p_expression, expression_test_read_var_func, &value));
+  expression_parse(p_expression, "var == 7 && (buf[0] = 3)");
+  test_expect_u32(0, expression_get_required_value(
+                         p_expression, expression_test_read_var_func, &value));
+
+  expression_destroy(p_expression);
+}
+
 void
 expression_test() {
   expression_test_basic();
@@ -283,4 +335,6 @@ expression_test() {
   expression_test_assign();
   expression_test_misc();
   expression_test_parens();
+  expression_test_short_circuit();
+  expression_test_required_value();
 }
@@ -0,0 +1,311 @@
+/* Appends at the end of intel_fdc.c. */
+
+#include "test.h"
+
+#include <string.h>
+
+enum {
+  k_intel_fdc_test_num_pulses = 1000000,
+  k_intel_fdc_test_num_sectors = 20000,
+  k_intel_fdc_test_max_bytes = 256,
+};
+
+static uint32_t s_intel_fdc_test_rand = 0x8271;
+
+static uint32_t
+intel_fdc_test_rand(void) {
+  return test_rand(&s_intel_fdc_test_rand);
+}
+
+static void
+intel_fdc_test_gather_odd_bits(void) {
+  /* Against a plain bit by bit gather, for every 16-bit value. */
+  uint32_t val;
+
+  for (val = 0; val < 0x10000; ++val) {
+    uint32_t i;
+    uint8_t expect = 0;
+    for (i = 0; i < 8; ++i) {
+      expect <<= 1;
+      expect |= !!(val & (0x4000 >> (i * 2)));
+    }
+    test_expect_u32(expect, intel_fdc_gather_odd_bits(val));
+  }
+}
+
+static void
+intel_fdc_test_pulses_to_bits(void) {
+  /* Against the original pair by pair fold of 2us pulses to 4us bits. */
+  uint32_t i;
+
+  for (i = 0; i < k_intel_fdc_test_num_pulses; ++i) {
+    uint32_t j;
+    uint32_t pulses = intel_fdc_test_rand();
+    uint32_t shift_pulses;
+    uint32_t expect = 0;
+    /* Sparse pulses too, like real FM. */
+    if (i & 1) {
+      pulses &= intel_fdc_test_rand();
+    }
+    shift_pulses = pulses;
+    for (j = 0; j < 16; ++j) {
+      expect <<= 1;
+      expect |= !!(shift_pulses & 0xC0000000);
+      shift_pulses <<= 2;
+    }
+    test_expect_u32(expect, intel_fdc_pulses_to_bits(pulses));
+  }
+}
+
+struct intel_fdc_test_env {
+  struct timing_struct* p_timing;
+  uint8_t* p_mem;
+  struct state_6502* p_state_6502;
+  struct disc_drive_struct* p_drive;
+  struct intel_fdc_struct* p_fdc;
+};
+
+static void
+intel_fdc_test_env_create(struct intel_fdc_test_env* p_env) {
+  /* A controller with its own timing, CPU and drive, so that timers, NMIs
+   * and seeks from one decode can't leak into another.
+   */
+  struct bbc_options options;
+
+  (void) memset(&options, '\0', sizeof(options));
+  options.p_opt_flags = "";
+  options.p_log_flags = "";
+  p_env->p_timing = timing_create(1);
+  p_env->p_mem = util_mallocz(0x10000);
+  p_env->p_state_6502 = state_6502_create(p_env->p_timing, p_env->p_mem);
+  p_env->p_drive = disc_drive_create(0, p_env->p_timing, &options);
+  p_env->p_fdc = intel_fdc_create(p_env->p_state_6502,
+                                  p_env->p_timing,
+                                  &options);
+  intel_fdc_set_drives(p_env->p_fdc, p_env->p_drive, p_env->p_drive);
+}
+
+static void
+intel_fdc_test_env_destroy(struct intel_fdc_test_env* p_env) {
+  intel_fdc_destroy(p_env->p_fdc);
+  disc_drive_destroy(p_env->p_drive);
+  state_6502_destroy(p_env->p_state_6502);
+  util_free(p_env->p_mem);
+  timing_destroy(p_env->p_timing);
+}
+
+static void
+intel_fdc_test_start_read(struct intel_fdc_struct* p_fdc,
+                          uint8_t sector,
+                          uint8_t num_sectors) {
+  /* The state a READ DATA command is in once the head has settled. */
+  p_fdc->regs[k_intel_fdc_register_internal_command] =
+      (k_intel_fdc_command_READ_DATA << 2);
+  p_fdc->regs[k_intel_fdc_register_mode] |= k_intel_fdc_mode_no_dma;
+  p_fdc->regs[k_intel_fdc_register_internal_param_1] = 0;
+  p_fdc->regs[k_intel_fdc_register_internal_param_2] = sector;
+  p_fdc->regs[k_intel_fdc_register_internal_param_3] = num_sectors;
+  p_fdc->regs[k_intel_fdc_register_internal_param_4] = 1;
+  p_fdc->regs[k_intel_fdc_register_internal_seek_retry_count] = 0;
+  p_fdc->call_context = k_intel_fdc_call_read;
+  intel_fdc_set_drive_out(p_fdc, (k_intel_fdc_drive_out_select_0 |
+                                  k_intel_fdc_drive_out_load_head));
+  intel_fdc_set_result(p_fdc, 0);
+  intel_fdc_status_raise(p_fdc, k_intel_fdc_status_flag_busy);
+  intel_fdc_setup_sector_size(p_fdc);
+  intel_fdc_start_syncing_for_header(p_fdc);
+}
+
+static uint32_t
+intel_fdc_test_make_sector(uint8_t* p_clocks, uint8_t* p_data) {
+  /* A gap, then an FM sector header and sector, mostly well formed. The
+   * sector number, CRCs, marks and gaps are sometimes wrong, and sometimes
+   * there's noise instead.
+   */
+  uint32_t i;
+  uint16_t crc;
+  uint8_t header[4];
+  uint32_t num_bytes = 0;
+  uint32_t gap = (intel_fdc_test_rand() % 20);
+
+  for (i = 0; i < gap; ++i) {
+    p_clocks[num_bytes] = 0xFF;
+    p_data[num_bytes++] = 0xFF;
+  }
+  if ((intel_fdc_test_rand() % 8) == 0) {
+    for (i = 0; i < 16; ++i) {
+      p_clocks[num_bytes] = intel_fdc_test_rand();
+      p_data[num_bytes++] = intel_fdc_test_rand();
+    }
+    return num_bytes;
+  }
+  for (i = 0; i < 6; ++i) {
+    p_clocks[num_bytes] = 0xFF;
+    p_data[num_bytes++] = 0x00;
+  }
+
+  header[0] = 0;
+  header[1] = 0;
+  header[2] = (intel_fdc_test_rand() % 4);
+  header[3] = 0;
+  p_clocks[num_bytes] = k_ibm_disc_mark_clock_pattern;
+  p_data[num_bytes++] = k_ibm_disc_id_mark_data_pattern;
+  crc = ibm_disc_format_crc_init(0);
+  crc = ibm_disc_format_crc_add_byte(crc, k_ibm_disc_id_mark_data_pattern);
+  for (i = 0; i < 4; ++i) {
+    crc = ibm_disc_format_crc_add_byte(crc, header[i]);
+    p_clocks[num_bytes] = 0xFF;
+    p_data[num_bytes++] = header[i];
+  }
+  if ((intel_fdc_test_rand() % 16) == 0) {
+    crc ^= 1;
+  }
+  p_clocks[num_bytes] = 0xFF;
+  p_data[num_bytes++] = (crc >> 8);
+  p_clocks[num_bytes] = 0xFF;
+  p_data[num_bytes++] = (crc & 0xFF);
+
+  gap = (11 + (intel_fdc_test_rand() % 4));
+  for (i = 0; i < gap; ++i) {
+    p_clocks[num_bytes] = 0xFF;
+    p_data[num_bytes++] = 0xFF;
+  }
+  for (i = 0; i < 6; ++i) {
+    p_clocks[num_bytes] = 0xFF;
+    p_data[num_bytes++] = 0x00;
+  }
+
+  p_clocks[num_bytes] = k_ibm_disc_mark_clock_pattern;
+  switch (intel_fdc_test_rand() % 8) {
+  case 0:
+    p_data[num_bytes] = k_ibm_disc_deleted_data_mark_data_pattern;
+    break;
+  case 1:
+    /* Not a data mark. */
+    p_data[num_bytes] = 0xFC;
+    break;
+  default:
+    p_data[num_bytes] = k_ibm_disc_data_mark_data_pattern;
+    break;
+  }
+  crc = ibm_disc_format_crc_init(0);
+  crc = ibm_disc_format_crc_add_byte(crc, p_data[num_bytes]);
+  num_bytes++;
+  for (i = 0; i < 128; ++i) {
+    uint8_t data = intel_fdc_test_rand();
+    crc = ibm_disc_format_crc_add_byte(crc, data);
+    p_clocks[num_bytes] = 0xFF;
+    p_data[num_bytes++] = data;
+  }
+  if ((intel_fdc_test_rand() % 16) == 0) {
+    crc ^= 1;
+  }
+  p_clocks[num_bytes] = 0xFF;
+  p_data[num_bytes++] = (crc >> 8);
+  p_clocks[num_bytes] = 0xFF;
+  p_data[num_bytes++] = (crc & 0xFF);
+  /* Some gap, so that a change in bit alignment doesn't cut the CRC short. */
+  p_clocks[num_bytes] = 0xFF;
+  p_data[num_bytes++] = 0xFF;
+
+  assert(num_bytes <= k_intel_fdc_test_max_bytes);
+  return num_bytes;
+}
+
+static void
+intel_fdc_test_shift_data_bits_bitwise(struct intel_fdc_struct* p_fdc,
+                                       uint32_t pulses) {
+  /* The original bit by bit decode. */
+  uint32_t i;
+  uint32_t bits = intel_fdc_pulses_to_bits(pulses);
+
+  for (i = 0; i < 16; ++i) {
+    intel_fdc_shift_data_bit(p_fdc, !!(bits & 0x8000));
+    bits <<= 1;
+  }
+}
+
+static void
+intel_fdc_test_expect_same(struct intel_fdc_test_env* p_bitwise,
+                           struct intel_fdc_test_env* p_bytewise) {
+  /* Everything but the pointers into each environment. */
+  size_t offset = offsetof(struct intel_fdc_struct, parameter_callback);
+  struct intel_fdc_struct* p_bitwise_fdc = p_bitwise->p_fdc;
+  struct intel_fdc_struct* p_bytewise_fdc = p_bytewise->p_fdc;
+
+  test_expect_binary(((uint8_t*) p_bitwise_fdc + offset),
+                     ((uint8_t*) p_bytewise_fdc + offset),
+                     (sizeof(struct intel_fdc_struct) - offset));
+  test_expect_u32(
+      timing_timer_is_running(p_bitwise->p_timing, p_bitwise_fdc->timer_id),
+      timing_timer_is_running(p_bytewise->p_timing,
+                              p_bytewise_fdc->timer_id));
+  test_expect_u32(
+      state_6502_check_irq_firing(p_bitwise->p_state_6502,
+                                  k_state_6502_irq_nmi),
+      state_6502_check_irq_firing(p_bytewise->p_state_6502,
+                                  k_state_6502_irq_nmi));
+}
+
+static void
+intel_fdc_test_bytewise_decode(void) {
+  /* Sectors of FM pulses, at any bit alignment, go through READ DATA on two
+   * controllers: one decoding bit by bit, one in batches. After each 32
+   * pulses, the whole controller state must match.
+   */
+  uint32_t i_sector;
+  struct intel_fdc_test_env bitwise;
+  struct intel_fdc_test_env bytewise;
+  uint8_t clocks[k_intel_fdc_test_max_bytes];
+  uint8_t data[k_intel_fdc_test_max_bytes];
+  uint32_t carry = 0xFFFFFFFF;
+
+  intel_fdc_test_env_create(&bitwise);
+  intel_fdc_test_env_create(&bytewise);
+
+  for (i_sector = 0; i_sector < k_intel_fdc_test_num_sectors; ++i_sector) {
+    uint32_t i;
+    uint32_t num_bytes = intel_fdc_test_make_sector(&clocks[0], &data[0]);
+    uint32_t shift = (intel_fdc_test_rand() % 32);
+
+    if (bitwise.p_fdc->state == k_intel_fdc_state_idle) {
+      uint8_t sector = (intel_fdc_test_rand() % 4);
+      uint8_t num_sectors = (1 + (intel_fdc_test_rand() % 3));
+      intel_fdc_test_start_read(bitwise.p_fdc, sector, num_sectors);
+      intel_fdc_test_start_read(bytewise.p_fdc, sector, num_sectors);
+      intel_fdc_test_expect_same(&bitwise, &bytewise);
+    }
+
+    for (i = 0; i < num_bytes; ++i) {
+      uint32_t pulses = ibm_disc_format_fm_to_2us_pulses(clocks[i], data[i]);
+      uint32_t shifted = pulses;
+      if (shift != 0) {
+        shifted = ((carry << (32 - shift)) | (pulses >> shift));
+      }
+      carry = pulses;
+
+      intel_fdc_test_shift_data_bits_bitwise(bitwise.p_fdc, shifted);
+      intel_fdc_shift_data_bits(bytewise.p_fdc, shifted);
+      intel_fdc_test_expect_same(&bitwise, &bytewise);
+
+      /* Play the CPU, usually picking up each byte in time. */
+      if ((intel_fdc_test_rand() % 256) != 0) {
+        if (intel_fdc_get_internal_status(bitwise.p_fdc) &
+                k_intel_fdc_status_flag_need_data) {
+          (void) intel_fdc_read(bitwise.p_fdc, k_intel_fdc_data);
+          (void) intel_fdc_read(bytewise.p_fdc, k_intel_fdc_data);
+        }
+      }
+    }
+  }
+
+  intel_fdc_test_env_destroy(&bitwise);
+  intel_fdc_test_env_destroy(&bytewise);
+}
+
+void
+intel_fdc_test(void) {
+  intel_fdc_test_gather_odd_bits();
+  intel_fdc_test_pulses_to_bits();
+  intel_fdc_test_bytewise_decode();
+}
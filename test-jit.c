@@ -1515,6 +1515,125 @@ jit_test_compile_binary(void) {
   test_expect_binary(p_expect, p_binary, expect_len);
 }
 
+static void
+jit_test_collapse_loop(uint16_t addr) {
+  state_6502_set_pc(s_p_state_6502, addr);
+  jit_enter(s_p_cpu_driver);
+  interp_testing_unexit(s_p_interp);
+}
+
+static void
+jit_test_collapse_loops(void) {
+  /* A loop polling a register that only changes when a timer fires is
+   * collapsed, which ends its block at the branch. A read with side effects
+   * isn't. Each loop falls through first time around.
+   */
+  struct util_buffer* p_buf = util_buffer_create();
+
+  jit_compiler_testing_set_accurate_cycles(s_p_compiler, 0);
+
+  /* IFR is a plain load. */
+  util_buffer_setup(p_buf, (s_p_mem + 0x3D00), 0x100);
+  emit_LDA(p_buf, k_abs, 0xFE4D);
+  emit_CMP(p_buf, k_imm, 0x00);
+  emit_BCC(p_buf, -7);
+  emit_EXIT(p_buf);
+  state_6502_set_pc(s_p_state_6502, 0x3D00);
+  jit_enter(s_p_cpu_driver);
+  interp_testing_unexit(s_p_interp);
+  test_expect_eq(0x3D07, jit_metadata_get_code_block(s_p_metadata, 0x3D07));
+
+  /* ORB clears CB1. */
+  util_buffer_setup(p_buf, (s_p_mem + 0x3E00), 0x100);
+  emit_LDA(p_buf, k_abs, 0xFE40);
+  emit_CMP(p_buf, k_imm, 0x00);
+  emit_BCC(p_buf, -7);
+  emit_EXIT(p_buf);
+  state_6502_set_pc(s_p_state_6502, 0x3E00);
+  jit_enter(s_p_cpu_driver);
+  interp_testing_unexit(s_p_interp);
+  test_expect_eq(0x3E00, jit_metadata_get_code_block(s_p_metadata, 0x3E07));
+
+  /* ORA clears CA1. */
+  util_buffer_setup(p_buf, (s_p_mem + 0x3F00), 0x100);
+  emit_LDA(p_buf, k_abs, 0xFE41);
+  emit_CMP(p_buf, k_imm, 0x00);
+  emit_BCC(p_buf, -7);
+  emit_EXIT(p_buf);
+  state_6502_set_pc(s_p_state_6502, 0x3F00);
+  jit_enter(s_p_cpu_driver);
+  interp_testing_unexit(s_p_interp);
+  test_expect_eq(0x3F00, jit_metadata_get_code_block(s_p_metadata, 0x3F07));
+
+  /* The AND form, on a plain load and then on a read that clears CB1. */
+  util_buffer_setup(p_buf, (s_p_mem + 0x2200), 0x100);
+  emit_LDA(p_buf, k_abs, 0xFE4D);
+  emit_AND(p_buf, k_imm, 0x00);
+  emit_BNE(p_buf, -7);
+  emit_EXIT(p_buf);
+  jit_test_collapse_loop(0x2200);
+  test_expect_eq(0x2207, jit_metadata_get_code_block(s_p_metadata, 0x2207));
+
+  util_buffer_setup(p_buf, (s_p_mem + 0x2300), 0x100);
+  emit_LDA(p_buf, k_abs, 0xFE40);
+  emit_AND(p_buf, k_imm, 0x00);
+  emit_BNE(p_buf, -7);
+  emit_EXIT(p_buf);
+  jit_test_collapse_loop(0x2300);
+  test_expect_eq(0x2300, jit_metadata_get_code_block(s_p_metadata, 0x2307));
+
+  /* The BIT form. IER bit 7 always reads as 1. */
+  util_buffer_setup(p_buf, (s_p_mem + 0x2400), 0x100);
+  emit_BIT(p_buf, k_abs, 0xFE4E);
+  emit_BPL(p_buf, -5);
+  emit_EXIT(p_buf);
+  jit_test_collapse_loop(0x2400);
+  test_expect_eq(0x2405, jit_metadata_get_code_block(s_p_metadata, 0x2405));
+
+  /* The remaining branch forms, polling RAM. */
+  s_p_mem[0x70] = 0x00;
+  s_p_mem[0x71] = 0x40;
+
+  util_buffer_setup(p_buf, (s_p_mem + 0x2500), 0x100);
+  emit_LDA(p_buf, k_zpg, 0x70);
+  emit_CMP(p_buf, k_imm, 0x01);
+  emit_BCS(p_buf, -6);
+  emit_EXIT(p_buf);
+  jit_test_collapse_loop(0x2500);
+  test_expect_eq(0x2506, jit_metadata_get_code_block(s_p_metadata, 0x2506));
+
+  util_buffer_setup(p_buf, (s_p_mem + 0x2600), 0x100);
+  emit_LDA(p_buf, k_zpg, 0x70);
+  emit_BMI(p_buf, -4);
+  emit_EXIT(p_buf);
+  jit_test_collapse_loop(0x2600);
+  test_expect_eq(0x2604, jit_metadata_get_code_block(s_p_metadata, 0x2604));
+
+  util_buffer_setup(p_buf, (s_p_mem + 0x2700), 0x100);
+  emit_LDA(p_buf, k_imm, 0x80);
+  emit_BPL(p_buf, -4);
+  emit_EXIT(p_buf);
+  jit_test_collapse_loop(0x2700);
+  test_expect_eq(0x2704, jit_metadata_get_code_block(s_p_metadata, 0x2704));
+
+  util_buffer_setup(p_buf, (s_p_mem + 0x2800), 0x100);
+  emit_BIT(p_buf, k_zpg, 0x71);
+  emit_BVC(p_buf, -4);
+  emit_EXIT(p_buf);
+  jit_test_collapse_loop(0x2800);
+  test_expect_eq(0x2804, jit_metadata_get_code_block(s_p_metadata, 0x2804));
+
+  util_buffer_setup(p_buf, (s_p_mem + 0x2900), 0x100);
+  emit_BIT(p_buf, k_zpg, 0x70);
+  emit_BVS(p_buf, -4);
+  emit_EXIT(p_buf);
+  jit_test_collapse_loop(0x2900);
+  test_expect_eq(0x2904, jit_metadata_get_code_block(s_p_metadata, 0x2904));
+
+  jit_compiler_testing_set_accurate_cycles(s_p_compiler, 1);
+  util_buffer_destroy(p_buf);
+}
+
 void
 jit_test(struct bbc_struct* p_bbc) {
   jit_test_init(p_bbc);
@@ -1562,6 +1681,7 @@ jit_test(struct bbc_struct* p_bbc) {
   jit_compiler_testing_set_optimizing(s_p_compiler, 1);
   jit_test_compile_binary();
   jit_test_compile_metadata();
+  jit_test_collapse_loops();
   jit_compiler_testing_set_max_ops(s_p_compiler, 4);
   jit_compiler_testing_set_optimizing(s_p_compiler, 0);
 
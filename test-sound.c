@@ -0,0 +1,373 @@
+/* Appends at the end of sound.c. */
+
+#include "test.h"
+
+/* The original per-sample implementations, kept as references for the
+ * batched versions.
+ */
+static void
+sound_test_reference_fill(struct sound_struct* p_sound,
+                          uint32_t num_frames,
+                          uint8_t* p_volumes,
+                          uint16_t* p_periods,
+                          uint16_t noise_rng,
+                          int noise_type) {
+  uint32_t i;
+  uint8_t channel;
+
+  int16_t* p_sn_frames = p_sound->p_sn_frames;
+  uint16_t* p_counters = &p_sound->counter[0];
+  uint8_t* p_outputs = &p_sound->output[0];
+  uint32_t sn_frames_filled = p_sound->sn_frames_filled;
+  int16_t volume_silence = p_sound->volume_silence;
+
+  if ((sn_frames_filled + num_frames) >
+      p_sound->sn_frames_per_driver_buffer_size) {
+    util_bail("p_sn_frames overflowed");
+  }
+
+  for (i = 0; i < num_frames; ++i) {
+    int32_t sample = 0;
+    for (channel = 0; channel < 4; ++channel) {
+      /* Tick the sn76489 clock and see if any timers expire. Flip the flip
+       * flops if they do.
+       */
+      int16_t sample_component = volume_silence;
+      uint16_t counter = p_counters[channel];
+      uint8_t output = p_outputs[channel];
+      int is_noise = 0;
+      if (channel == 3) {
+        is_noise = 1;
+      }
+
+      counter = ((counter - 1) & 0x3ff);
+      if (counter == 0) {
+        counter = p_periods[channel];
+        output = !output;
+        p_outputs[channel] = output;
+
+        if (is_noise && output) {
+          /* NOTE: we do this like jsbeeb: we only update the random number
+           * every two counter expiries, and we have the period values half what
+           * they really are. This might mirror the real silicon? It avoids
+           * needing more than 10 bits to store the period.
+           */
+          if (noise_type == 0) {
+            noise_rng >>= 1;
+            if (noise_rng == 0) {
+              noise_rng = (1 << 14);
+            }
+          } else {
+            int bit = ((noise_rng & 1) ^ ((noise_rng & 2) >> 1));
+            noise_rng = ((noise_rng >> 1) | (bit << 14));
+          }
+          p_sound->noise_rng = noise_rng;
+        }
+      }
+
+      if (is_noise) {
+        output = (noise_rng & 1);
+      }
+
+      p_counters[channel] = counter;
+
+      if (output) {
+        uint8_t sn_value = p_volumes[channel];
+        sample_component = p_sound->volume_outputs[sn_value];
+      }
+      sample += sample_component;
+    }
+    if (p_sound->filter_cutoff != 0) {
+      double output_sample = (double) sample;
+      output_sample = iir_lowpass_apply(
+          output_sample,
+          &p_sound->iir_first_pass_input_history[0],
+          &p_sound->iir_first_pass_output_history[0],
+          &p_sound->iir_input_coefficients[0],
+          &p_sound->iir_output_coefficients[0]);
+      output_sample = iir_lowpass_apply(
+          output_sample,
+          &p_sound->iir_second_pass_input_history[0],
+          &p_sound->iir_second_pass_output_history[0],
+          &p_sound->iir_input_coefficients[0],
+          &p_sound->iir_output_coefficients[0]);
+      sample = (int32_t) output_sample;
+      if (sample > INT16_MAX) {
+        sample = INT16_MAX;
+      } else if (sample < INT16_MIN) {
+        sample = INT16_MIN;
+      }
+    }
+    p_sn_frames[sn_frames_filled + i] = sample;
+  }
+
+  p_sound->sn_frames_filled += num_frames;
+}
+
+static uint32_t
+sound_test_reference_resample(struct sound_struct* p_sound) {
+  uint32_t sn_frames_index;
+
+  int16_t* p_driver_frames = p_sound->p_driver_frames;
+  int16_t* p_sn_frames = p_sound->p_sn_frames;
+  double resample_count = p_sound->sn_frames_per_driver_frame;
+  uint32_t num_sn_frames = p_sound->sn_frames_filled;
+  uint32_t driver_buffer_size = p_sound->driver_buffer_size;
+  uint32_t driver_buffer_index = p_sound->driver_buffer_index;
+  uint32_t num_driver_frames_written = 0;
+
+  /* Carry-over from prevous resample chunk. */
+  double accumulated_value = p_sound->accumulated_value;
+  double accumulated_count = p_sound->accumulated_count;
+
+  /* Downsample it to host device rate via average of sample values.
+   * Sampled sound playback is very sensitive to the quality of downsampling,
+   * so even the splitting of the border sample value into fractions is
+   * important.
+   */
+  for (sn_frames_index = 0;
+       (sn_frames_index < num_sn_frames);
+       ++sn_frames_index) {
+    double leftover;
+    double this_sample_value = p_sn_frames[sn_frames_index];
+    accumulated_count++;
+    if (accumulated_count < resample_count) {
+      accumulated_value += this_sample_value;
+      continue;
+    }
+
+    leftover = (accumulated_count - resample_count);
+    accumulated_value += ((1.0 - leftover) * this_sample_value);
+
+    if (driver_buffer_index < driver_buffer_size) {
+      double average_sample_value = (accumulated_value / resample_count);
+      p_driver_frames[driver_buffer_index] = round(average_sample_value);
+      driver_buffer_index++;
+      num_driver_frames_written++;
+    }
+
+    accumulated_value = (leftover * this_sample_value);
+    accumulated_count = leftover;
+  }
+
+  /* Preserve resample state so we don't lose precision as we cross resample
+   * chunks.
+   */
+  p_sound->accumulated_value = accumulated_value;
+  p_sound->accumulated_count = accumulated_count;
+
+  p_sound->sn_frames_filled = 0;
+  p_sound->driver_buffer_index = driver_buffer_index;
+
+  return num_driver_frames_written;
+}
+
+static void
+sound_test_noop_record(void* p, int16_t* p_frames, uint32_t num_frames) {
+  (void) p;
+  (void) p_frames;
+  (void) num_frames;
+}
+
+static struct sound_struct*
+sound_test_create(const char* p_opt_flags) {
+  struct bbc_options options;
+  struct sound_struct* p_sound;
+
+  (void) memset(&options, '\0', sizeof(options));
+  options.p_opt_flags = p_opt_flags;
+  options.p_log_flags = "";
+  p_sound = sound_create(0, NULL, &options);
+  sound_set_record_callback(p_sound, 44100, sound_test_noop_record, NULL);
+  sound_power_on_reset(p_sound);
+
+  return p_sound;
+}
+
+static void
+sound_test_compare_state(struct sound_struct* p_sound,
+                         struct sound_struct* p_reference) {
+  uint32_t i;
+
+  for (i = 0; i < k_sound_num_channels; ++i) {
+    test_expect_u32(p_reference->counter[i], p_sound->counter[i]);
+    test_expect_u32(p_reference->output[i], p_sound->output[i]);
+  }
+  test_expect_u32(p_reference->noise_rng, p_sound->noise_rng);
+}
+
+static void
+sound_test_run(const char* p_opt_flags,
+               uint16_t* p_periods,
+               uint8_t* p_volumes,
+               int noise_type,
+               uint32_t max_error) {
+  /* Odd chunk sizes check state carries over between fills. */
+  static const uint32_t chunks[] = { 1, 2, 7, 1000, 5001, 3, 20000, 777 };
+  uint32_t i;
+  uint32_t j;
+
+  struct sound_struct* p_sound = sound_test_create(p_opt_flags);
+  struct sound_struct* p_reference = sound_test_create(p_opt_flags);
+
+  for (i = 0; i < (sizeof(chunks) / sizeof(chunks[0])); ++i) {
+    uint32_t num_frames = chunks[i];
+    uint32_t num_driver_frames;
+
+    sound_fill_sn76489_buffer(p_sound,
+                              num_frames,
+                              p_volumes,
+                              p_periods,
+                              p_sound->noise_rng,
+                              noise_type);
+    sound_test_reference_fill(p_reference,
+                              num_frames,
+                              p_volumes,
+                              p_periods,
+                              p_reference->noise_rng,
+                              noise_type);
+    sound_test_compare_state(p_sound, p_reference);
+    /* Synthesis and filtering do the same arithmetic in the same order, so
+     * they should be exact.
+     */
+    test_expect_u32(p_reference->sn_frames_filled, p_sound->sn_frames_filled);
+    test_expect_binary((uint8_t*) p_reference->p_sn_frames,
+                       (uint8_t*) p_sound->p_sn_frames,
+                       (num_frames * sizeof(int16_t)));
+
+    p_sound->driver_buffer_index = 0;
+    p_reference->driver_buffer_index = 0;
+    num_driver_frames = sound_resample_to_driver_buffer(p_sound);
+    test_expect_u32(sound_test_reference_resample(p_reference),
+                    num_driver_frames);
+    /* Resampling sums in a different order, so allow for rounding. */
+    for (j = 0; j < num_driver_frames; ++j) {
+      int32_t delta = (p_sound->p_driver_frames[j] -
+                       p_reference->p_driver_frames[j]);
+      if (delta < 0) {
+        delta = -delta;
+      }
+      test_expect_u32(1, ((uint32_t) delta <= max_error));
+    }
+  }
+
+  sound_destroy(p_sound);
+  sound_destroy(p_reference);
+}
+
+static void
+sound_test_batched_synthesis(void) {
+  uint16_t periods[4];
+  uint8_t volumes[4];
+
+  /* Power-on state: 0 periods are the 1024 tick maximum. */
+  periods[0] = 0;
+  periods[1] = 0;
+  periods[2] = 0;
+  periods[3] = 0x40;
+  volumes[0] = 0;
+  volumes[1] = 0;
+  volumes[2] = 0;
+  volumes[3] = 0;
+  sound_test_run("sound:filter_cutoff=0", periods, volumes, 0, 1);
+  sound_test_run("", periods, volumes, 0, 1);
+
+  /* Very short periods, including an expiry every tick. */
+  periods[0] = 1;
+  periods[1] = 2;
+  periods[2] = 3;
+  periods[3] = 0x10;
+  volumes[0] = 0;
+  volumes[1] = 4;
+  volumes[2] = 15;
+  volumes[3] = 7;
+  sound_test_run("sound:filter_cutoff=0", periods, volumes, 1, 1);
+  sound_test_run("", periods, volumes, 1, 1);
+
+  /* Typical tones, white noise, positive silence. */
+  periods[0] = 0x3ff;
+  periods[1] = 0x155;
+  periods[2] = 0x71;
+  periods[3] = 0x20;
+  volumes[0] = 2;
+  volumes[1] = 0;
+  volumes[2] = 9;
+  volumes[3] = 1;
+  sound_test_run("sound:filter_cutoff=0,sound:positive-silence",
+                 periods,
+                 volumes,
+                 1,
+                 1);
+  sound_test_run("sound:positive-silence", periods, volumes, 1, 1);
+  sound_test_run("", periods, volumes, 0, 1);
+}
+
+static void
+sound_test_ring(void) {
+  int16_t frames[16];
+  uint32_t i;
+  double base_ratio;
+
+  struct sound_struct* p_sound = sound_test_create("sound:ring");
+
+  test_expect_u32(1, p_sound->is_ring);
+  p_sound->ring_size = 8;
+  p_sound->ring_target_fill = 4;
+  p_sound->p_ring_frames = util_mallocz(8 * sizeof(int16_t));
+  p_sound->p_ring_pull_frames = util_mallocz(8 * sizeof(int16_t));
+
+  for (i = 0; i < 16; ++i) {
+    frames[i] = (i + 1);
+  }
+
+  /* Wrap around the end of the ring. */
+  sound_ring_push(p_sound, &frames[0], 6);
+  sound_ring_pull(p_sound, &frames[0], 4);
+  test_expect_u32(1, frames[0]);
+  test_expect_u32(4, frames[3]);
+  sound_ring_push(p_sound, &frames[0], 4);
+  test_expect_u32(6, sound_ring_get_fill(p_sound));
+  sound_ring_pull(p_sound, &frames[0], 6);
+  test_expect_u32(5, frames[0]);
+  test_expect_u32(6, frames[1]);
+  test_expect_u32(1, frames[2]);
+  test_expect_u32(4, frames[5]);
+  test_expect_u32(0, p_sound->ring_underrun_frames);
+
+  /* Overflow drops, rather than blocks. */
+  for (i = 0; i < 16; ++i) {
+    frames[i] = 100;
+  }
+  sound_ring_push(p_sound, &frames[0], 10);
+  test_expect_u32(8, sound_ring_get_fill(p_sound));
+  test_expect_u32(2, p_sound->ring_dropped_frames);
+
+  /* Underrun holds the last frame. */
+  sound_ring_pull(p_sound, &frames[0], 10);
+  test_expect_u32(100, frames[9]);
+  test_expect_u32(2, p_sound->ring_underrun_frames);
+  test_expect_u32(0, sound_ring_get_fill(p_sound));
+
+  /* Rate control: an empty ring slows consumption of emulated samples, a full
+   * one speeds it up, and on target leaves it alone.
+   */
+  base_ratio = ((double) k_sound_clock_rate / 44100);
+  sound_ring_adjust_resample_ratio(p_sound);
+  test_expect_u32(1, (p_sound->sn_frames_per_driver_frame < base_ratio));
+  sound_ring_push(p_sound, &frames[0], 4);
+  sound_ring_adjust_resample_ratio(p_sound);
+  test_expect_u32(1, (p_sound->sn_frames_per_driver_frame == base_ratio));
+  sound_ring_push(p_sound, &frames[0], 4);
+  sound_ring_adjust_resample_ratio(p_sound);
+  test_expect_u32(1, (p_sound->sn_frames_per_driver_frame > base_ratio));
+  test_expect_u32(1, (p_sound->sn_frames_per_driver_frame <=
+                      (base_ratio * (1.0 + k_sound_ring_max_drift))));
+
+  sound_destroy(p_sound);
+}
+
+void
+sound_test(void) {
+  sound_test_batched_synthesis();
+  sound_test_ring();
+}
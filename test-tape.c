@@ -0,0 +1,362 @@
+/* Appends at the end of tape.c. */
+
+#include "test.h"
+
+#include "mc6850.h"
+#include "state_6502.h"
+
+enum {
+  k_tape_test_max_bits = 200000,
+  k_tape_test_num_blocks = 24,
+};
+
+struct tape_test_env {
+  struct timing_struct* p_timing;
+  uint8_t* p_mem;
+  struct state_6502* p_state_6502;
+  struct mc6850_struct* p_serial;
+  struct tape_struct* p_tape;
+  struct serial_ula_struct* p_serial_ula;
+};
+
+static uint32_t s_tape_test_rand = 0x1200;
+static int8_t s_tape_test_bits[k_tape_test_max_bits];
+static uint32_t s_tape_test_num_bits;
+
+static uint32_t
+tape_test_rand(void) {
+  return test_rand(&s_tape_test_rand);
+}
+
+static void
+tape_test_add_bits(struct tape_struct* p_tape,
+                   int8_t bit,
+                   uint32_t num_bits) {
+  uint32_t i;
+
+  assert((s_tape_test_num_bits + num_bits) <= k_tape_test_max_bits);
+  for (i = 0; i < num_bits; ++i) {
+    s_tape_test_bits[s_tape_test_num_bits++] = bit;
+  }
+  tape_add_bits(p_tape, bit, num_bits);
+}
+
+static void
+tape_test_add_bit(struct tape_struct* p_tape, int8_t bit) {
+  assert(s_tape_test_num_bits < k_tape_test_max_bits);
+  s_tape_test_bits[s_tape_test_num_bits++] = bit;
+  tape_add_bit(p_tape, bit);
+}
+
+static void
+tape_test_add_byte(struct tape_struct* p_tape, uint8_t byte) {
+  uint32_t i;
+
+  assert((s_tape_test_num_bits + 10) <= k_tape_test_max_bits);
+  s_tape_test_bits[s_tape_test_num_bits++] = k_tape_bit_0;
+  for (i = 0; i < 8; ++i) {
+    s_tape_test_bits[s_tape_test_num_bits++] = ((byte >> i) & 1);
+  }
+  s_tape_test_bits[s_tape_test_num_bits++] = k_tape_bit_1;
+  tape_add_byte(p_tape, byte);
+}
+
+static uint32_t
+tape_test_count_chunks(struct tape_struct* p_tape,
+                       uint32_t tape_index,
+                       uint32_t type) {
+  uint32_t i;
+  uint32_t count = 0;
+
+  for (i = 0; i < p_tape->num_tape_chunks[tape_index]; ++i) {
+    if (tape_chunk_get_type(p_tape->p_tape_chunks[tape_index][i]) == type) {
+      count++;
+    }
+  }
+  return count;
+}
+
+static void
+tape_test_round_trip(struct tape_struct* p_tape) {
+  /* Carrier, framed bytes, silence and loose bits, including frames broken
+   * mid byte, all read back exactly as they were added.
+   */
+  uint32_t i;
+  uint32_t num_bytes = 0;
+
+  s_tape_test_num_bits = 0;
+  tape_build_start(p_tape);
+
+  while (s_tape_test_num_bits < (k_tape_test_max_bits - 1000)) {
+    uint32_t j;
+    uint32_t num;
+    switch (tape_test_rand() % 6) {
+    case 0:
+      /* Carrier, sometimes long enough to have settled. */
+      tape_test_add_bits(p_tape, k_tape_bit_1, (1 + (tape_test_rand() % 600)));
+      break;
+    case 1:
+      num = (1 + (tape_test_rand() % 32));
+      for (j = 0; j < num; ++j) {
+        tape_test_add_byte(p_tape, tape_test_rand());
+      }
+      num_bytes += num;
+      break;
+    case 2:
+      tape_test_add_bits(p_tape,
+                         k_tape_bit_silence,
+                         (1 + (tape_test_rand() % 300)));
+      break;
+    case 3:
+      /* A frame broken off mid byte by silence. */
+      tape_test_add_bit(p_tape, k_tape_bit_0);
+      num = (tape_test_rand() % 8);
+      for (j = 0; j < num; ++j) {
+        tape_test_add_bit(p_tape, (tape_test_rand() & 1));
+      }
+      tape_test_add_bit(p_tape, k_tape_bit_silence);
+      break;
+    case 4:
+      /* A frame with a bad stop bit, so framing must retry from the bit
+       * after its start bit.
+       */
+      tape_test_add_bit(p_tape, k_tape_bit_0);
+      for (j = 0; j < 8; ++j) {
+        tape_test_add_bit(p_tape, (tape_test_rand() & 1));
+      }
+      tape_test_add_bit(p_tape, k_tape_bit_0);
+      break;
+    default:
+      /* Runs of 0s, added in one go. */
+      tape_test_add_bits(p_tape, k_tape_bit_0, (1 + (tape_test_rand() % 20)));
+      break;
+    }
+  }
+  tape_build_finish(p_tape, "round trip");
+
+  p_tape->tape_index = (p_tape->tapes_added - 1);
+  tape_rewind(p_tape);
+  test_expect_u32(s_tape_test_num_bits,
+                  p_tape->num_tape_bits[p_tape->tape_index]);
+  for (i = 0; i < s_tape_test_num_bits; ++i) {
+    test_expect_u32((uint8_t) s_tape_test_bits[i],
+                    (uint8_t) tape_next_bit(p_tape));
+  }
+  test_expect_u32(p_tape->num_tape_chunks[p_tape->tape_index],
+                  p_tape->chunk_index);
+
+  /* Every whole byte was found as a frame, even after a broken one. */
+  test_expect_u32(1,
+                  (tape_test_count_chunks(p_tape,
+                                          p_tape->tape_index,
+                                          k_tape_chunk_frame) >= num_bytes));
+}
+
+static void
+tape_test_long_carrier(struct tape_struct* p_tape) {
+  /* A carrier longer than a chunk can hold spans two chunks, added in two
+   * parts, and reads back seamlessly across the chunk boundary.
+   */
+  int8_t bits[64];
+  uint32_t num_bits;
+  uint32_t i;
+  uint32_t last_chunk = 0;
+  uint32_t last_offset = 0;
+  uint32_t num_first = (k_tape_chunk_max_run - 20);
+
+  tape_build_start(p_tape);
+  tape_add_bits(p_tape, k_tape_bit_1, num_first);
+  tape_add_bits(p_tape, k_tape_bit_1, 40);
+  tape_add_byte(p_tape, 0x00);
+  tape_build_finish(p_tape, "long carrier");
+
+  p_tape->tape_index = (p_tape->tapes_added - 1);
+  tape_rewind(p_tape);
+  test_expect_u32(3, p_tape->num_tape_chunks[p_tape->tape_index]);
+  test_expect_u32(k_tape_chunk_max_run,
+                  tape_chunk_get_num_bits(p_tape->p_tape_chunks[
+                      p_tape->tape_index][0]));
+
+  /* Peek from 10 bits before the chunk boundary. */
+  p_tape->chunk_offset = (k_tape_chunk_max_run - 10);
+  num_bits = tape_peek_bits(p_tape,
+                            &bits[0],
+                            64,
+                            &last_chunk,
+                            &last_offset);
+  test_expect_u32(10 + 20 + 10, num_bits);
+  for (i = 0; i < 30; ++i) {
+    test_expect_u32(k_tape_bit_1, bits[i]);
+  }
+  for (i = 30; i < 39; ++i) {
+    test_expect_u32(k_tape_bit_0, bits[i]);
+  }
+  test_expect_u32(k_tape_bit_1, bits[39]);
+  test_expect_u32(2, last_chunk);
+  test_expect_u32((k_tape_chunk_frame_bits - 1), last_offset);
+}
+
+static void
+tape_test_env_create(struct tape_test_env* p_env, const char* p_opt_flags) {
+  /* A tape wired to its own serial ULA and ACIA, as in a BBC. */
+  struct bbc_options options;
+
+  (void) memset(&options, '\0', sizeof(options));
+  options.p_opt_flags = p_opt_flags;
+  options.p_log_flags = "";
+  p_env->p_timing = timing_create(1);
+  p_env->p_mem = util_mallocz(0x10000);
+  p_env->p_state_6502 = state_6502_create(p_env->p_timing, p_env->p_mem);
+  p_env->p_serial = mc6850_create(p_env->p_state_6502, &options);
+  p_env->p_tape = tape_create(p_env->p_timing, &options);
+  p_env->p_serial_ula = serial_ula_create(p_env->p_serial,
+                                          p_env->p_tape,
+                                          0,
+                                          &options);
+  mc6850_power_on_reset(p_env->p_serial);
+  serial_ula_power_on_reset(p_env->p_serial_ula);
+}
+
+static void
+tape_test_env_destroy(struct tape_test_env* p_env) {
+  serial_ula_destroy(p_env->p_serial_ula);
+  tape_destroy(p_env->p_tape);
+  mc6850_destroy(p_env->p_serial);
+  state_6502_destroy(p_env->p_state_6502);
+  util_free(p_env->p_mem);
+  timing_destroy(p_env->p_timing);
+}
+
+static void
+tape_test_build_blocks(struct tape_struct* p_tape) {
+  /* Carrier tones long enough to raise DCD, blocks of bytes, the odd broken
+   * frame and some silences. Seeded, so every build is the same tape.
+   */
+  uint32_t i;
+  uint32_t j;
+
+  s_tape_test_rand = 0x3400;
+  s_tape_test_num_bits = 0;
+  tape_build_start(p_tape);
+  for (i = 0; i < k_tape_test_num_blocks; ++i) {
+    uint32_t num_bytes = (1 + (tape_test_rand() % 96));
+    tape_test_add_bits(p_tape, k_tape_bit_1, (200 + (tape_test_rand() % 2000)));
+    for (j = 0; j < num_bytes; ++j) {
+      tape_test_add_byte(p_tape, tape_test_rand());
+      if ((tape_test_rand() % 16) == 0) {
+        /* Extra stop bits. */
+        tape_test_add_bits(p_tape, k_tape_bit_1, (1 + (tape_test_rand() % 4)));
+      }
+    }
+    if ((tape_test_rand() % 4) == 0) {
+      tape_test_add_bit(p_tape, k_tape_bit_0);
+      tape_test_add_bits(p_tape,
+                         k_tape_bit_silence,
+                         (1 + (tape_test_rand() % 1000)));
+    }
+  }
+  tape_test_add_bits(p_tape, k_tape_bit_1, 1000);
+  tape_build_finish(p_tape, "blocks");
+
+  p_tape->tape_index = (p_tape->tapes_added - 1);
+  tape_rewind(p_tape);
+}
+
+static void
+tape_test_fast_load_lockstep(void) {
+  /* Fast load predicts, via a dry run of the serial ULA and ACIA, how many
+   * bits it can deliver before the CPU would see a change. Run it in lockstep
+   * with the bit at a time path, with a CPU polling the ACIA and rewriting
+   * its settings, which makes tape_sync() split batches. The CPU must not be
+   * able to tell the difference.
+   */
+  static const uint8_t s_acia_controls[] = {
+    0x03, 0x15, 0x16, 0x95, 0x96, 0x11, 0x09,
+  };
+  struct tape_test_env slow;
+  struct tape_test_env fast;
+  uint64_t num_bits;
+  uint32_t num_sync_writes = 0;
+  uint32_t num_bytes_read = 0;
+
+  tape_test_env_create(&slow, "");
+  tape_test_env_create(&fast, "tape:fast-load");
+  tape_test_build_blocks(slow.p_tape);
+  tape_test_build_blocks(fast.p_tape);
+  num_bits = slow.p_tape->num_tape_bits[slow.p_tape->tape_index];
+
+  s_tape_test_rand = 0x5600;
+  mc6850_write(slow.p_serial, 0, 0x16);
+  mc6850_write(fast.p_serial, 0, 0x16);
+  /* Motor on, tape selected. */
+  serial_ula_write(slow.p_serial_ula, 0x85);
+  serial_ula_write(fast.p_serial_ula, 0x85);
+
+  /* Stop short of the end, where running out of tape stops the motor. */
+  while (slow.p_tape->tape_buffer_pos < (num_bits - 100)) {
+    uint32_t action;
+    uint8_t slow_status;
+    uint8_t fast_status;
+    uint64_t delta = (1 + (tape_test_rand() % 3000));
+
+    (void) timing_advance_time_delta(slow.p_timing, delta);
+    (void) timing_advance_time_delta(fast.p_timing, delta);
+
+    slow_status = mc6850_read(slow.p_serial, 0);
+    fast_status = mc6850_read(fast.p_serial, 0);
+    test_expect_u32(slow_status, fast_status);
+
+    action = (tape_test_rand() % 1024);
+    if (action < 768) {
+      /* Read the data register, mostly when something was received. */
+      if ((action < 64) || (slow_status & 0x01)) {
+        test_expect_u32(mc6850_read(slow.p_serial, 1),
+                        mc6850_read(fast.p_serial, 1));
+        num_bytes_read++;
+      }
+    } else if (action < 772) {
+      uint8_t val = s_acia_controls[tape_test_rand() %
+                                    sizeof(s_acia_controls)];
+      tape_sync(slow.p_tape);
+      mc6850_write(slow.p_serial, 0, val);
+      tape_sync(fast.p_tape);
+      mc6850_write(fast.p_serial, 0, val);
+      num_sync_writes++;
+    } else if (action < 774) {
+      /* Flip between tape and RS423, leaving the motor running. */
+      uint8_t val = ((tape_test_rand() & 1) ? 0xC5 : 0x85);
+      serial_ula_write(slow.p_serial_ula, val);
+      serial_ula_write(fast.p_serial_ula, val);
+      num_sync_writes++;
+    }
+  }
+
+  test_expect_u32(1, (num_sync_writes > 100));
+  test_expect_u32(1, (num_bytes_read > 1000));
+  /* And the fast path really did batch. */
+  test_expect_u32(1, ((fast.p_tape->run_batches * 4) <
+                      slow.p_tape->run_batches));
+
+  tape_test_env_destroy(&slow);
+  tape_test_env_destroy(&fast);
+}
+
+void
+tape_test(void) {
+  struct bbc_options options;
+  struct timing_struct* p_timing = timing_create(1);
+  struct tape_struct* p_tape;
+
+  (void) memset(&options, '\0', sizeof(options));
+  options.p_opt_flags = "";
+  options.p_log_flags = "";
+  p_tape = tape_create(p_timing, &options);
+
+  tape_test_round_trip(p_tape);
+  tape_test_long_carrier(p_tape);
+
+  tape_destroy(p_tape);
+  timing_destroy(p_timing);
+
+  tape_test_fast_load_lockstep();
+}
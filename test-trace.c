@@ -0,0 +1,127 @@
+/* Appends at the end of trace.c. */
+
+#include "test.h"
+
+enum {
+  k_trace_test_max_lines = 8,
+};
+
+static const char* k_trace_test_file_name = "test_trace.trc";
+
+static uint8_t s_trace_test_mem[k_6502_addr_space_size];
+static struct trace_decode_line s_trace_test_lines[k_trace_test_max_lines];
+static uint32_t s_trace_test_num_lines;
+
+static void
+trace_test_line_callback(void* p,
+                         struct trace_decode_line* p_line,
+                         uint8_t* p_optypes,
+                         uint8_t* p_opmodes) {
+  (void) p;
+  (void) p_optypes;
+  (void) p_opmodes;
+
+  assert(s_trace_test_num_lines < k_trace_test_max_lines);
+  s_trace_test_lines[s_trace_test_num_lines++] = *p_line;
+}
+
+static void
+trace_test_round_trip(void) {
+  /* A normal instruction, a store interrupted by an IRQ, and a JMP away from
+   * the IRQ handler, decoded back to what was traced.
+   */
+  struct trace_decode_line* p_line;
+  struct trace_struct* p_trace;
+  uint8_t* p_mem = &s_trace_test_mem[0];
+
+  (void) memset(p_mem, '\0', k_6502_addr_space_size);
+  /* LDA #$01; STA $70. */
+  p_mem[0x1000] = 0xA9;
+  p_mem[0x1001] = 0x01;
+  p_mem[0x1002] = 0x85;
+  p_mem[0x1003] = 0x70;
+  /* JMP $3000. */
+  p_mem[0xE000] = 0x4C;
+  p_mem[0xE001] = 0x00;
+  p_mem[0xE002] = 0x30;
+  /* NOP. */
+  p_mem[0x3000] = 0xEA;
+
+  p_trace = trace_create(k_trace_test_file_name, 0, "");
+  trace_instruction(p_trace, p_mem, 0x1000, 0,
+                    0x00, 0x00, 0x00, 0xFF, 0x20,
+                    0, 0x0000, 0x00,
+                    100);
+  trace_instruction(p_trace, p_mem, 0x1002, 0,
+                    0x01, 0x00, 0x00, 0xFF, 0x20,
+                    1, 0x1001, 0x01,
+                    102);
+  /* The IRQ record carries the STA's write. */
+  trace_instruction(p_trace, p_mem, 0x1004, 1,
+                    0x01, 0x00, 0x00, 0xFF, 0x20,
+                    1, 0x0070, 0x01,
+                    105);
+  trace_instruction(p_trace, p_mem, 0xE000, 0,
+                    0x01, 0x00, 0x00, 0xFC, 0x24,
+                    1, 0x01FD, 0x20,
+                    112);
+  trace_instruction(p_trace, p_mem, 0x3000, 0,
+                    0x01, 0x00, 0x00, 0xFC, 0x24,
+                    1, 0x3000, 0x00,
+                    115);
+  trace_destroy(p_trace);
+
+  s_trace_test_num_lines = 0;
+  trace_decode_lines(k_trace_test_file_name, trace_test_line_callback, NULL);
+  (void) remove(k_trace_test_file_name);
+
+  test_expect_u32(5, s_trace_test_num_lines);
+
+  p_line = &s_trace_test_lines[0];
+  test_expect_u32(0x1000, p_line->pc);
+  test_expect_u32((k_trace_code_valid | 0x01A9), p_line->code);
+  test_expect_u32(0, p_line->is_irq);
+  test_expect_u32(0x00, p_line->a);
+  test_expect_u32(0xFF, p_line->s);
+  test_expect_u32(0x20, p_line->flags);
+  test_expect_u32(100, p_line->ticks);
+  test_expect_u32(0, p_line->has_mem);
+
+  p_line = &s_trace_test_lines[1];
+  test_expect_u32(0x1002, p_line->pc);
+  test_expect_u32((k_trace_code_valid | 0x7085), p_line->code);
+  test_expect_u32(0, p_line->is_irq);
+  test_expect_u32(0x01, p_line->a);
+  test_expect_u32(102, p_line->ticks);
+  test_expect_u32(1, p_line->has_mem);
+  test_expect_u32(0x0070, p_line->mem_addr);
+  test_expect_u32(0x01, p_line->mem_val);
+
+  p_line = &s_trace_test_lines[2];
+  test_expect_u32(0x1004, p_line->pc);
+  test_expect_u32(1, p_line->is_irq);
+  test_expect_u32(105, p_line->ticks);
+  test_expect_u32(0, p_line->has_mem);
+
+  p_line = &s_trace_test_lines[3];
+  test_expect_u32(0xE000, p_line->pc);
+  test_expect_u32((k_trace_code_valid | 0x30004C), p_line->code);
+  test_expect_u32(0, p_line->is_irq);
+  test_expect_u32(0xFC, p_line->s);
+  test_expect_u32(0x24, p_line->flags);
+  test_expect_u32(112, p_line->ticks);
+  test_expect_u32(0, p_line->has_mem);
+
+  p_line = &s_trace_test_lines[4];
+  test_expect_u32(0x3000, p_line->pc);
+  test_expect_u32((k_trace_code_valid | 0xEA), p_line->code);
+  test_expect_u32(0, p_line->is_irq);
+  test_expect_u32(0x01, p_line->a);
+  test_expect_u32(115, p_line->ticks);
+  test_expect_u32(0, p_line->has_mem);
+}
+
+void
+trace_test(void) {
+  trace_test_round_trip();
+}
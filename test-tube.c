@@ -0,0 +1,285 @@
+/* Appends at the end of tube.c. */
+
+#include "test.h"
+
+static struct tube_struct* s_p_tube;
+static uint8_t* s_p_tube_test_host_mem;
+
+static void
+tube_test_null_callback(void* p) {
+  (void) p;
+}
+
+static void
+tube_test_before(void) {
+  /* Just the ULA and the two interrupt line owners: no parasite thread. */
+  struct tube_struct* p_tube = util_mallocz(sizeof(struct tube_struct));
+
+  s_p_tube_test_host_mem = util_mallocz(0x10000);
+  p_tube->p_lock = os_lock_create();
+  p_tube->p_host_timing = timing_create(1);
+  p_tube->p_host_state_6502 = state_6502_create(p_tube->p_host_timing,
+                                                s_p_tube_test_host_mem);
+  p_tube->host_timer_id = timing_register_timer(p_tube->p_host_timing,
+                                                "tube_host_sync",
+                                                tube_test_null_callback,
+                                                p_tube);
+  p_tube->p_mem = util_mallocz(0x10000);
+  p_tube->p_timing = timing_create(1);
+  p_tube->p_state_6502 = state_6502_create(p_tube->p_timing, p_tube->p_mem);
+
+  tube_reset_fifos(p_tube);
+  tube_update_interrupts(p_tube);
+  s_p_tube = p_tube;
+}
+
+static void
+tube_test_after(void) {
+  struct tube_struct* p_tube = s_p_tube;
+
+  state_6502_destroy(p_tube->p_state_6502);
+  timing_destroy(p_tube->p_timing);
+  util_free(p_tube->p_mem);
+  state_6502_destroy(p_tube->p_host_state_6502);
+  timing_destroy(p_tube->p_host_timing);
+  os_lock_destroy(p_tube->p_lock);
+  util_free(p_tube);
+  util_free(s_p_tube_test_host_mem);
+  s_p_tube = NULL;
+}
+
+static void
+tube_test_reset_state(void) {
+  struct tube_struct* p_tube;
+
+  tube_test_before();
+  p_tube = s_p_tube;
+
+  /* Room to write everywhere, and R3 has a byte waiting for the host. */
+  test_expect_u32(0x40, tube_host_read(p_tube, 0));
+  test_expect_u32(0x40, tube_host_read(p_tube, 2));
+  test_expect_u32(0xC0, tube_host_read(p_tube, 4));
+  test_expect_u32(0x40, tube_host_read(p_tube, 6));
+  test_expect_u32(0x40, tube_parasite_read_reg(p_tube, 0));
+  test_expect_u32(0x40, tube_parasite_read_reg(p_tube, 2));
+  test_expect_u32(0x40, tube_parasite_read_reg(p_tube, 4));
+  test_expect_u32(0x40, tube_parasite_read_reg(p_tube, 6));
+
+  /* R1 flags are set and cleared by bit 7 and read back in the status. */
+  tube_host_write(p_tube, 0, (0x80 | k_tube_r1_J | k_tube_r1_I));
+  test_expect_u32((0x40 | k_tube_r1_J | k_tube_r1_I),
+                  tube_host_read(p_tube, 0));
+  tube_host_write(p_tube, 0, k_tube_r1_I);
+  test_expect_u32((0x40 | k_tube_r1_J), tube_parasite_read_reg(p_tube, 0));
+
+  /* T clears the FIFOs. */
+  tube_parasite_write_reg(p_tube, 1, 0x11);
+  tube_host_write(p_tube, 3, 0x22);
+  tube_host_write(p_tube, 0, (0x80 | k_tube_r1_T));
+  test_expect_u32(0x40, (tube_host_read(p_tube, 0) & 0xC0));
+  test_expect_u32(0x40, tube_parasite_read_reg(p_tube, 2));
+
+  tube_test_after();
+}
+
+static void
+tube_test_r1_fifo(void) {
+  /* Parasite to host R1 holds 24 bytes, in order. */
+  struct tube_struct* p_tube;
+  uint32_t i;
+
+  tube_test_before();
+  p_tube = s_p_tube;
+
+  for (i = 0; i < k_tube_ph1_fifo_size; ++i) {
+    test_expect_u32(0x40, (tube_parasite_read_reg(p_tube, 0) & 0xC0));
+    tube_parasite_write_reg(p_tube, 1, (0x30 + i));
+    test_expect_u32(0x80, (tube_host_read(p_tube, 0) & 0x80));
+  }
+  /* Full: no room, and further bytes are dropped. */
+  test_expect_u32(0, (tube_parasite_read_reg(p_tube, 0) & 0x40));
+  tube_parasite_write_reg(p_tube, 1, 0xFF);
+
+  for (i = 0; i < k_tube_ph1_fifo_size; ++i) {
+    test_expect_u32(0x80, (tube_host_read(p_tube, 0) & 0x80));
+    test_expect_u32((0x30 + i), tube_host_read(p_tube, 1));
+    test_expect_u32(0x40, (tube_parasite_read_reg(p_tube, 0) & 0x40));
+  }
+  test_expect_u32(0, (tube_host_read(p_tube, 0) & 0x80));
+
+  /* Host to parasite R1 is a single byte latch. */
+  tube_host_write(p_tube, 1, 0x5A);
+  test_expect_u32(0, (tube_host_read(p_tube, 0) & 0x40));
+  test_expect_u32(0xC0, (tube_parasite_read_reg(p_tube, 0) & 0xC0));
+  test_expect_u32(0x5A, tube_parasite_read_reg(p_tube, 1));
+  test_expect_u32(0x40, (tube_parasite_read_reg(p_tube, 0) & 0xC0));
+  test_expect_u32(0x40, (tube_host_read(p_tube, 0) & 0x40));
+
+  tube_test_after();
+}
+
+static void
+tube_test_r2_r4_latches(void) {
+  struct tube_struct* p_tube;
+
+  tube_test_before();
+  p_tube = s_p_tube;
+
+  tube_parasite_write_reg(p_tube, 3, 0x12);
+  test_expect_u32(0xC0, tube_host_read(p_tube, 2));
+  test_expect_u32(0x00, tube_parasite_read_reg(p_tube, 2));
+  /* A second write overwrites the latch. */
+  tube_parasite_write_reg(p_tube, 3, 0x34);
+  test_expect_u32(0x34, tube_host_read(p_tube, 3));
+  test_expect_u32(0x40, tube_host_read(p_tube, 2));
+  test_expect_u32(0x40, tube_parasite_read_reg(p_tube, 2));
+
+  tube_host_write(p_tube, 7, 0x56);
+  test_expect_u32(0x00, tube_host_read(p_tube, 6));
+  test_expect_u32(0xC0, tube_parasite_read_reg(p_tube, 6));
+  test_expect_u32(0x56, tube_parasite_read_reg(p_tube, 7));
+  test_expect_u32(0x40, tube_parasite_read_reg(p_tube, 6));
+  test_expect_u32(0x40, tube_host_read(p_tube, 6));
+
+  tube_test_after();
+}
+
+static void
+tube_test_r3_fifo(void) {
+  /* R3 is one byte, or two with V set, in each direction. */
+  struct tube_struct* p_tube;
+
+  tube_test_before();
+  p_tube = s_p_tube;
+
+  /* Drain the byte that's there after reset. */
+  (void) tube_host_read(p_tube, 5);
+  test_expect_u32(0x40, tube_host_read(p_tube, 4));
+
+  tube_host_write(p_tube, 5, 0x01);
+  test_expect_u32(0x80, (tube_parasite_read_reg(p_tube, 4) & 0x80));
+  test_expect_u32(0x01, tube_parasite_read_reg(p_tube, 5));
+  test_expect_u32(0x00, (tube_parasite_read_reg(p_tube, 4) & 0x80));
+
+  tube_host_write(p_tube, 0, (0x80 | k_tube_r1_V));
+  tube_host_write(p_tube, 5, 0xA1);
+  test_expect_u32(0x00, (tube_parasite_read_reg(p_tube, 4) & 0x80));
+  tube_host_write(p_tube, 5, 0xA2);
+  test_expect_u32(0x80, (tube_parasite_read_reg(p_tube, 4) & 0x80));
+  test_expect_u32(0x00, (tube_host_read(p_tube, 4) & 0x40));
+  test_expect_u32(0xA1, tube_parasite_read_reg(p_tube, 5));
+  test_expect_u32(0xA2, tube_parasite_read_reg(p_tube, 5));
+  test_expect_u32(0x40, (tube_host_read(p_tube, 4) & 0x40));
+
+  tube_parasite_write_reg(p_tube, 5, 0xB1);
+  test_expect_u32(0x00, (tube_host_read(p_tube, 4) & 0x80));
+  tube_parasite_write_reg(p_tube, 5, 0xB2);
+  test_expect_u32(0x80, (tube_host_read(p_tube, 4) & 0x80));
+  test_expect_u32(0xB1, tube_host_read(p_tube, 5));
+  test_expect_u32(0x80, (tube_host_read(p_tube, 4) & 0x80));
+  test_expect_u32(0xB2, tube_host_read(p_tube, 5));
+  test_expect_u32(0x00, (tube_host_read(p_tube, 4) & 0x80));
+
+  tube_test_after();
+}
+
+static void
+tube_test_interrupts(void) {
+  struct tube_struct* p_tube;
+  struct state_6502* p_host_state_6502;
+  struct state_6502* p_state_6502;
+
+  tube_test_before();
+  p_tube = s_p_tube;
+  p_host_state_6502 = p_tube->p_host_state_6502;
+  p_state_6502 = p_tube->p_state_6502;
+
+  /* Host IRQ from R4, only with Q set. The sync timer only runs then. */
+  tube_parasite_write_reg(p_tube, 7, 0x01);
+  (void) tube_host_read(p_tube, 6);
+  test_expect_u32(0, state_6502_get_irq_level(p_host_state_6502,
+                                              k_state_6502_irq_tube));
+  test_expect_u32(0, timing_timer_is_running(p_tube->p_host_timing,
+                                             p_tube->host_timer_id));
+  tube_host_write(p_tube, 0, (0x80 | k_tube_r1_Q));
+  test_expect_u32(1, state_6502_get_irq_level(p_host_state_6502,
+                                              k_state_6502_irq_tube));
+  test_expect_u32(1, timing_timer_is_running(p_tube->p_host_timing,
+                                             p_tube->host_timer_id));
+  (void) tube_host_read(p_tube, 7);
+  test_expect_u32(0, state_6502_get_irq_level(p_host_state_6502,
+                                              k_state_6502_irq_tube));
+  tube_host_write(p_tube, 0, k_tube_r1_Q);
+  test_expect_u32(0, timing_timer_is_running(p_tube->p_host_timing,
+                                             p_tube->host_timer_id));
+
+  /* Parasite IRQ from R1 with I, and from R4 with J. The parasite picks up
+   * its lines on its own accesses.
+   */
+  tube_host_write(p_tube, 0, (0x80 | k_tube_r1_I | k_tube_r1_J));
+  tube_host_write(p_tube, 1, 0x01);
+  test_expect_u32(1, p_tube->parasite_irq);
+  (void) tube_parasite_read_reg(p_tube, 0);
+  test_expect_u32(1, state_6502_get_irq_level(p_state_6502,
+                                              k_state_6502_irq_tube));
+  (void) tube_parasite_read_reg(p_tube, 1);
+  test_expect_u32(0, p_tube->parasite_irq);
+  test_expect_u32(0, state_6502_get_irq_level(p_state_6502,
+                                              k_state_6502_irq_tube));
+  tube_host_write(p_tube, 7, 0x01);
+  test_expect_u32(1, p_tube->parasite_irq);
+  (void) tube_parasite_read_reg(p_tube, 7);
+  test_expect_u32(0, p_tube->parasite_irq);
+
+  /* Parasite NMI from R3 with M: asserted while the parasite has room to
+   * write, or something to read.
+   */
+  (void) tube_host_read(p_tube, 5);
+  tube_parasite_write_reg(p_tube, 5, 0x01);
+  tube_host_write(p_tube, 0, (0x80 | k_tube_r1_M));
+  test_expect_u32(0, p_tube->parasite_nmi);
+  tube_host_write(p_tube, 5, 0x02);
+  test_expect_u32(1, p_tube->parasite_nmi);
+  (void) tube_parasite_read_reg(p_tube, 5);
+  test_expect_u32(0, p_tube->parasite_nmi);
+  (void) tube_host_read(p_tube, 5);
+  test_expect_u32(1, p_tube->parasite_nmi);
+
+  tube_test_after();
+}
+
+static void
+tube_test_host_sync_backoff(void) {
+  /* The host sync period grows while the parasite is quiet, and snaps back
+   * when it writes.
+   */
+  struct tube_struct* p_tube;
+  uint32_t i;
+
+  tube_test_before();
+  p_tube = s_p_tube;
+
+  tube_host_write(p_tube, 0, (0x80 | k_tube_r1_Q));
+  test_expect_u32(k_tube_host_sync_cycles, p_tube->host_sync_cycles);
+  for (i = 0; i < 16; ++i) {
+    tube_host_timer_callback(p_tube);
+  }
+  test_expect_u32(k_tube_host_max_sync_cycles, p_tube->host_sync_cycles);
+  tube_parasite_write_reg(p_tube, 7, 0x01);
+  tube_host_timer_callback(p_tube);
+  test_expect_u32(k_tube_host_sync_cycles, p_tube->host_sync_cycles);
+  test_expect_u32(1, state_6502_get_irq_level(p_tube->p_host_state_6502,
+                                              k_state_6502_irq_tube));
+
+  tube_test_after();
+}
+
+void
+tube_test(void) {
+  tube_test_reset_state();
+  tube_test_r1_fifo();
+  tube_test_r2_r4_latches();
+  tube_test_r3_fifo();
+  tube_test_interrupts();
+  tube_test_host_sync_backoff();
+}
@@ -0,0 +1,274 @@
+/* Appends at the end of util_compress.c. */
+
+#include "test.h"
+
+#include "bbc_options.h"
+#include "disc.h"
+#include "disc_tool.h"
+
+enum {
+  k_util_compress_test_num_tracks = 3,
+  k_util_compress_test_track_size = 2560,
+  k_util_compress_test_image_size =
+      (k_util_compress_test_num_tracks * k_util_compress_test_track_size),
+};
+
+static const char* s_p_util_compress_test_gz = "beebjit_test.ssd.gz";
+static const char* s_p_util_compress_test_zip = "beebjit_test.zip";
+static const char* s_p_util_compress_test_bad_size_gz =
+    "beebjit_test_bad_size.ssd.gz";
+
+static uint8_t s_util_compress_test_image[k_util_compress_test_image_size];
+
+static uint32_t
+util_compress_test_deflate(uint8_t* p_dst) {
+  /* Raw deflate data is what's inside a zlib stream, minus the 2 byte header
+   * and the 4 byte Adler-32 trailer.
+   */
+  uint8_t* p_zlib;
+  size_t len = util_compress_bound(k_util_compress_test_image_size);
+  uint32_t ret;
+
+  p_zlib = util_malloc(len);
+  test_expect_u32(0, util_compress(&len,
+                                   &s_util_compress_test_image[0],
+                                   k_util_compress_test_image_size,
+                                   p_zlib,
+                                   1));
+  ret = (len - 6);
+  (void) memcpy(p_dst, (p_zlib + 2), ret);
+  util_free(p_zlib);
+
+  return ret;
+}
+
+static uint32_t
+util_compress_test_image_crc32(void) {
+  uint32_t crc = util_crc32_init();
+  crc = util_crc32_add(crc,
+                       &s_util_compress_test_image[0],
+                       k_util_compress_test_image_size);
+  return util_crc32_finish(crc);
+}
+
+static void
+util_compress_test_write_file(const char* p_file_name,
+                              uint8_t* p_buf,
+                              uint32_t len) {
+  struct util_file* p_file = util_file_open(p_file_name, 1, 1);
+  util_file_write(p_file, p_buf, len);
+  util_file_close(p_file);
+}
+
+static void
+util_compress_test_write_gz(void) {
+  uint8_t* p_buf;
+  uint32_t len;
+
+  p_buf = util_mallocz(
+      util_compress_bound(k_util_compress_test_image_size) + 18);
+  /* Magic, deflate, no flags, no mtime, no extra flags, unknown OS. */
+  p_buf[0] = 0x1F;
+  p_buf[1] = 0x8B;
+  p_buf[2] = 8;
+  p_buf[9] = 0xFF;
+  len = 10;
+  len += util_compress_test_deflate(p_buf + len);
+  util_write_le32((p_buf + len), util_compress_test_image_crc32());
+  len += 4;
+  util_write_le32((p_buf + len), k_util_compress_test_image_size);
+  len += 4;
+
+  util_compress_test_write_file(s_p_util_compress_test_gz, p_buf, len);
+  util_free(p_buf);
+}
+
+static void
+util_compress_test_write_zip(void) {
+  /* A single deflated member, then the central directory and its end
+   * record.
+   */
+  static const char* p_name = "DISC.SSD";
+  uint8_t* p_buf;
+  uint32_t len;
+  uint32_t data_len;
+  uint32_t central_pos;
+  uint32_t name_len = strlen(p_name);
+  uint32_t crc = util_compress_test_image_crc32();
+
+  p_buf = util_mallocz(
+      util_compress_bound(k_util_compress_test_image_size) + 256);
+  util_write_le32((p_buf + 0), 0x04034B50);
+  util_write_le16((p_buf + 4), 20);
+  util_write_le16((p_buf + 8), 8);
+  util_write_le32((p_buf + 14), crc);
+  util_write_le32((p_buf + 22), k_util_compress_test_image_size);
+  util_write_le16((p_buf + 26), name_len);
+  (void) memcpy((p_buf + 30), p_name, name_len);
+  len = (30 + name_len);
+  data_len = util_compress_test_deflate(p_buf + len);
+  util_write_le32((p_buf + 18), data_len);
+  len += data_len;
+
+  central_pos = len;
+  util_write_le32((p_buf + len + 0), 0x02014B50);
+  util_write_le16((p_buf + len + 4), 20);
+  util_write_le16((p_buf + len + 6), 20);
+  util_write_le16((p_buf + len + 10), 8);
+  util_write_le32((p_buf + len + 16), crc);
+  util_write_le32((p_buf + len + 20), data_len);
+  util_write_le32((p_buf + len + 24), k_util_compress_test_image_size);
+  util_write_le16((p_buf + len + 28), name_len);
+  (void) memcpy((p_buf + len + 46), p_name, name_len);
+  len += (46 + name_len);
+
+  util_write_le32((p_buf + len + 0), 0x06054B50);
+  util_write_le16((p_buf + len + 8), 1);
+  util_write_le16((p_buf + len + 10), 1);
+  util_write_le32((p_buf + len + 12), (len - central_pos));
+  util_write_le32((p_buf + len + 16), central_pos);
+  len += 22;
+
+  util_compress_test_write_file(s_p_util_compress_test_zip, p_buf, len);
+  util_free(p_buf);
+}
+
+static void
+util_compress_test_check_disc(const char* p_file_name) {
+  /* Every sector decoded from the loaded disc matches the image. */
+  struct bbc_options options;
+  struct disc_struct* p_disc;
+  struct disc_tool_struct* p_tool;
+  uint32_t i_track;
+
+  (void) memset(&options, '\0', sizeof(options));
+  options.p_opt_flags = "";
+  options.p_log_flags = "";
+  p_disc = disc_create(p_file_name, 0, 0, 0, 0, 0, &options);
+  disc_load(p_disc);
+  p_tool = disc_tool_create();
+  disc_tool_set_disc(p_tool, p_disc);
+
+  for (i_track = 0; i_track < k_util_compress_test_num_tracks; ++i_track) {
+    uint32_t num_sectors;
+    uint32_t i_sector;
+    struct disc_tool_sector* p_sectors;
+
+    disc_tool_set_track(p_tool, i_track);
+    disc_tool_find_sectors(p_tool);
+    p_sectors = disc_tool_get_sectors(p_tool, &num_sectors);
+    test_expect_u32(10, num_sectors);
+    for (i_sector = 0; i_sector < num_sectors; ++i_sector) {
+      uint8_t sector_data[k_disc_tool_max_sector_length];
+      uint32_t sector_length;
+      uint32_t pos = ((i_track * k_util_compress_test_track_size) +
+                      (p_sectors[i_sector].header_bytes[2] * 256));
+      disc_tool_read_sector(p_tool,
+                            &sector_length,
+                            &sector_data[0],
+                            i_sector,
+                            0);
+      test_expect_u32(256, sector_length);
+      test_expect_binary(&s_util_compress_test_image[pos],
+                         &sector_data[0],
+                         256);
+    }
+  }
+
+  disc_tool_destroy(p_tool);
+  disc_destroy(p_disc);
+}
+
+static void
+util_compress_test_memory_seek(void) {
+  /* A memory file seeks like fseek(): past the end is allowed, and reads
+   * from there return nothing.
+   */
+  uint8_t buf[16];
+  struct util_file* p_file =
+      util_compress_open(s_p_util_compress_test_gz, NULL);
+
+  test_expect_u32(k_util_compress_test_image_size,
+                  util_file_get_size(p_file));
+  util_file_seek(p_file, (k_util_compress_test_image_size + 100));
+  test_expect_u32((k_util_compress_test_image_size + 100),
+                  util_file_get_pos(p_file));
+  test_expect_u32(0, util_file_read(p_file, &buf[0], sizeof(buf)));
+  util_file_seek(p_file, (k_util_compress_test_image_size - 4));
+  test_expect_u32(4, util_file_read(p_file, &buf[0], sizeof(buf)));
+  test_expect_binary(
+      &s_util_compress_test_image[k_util_compress_test_image_size - 4],
+      &buf[0],
+      4);
+  util_file_close(p_file);
+}
+
+static void
+util_compress_test_gunzip_sizing(void) {
+  /* A buffer that's too small is reported as such, so the caller can grow it,
+   * but corrupt data fails outright. A wrong size in the trailer only costs
+   * some retries.
+   */
+  uint8_t* p_src;
+  uint8_t* p_dst;
+  size_t src_len;
+  size_t dst_len;
+  struct util_file* p_file = util_file_open(s_p_util_compress_test_gz, 0, 0);
+
+  src_len = util_file_get_size(p_file);
+  p_src = util_malloc(src_len);
+  test_expect_u32(src_len, util_file_read(p_file, p_src, src_len));
+  util_file_close(p_file);
+  p_dst = util_malloc(k_util_compress_test_image_size);
+
+  dst_len = 100;
+  test_expect_u32((uint32_t) k_util_gunzip_dst_full,
+                  (uint32_t) util_gunzip(&dst_len, p_src, src_len, p_dst));
+  dst_len = k_util_compress_test_image_size;
+  test_expect_u32(0, util_gunzip(&dst_len, p_src, src_len, p_dst));
+  test_expect_u32(k_util_compress_test_image_size, dst_len);
+
+  util_write_le32((p_src + src_len - 4), 16);
+  util_compress_test_write_file(s_p_util_compress_test_bad_size_gz,
+                                p_src,
+                                src_len);
+  p_file = util_compress_open(s_p_util_compress_test_bad_size_gz, NULL);
+  test_expect_u32(k_util_compress_test_image_size,
+                  util_file_get_size(p_file));
+  util_file_close(p_file);
+  (void) remove(s_p_util_compress_test_bad_size_gz);
+
+  /* A first block of the reserved type 3 is invalid. */
+  p_src[10] = 0x07;
+  dst_len = k_util_compress_test_image_size;
+  test_expect_neq(0, util_gunzip(&dst_len, p_src, src_len, p_dst));
+  dst_len = k_util_compress_test_image_size;
+  test_expect_neq((uint32_t) k_util_gunzip_dst_full,
+                  (uint32_t) util_gunzip(&dst_len, p_src, src_len, p_dst));
+
+  util_free(p_src);
+  util_free(p_dst);
+}
+
+void
+util_compress_test(void) {
+  uint32_t i;
+  uint32_t seed = 0x5EED;
+
+  /* Compressible, but not trivially so. */
+  for (i = 0; i < k_util_compress_test_image_size; ++i) {
+    seed = ((seed * 1103515245) + 12345);
+    s_util_compress_test_image[i] = ((seed >> 16) & 0x0F);
+  }
+  util_compress_test_write_gz();
+  util_compress_test_write_zip();
+
+  util_compress_test_memory_seek();
+  util_compress_test_gunzip_sizing();
+  util_compress_test_check_disc(s_p_util_compress_test_gz);
+  util_compress_test_check_disc(s_p_util_compress_test_zip);
+  util_compress_test_check_disc("beebjit_test.zip/DISC.SSD");
+
+  (void) remove(s_p_util_compress_test_gz);
+  (void) remove(s_p_util_compress_test_zip);
+}
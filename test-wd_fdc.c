@@ -0,0 +1,129 @@
+/* Appends at the end of wd_fdc.c. */
+
+#include "test.h"
+
+#include <string.h>
+
+enum {
+  k_wd_fdc_test_num_batches = 200000,
+};
+
+static uint32_t s_wd_fdc_test_rand = 0x1770;
+
+static uint32_t
+wd_fdc_test_rand(void) {
+  return test_rand(&s_wd_fdc_test_rand);
+}
+
+static uint32_t
+wd_fdc_test_make_pulses(void) {
+  /* Random pulses, well formed FM and MFM, and the marks the mark detector
+   * looks for, at any bit alignment.
+   */
+  static const uint8_t marks[3] = { 0xF8, 0xFB, 0xFE };
+  uint32_t pulses;
+  uint32_t rotate;
+  int last_mfm_bit = 0;
+
+  switch (wd_fdc_test_rand() % 6) {
+  case 0:
+    pulses = wd_fdc_test_rand();
+    break;
+  case 1:
+    pulses = ((0xAAAA << 16) | k_ibm_disc_mfm_a1_sync);
+    break;
+  case 2:
+    pulses = ((k_ibm_disc_mfm_a1_sync << 16) | k_ibm_disc_mfm_a1_sync);
+    break;
+  case 3:
+    pulses = ibm_disc_format_fm_to_2us_pulses(
+        0xC7, marks[wd_fdc_test_rand() % 3]);
+    break;
+  case 4:
+    pulses = ibm_disc_format_fm_to_2us_pulses(0xFF, wd_fdc_test_rand());
+    break;
+  default:
+    pulses = ibm_disc_format_mfm_to_2us_pulses(&last_mfm_bit,
+                                               wd_fdc_test_rand());
+    pulses <<= 16;
+    pulses |= ibm_disc_format_mfm_to_2us_pulses(&last_mfm_bit,
+                                                wd_fdc_test_rand());
+    break;
+  }
+
+  rotate = (wd_fdc_test_rand() % 32);
+  if (rotate != 0) {
+    pulses = ((pulses << rotate) | (pulses >> (32 - rotate)));
+  }
+  return pulses;
+}
+
+static void
+wd_fdc_test_shift_pulses_bitwise(struct wd_fdc_struct* p_fdc,
+                                 uint32_t pulses,
+                                 uint32_t pulses_count) {
+  /* The original bit by bit decode. */
+  uint32_t i;
+
+  pulses <<= (32 - pulses_count);
+  for (i = 0; i < pulses_count; ++i) {
+    int bit = !!(pulses & 0x80000000);
+    wd_fdc_bit_received(p_fdc, bit);
+    pulses <<= 1;
+  }
+}
+
+static void
+wd_fdc_test_bytewise_decode(void) {
+  /* The batched decode must leave the mark detector, data shifter and
+   * delivered byte exactly as the bit by bit decode does.
+   */
+  uint32_t i;
+  struct bbc_options options;
+  struct timing_struct* p_timing = timing_create(1);
+  struct wd_fdc_struct* p_bitwise =
+      util_mallocz(sizeof(struct wd_fdc_struct));
+  struct wd_fdc_struct* p_bytewise =
+      util_mallocz(sizeof(struct wd_fdc_struct));
+
+  (void) memset(&options, '\0', sizeof(options));
+  options.p_opt_flags = "";
+  options.p_log_flags = "";
+  /* Iffy FM pulses are replaced with quasi random ones from the drive. */
+  p_bitwise->p_current_drive = disc_drive_create(0, p_timing, &options);
+
+  for (i = 0; i < k_wd_fdc_test_num_batches; ++i) {
+    uint32_t pulses = wd_fdc_test_make_pulses();
+    uint32_t pulses_count = 32;
+
+    if ((wd_fdc_test_rand() % 64) == 0) {
+      /* A density change, which may leave a part filled data shifter that is
+       * too long for the new density.
+       */
+      p_bitwise->control_register ^= k_wd_fdc_control_density;
+      p_bitwise->data_shift_count = (wd_fdc_test_rand() % 32);
+      p_bitwise->data_shifter = wd_fdc_test_rand();
+    }
+    if (wd_fdc_is_double_density(p_bitwise->control_register)) {
+      /* The drive is in 32us mode. */
+      pulses_count = 16;
+    }
+
+    (void) memcpy(p_bytewise, p_bitwise, sizeof(struct wd_fdc_struct));
+    wd_fdc_test_shift_pulses_bitwise(p_bitwise, pulses, pulses_count);
+    wd_fdc_shift_pulses(p_bytewise, pulses, pulses_count);
+    test_expect_binary((uint8_t*) p_bitwise,
+                       (uint8_t*) p_bytewise,
+                       sizeof(struct wd_fdc_struct));
+  }
+
+  disc_drive_destroy(p_bitwise->p_current_drive);
+  util_free(p_bitwise);
+  util_free(p_bytewise);
+  timing_destroy(p_timing);
+}
+
+void
+wd_fdc_test(void) {
+  wd_fdc_test_bytewise_decode();
+}
@@ -8,7 +8,15 @@
 #include <string.h>
 
 extern void timing_test(void);
+extern void disc_drive_test(void);
+extern void wd_fdc_test(void);
+extern void intel_fdc_test(void);
+extern void tape_test(void);
+extern void trace_test(void);
+extern void util_compress_test(void);
+extern void tube_test(void);
 extern void video_test(void);
+extern void sound_test(void);
 extern void jit_test(struct bbc_struct* p_bbc);
 extern void expression_test(void);
 extern void bbc_test(struct bbc_struct* p_bbc);
@@ -19,7 +27,15 @@ test_do_tests(struct bbc_struct* p_bbc) {
   bbc_power_on_reset(p_bbc);
 
   timing_test();
+  disc_drive_test();
+  wd_fdc_test();
+  intel_fdc_test();
+  tape_test();
+  trace_test();
+  util_compress_test();
+  tube_test();
   video_test();
+  sound_test();
   jit_test(p_bbc);
   expression_test();
   bbc_test(p_bbc);
@@ -62,3 +78,13 @@ test_expect_binary(uint8_t* p_expect, uint8_t* p_actual, size_t len) {
     exit(1);
   }
 }
+
+uint32_t
+test_rand(uint32_t* p_state) {
+  uint32_t x = *p_state;
+  x ^= (x << 13);
+  x ^= (x >> 17);
+  x ^= (x << 5);
+  *p_state = x;
+  return x;
+}
@@ -12,5 +12,7 @@ void test_expect_u32(uint32_t expectation, uint32_t actual);
 void test_expect_eq(uint32_t v1, uint32_t v2);
 void test_expect_neq(uint32_t v1, uint32_t v2);
 void test_expect_binary(uint8_t* p_expect, uint8_t* p_actual, size_t len);
+/* xorshift32, for a repeatable stream from the given seed state. */
+uint32_t test_rand(uint32_t* p_state);
 
 #endif /* BEEBJIT_TEST_H */
@@ -78,6 +78,9 @@ timing_set_log_expiries(struct timing_struct* p_timing, int log_expiries) {
 void
 timing_reset_total_timer_ticks(struct timing_struct* p_timing) {
   p_timing->total_timer_ticks = 0;
+  p_timing->odd_even_mixin = 0;
+  /* The odd / even tracker mixes in the total, so must be refreshed. */
+  timing_set_countdown(p_timing, p_timing->countdown);
 }
 
 static inline uint64_t
@@ -0,0 +1,727 @@
+#include "trace.h"
+
+#include "defs_6502.h"
+#include "log.h"
+#include "os_channel.h"
+#include "os_thread.h"
+#include "util.h"
+#include "util_compress.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+enum {
+  k_trace_message_work = 1,
+  k_trace_message_exit = 2,
+};
+
+enum {
+  k_trace_version = 1,
+  k_trace_file_header_len = 16,
+  k_trace_chunk_header_len = 8,
+  k_trace_chunk_size = (1024 * 1024),
+  /* Header, PC, 3 code bytes, 5 registers, memory access, 10 byte varint. */
+  k_trace_max_record_len = 32,
+};
+
+/* Record header bits. Each set bit means that field follows, in this order. A
+ * record ends with a varint of (cycle delta << 1) | is_irq. The memory access
+ * is the one made by the previous instruction.
+ */
+enum {
+  k_trace_pc = 0x01,
+  k_trace_code = 0x02,
+  k_trace_a = 0x04,
+  k_trace_x = 0x08,
+  k_trace_y = 0x10,
+  k_trace_s = 0x20,
+  k_trace_flags = 0x40,
+  k_trace_mem = 0x80,
+};
+
+/* The opcode bytes last recorded at an address, with a valid bit. Code is
+ * only recorded when it differs, which catches self-modifying code.
+ */
+enum {
+  k_trace_code_valid = 0x01000000,
+};
+
+static const char s_trace_magic[] = "BEEBTRC";
+
+struct trace_struct {
+  struct util_file* p_file;
+  struct os_thread_struct* p_thread;
+  intptr_t handle_message_read;
+  intptr_t handle_message_write;
+  intptr_t handle_ack_read;
+  intptr_t handle_ack_write;
+
+  /* The CPU thread fills p_buf. A full chunk is swapped into p_spare and
+   * handed to the thread, which owns it until it acknowledges.
+   */
+  uint8_t* p_buf;
+  uint32_t buf_len;
+  uint8_t* p_spare;
+  uint32_t spare_len;
+  int is_chunk_in_flight;
+  uint8_t* p_compressed;
+  size_t compressed_alloc;
+
+  uint8_t oplens[k_6502_op_num_opcodes];
+  uint8_t opmems[k_6502_op_num_opcodes];
+  uint32_t* p_code_shadow;
+
+  uint64_t from_ticks;
+  uint64_t to_ticks;
+  int32_t from_pc;
+  int32_t to_pc;
+  int is_tracing;
+  int is_stopped;
+
+  /* Encoder state: what the decoder will already know. */
+  uint16_t next_pc;
+  uint8_t a;
+  uint8_t x;
+  uint8_t y;
+  uint8_t s;
+  uint8_t flags;
+  int prev_has_mem;
+  uint64_t ticks;
+
+  uint64_t count_instructions;
+  uint64_t count_raw_bytes;
+  uint64_t count_file_bytes;
+};
+
+static void
+trace_write_chunk(struct trace_struct* p_trace) {
+  uint8_t header[k_trace_chunk_header_len];
+  size_t compressed_len = p_trace->compressed_alloc;
+
+  if (util_compress(&compressed_len,
+                    p_trace->p_spare,
+                    p_trace->spare_len,
+                    p_trace->p_compressed,
+                    1) != 0) {
+    util_bail("trace compression failed");
+  }
+  util_write_le32(&header[0], (uint32_t) compressed_len);
+  util_write_le32(&header[4], p_trace->spare_len);
+  util_file_write(p_trace->p_file, header, sizeof(header));
+  util_file_write(p_trace->p_file, p_trace->p_compressed, compressed_len);
+  p_trace->count_file_bytes += (sizeof(header) + compressed_len);
+}
+
+static void*
+trace_thread(void* p) {
+  struct trace_struct* p_trace = (struct trace_struct*) p;
+
+  while (1) {
+    uint8_t message;
+    os_channel_read(p_trace->handle_message_read, &message, 1);
+    if (message == k_trace_message_exit) {
+      break;
+    }
+    trace_write_chunk(p_trace);
+    os_channel_write(p_trace->handle_ack_write, &message, 1);
+  }
+
+  return NULL;
+}
+
+static void
+trace_wait_chunk(struct trace_struct* p_trace) {
+  uint8_t message;
+
+  if (!p_trace->is_chunk_in_flight) {
+    return;
+  }
+  os_channel_read(p_trace->handle_ack_read, &message, 1);
+  assert(message == k_trace_message_work);
+  p_trace->is_chunk_in_flight = 0;
+}
+
+static void
+trace_send_chunk(struct trace_struct* p_trace) {
+  uint8_t message = k_trace_message_work;
+  uint8_t* p_buf = p_trace->p_buf;
+
+  /* Only one chunk is ever in flight, so a slow disc throttles the CPU
+   * rather than queueing without bound.
+   */
+  trace_wait_chunk(p_trace);
+
+  p_trace->count_raw_bytes += p_trace->buf_len;
+  p_trace->p_buf = p_trace->p_spare;
+  p_trace->p_spare = p_buf;
+  p_trace->spare_len = p_trace->buf_len;
+  p_trace->buf_len = 0;
+
+  p_trace->is_chunk_in_flight = 1;
+  os_channel_write(p_trace->handle_message_write, &message, 1);
+}
+
+static void
+trace_finish(struct trace_struct* p_trace) {
+  uint8_t message = k_trace_message_exit;
+
+  p_trace->is_stopped = 1;
+  p_trace->is_tracing = 0;
+
+  if (p_trace->buf_len > 0) {
+    trace_send_chunk(p_trace);
+  }
+  trace_wait_chunk(p_trace);
+  os_channel_write(p_trace->handle_message_write, &message, 1);
+  (void) os_thread_destroy(p_trace->p_thread);
+  util_file_flush(p_trace->p_file);
+}
+
+struct trace_struct*
+trace_create(const char* p_file_name, int is_65c12, const char* p_opt_flags) {
+  uint8_t header[k_trace_file_header_len];
+  uint8_t* p_optypes;
+  uint8_t* p_opmodes;
+  uint8_t* p_opmems;
+  uint32_t from_pc;
+  uint32_t to_pc;
+  uint32_t i;
+  struct trace_struct* p_trace = util_mallocz(sizeof(struct trace_struct));
+
+  defs_6502_init();
+  if (is_65c12) {
+    p_optypes = defs_6502_get_65c12_optype_map();
+    p_opmodes = defs_6502_get_65c12_opmode_map();
+    p_opmems = defs_6502_get_65c12_opmem_map();
+  } else {
+    p_optypes = defs_6502_get_6502_optype_map();
+    p_opmodes = defs_6502_get_6502_opmode_map();
+    p_opmems = defs_6502_get_6502_opmem_map();
+  }
+  for (i = 0; i < k_6502_op_num_opcodes; ++i) {
+    p_trace->oplens[i] = g_opmodelens[p_opmodes[i]];
+    p_trace->opmems[i] = (p_opmems[i] != 0);
+    /* KIL has no length but is traced as a single byte. */
+    if (p_optypes[i] == k_kil) {
+      p_trace->oplens[i] = 1;
+    }
+  }
+  p_trace->p_code_shadow =
+      util_mallocz(k_6502_addr_space_size * sizeof(uint32_t));
+
+  p_trace->to_ticks = UINT64_MAX;
+  p_trace->from_pc = -1;
+  p_trace->to_pc = -1;
+  (void) util_get_u64_option(&p_trace->from_ticks,
+                             p_opt_flags,
+                             "trace:from-cycles=");
+  (void) util_get_u64_option(&p_trace->to_ticks,
+                             p_opt_flags,
+                             "trace:to-cycles=");
+  if (util_get_u32_hex_option(&from_pc, p_opt_flags, "trace:from-pc=")) {
+    p_trace->from_pc = (uint16_t) from_pc;
+  }
+  if (util_get_u32_hex_option(&to_pc, p_opt_flags, "trace:to-pc=")) {
+    p_trace->to_pc = (uint16_t) to_pc;
+  }
+
+  p_trace->p_buf = util_malloc(k_trace_chunk_size);
+  p_trace->p_spare = util_malloc(k_trace_chunk_size);
+  p_trace->compressed_alloc = util_compress_bound(k_trace_chunk_size);
+  p_trace->p_compressed = util_malloc(p_trace->compressed_alloc);
+
+  p_trace->p_file = util_file_open(p_file_name, 1, 1);
+  (void) memset(header, '\0', sizeof(header));
+  (void) memcpy(header, s_trace_magic, sizeof(s_trace_magic));
+  header[8] = k_trace_version;
+  header[9] = !!is_65c12;
+  util_file_write(p_trace->p_file, header, sizeof(header));
+  p_trace->count_file_bytes = sizeof(header);
+
+  os_channel_get_handles(&p_trace->handle_message_read,
+                         &p_trace->handle_message_write,
+                         &p_trace->handle_ack_read,
+                         &p_trace->handle_ack_write);
+  p_trace->p_thread = os_thread_create(trace_thread, p_trace);
+
+  return p_trace;
+}
+
+void
+trace_destroy(struct trace_struct* p_trace) {
+  /* Nothing lands at exit(), so the last chunk is written here. */
+  trace_finish(p_trace);
+
+  log_do_log(k_log_misc,
+             k_log_info,
+             "trace: %"PRIu64" instructions, %"PRIu64" bytes raw, "
+             "%"PRIu64" bytes written",
+             p_trace->count_instructions,
+             p_trace->count_raw_bytes,
+             p_trace->count_file_bytes);
+
+  os_channel_free_handles(p_trace->handle_message_read,
+                          p_trace->handle_message_write,
+                          p_trace->handle_ack_read,
+                          p_trace->handle_ack_write);
+  util_file_close(p_trace->p_file);
+  util_free(p_trace->p_code_shadow);
+  util_free(p_trace->p_buf);
+  util_free(p_trace->p_spare);
+  util_free(p_trace->p_compressed);
+  util_free(p_trace);
+}
+
+static int
+trace_start(struct trace_struct* p_trace,
+            uint16_t pc,
+            uint8_t a,
+            uint8_t x,
+            uint8_t y,
+            uint8_t s,
+            uint8_t flags,
+            uint64_t ticks) {
+  if (p_trace->is_stopped || (ticks < p_trace->from_ticks)) {
+    return 0;
+  }
+  if ((p_trace->from_pc != -1) && (pc != p_trace->from_pc)) {
+    return 0;
+  }
+
+  /* The first record carries everything. */
+  p_trace->is_tracing = 1;
+  p_trace->next_pc = (pc + 1);
+  p_trace->a = ~a;
+  p_trace->x = ~x;
+  p_trace->y = ~y;
+  p_trace->s = ~s;
+  p_trace->flags = ~flags;
+  p_trace->prev_has_mem = 0;
+  return 1;
+}
+
+void
+trace_instruction(struct trace_struct* p_trace,
+                  const uint8_t* p_mem,
+                  uint16_t pc,
+                  int is_irq,
+                  uint8_t a,
+                  uint8_t x,
+                  uint8_t y,
+                  uint8_t s,
+                  uint8_t flags,
+                  int has_prev,
+                  uint16_t prev_addr,
+                  uint8_t prev_val,
+                  uint64_t ticks) {
+  uint8_t* p_header;
+  uint8_t* p_out;
+  uint8_t header;
+  uint8_t opcode;
+  uint64_t delta;
+
+  if (!p_trace->is_tracing) {
+    if (!trace_start(p_trace, pc, a, x, y, s, flags, ticks)) {
+      return;
+    }
+    has_prev = 0;
+  }
+  if ((ticks >= p_trace->to_ticks) || (pc == p_trace->to_pc)) {
+    p_trace->is_tracing = 0;
+    p_trace->is_stopped = 1;
+    return;
+  }
+
+  p_header = (p_trace->p_buf + p_trace->buf_len);
+  p_out = (p_header + 1);
+  header = 0;
+
+  if (pc != p_trace->next_pc) {
+    header |= k_trace_pc;
+    *p_out++ = (uint8_t) pc;
+    *p_out++ = (uint8_t) (pc >> 8);
+  }
+
+  if (is_irq) {
+    opcode = 0x00;
+    p_trace->next_pc = pc;
+  } else {
+    uint32_t len;
+    uint32_t code;
+
+    opcode = p_mem[pc];
+    len = p_trace->oplens[opcode];
+    code = (k_trace_code_valid | opcode);
+    if (len > 1) {
+      code |= (p_mem[(uint16_t) (pc + 1)] << 8);
+    }
+    if (len > 2) {
+      code |= (p_mem[(uint16_t) (pc + 2)] << 16);
+    }
+    if (p_trace->p_code_shadow[pc] != code) {
+      p_trace->p_code_shadow[pc] = code;
+      header |= k_trace_code;
+      *p_out++ = opcode;
+      if (len > 1) {
+        *p_out++ = (uint8_t) (code >> 8);
+      }
+      if (len > 2) {
+        *p_out++ = (uint8_t) (code >> 16);
+      }
+    }
+    p_trace->next_pc = (pc + len);
+  }
+
+  if (a != p_trace->a) {
+    header |= k_trace_a;
+    *p_out++ = a;
+    p_trace->a = a;
+  }
+  if (x != p_trace->x) {
+    header |= k_trace_x;
+    *p_out++ = x;
+    p_trace->x = x;
+  }
+  if (y != p_trace->y) {
+    header |= k_trace_y;
+    *p_out++ = y;
+    p_trace->y = y;
+  }
+  if (s != p_trace->s) {
+    header |= k_trace_s;
+    *p_out++ = s;
+    p_trace->s = s;
+  }
+  if (flags != p_trace->flags) {
+    header |= k_trace_flags;
+    *p_out++ = flags;
+    p_trace->flags = flags;
+  }
+
+  if (has_prev && p_trace->prev_has_mem) {
+    header |= k_trace_mem;
+    *p_out++ = (uint8_t) prev_addr;
+    *p_out++ = (uint8_t) (prev_addr >> 8);
+    *p_out++ = prev_val;
+  }
+  /* Only now that any pending access has gone out can an IRQ clear it. */
+  if (is_irq) {
+    p_trace->prev_has_mem = 0;
+  } else {
+    p_trace->prev_has_mem = p_trace->opmems[opcode];
+  }
+
+  delta = (((ticks - p_trace->ticks) << 1) | !!is_irq);
+  p_trace->ticks = ticks;
+  while (delta >= 0x80) {
+    *p_out++ = (uint8_t) (delta | 0x80);
+    delta >>= 7;
+  }
+  *p_out++ = (uint8_t) delta;
+
+  *p_header = header;
+  p_trace->buf_len = (p_out - p_trace->p_buf);
+  p_trace->count_instructions++;
+
+  if (p_trace->buf_len > (k_trace_chunk_size - k_trace_max_record_len)) {
+    trace_send_chunk(p_trace);
+  }
+}
+
+struct trace_decode_line {
+  uint16_t pc;
+  uint32_t code;
+  int is_irq;
+  uint8_t a;
+  uint8_t x;
+  uint8_t y;
+  uint8_t s;
+  uint8_t flags;
+  uint64_t ticks;
+  int has_mem;
+  uint16_t mem_addr;
+  uint8_t mem_val;
+};
+
+static void
+trace_decode_print(void* p,
+                   struct trace_decode_line* p_line,
+                   uint8_t* p_optypes,
+                   uint8_t* p_opmodes) {
+  char buf[32];
+  char flags_buf[9];
+  char mem_buf[32];
+  uint8_t opcode = (uint8_t) p_line->code;
+  uint8_t operand1 = (uint8_t) (p_line->code >> 8);
+  uint16_t addr = (uint16_t) (p_line->code >> 8);
+  const char* opname = g_p_opnames[p_optypes[opcode]];
+  uint8_t flags = p_line->flags;
+  size_t buf_len = sizeof(buf);
+
+  (void) p;
+
+  if (p_line->is_irq) {
+    (void) snprintf(buf, sizeof(buf), "IRQ");
+  } else {
+    switch (p_opmodes[opcode]) {
+    case k_acc:
+      (void) snprintf(buf, buf_len, "%s A", opname);
+      break;
+    case k_imm:
+      (void) snprintf(buf, buf_len, "%s #$%.2"PRIX8, opname, operand1);
+      break;
+    case k_zpg:
+      (void) snprintf(buf, buf_len, "%s $%.2"PRIX8, opname, operand1);
+      break;
+    case k_abs:
+      (void) snprintf(buf, buf_len, "%s $%.4"PRIX16, opname, addr);
+      break;
+    case k_zpx:
+      (void) snprintf(buf, buf_len, "%s $%.2"PRIX8",X", opname, operand1);
+      break;
+    case k_zpy:
+      (void) snprintf(buf, buf_len, "%s $%.2"PRIX8",Y", opname, operand1);
+      break;
+    case k_abx:
+      (void) snprintf(buf, buf_len, "%s $%.4"PRIX16",X", opname, addr);
+      break;
+    case k_aby:
+      (void) snprintf(buf, buf_len, "%s $%.4"PRIX16",Y", opname, addr);
+      break;
+    case k_idx:
+      (void) snprintf(buf, buf_len, "%s ($%.2"PRIX8",X)", opname, operand1);
+      break;
+    case k_idy:
+      (void) snprintf(buf, buf_len, "%s ($%.2"PRIX8"),Y", opname, operand1);
+      break;
+    case k_ind:
+      (void) snprintf(buf, buf_len, "%s ($%.4"PRIX16")", opname, addr);
+      break;
+    case k_rel:
+      addr = (p_line->pc + 2 + (int8_t) operand1);
+      (void) snprintf(buf, buf_len, "%s $%.4"PRIX16, opname, addr);
+      break;
+    case k_iax:
+      (void) snprintf(buf, buf_len, "%s ($%.4"PRIX16",X)", opname, addr);
+      break;
+    case k_id:
+      (void) snprintf(buf, buf_len, "%s ($%.2"PRIX8")", opname, operand1);
+      break;
+    default:
+      (void) snprintf(buf, buf_len, "%s", opname);
+      break;
+    }
+  }
+
+  (void) memset(flags_buf, ' ', 8);
+  flags_buf[8] = '\0';
+  if (flags & 0x01) {
+    flags_buf[0] = 'C';
+  }
+  if (flags & 0x02) {
+    flags_buf[1] = 'Z';
+  }
+  if (flags & 0x04) {
+    flags_buf[2] = 'I';
+  }
+  if (flags & 0x08) {
+    flags_buf[3] = 'D';
+  }
+  flags_buf[5] = '1';
+  if (flags & 0x40) {
+    flags_buf[6] = 'O';
+  }
+  if (flags & 0x80) {
+    flags_buf[7] = 'N';
+  }
+
+  mem_buf[0] = '\0';
+  if (p_line->has_mem) {
+    (void) snprintf(mem_buf,
+                    sizeof(mem_buf),
+                    " [addr=%.4"PRIX16" val=%.2"PRIX8"]",
+                    p_line->mem_addr,
+                    p_line->mem_val);
+  }
+
+  (void) printf("%.4"PRIX16": %-14s "
+                "[A=%.2"PRIX8" X=%.2"PRIX8" Y=%.2"PRIX8" S=%.2"PRIX8" F=%s] "
+                "[ticks=%"PRIu64"]%s\n",
+                p_line->pc,
+                buf,
+                p_line->a,
+                p_line->x,
+                p_line->y,
+                p_line->s,
+                flags_buf,
+                p_line->ticks,
+                mem_buf);
+}
+
+static void
+trace_decode_lines(const char* p_file_name,
+                   void (*p_line_callback)(void* p,
+                                           struct trace_decode_line* p_line,
+                                           uint8_t* p_optypes,
+                                           uint8_t* p_opmodes),
+                   void* p_line_callback_object) {
+  uint8_t header[k_trace_file_header_len];
+  struct trace_decode_line line;
+  struct trace_decode_line next_line;
+  uint8_t* p_optypes;
+  uint8_t* p_opmodes;
+  uint8_t oplens[k_6502_op_num_opcodes];
+  uint32_t i;
+  uint8_t* p_compressed = NULL;
+  uint8_t* p_raw = NULL;
+  uint32_t compressed_alloc = 0;
+  uint32_t raw_alloc = 0;
+  uint16_t next_pc = 0;
+  int has_line = 0;
+  uint32_t* p_code_shadow =
+      util_mallocz(k_6502_addr_space_size * sizeof(uint32_t));
+  struct util_file* p_file = util_file_open(p_file_name, 0, 0);
+
+  if ((util_file_read(p_file, header, sizeof(header)) != sizeof(header)) ||
+      memcmp(header, s_trace_magic, sizeof(s_trace_magic)) ||
+      (header[8] != k_trace_version)) {
+    util_bail("not a beebjit trace file: %s", p_file_name);
+  }
+
+  defs_6502_init();
+  if (header[9]) {
+    p_optypes = defs_6502_get_65c12_optype_map();
+    p_opmodes = defs_6502_get_65c12_opmode_map();
+  } else {
+    p_optypes = defs_6502_get_6502_optype_map();
+    p_opmodes = defs_6502_get_6502_opmode_map();
+  }
+  for (i = 0; i < k_6502_op_num_opcodes; ++i) {
+    oplens[i] = g_opmodelens[p_opmodes[i]];
+    if (p_optypes[i] == k_kil) {
+      oplens[i] = 1;
+    }
+  }
+
+  (void) memset(&line, '\0', sizeof(line));
+  (void) memset(&next_line, '\0', sizeof(next_line));
+
+  while (1) {
+    uint8_t chunk_header[k_trace_chunk_header_len];
+    uint32_t compressed_len;
+    uint32_t raw_len;
+    size_t uncompressed_len;
+    uint32_t pos;
+
+    if (util_file_read(p_file, chunk_header, sizeof(chunk_header)) !=
+        sizeof(chunk_header)) {
+      break;
+    }
+    compressed_len = util_read_le32(&chunk_header[0]);
+    raw_len = util_read_le32(&chunk_header[4]);
+    if (compressed_len > compressed_alloc) {
+      p_compressed = util_realloc(p_compressed, compressed_len);
+      compressed_alloc = compressed_len;
+    }
+    if (raw_len > raw_alloc) {
+      p_raw = util_realloc(p_raw, raw_len);
+      raw_alloc = raw_len;
+    }
+    if (util_file_read(p_file, p_compressed, compressed_len) !=
+        compressed_len) {
+      util_bail("truncated trace chunk");
+    }
+    uncompressed_len = raw_len;
+    if ((util_uncompress(&uncompressed_len,
+                         p_compressed,
+                         compressed_len,
+                         p_raw) != 0) ||
+        (uncompressed_len != raw_len)) {
+      util_bail("corrupt trace chunk");
+    }
+
+    pos = 0;
+    while (pos < raw_len) {
+      uint8_t record_header = p_raw[pos++];
+      uint64_t delta = 0;
+      uint32_t shift = 0;
+      uint8_t byte;
+
+      next_line.has_mem = 0;
+      if (record_header & k_trace_pc) {
+        next_pc = (p_raw[pos] | (p_raw[pos + 1] << 8));
+        pos += 2;
+      }
+      next_line.pc = next_pc;
+      if (record_header & k_trace_code) {
+        uint8_t opcode = p_raw[pos++];
+        uint32_t code = (k_trace_code_valid | opcode);
+        if (oplens[opcode] > 1) {
+          code |= (p_raw[pos++] << 8);
+        }
+        if (oplens[opcode] > 2) {
+          code |= (p_raw[pos++] << 16);
+        }
+        p_code_shadow[next_pc] = code;
+      }
+      if (record_header & k_trace_a) {
+        next_line.a = p_raw[pos++];
+      }
+      if (record_header & k_trace_x) {
+        next_line.x = p_raw[pos++];
+      }
+      if (record_header & k_trace_y) {
+        next_line.y = p_raw[pos++];
+      }
+      if (record_header & k_trace_s) {
+        next_line.s = p_raw[pos++];
+      }
+      if (record_header & k_trace_flags) {
+        next_line.flags = p_raw[pos++];
+      }
+      if (record_header & k_trace_mem) {
+        line.has_mem = 1;
+        line.mem_addr = (p_raw[pos] | (p_raw[pos + 1] << 8));
+        line.mem_val = p_raw[pos + 2];
+        pos += 3;
+      }
+      do {
+        byte = p_raw[pos++];
+        delta |= ((uint64_t) (byte & 0x7F) << shift);
+        shift += 7;
+      } while (byte & 0x80);
+      next_line.is_irq = (delta & 1);
+      next_line.ticks += (delta >> 1);
+      next_line.code = p_code_shadow[next_pc];
+      if (next_line.is_irq) {
+        next_line.code = 0;
+      } else {
+        next_pc += oplens[(uint8_t) next_line.code];
+      }
+
+      /* A line is printed once the next record supplies its memory access. */
+      if (has_line) {
+        p_line_callback(p_line_callback_object, &line, p_optypes, p_opmodes);
+      }
+      line = next_line;
+      has_line = 1;
+    }
+  }
+  if (has_line) {
+    p_line_callback(p_line_callback_object, &line, p_optypes, p_opmodes);
+  }
+
+  util_file_close(p_file);
+  util_free(p_code_shadow);
+  util_free(p_compressed);
+  util_free(p_raw);
+}
+
+void
+trace_decode(const char* p_file_name) {
+  trace_decode_lines(p_file_name, trace_decode_print, NULL);
+}
+
+#include "test-trace.c"
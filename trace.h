@@ -0,0 +1,43 @@
+#ifndef BEEBJIT_TRACE_H
+#define BEEBJIT_TRACE_H
+
+#include <stdint.h>
+
+struct trace_struct;
+
+/* A compact binary trace of every instruction run: PC, opcode bytes,
+ * registers, the memory access and the cycle count. Records are delta encoded
+ * against the previous instruction and compressed in chunks on a background
+ * thread.
+ * Options in p_opt_flags limit the traced span: trace:from-cycles=,
+ * trace:to-cycles=, trace:from-pc= and trace:to-pc= (hex). Tracing starts once
+ * both start conditions hold and stops for good at either stop condition.
+ */
+struct trace_struct* trace_create(const char* p_file_name,
+                                  int is_65c12,
+                                  const char* p_opt_flags);
+void trace_destroy(struct trace_struct* p_trace);
+
+/* Called before each instruction. p_mem is the 6502 read view, for the opcode
+ * bytes. The access made by the previous instruction, if it was a memory
+ * access, is described by prev_addr and prev_val; has_prev is 0 if the
+ * previous instruction isn't known, such as on entry to the CPU.
+ */
+void trace_instruction(struct trace_struct* p_trace,
+                       const uint8_t* p_mem,
+                       uint16_t pc,
+                       int is_irq,
+                       uint8_t a,
+                       uint8_t x,
+                       uint8_t y,
+                       uint8_t s,
+                       uint8_t flags,
+                       int has_prev,
+                       uint16_t prev_addr,
+                       uint8_t prev_val,
+                       uint64_t ticks);
+
+/* Prints a trace file as text, one instruction per line. */
+void trace_decode(const char* p_file_name);
+
+#endif /* BEEBJIT_TRACE_H */
@@ -0,0 +1,760 @@
+#include "tube.h"
+
+#include "bbc_options.h"
+#include "cpu_driver.h"
+#include "log.h"
+#include "memory_access.h"
+#include "os_lock.h"
+#include "os_thread.h"
+#include "os_time.h"
+#include "state_6502.h"
+#include "timing.h"
+#include "util.h"
+
+#include <assert.h>
+#include <string.h>
+
+enum {
+  k_tube_max_rom_size = 4096,
+  k_tube_parasite_regs = 0xFEF8,
+  k_tube_ph1_fifo_size = 24,
+  /* Cycle periods at which each side picks up the other's interrupt lines.
+   * The host backs off while the parasite isn't writing anything.
+   */
+  k_tube_parasite_sync_cycles = 256,
+  k_tube_host_sync_cycles = 128,
+  k_tube_host_max_sync_cycles = 8192,
+  /* After this many empty status polls, the parasite is idle. */
+  k_tube_idle_polls = 1024,
+  k_tube_idle_sleep_us = 50,
+};
+
+enum {
+  k_tube_r1_Q = 0x01,
+  k_tube_r1_I = 0x02,
+  k_tube_r1_J = 0x04,
+  k_tube_r1_M = 0x08,
+  k_tube_r1_V = 0x10,
+  k_tube_r1_P = 0x20,
+  k_tube_r1_T = 0x40,
+  k_tube_r1_S = 0x80,
+};
+
+enum {
+  k_tube_stat_data = 0x80,
+  k_tube_stat_not_full = 0x40,
+};
+
+struct tube_ula {
+  uint8_t r1stat;
+  /* Bit 7: data available to read. Bit 6: room to write. */
+  uint8_t hstat[4];
+  uint8_t pstat[4];
+  uint8_t ph1[k_tube_ph1_fifo_size];
+  uint32_t ph1pos;
+  uint8_t hp1;
+  uint8_t ph2;
+  uint8_t hp2;
+  uint8_t ph3[2];
+  uint32_t ph3pos;
+  uint8_t hp3[2];
+  uint32_t hp3pos;
+  uint8_t ph4;
+  uint8_t hp4;
+};
+
+struct tube_struct {
+  struct timing_struct* p_host_timing;
+  struct state_6502* p_host_state_6502;
+  uint32_t host_timer_id;
+  uint32_t host_sync_cycles;
+  uint32_t host_seen_parasite_writes;
+
+  /* The ULA is shared by both threads, under the lock. The interrupt lines
+   * are recalculated under the lock and picked up by each side locklessly.
+   */
+  struct os_lock_struct* p_lock;
+  struct tube_ula ula;
+  volatile int host_irq;
+  volatile int parasite_irq;
+  volatile int parasite_nmi;
+  volatile int is_parasite_reset_pending;
+  volatile int is_exiting;
+  volatile uint32_t parasite_writes;
+
+  /* Everything below is owned by the parasite thread. */
+  struct bbc_options options;
+  struct timing_struct* p_timing;
+  struct state_6502* p_state_6502;
+  struct memory_access memory_access;
+  struct cpu_driver* p_cpu_driver;
+  struct os_thread_struct* p_thread;
+  struct os_time_sleeper* p_sleeper;
+  uint32_t timer_id;
+  uint32_t idle_polls;
+
+  uint8_t* p_mem;
+  uint8_t rom[k_tube_max_rom_size];
+  uint8_t shadow[k_tube_max_rom_size];
+  uint32_t rom_len;
+  uint16_t rom_base;
+  uint16_t write_callback_from;
+  int is_rom_paged_in;
+};
+
+static void
+tube_update_interrupts(struct tube_struct* p_tube) {
+  struct tube_ula* p_ula = &p_tube->ula;
+  uint8_t r1stat = p_ula->r1stat;
+  int nmi = 0;
+
+  p_tube->host_irq = ((r1stat & k_tube_r1_Q) &&
+                      (p_ula->hstat[3] & k_tube_stat_data));
+  p_tube->parasite_irq = (((r1stat & k_tube_r1_I) &&
+                           (p_ula->pstat[0] & k_tube_stat_data)) ||
+                          ((r1stat & k_tube_r1_J) &&
+                           (p_ula->pstat[3] & k_tube_stat_data)));
+  /* R3 asks for an NMI when there's something to read, or room to write. */
+  if (r1stat & k_tube_r1_M) {
+    uint32_t needed = ((r1stat & k_tube_r1_V) ? 2 : 1);
+    nmi = ((p_ula->hp3pos >= needed) || (p_ula->ph3pos == 0));
+  }
+  p_tube->parasite_nmi = nmi;
+}
+
+static void
+tube_reset_fifos(struct tube_struct* p_tube) {
+  struct tube_ula* p_ula = &p_tube->ula;
+  uint32_t i;
+
+  for (i = 0; i < 4; ++i) {
+    p_ula->hstat[i] = k_tube_stat_not_full;
+    p_ula->pstat[i] = k_tube_stat_not_full;
+  }
+  /* EMU NOTE: R3 comes out of reset with a byte waiting for the host, as per
+   * b-em.
+   */
+  p_ula->hstat[2] |= k_tube_stat_data;
+  p_ula->ph1pos = 0;
+  p_ula->ph3pos = 1;
+  p_ula->hp3pos = 0;
+}
+
+static void
+tube_page_out_rom(struct tube_struct* p_tube) {
+  assert(p_tube->is_rom_paged_in);
+  (void) memcpy((p_tube->p_mem + p_tube->rom_base),
+                &p_tube->shadow[0],
+                p_tube->rom_len);
+  p_tube->is_rom_paged_in = 0;
+}
+
+static void
+tube_page_in_rom(struct tube_struct* p_tube) {
+  if (!p_tube->is_rom_paged_in) {
+    (void) memcpy(&p_tube->shadow[0],
+                  (p_tube->p_mem + p_tube->rom_base),
+                  p_tube->rom_len);
+  }
+  (void) memcpy((p_tube->p_mem + p_tube->rom_base),
+                &p_tube->rom[0],
+                p_tube->rom_len);
+  p_tube->is_rom_paged_in = 1;
+}
+
+static void
+tube_host_apply_irq(struct tube_struct* p_tube) {
+  state_6502_set_irq_level(p_tube->p_host_state_6502,
+                           k_state_6502_irq_tube,
+                           p_tube->host_irq);
+}
+
+static void
+tube_host_timer_callback(void* p) {
+  struct tube_struct* p_tube = (struct tube_struct*) p;
+  uint32_t parasite_writes = p_tube->parasite_writes;
+
+  if (parasite_writes != p_tube->host_seen_parasite_writes) {
+    p_tube->host_seen_parasite_writes = parasite_writes;
+    p_tube->host_sync_cycles = k_tube_host_sync_cycles;
+  } else if (p_tube->host_sync_cycles < k_tube_host_max_sync_cycles) {
+    p_tube->host_sync_cycles *= 2;
+  }
+  (void) timing_adjust_timer_value(p_tube->p_host_timing,
+                                   NULL,
+                                   p_tube->host_timer_id,
+                                   p_tube->host_sync_cycles);
+  tube_host_apply_irq(p_tube);
+}
+
+static void
+tube_host_update_sync(struct tube_struct* p_tube) {
+  /* The parasite can only raise the host's interrupt line if the host has
+   * enabled it. Otherwise the host picks everything up on its own register
+   * accesses, and the sync timer doesn't run at all. r1stat is only written
+   * by the host.
+   */
+  struct timing_struct* p_timing = p_tube->p_host_timing;
+  uint32_t timer_id = p_tube->host_timer_id;
+  int is_running = timing_timer_is_running(p_timing, timer_id);
+
+  if (p_tube->ula.r1stat & k_tube_r1_Q) {
+    if (!is_running) {
+      p_tube->host_sync_cycles = k_tube_host_sync_cycles;
+      (void) timing_start_timer_with_value(p_timing,
+                                           timer_id,
+                                           p_tube->host_sync_cycles);
+    }
+  } else if (is_running) {
+    (void) timing_stop_timer(p_timing, timer_id);
+  }
+}
+
+uint8_t
+tube_host_read(struct tube_struct* p_tube, uint8_t reg) {
+  struct tube_ula* p_ula = &p_tube->ula;
+  uint8_t ret = 0xFE;
+  uint32_t i;
+
+  os_lock_lock(p_tube->p_lock);
+  switch (reg & 7) {
+  case 0:
+    ret = ((p_ula->hstat[0] & 0xC0) | p_ula->r1stat);
+    break;
+  case 1:
+    ret = p_ula->ph1[0];
+    if (p_ula->ph1pos > 0) {
+      for (i = 1; i < p_ula->ph1pos; ++i) {
+        p_ula->ph1[i - 1] = p_ula->ph1[i];
+      }
+      p_ula->ph1pos--;
+      p_ula->pstat[0] |= k_tube_stat_not_full;
+      if (p_ula->ph1pos == 0) {
+        p_ula->hstat[0] &= ~k_tube_stat_data;
+      }
+    }
+    break;
+  case 2:
+    ret = p_ula->hstat[1];
+    break;
+  case 3:
+    ret = p_ula->ph2;
+    if (p_ula->hstat[1] & k_tube_stat_data) {
+      p_ula->hstat[1] &= ~k_tube_stat_data;
+      p_ula->pstat[1] |= k_tube_stat_not_full;
+    }
+    break;
+  case 4:
+    ret = p_ula->hstat[2];
+    break;
+  case 5:
+    ret = p_ula->ph3[0];
+    if (p_ula->ph3pos > 0) {
+      p_ula->ph3[0] = p_ula->ph3[1];
+      p_ula->ph3pos--;
+      if (p_ula->ph3pos == 0) {
+        p_ula->hstat[2] &= ~k_tube_stat_data;
+        p_ula->pstat[2] |= k_tube_stat_not_full;
+      }
+    }
+    break;
+  case 6:
+    ret = p_ula->hstat[3];
+    break;
+  case 7:
+    ret = p_ula->ph4;
+    if (p_ula->hstat[3] & k_tube_stat_data) {
+      p_ula->hstat[3] &= ~k_tube_stat_data;
+      p_ula->pstat[3] |= k_tube_stat_not_full;
+    }
+    break;
+  default:
+    assert(0);
+    break;
+  }
+  tube_update_interrupts(p_tube);
+  os_lock_unlock(p_tube->p_lock);
+
+  tube_host_apply_irq(p_tube);
+
+  return ret;
+}
+
+void
+tube_host_write(struct tube_struct* p_tube, uint8_t reg, uint8_t val) {
+  struct tube_ula* p_ula = &p_tube->ula;
+
+  os_lock_lock(p_tube->p_lock);
+  switch (reg & 7) {
+  case 0:
+    if (val & k_tube_r1_S) {
+      p_ula->r1stat |= (val & 0x3F);
+    } else {
+      p_ula->r1stat &= ~(val & 0x3F);
+    }
+    if ((val & (k_tube_r1_S | k_tube_r1_T)) == (k_tube_r1_S | k_tube_r1_T)) {
+      tube_reset_fifos(p_tube);
+    }
+    if ((val & (k_tube_r1_S | k_tube_r1_P)) == (k_tube_r1_S | k_tube_r1_P)) {
+      /* The parasite sits in reset until P is cleared. */
+      p_tube->is_parasite_reset_pending = 1;
+    }
+    break;
+  case 1:
+    p_ula->hp1 = val;
+    p_ula->pstat[0] |= k_tube_stat_data;
+    p_ula->hstat[0] &= ~k_tube_stat_not_full;
+    break;
+  case 3:
+    p_ula->hp2 = val;
+    p_ula->pstat[1] |= k_tube_stat_data;
+    p_ula->hstat[1] &= ~k_tube_stat_not_full;
+    break;
+  case 5:
+    if (p_ula->r1stat & k_tube_r1_V) {
+      if (p_ula->hp3pos < 2) {
+        p_ula->hp3[p_ula->hp3pos++] = val;
+      }
+      if (p_ula->hp3pos == 2) {
+        p_ula->pstat[2] |= k_tube_stat_data;
+        p_ula->hstat[2] &= ~k_tube_stat_not_full;
+      }
+    } else {
+      p_ula->hp3[0] = val;
+      p_ula->hp3pos = 1;
+      p_ula->pstat[2] |= k_tube_stat_data;
+      p_ula->hstat[2] &= ~k_tube_stat_not_full;
+    }
+    break;
+  case 7:
+    p_ula->hp4 = val;
+    p_ula->pstat[3] |= k_tube_stat_data;
+    p_ula->hstat[3] &= ~k_tube_stat_not_full;
+    break;
+  default:
+    /* Writes to the other status registers do nothing. */
+    break;
+  }
+  tube_update_interrupts(p_tube);
+  os_lock_unlock(p_tube->p_lock);
+
+  tube_host_apply_irq(p_tube);
+  if ((reg & 7) == 0) {
+    tube_host_update_sync(p_tube);
+  }
+}
+
+static void
+tube_parasite_apply_interrupts(struct tube_struct* p_tube) {
+  struct state_6502* p_state_6502 = p_tube->p_state_6502;
+
+  state_6502_set_irq_level(p_state_6502,
+                           k_state_6502_irq_tube,
+                           p_tube->parasite_irq);
+  /* NMI is edge triggered so this only fires on a new assertion. */
+  state_6502_set_irq_level(p_state_6502,
+                           k_state_6502_irq_nmi,
+                           p_tube->parasite_nmi);
+}
+
+static uint8_t
+tube_parasite_read_reg(struct tube_struct* p_tube, uint8_t reg) {
+  struct tube_ula* p_ula = &p_tube->ula;
+  uint8_t ret = 0xFE;
+
+  os_lock_lock(p_tube->p_lock);
+  switch (reg & 7) {
+  case 0:
+    ret = ((p_ula->pstat[0] & 0xC0) | p_ula->r1stat);
+    break;
+  case 1:
+    ret = p_ula->hp1;
+    if (p_ula->pstat[0] & k_tube_stat_data) {
+      p_ula->pstat[0] &= ~k_tube_stat_data;
+      p_ula->hstat[0] |= k_tube_stat_not_full;
+    }
+    break;
+  case 2:
+    ret = p_ula->pstat[1];
+    break;
+  case 3:
+    ret = p_ula->hp2;
+    if (p_ula->pstat[1] & k_tube_stat_data) {
+      p_ula->pstat[1] &= ~k_tube_stat_data;
+      p_ula->hstat[1] |= k_tube_stat_not_full;
+    }
+    break;
+  case 4:
+    ret = p_ula->pstat[2];
+    break;
+  case 5:
+    ret = p_ula->hp3[0];
+    if (p_ula->hp3pos > 0) {
+      p_ula->hp3[0] = p_ula->hp3[1];
+      p_ula->hp3pos--;
+      if (p_ula->hp3pos == 0) {
+        p_ula->pstat[2] &= ~k_tube_stat_data;
+        p_ula->hstat[2] |= k_tube_stat_not_full;
+      }
+    }
+    break;
+  case 6:
+    ret = p_ula->pstat[3];
+    break;
+  case 7:
+    ret = p_ula->hp4;
+    if (p_ula->pstat[3] & k_tube_stat_data) {
+      p_ula->pstat[3] &= ~k_tube_stat_data;
+      p_ula->hstat[3] |= k_tube_stat_not_full;
+    }
+    break;
+  default:
+    assert(0);
+    break;
+  }
+  tube_update_interrupts(p_tube);
+  os_lock_unlock(p_tube->p_lock);
+
+  tube_parasite_apply_interrupts(p_tube);
+
+  /* Spinning on an empty status register means the client is waiting on the
+   * host.
+   */
+  if (!(reg & 1) && !(ret & k_tube_stat_data)) {
+    p_tube->idle_polls++;
+  } else {
+    p_tube->idle_polls = 0;
+  }
+
+  return ret;
+}
+
+static void
+tube_parasite_write_reg(struct tube_struct* p_tube, uint8_t reg, uint8_t val) {
+  struct tube_ula* p_ula = &p_tube->ula;
+
+  os_lock_lock(p_tube->p_lock);
+  switch (reg & 7) {
+  case 1:
+    if (p_ula->ph1pos < k_tube_ph1_fifo_size) {
+      p_ula->ph1[p_ula->ph1pos++] = val;
+      p_ula->hstat[0] |= k_tube_stat_data;
+      if (p_ula->ph1pos == k_tube_ph1_fifo_size) {
+        p_ula->pstat[0] &= ~k_tube_stat_not_full;
+      }
+    }
+    break;
+  case 3:
+    p_ula->ph2 = val;
+    p_ula->hstat[1] |= k_tube_stat_data;
+    p_ula->pstat[1] &= ~k_tube_stat_not_full;
+    break;
+  case 5:
+    if (p_ula->r1stat & k_tube_r1_V) {
+      if (p_ula->ph3pos < 2) {
+        p_ula->ph3[p_ula->ph3pos++] = val;
+      }
+      if (p_ula->ph3pos == 2) {
+        p_ula->hstat[2] |= k_tube_stat_data;
+        p_ula->pstat[2] &= ~k_tube_stat_not_full;
+      }
+    } else {
+      p_ula->ph3[0] = val;
+      p_ula->ph3pos = 1;
+      p_ula->hstat[2] |= k_tube_stat_data;
+      p_ula->pstat[2] &= ~k_tube_stat_not_full;
+    }
+    break;
+  case 7:
+    p_ula->ph4 = val;
+    p_ula->hstat[3] |= k_tube_stat_data;
+    p_ula->pstat[3] &= ~k_tube_stat_not_full;
+    break;
+  default:
+    break;
+  }
+  p_tube->parasite_writes++;
+  tube_update_interrupts(p_tube);
+  os_lock_unlock(p_tube->p_lock);
+
+  tube_parasite_apply_interrupts(p_tube);
+  p_tube->idle_polls = 0;
+}
+
+static int
+tube_parasite_is_always_ram(void* p, uint16_t addr) {
+  struct tube_struct* p_tube = (struct tube_struct*) p;
+  return (addr < p_tube->write_callback_from);
+}
+
+static uint16_t
+tube_parasite_read_needs_callback_from(void* p) {
+  (void) p;
+  return k_tube_parasite_regs;
+}
+
+static uint16_t
+tube_parasite_write_needs_callback_from(void* p) {
+  struct tube_struct* p_tube = (struct tube_struct*) p;
+  return p_tube->write_callback_from;
+}
+
+static int
+tube_parasite_read_needs_callback(void* p, uint16_t addr) {
+  (void) p;
+  return (addr >= k_tube_parasite_regs);
+}
+
+static int
+tube_parasite_write_needs_callback(void* p, uint16_t addr) {
+  struct tube_struct* p_tube = (struct tube_struct*) p;
+  return (addr >= p_tube->write_callback_from);
+}
+
+static uint8_t
+tube_parasite_read_callback(void* p,
+                            uint16_t addr,
+                            uint16_t pc,
+                            int do_last_tick_callback) {
+  struct tube_struct* p_tube = (struct tube_struct*) p;
+
+  (void) pc;
+
+  if (do_last_tick_callback) {
+    p_tube->memory_access.memory_client_last_tick_callback(
+        p_tube->memory_access.p_last_tick_callback_obj);
+  }
+
+  if ((addr & ~7) != k_tube_parasite_regs) {
+    return p_tube->p_mem[addr];
+  }
+
+  /* The client ROM pages itself out on the first Tube register access. */
+  if (p_tube->is_rom_paged_in) {
+    tube_page_out_rom(p_tube);
+  }
+
+  return tube_parasite_read_reg(p_tube, (addr & 7));
+}
+
+static int
+tube_parasite_write_callback(void* p,
+                             uint16_t addr,
+                             uint8_t val,
+                             uint16_t pc,
+                             int do_last_tick_callback) {
+  struct tube_struct* p_tube = (struct tube_struct*) p;
+
+  (void) pc;
+
+  if (do_last_tick_callback) {
+    p_tube->memory_access.memory_client_last_tick_callback(
+        p_tube->memory_access.p_last_tick_callback_obj);
+  }
+
+  if ((addr & ~7) == k_tube_parasite_regs) {
+    tube_parasite_write_reg(p_tube, (addr & 7), val);
+  } else if (p_tube->is_rom_paged_in && (addr >= p_tube->rom_base)) {
+    p_tube->shadow[addr - p_tube->rom_base] = val;
+  } else {
+    p_tube->p_mem[addr] = val;
+  }
+
+  return 0;
+}
+
+static void
+tube_parasite_do_reset_callback(void* p, uint32_t flags) {
+  struct tube_struct* p_tube = (struct tube_struct*) p;
+  struct cpu_driver* p_cpu_driver = p_tube->p_cpu_driver;
+
+  (void) flags;
+
+  while (!p_tube->is_exiting) {
+    int is_held;
+    os_lock_lock(p_tube->p_lock);
+    is_held = !!(p_tube->ula.r1stat & k_tube_r1_P);
+    if (!is_held) {
+      p_tube->is_parasite_reset_pending = 0;
+    }
+    os_lock_unlock(p_tube->p_lock);
+    if (!is_held) {
+      break;
+    }
+    os_time_sleeper_sleep_us(p_tube->p_sleeper, k_tube_idle_sleep_us);
+  }
+
+  tube_page_in_rom(p_tube);
+  state_6502_set_irq_level(p_tube->p_state_6502, k_state_6502_irq_tube, 0);
+  state_6502_set_irq_level(p_tube->p_state_6502, k_state_6502_irq_nmi, 0);
+  state_6502_reset(p_tube->p_state_6502);
+  p_tube->idle_polls = 0;
+
+  p_cpu_driver->p_funcs->apply_flags(
+      p_cpu_driver,
+      0,
+      (k_cpu_flag_soft_reset | k_cpu_flag_hard_reset));
+}
+
+static void
+tube_parasite_timer_callback(void* p) {
+  struct tube_struct* p_tube = (struct tube_struct*) p;
+  struct cpu_driver* p_cpu_driver = p_tube->p_cpu_driver;
+
+  (void) timing_adjust_timer_value(p_tube->p_timing,
+                                   NULL,
+                                   p_tube->timer_id,
+                                   k_tube_parasite_sync_cycles);
+
+  if (p_tube->is_exiting) {
+    p_cpu_driver->p_funcs->apply_flags(p_cpu_driver, k_cpu_flag_exited, 0);
+    return;
+  }
+  if (p_tube->is_parasite_reset_pending) {
+    p_cpu_driver->p_funcs->apply_flags(p_cpu_driver, k_cpu_flag_soft_reset, 0);
+    return;
+  }
+
+  tube_parasite_apply_interrupts(p_tube);
+
+  /* Don't burn a host core while the client waits on the host. */
+  if (p_tube->idle_polls >= k_tube_idle_polls) {
+    os_time_sleeper_sleep_us(p_tube->p_sleeper, k_tube_idle_sleep_us);
+  }
+}
+
+static void*
+tube_parasite_thread(void* p) {
+  struct tube_struct* p_tube = (struct tube_struct*) p;
+  struct cpu_driver* p_cpu_driver = p_tube->p_cpu_driver;
+  int exited;
+
+  exited = p_cpu_driver->p_funcs->enter(p_cpu_driver);
+  (void) exited;
+  assert(exited == 1);
+
+  return NULL;
+}
+
+struct tube_struct*
+tube_create(struct timing_struct* p_host_timing,
+            struct state_6502* p_host_state_6502,
+            uint8_t* p_rom,
+            uint32_t rom_len,
+            struct bbc_options* p_options) {
+  struct memory_access* p_memory_access;
+  struct tube_struct* p_tube = util_mallocz(sizeof(struct tube_struct));
+
+  if ((rom_len == 0) || (rom_len > k_tube_max_rom_size)) {
+    util_bail("tube client ROM must be 1 to %d bytes", k_tube_max_rom_size);
+  }
+
+  p_tube->p_host_timing = p_host_timing;
+  p_tube->p_host_state_6502 = p_host_state_6502;
+  p_tube->p_lock = os_lock_create();
+  p_tube->p_sleeper = os_time_create_sleeper();
+
+  (void) memcpy(&p_tube->rom[0], p_rom, rom_len);
+  p_tube->rom_len = rom_len;
+  p_tube->rom_base = (0x10000 - rom_len);
+  p_tube->write_callback_from = p_tube->rom_base;
+  if (p_tube->write_callback_from > k_tube_parasite_regs) {
+    p_tube->write_callback_from = k_tube_parasite_regs;
+  }
+
+  p_tube->p_mem = util_mallocz(0x10000);
+  tube_page_in_rom(p_tube);
+
+  p_memory_access = &p_tube->memory_access;
+  p_memory_access->p_mem_read = p_tube->p_mem;
+  p_memory_access->p_mem_write = p_tube->p_mem;
+  p_memory_access->p_callback_obj = p_tube;
+  p_memory_access->memory_is_always_ram = tube_parasite_is_always_ram;
+  p_memory_access->memory_read_needs_callback_from =
+      tube_parasite_read_needs_callback_from;
+  p_memory_access->memory_write_needs_callback_from =
+      tube_parasite_write_needs_callback_from;
+  p_memory_access->memory_read_needs_callback =
+      tube_parasite_read_needs_callback;
+  p_memory_access->memory_write_needs_callback =
+      tube_parasite_write_needs_callback;
+  p_memory_access->memory_read_callback = tube_parasite_read_callback;
+  p_memory_access->memory_write_callback = tube_parasite_write_callback;
+
+  /* The JIT and inturbo drivers own fixed host mappings for the BBC itself,
+   * so the second processor is always interpreted. It's a 65C02.
+   */
+  p_tube->options = *p_options;
+  p_tube->options.debug_callback = NULL;
+  p_tube->options.p_debug_object = NULL;
+  p_tube->p_timing = timing_create(1);
+  p_tube->p_state_6502 = state_6502_create(p_tube->p_timing, p_tube->p_mem);
+  p_tube->p_cpu_driver = cpu_driver_alloc(k_cpu_mode_interp,
+                                          1,
+                                          p_tube->p_state_6502,
+                                          p_memory_access,
+                                          p_tube->p_timing,
+                                          &p_tube->options);
+  cpu_driver_init(p_tube->p_cpu_driver);
+  p_tube->p_cpu_driver->p_funcs->set_reset_callback(
+      p_tube->p_cpu_driver,
+      tube_parasite_do_reset_callback,
+      p_tube);
+
+  p_tube->timer_id = timing_register_timer(p_tube->p_timing,
+                                           "tube_parasite_sync",
+                                           tube_parasite_timer_callback,
+                                           p_tube);
+  (void) timing_start_timer_with_value(p_tube->p_timing,
+                                       p_tube->timer_id,
+                                       k_tube_parasite_sync_cycles);
+
+  p_tube->host_timer_id = timing_register_timer(p_host_timing,
+                                                "tube_host_sync",
+                                                tube_host_timer_callback,
+                                                p_tube);
+
+  tube_reset_fifos(p_tube);
+  tube_update_interrupts(p_tube);
+  state_6502_reset(p_tube->p_state_6502);
+
+  p_tube->p_thread = os_thread_create(tube_parasite_thread, p_tube);
+
+  log_do_log(k_log_misc,
+             k_log_info,
+             "tube: 65C02 second processor, %d byte client ROM",
+             (int) rom_len);
+
+  return p_tube;
+}
+
+void
+tube_destroy(struct tube_struct* p_tube) {
+  struct cpu_driver* p_cpu_driver = p_tube->p_cpu_driver;
+
+  p_tube->is_exiting = 1;
+  (void) os_thread_destroy(p_tube->p_thread);
+
+  p_cpu_driver->p_funcs->destroy(p_cpu_driver);
+  state_6502_destroy(p_tube->p_state_6502);
+  timing_destroy(p_tube->p_timing);
+  os_time_free_sleeper(p_tube->p_sleeper);
+  os_lock_destroy(p_tube->p_lock);
+  util_free(p_tube->p_mem);
+  util_free(p_tube);
+}
+
+void
+tube_reset(struct tube_struct* p_tube) {
+  os_lock_lock(p_tube->p_lock);
+  p_tube->ula.r1stat = 0;
+  tube_reset_fifos(p_tube);
+  tube_update_interrupts(p_tube);
+  p_tube->is_parasite_reset_pending = 1;
+  os_lock_unlock(p_tube->p_lock);
+
+  tube_host_apply_irq(p_tube);
+  tube_host_update_sync(p_tube);
+}
+
+#include "test-tube.c"
@@ -0,0 +1,29 @@
+#ifndef BEEBJIT_TUBE_H
+#define BEEBJIT_TUBE_H
+
+#include <stdint.h>
+
+struct tube_struct;
+
+struct bbc_options;
+struct state_6502;
+struct timing_struct;
+
+/* A Tube ULA plus a 6502 second processor running the given client ROM.
+ * The second processor runs flat out on its own host thread. The two sides
+ * only meet at the Tube FIFOs and interrupt lines.
+ */
+struct tube_struct* tube_create(struct timing_struct* p_host_timing,
+                                struct state_6502* p_host_state_6502,
+                                uint8_t* p_rom,
+                                uint32_t rom_len,
+                                struct bbc_options* p_options);
+void tube_destroy(struct tube_struct* p_tube);
+
+/* Resets the ULA and the second processor. */
+void tube_reset(struct tube_struct* p_tube);
+
+uint8_t tube_host_read(struct tube_struct* p_tube, uint8_t reg);
+void tube_host_write(struct tube_struct* p_tube, uint8_t reg, uint8_t val);
+
+#endif /* BEEBJIT_TUBE_H */
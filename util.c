@@ -317,6 +317,7 @@ util_file_name_split(char** p_file_name_base,
   if (p_sep == NULL) {
     *p_file_name_base = NULL;
     *p_file_name = strdup(p_full_file_name);
+    return;
   }
 
   len = (p_sep - p_full_file_name);
@@ -342,6 +343,15 @@ util_file_name_join(const char* p_file_name_base, const char* p_file_name) {
   return strdup(&file_name_buf[0]);
 }
 
+/* Either a stdio file or a read-only view of a memory buffer. */
+struct util_file {
+  FILE* p_file;
+  uint8_t* p_mem;
+  uint64_t mem_size;
+  uint64_t mem_pos;
+  int is_mem_owned;
+};
+
 struct util_file*
 util_file_open(const char* p_file_name, int writeable, int create) {
   struct util_file* p_file = util_file_try_open(p_file_name, writeable, create);
@@ -353,7 +363,8 @@ util_file_open(const char* p_file_name, int writeable, int create) {
 
 struct util_file*
 util_file_try_open(const char* p_file_name, int writeable, int create) {
-  FILE* p_file;
+  FILE* p_stdio_file;
+  struct util_file* p_file;
 
   /* Need the "b" aka. "binary" for Windows. */
   const char* p_flags = "rb";
@@ -366,46 +377,79 @@ util_file_try_open(const char* p_file_name, int writeable, int create) {
     }
   }
 
-  p_file = fopen(p_file_name, p_flags);
+  p_stdio_file = fopen(p_file_name, p_flags);
+  if (p_stdio_file == NULL) {
+    return NULL;
+  }
+  p_file = util_mallocz(sizeof(struct util_file));
+  p_file->p_file = p_stdio_file;
 
-  return (struct util_file*) p_file;
+  return p_file;
 }
 
 struct util_file*
 util_file_try_read_open(const char* p_file_name) {
-  FILE* p_file = fopen(p_file_name, "rb");
-  return (struct util_file*) p_file;
+  return util_file_try_open(p_file_name, 0, 0);
+}
+
+struct util_file*
+util_file_open_memory(uint8_t* p_buf, uint64_t size, int is_owned) {
+  struct util_file* p_file = util_mallocz(sizeof(struct util_file));
+
+  p_file->p_mem = p_buf;
+  p_file->mem_size = size;
+  p_file->is_mem_owned = is_owned;
+
+  return p_file;
+}
+
+uint8_t*
+util_file_get_memory(struct util_file* p_file, uint64_t* p_size) {
+  *p_size = p_file->mem_size;
+  return p_file->p_mem;
 }
 
 void
-util_file_close(struct util_file* p) {
-  int ret = fclose((FILE*) p);
-  if (ret != 0) {
-    util_bail("close failed");
+util_file_close(struct util_file* p_file) {
+  if (p_file->p_file != NULL) {
+    int ret = fclose(p_file->p_file);
+    if (ret != 0) {
+      util_bail("close failed");
+    }
+  }
+  if (p_file->is_mem_owned) {
+    util_free(p_file->p_mem);
   }
+  util_free(p_file);
 }
 
 uint64_t
-util_file_get_pos(struct util_file* p) {
-  FILE* p_file = (FILE*) p;
+util_file_get_pos(struct util_file* p_file) {
+  if (p_file->p_file == NULL) {
+    return p_file->mem_pos;
+  }
 
-  return ftell(p_file);
+  return ftell(p_file->p_file);
 }
 
 uint64_t
-util_file_get_size(struct util_file* p) {
+util_file_get_size(struct util_file* p_file) {
   int ret;
   uint64_t pos;
-  FILE* p_file = (FILE*) p;
 
-  ret = fseek(p_file, 0, SEEK_END);
+  if (p_file->p_file == NULL) {
+    p_file->mem_pos = 0;
+    return p_file->mem_size;
+  }
+
+  ret = fseek(p_file->p_file, 0, SEEK_END);
   if (ret != 0) {
     util_bail("fseek SEEK_END failed");
   }
 
-  pos = ftell(p_file);
+  pos = ftell(p_file->p_file);
 
-  ret = fseek(p_file, 0, SEEK_SET);
+  ret = fseek(p_file->p_file, 0, SEEK_SET);
   if (ret != 0) {
     util_bail("fseek SEEK_SET failed");
   }
@@ -414,37 +458,62 @@ util_file_get_size(struct util_file* p) {
 }
 
 uint64_t
-util_file_read(struct util_file* p, void* p_buf, uint64_t length) {
-  FILE* p_file = (FILE*) p;
+util_file_read(struct util_file* p_file, void* p_buf, uint64_t length) {
+  if (p_file->p_file == NULL) {
+    uint64_t left = 0;
+    if (p_file->mem_pos < p_file->mem_size) {
+      left = (p_file->mem_size - p_file->mem_pos);
+    }
+    if (length > left) {
+      length = left;
+    }
+    (void) memcpy(p_buf, (p_file->p_mem + p_file->mem_pos), length);
+    p_file->mem_pos += length;
+    return length;
+  }
 
-  return fread(p_buf, 1, length, p_file);
+  return fread(p_buf, 1, length, p_file->p_file);
 }
 
 void
-util_file_write(struct util_file* p, const void* p_buf, uint64_t length) {
-  FILE* p_file = (FILE*) p;
-  uint64_t ret = fwrite(p_buf, 1, length, p_file);
+util_file_write(struct util_file* p_file, const void* p_buf, uint64_t length) {
+  uint64_t ret;
+
+  if (p_file->p_file == NULL) {
+    util_bail("write to memory file");
+  }
+  ret = fwrite(p_buf, 1, length, p_file->p_file);
   if (ret != length) {
     util_bail("fwrite short write");
   }
 }
 
 void
-util_file_seek(struct util_file* p, uint64_t pos) {
+util_file_seek(struct util_file* p_file, uint64_t pos) {
   int ret;
-  FILE* p_file = (FILE*) p;
 
-  ret = fseek(p_file, pos, SEEK_SET);
+  if (p_file->p_file == NULL) {
+    /* As with fseek(), seeking past the end is fine and reads there return
+     * nothing.
+     */
+    p_file->mem_pos = pos;
+    return;
+  }
+
+  ret = fseek(p_file->p_file, pos, SEEK_SET);
   if (ret != 0) {
     util_bail("fseek SEEK_SET failed");
   }
 }
 
 void
-util_file_flush(struct util_file* p) {
-  FILE* p_file = (FILE*) p;
+util_file_flush(struct util_file* p_file) {
+  int ret;
 
-  int ret = fflush(p_file);
+  if (p_file->p_file == NULL) {
+    return;
+  }
+  ret = fflush(p_file->p_file);
   if (ret != 0) {
     util_bail("fflush failed");
   }
@@ -705,6 +774,20 @@ util_read_le32(uint8_t* p_buf) {
   return ret;
 }
 
+void
+util_write_le16(uint8_t* p_buf, uint16_t val) {
+  p_buf[0] = (val & 0xFF);
+  p_buf[1] = (val >> 8);
+}
+
+void
+util_write_le32(uint8_t* p_buf, uint32_t val) {
+  p_buf[0] = (val & 0xFF);
+  p_buf[1] = ((val >> 8) & 0xFF);
+  p_buf[2] = ((val >> 16) & 0xFF);
+  p_buf[3] = (val >> 24);
+}
+
 uint32_t
 util_crc32_init() {
   return 0xFFFFFFFF;
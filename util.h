@@ -69,6 +69,12 @@ struct util_file* util_file_try_open(const char* p_file_name,
                                      int writeable,
                                      int create);
 struct util_file* util_file_try_read_open(const char* p_file_name);
+/* A read-only file over a memory buffer, freed on close if is_owned. */
+struct util_file* util_file_open_memory(uint8_t* p_buf,
+                                        uint64_t size,
+                                        int is_owned);
+/* Returns NULL for a file that isn't over a memory buffer. */
+uint8_t* util_file_get_memory(struct util_file* p_file, uint64_t* p_size);
 void util_file_close(struct util_file* p_file);
 uint64_t util_file_get_pos(struct util_file* p_file);
 uint64_t util_file_get_size(struct util_file* p_file);
@@ -112,6 +118,8 @@ uint16_t util_read_be16(uint8_t* p_buf);
 uint32_t util_read_be32(uint8_t* p_buf);
 uint16_t util_read_le16(uint8_t* p_buf);
 uint32_t util_read_le32(uint8_t* p_buf);
+void util_write_le16(uint8_t* p_buf, uint16_t val);
+void util_write_le32(uint8_t* p_buf, uint32_t val);
 uint32_t util_crc32_init();
 uint32_t util_crc32_add(uint32_t crc, uint8_t* p_buf, uint32_t len);
 uint32_t util_crc32_finish(uint32_t crc);
@@ -1,12 +1,26 @@
-#define MINIZ_NO_ARCHIVE_APIS
+#define MINIZ_NO_ARCHIVE_WRITING_APIS
 #define MINIZ_NO_STDIO
 
+/* miniz's zip reader has an unused parameter in NDEBUG builds. */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
 #include "miniz.c"
+#pragma GCC diagnostic pop
 
 #include "util_compress.h"
 
+#include "log.h"
+#include "util.h"
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdio.h>
 #include <string.h>
 
+enum {
+  k_util_compress_max_size = (256 * 1024 * 1024),
+};
+
 static int
 util_gunzip_chunk(size_t* p_dst_len,
                   size_t* p_src_consumed,
@@ -63,10 +77,6 @@ util_gunzip_chunk(size_t* p_dst_len,
 
   status = inflate(&stream, Z_FINISH);
 
-  if (status != Z_STREAM_END) {
-    return -2;
-  }
-
   *p_dst_len = (dst_len - stream.avail_out);
   src_left -= stream.total_in;
   *p_src_consumed = (src_len - src_left);
@@ -74,6 +84,13 @@ util_gunzip_chunk(size_t* p_dst_len,
   if (inflateEnd(&stream) != Z_OK) {
     return -3;
   }
+  if (status != Z_STREAM_END) {
+    /* Running out of output space isn't the data's fault. */
+    if ((status == Z_BUF_ERROR) && (*p_dst_len == dst_len)) {
+      return k_util_gunzip_dst_full;
+    }
+    return -2;
+  }
 
   return 0;
 }
@@ -132,3 +149,288 @@ util_uncompress(size_t* p_dst_len,
 
   return 0;
 }
+
+size_t
+util_compress_bound(size_t src_len) {
+  return compressBound(src_len);
+}
+
+int
+util_compress(size_t* p_dst_len,
+              const uint8_t* p_src,
+              size_t src_len,
+              uint8_t* p_dst,
+              int level) {
+  mz_ulong dst_len = *p_dst_len;
+  int ret = compress2(p_dst, &dst_len, p_src, src_len, level);
+
+  if (ret != Z_OK) {
+    return -1;
+  }
+
+  *p_dst_len = dst_len;
+
+  return 0;
+}
+
+static int
+util_compress_find_zip(const char* p_file_name,
+                       size_t* p_archive_len,
+                       const char** p_p_member_name) {
+  const char* p_str = p_file_name;
+
+  /* The archive name ends at the first ".zip" followed by a separator or the
+   * end of the name.
+   */
+  while ((p_str = strchr(p_str, '.')) != NULL) {
+    if ((tolower(p_str[1]) == 'z') &&
+        (tolower(p_str[2]) == 'i') &&
+        (tolower(p_str[3]) == 'p')) {
+      char c = p_str[4];
+      if ((c == '\0') || (c == '/') || (c == '\\')) {
+        *p_archive_len = ((p_str + 4) - p_file_name);
+        *p_p_member_name = ((c == '\0') ? NULL : (p_str + 5));
+        return 1;
+      }
+    }
+    p_str++;
+  }
+
+  return 0;
+}
+
+static int
+util_compress_has_extension(const char* p_file_name,
+                            const char** p_extensions) {
+  while (*p_extensions != NULL) {
+    if (util_is_extension(p_file_name, *p_extensions)) {
+      return 1;
+    }
+    p_extensions++;
+  }
+  return 0;
+}
+
+static size_t
+util_compress_zip_read(void* p,
+                       mz_uint64 file_ofs,
+                       void* p_buf,
+                       size_t n) {
+  struct util_file* p_file = (struct util_file*) p;
+
+  util_file_seek(p_file, file_ofs);
+  return util_file_read(p_file, p_buf, n);
+}
+
+/* Only the central directory is read to find the member. Returns the member's
+ * index in the open archive.
+ */
+static mz_uint
+util_compress_zip_open(mz_zip_archive* p_zip,
+                       struct util_file** p_p_file,
+                       const char* p_file_name,
+                       const char** p_extensions) {
+  size_t archive_len;
+  const char* p_member_name;
+  char archive_name[4096];
+  struct util_file* p_file;
+  mz_uint num_files;
+  mz_uint i;
+  int index;
+
+  (void) util_compress_find_zip(p_file_name, &archive_len, &p_member_name);
+  if (archive_len >= sizeof(archive_name)) {
+    util_bail("zip name too long");
+  }
+  (void) memcpy(archive_name, p_file_name, archive_len);
+  archive_name[archive_len] = '\0';
+
+  p_file = util_file_open(archive_name, 0, 0);
+  mz_zip_zero_struct(p_zip);
+  p_zip->m_pRead = util_compress_zip_read;
+  p_zip->m_pIO_opaque = p_file;
+  if (!mz_zip_reader_init(p_zip, util_file_get_size(p_file), 0)) {
+    util_bail("couldn't read zip %s", archive_name);
+  }
+  *p_p_file = p_file;
+
+  if (p_member_name != NULL) {
+    index = mz_zip_reader_locate_file(p_zip, p_member_name, NULL, 0);
+    if (index < 0) {
+      util_bail("no %s in zip %s", p_member_name, archive_name);
+    }
+    return index;
+  }
+
+  num_files = mz_zip_reader_get_num_files(p_zip);
+  for (i = 0; i < num_files; ++i) {
+    mz_zip_archive_file_stat stat;
+    if (mz_zip_reader_is_file_a_directory(p_zip, i)) {
+      continue;
+    }
+    if (!mz_zip_reader_file_stat(p_zip, i, &stat)) {
+      continue;
+    }
+    if (util_compress_has_extension(stat.m_filename, p_extensions)) {
+      return i;
+    }
+  }
+  util_bail("no usable file in zip %s", archive_name);
+  return 0;
+}
+
+static void
+util_compress_zip_close(mz_zip_archive* p_zip, struct util_file* p_file) {
+  (void) mz_zip_reader_end(p_zip);
+  util_file_close(p_file);
+}
+
+int
+util_compress_is_compressed_name(const char* p_file_name) {
+  size_t archive_len;
+  const char* p_member_name;
+
+  if (util_is_extension(p_file_name, "gz")) {
+    return 1;
+  }
+  return util_compress_find_zip(p_file_name, &archive_len, &p_member_name);
+}
+
+char*
+util_compress_get_plain_name(const char* p_file_name,
+                             const char** p_extensions) {
+  size_t archive_len;
+  const char* p_member_name;
+  mz_zip_archive zip;
+  mz_zip_archive_file_stat stat;
+  struct util_file* p_file;
+  mz_uint index;
+  size_t dir_len;
+  const char* p_name;
+  char name_buf[4096];
+
+  if (util_is_extension(p_file_name, "gz")) {
+    (void) snprintf(name_buf,
+                    sizeof(name_buf),
+                    "%.*s",
+                    (int) (strlen(p_file_name) - 3),
+                    p_file_name);
+    return util_strdup(name_buf);
+  }
+  if (!util_compress_find_zip(p_file_name, &archive_len, &p_member_name)) {
+    return util_strdup(p_file_name);
+  }
+
+  index = util_compress_zip_open(&zip, &p_file, p_file_name, p_extensions);
+  if (!mz_zip_reader_file_stat(&zip, index, &stat)) {
+    util_bail("couldn't stat zip member");
+  }
+  util_compress_zip_close(&zip, p_file);
+
+  /* A zip member is named as if it sat next to the archive, minus any
+   * directories inside the archive.
+   */
+  p_name = strrchr(stat.m_filename, '/');
+  if (p_name == NULL) {
+    p_name = &stat.m_filename[0];
+  } else {
+    p_name++;
+  }
+  dir_len = archive_len;
+  while ((dir_len > 0) &&
+         (p_file_name[dir_len - 1] != '/') &&
+         (p_file_name[dir_len - 1] != '\\')) {
+    dir_len--;
+  }
+  (void) snprintf(name_buf,
+                  sizeof(name_buf),
+                  "%.*s%s",
+                  (int) dir_len,
+                  p_file_name,
+                  p_name);
+
+  return util_strdup(name_buf);
+}
+
+struct util_file*
+util_compress_open(const char* p_file_name, const char** p_extensions) {
+  size_t archive_len;
+  const char* p_member_name;
+  uint8_t* p_buf;
+  size_t size;
+
+  if (util_compress_find_zip(p_file_name, &archive_len, &p_member_name)) {
+    mz_zip_archive zip;
+    mz_zip_archive_file_stat stat;
+    struct util_file* p_file;
+    mz_uint index = util_compress_zip_open(&zip,
+                                           &p_file,
+                                           p_file_name,
+                                           p_extensions);
+    if (!mz_zip_reader_file_stat(&zip, index, &stat)) {
+      util_bail("couldn't stat zip member");
+    }
+    if (stat.m_uncomp_size > k_util_compress_max_size) {
+      util_bail("zip member %s too large", stat.m_filename);
+    }
+    size = stat.m_uncomp_size;
+    p_buf = util_malloc(size + 1);
+    if (!mz_zip_reader_extract_to_mem(&zip, index, p_buf, size, 0)) {
+      util_bail("couldn't extract %s from zip", stat.m_filename);
+    }
+    log_do_log(k_log_misc,
+               k_log_info,
+               "unzipped %s, %"PRIu64" bytes",
+               stat.m_filename,
+               (uint64_t) size);
+    util_compress_zip_close(&zip, p_file);
+  } else {
+    struct util_file* p_file = util_file_open(p_file_name, 0, 0);
+    uint64_t src_len = util_file_get_size(p_file);
+    uint8_t* p_src;
+    size_t alloc;
+
+    if (src_len > k_util_compress_max_size) {
+      util_bail("gzip file %s too large", p_file_name);
+    }
+    p_src = util_malloc(src_len + 1);
+    if (util_file_read(p_file, p_src, src_len) != src_len) {
+      util_bail("gzip file %s short read", p_file_name);
+    }
+    util_file_close(p_file);
+
+    /* The trailer has the uncompressed size, of the last member anyway. Grow
+     * and retry only if the output didn't fit, such as for concatenated
+     * members. Corrupt data fails straight away.
+     */
+    alloc = 0;
+    if (src_len >= 4) {
+      alloc = util_read_le32(&p_src[src_len - 4]);
+    }
+    if (alloc == 0) {
+      alloc = 1;
+    }
+    p_buf = NULL;
+    while (1) {
+      int ret;
+      p_buf = util_realloc(p_buf, alloc);
+      size = alloc;
+      ret = util_gunzip(&size, p_src, src_len, p_buf);
+      if (ret == 0) {
+        break;
+      }
+      if (ret != k_util_gunzip_dst_full) {
+        util_bail("gunzip failed: %s", p_file_name);
+      }
+      if (alloc >= k_util_compress_max_size) {
+        util_bail("gunzip of %s too large", p_file_name);
+      }
+      alloc *= 2;
+    }
+    util_free(p_src);
+  }
+
+  return util_file_open_memory(p_buf, size, 1);
+}
+
+#include "test-util_compress.c"
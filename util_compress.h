@@ -1,6 +1,13 @@
 #ifndef BEEBJIT_UTIL_COMPRESS_H
 #define BEEBJIT_UTIL_COMPRESS_H
 
+enum {
+  k_util_gunzip_dst_full = -4,
+};
+
+/* Returns 0, or k_util_gunzip_dst_full if the output didn't fit, or another
+ * non-zero value for corrupt or unsupported data.
+ */
 int util_gunzip(size_t* p_dst_len,
                 uint8_t* p_src,
                 size_t src_len,
@@ -11,4 +18,31 @@ int util_uncompress(size_t* p_dst_len,
                     size_t src_len,
                     uint8_t* p_dst);
 
+/* zlib format, the inverse of util_uncompress(). Level 1 is the fastest. The
+ * destination should hold util_compress_bound() bytes.
+ */
+size_t util_compress_bound(size_t src_len);
+int util_compress(size_t* p_dst_len,
+                  const uint8_t* p_src,
+                  size_t src_len,
+                  uint8_t* p_dst,
+                  int level);
+
+/* Compressed images. A name ending ".gz" is gunzipped. A name of the form
+ * "archive.zip/member" is that member of the zip, and a bare "archive.zip" is
+ * its first member with one of the NULL terminated extensions. Only the
+ * chosen member is read and decompressed.
+ */
+struct util_file;
+
+int util_compress_is_compressed_name(const char* p_file_name);
+/* The name the file has once decompressed, for picking its format or naming
+ * derived files.
+ */
+char* util_compress_get_plain_name(const char* p_file_name,
+                                   const char** p_extensions);
+/* Returns a read-only in-memory file. */
+struct util_file* util_compress_open(const char* p_file_name,
+                                     const char** p_extensions);
+
 #endif /* BEEBJIT_UTIL_COMPRESS_H */
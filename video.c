@@ -111,6 +111,7 @@ struct video_struct {
   /* Options. */
   uint32_t frames_skip;
   uint32_t frame_skip_counter;
+  int opt_is_frames_skip_no_render;
   int opt_is_always_clear_frame_buffer;
   int opt_is_show_frame_boundaries;
   int opt_is_hack_legacy_quest_cap;
@@ -353,13 +354,19 @@ video_check_go_inactive(struct video_struct* p_video) {
   if (p_video->opt_is_always_render) {
     return;
   }
+  if (p_video->has_paint_timer_triggered) {
+    return;
+  }
 
   /* If we're in fast mode, give rendering and painting a rest after each
    * paint.
    * We'll get prodded to start again by the 50Hz real time tick, which will
    * get noticed in video_timer_fired().
+   * The same applies if the upcoming frames are only going to be skipped.
    */
-  if (!*p_video->p_fast_flag || p_video->has_paint_timer_triggered) {
+  if (!*p_video->p_fast_flag &&
+      !(p_video->opt_is_frames_skip_no_render &&
+        (p_video->frame_skip_counter > 0))) {
     return;
   }
 
@@ -409,6 +416,17 @@ video_check_go_active(struct video_struct* p_video) {
     return;
   }
 
+  /* If the frame would be rendered only to have its paint skipped, don't
+   * bother. Rendering stays inactive and the CRTC just runs its timing, which
+   * is much faster.
+   */
+  if (p_video->opt_is_frames_skip_no_render &&
+      (p_video->frame_skip_counter > 0)) {
+    p_video->frame_skip_counter--;
+    p_video->is_wall_time_vsync_hit = 0;
+    return;
+  }
+
   /* If rendering is inactive, make it active again if we've hit a wall time
    * vsync. If fast mode persists, it'll go inactive immediately after the
    * next paint at the next vsync raise.
@@ -1442,6 +1460,8 @@ video_create(uint8_t* p_bbc_mem,
   (void) util_get_u32_option(&p_video->frames_skip,
                              p_options->p_opt_flags,
                              "video:frames-skip=");
+  p_video->opt_is_frames_skip_no_render = util_has_option(
+      p_options->p_opt_flags, "video:frames-skip-no-render");
   p_video->paint_start_cycles = 0;
   (void) util_get_u64_option(&p_video->paint_start_cycles,
                              p_options->p_opt_flags,
@@ -1691,6 +1711,11 @@ video_power_on_reset(struct video_struct* p_video) {
   }
 }
 
+uint32_t
+video_get_us_per_vsync(void) {
+  return k_video_us_per_vsync;
+}
+
 uint64_t
 video_get_num_vsyncs(struct video_struct* p_video) {
   return p_video->num_vsyncs;
@@ -42,6 +42,8 @@ void video_shadow_mode_updated(struct video_struct* p_video,
 void video_power_on_reset(struct video_struct* p_video);
 
 uint64_t video_get_num_vsyncs(struct video_struct* p_video);
+/* The vsync period of a standard PAL CRTC setup. */
+uint32_t video_get_us_per_vsync(void);
 uint64_t video_get_num_crtc_advances(struct video_struct* p_video);
 struct render_struct* video_get_render(struct video_struct* p_video);
 
@@ -165,6 +165,16 @@ wd_fdc_clear_state(struct wd_fdc_struct* p_fdc) {
   p_fdc->index_pulse_count = 0;
 }
 
+static void
+wd_fdc_set_pulses_wanted(struct wd_fdc_struct* p_fdc, int wanted) {
+  if (p_fdc->p_drive_0 != NULL) {
+    disc_drive_set_pulses_wanted(p_fdc->p_drive_0, wanted);
+  }
+  if (p_fdc->p_drive_1 != NULL) {
+    disc_drive_set_pulses_wanted(p_fdc->p_drive_1, wanted);
+  }
+}
+
 static void
 wd_fdc_update_nmi(struct wd_fdc_struct* p_fdc) {
   struct state_6502* p_state_6502 = p_fdc->p_state_6502;
@@ -905,6 +915,12 @@ wd_fdc_write(struct wd_fdc_struct* p_fdc, uint16_t addr, uint8_t val) {
     assert(0);
     break;
   }
+
+  /* A register write may start a command or change what the type I status
+   * bits should show, so take the next byte. The pulses callback decides from
+   * there.
+   */
+  wd_fdc_set_pulses_wanted(p_fdc, 1);
 }
 
 static void
@@ -1152,9 +1168,44 @@ wd_fdc_mark_detector_triggered(struct wd_fdc_struct* p_fdc) {
 }
 
 static void
-wd_fdc_bit_received(struct wd_fdc_struct* p_fdc, int bit) {
-  uint32_t data_shifter;
+wd_fdc_data_shifter_full(struct wd_fdc_struct* p_fdc) {
+  uint32_t data_shifter = p_fdc->data_shifter;
+
+  if (wd_fdc_is_double_density(p_fdc->control_register)) {
+    p_fdc->deliver_data = ibm_disc_format_2us_pulses_to_mfm(data_shifter);
+  } else {
+    uint8_t unused_clocks;
+    int is_iffy_pulse;
+    ibm_disc_format_2us_pulses_to_fm(&unused_clocks,
+                                     &p_fdc->deliver_data,
+                                     &is_iffy_pulse,
+                                     data_shifter);
+    /* If we're reading MFM as FM, the pulses won't all fall on 4us
+     * boundaries. This is fuzzy bits. We'll return a non-stable read.
+     */
+    if (is_iffy_pulse) {
+      struct disc_drive_struct* p_current_drive = p_fdc->p_current_drive;
+      data_shifter = disc_drive_get_quasi_random_pulses(p_current_drive);
+      ibm_disc_format_2us_pulses_to_fm(&unused_clocks,
+                                       &p_fdc->deliver_data,
+                                       &is_iffy_pulse,
+                                       data_shifter);
+    }
+  }
+  p_fdc->data_shifter = 0;
+  p_fdc->data_shift_count = 0;
+}
 
+static uint32_t
+wd_fdc_get_data_shift_length(struct wd_fdc_struct* p_fdc) {
+  if (wd_fdc_is_double_density(p_fdc->control_register)) {
+    return 16;
+  }
+  return 32;
+}
+
+static void
+wd_fdc_bit_received(struct wd_fdc_struct* p_fdc, int bit) {
   /* Always run the mark detector. For a command like "read track", the 1770
    * will re-sync in the middle of the command as appropriate.
    */
@@ -1167,39 +1218,119 @@ wd_fdc_bit_received(struct wd_fdc_struct* p_fdc, int bit) {
     return;
   }
 
-  data_shifter = p_fdc->data_shifter;
-  data_shifter <<= 1;
-  data_shifter |= bit;
-  p_fdc->data_shifter = data_shifter;
+  p_fdc->data_shifter <<= 1;
+  p_fdc->data_shifter |= bit;
   p_fdc->data_shift_count++;
 
+  if (p_fdc->data_shift_count == wd_fdc_get_data_shift_length(p_fdc)) {
+    wd_fdc_data_shifter_full(p_fdc);
+  }
+}
+
+static uint64_t
+wd_fdc_get_mark_stream(uint64_t mark_detector,
+                       uint32_t pulses,
+                       uint32_t pulses_count,
+                       uint32_t offset) {
+  /* The mark detector bits from offset upwards, as they will have been at
+   * some point while the pulses are shifted in. The lowest bit is the most
+   * recent.
+   */
+  if (offset >= pulses_count) {
+    return (mark_detector >> (offset - pulses_count));
+  }
+  return ((mark_detector << (pulses_count - offset)) | (pulses >> offset));
+}
+
+static int
+wd_fdc_has_pattern(uint64_t stream, uint32_t positions, uint16_t pattern) {
+  /* Checks all bit positions at once for the 16-bit pattern starting there. */
+  uint32_t i;
+  uint64_t match = ((1ull << positions) - 1);
+
+  for (i = 0; i < 16; ++i) {
+    uint64_t bits = (stream >> i);
+    if (!(pattern & (1 << i))) {
+      bits = ~bits;
+    }
+    match &= bits;
+  }
+
+  return (match != 0);
+}
+
+static int
+wd_fdc_bitstream_may_mark(struct wd_fdc_struct* p_fdc,
+                          uint32_t pulses,
+                          uint32_t pulses_count) {
+  /* Cheap pre-check of the mark detector for every bit of the incoming
+   * pulses. Anything that could trigger, or tag a marker, is left to the bit
+   * by bit path.
+   */
+  uint64_t mark_detector = p_fdc->mark_detector;
+
   if (wd_fdc_is_double_density(p_fdc->control_register)) {
-    if (p_fdc->data_shift_count == 16) {
-      p_fdc->deliver_data = ibm_disc_format_2us_pulses_to_mfm(data_shifter);
-      p_fdc->data_shifter = 0;
-      p_fdc->data_shift_count = 0;
+    return (wd_fdc_has_pattern(wd_fdc_get_mark_stream(mark_detector,
+                                                      pulses,
+                                                      pulses_count,
+                                                      0),
+                               pulses_count,
+                               0x4489) ||
+            wd_fdc_has_pattern(wd_fdc_get_mark_stream(mark_detector,
+                                                      pulses,
+                                                      pulses_count,
+                                                      16),
+                               pulses_count,
+                               0x4489));
+  }
+  return wd_fdc_has_pattern(wd_fdc_get_mark_stream(mark_detector,
+                                                   pulses,
+                                                   pulses_count,
+                                                   32),
+                            pulses_count,
+                            0x8888);
+}
+
+static void
+wd_fdc_shift_pulses(struct wd_fdc_struct* p_fdc,
+                    uint32_t pulses,
+                    uint32_t pulses_count) {
+  uint32_t i;
+  uint32_t shift_length = wd_fdc_get_data_shift_length(p_fdc);
+
+  if (pulses_count < 32) {
+    pulses &= ((1u << pulses_count) - 1);
+  }
+  if ((p_fdc->data_shift_count < shift_length) &&
+      !wd_fdc_bitstream_may_mark(p_fdc, pulses, pulses_count)) {
+    /* No mark detector activity, so the pulses can go into the data shifter
+     * in at most two chunks, either side of a completed byte.
+     */
+    uint32_t take = (shift_length - p_fdc->data_shift_count);
+    uint64_t data_shifter = p_fdc->data_shifter;
+
+    p_fdc->mark_detector <<= pulses_count;
+    p_fdc->mark_detector |= pulses;
+
+    if (take > pulses_count) {
+      take = pulses_count;
+    }
+    pulses_count -= take;
+    data_shifter <<= take;
+    data_shifter |= ((pulses >> pulses_count) & ((1ull << take) - 1));
+    p_fdc->data_shifter = (uint32_t) data_shifter;
+    p_fdc->data_shift_count += take;
+    if (p_fdc->data_shift_count == shift_length) {
+      wd_fdc_data_shifter_full(p_fdc);
+      p_fdc->data_shifter = (pulses & ((1ull << pulses_count) - 1));
+      p_fdc->data_shift_count = pulses_count;
     }
   } else {
-    if (p_fdc->data_shift_count == 32) {
-      uint8_t unused_clocks;
-      int is_iffy_pulse;
-      ibm_disc_format_2us_pulses_to_fm(&unused_clocks,
-                                       &p_fdc->deliver_data,
-                                       &is_iffy_pulse,
-                                       data_shifter);
-      /* If we're reading MFM as FM, the pulses won't all fall on 4us
-       * boundaries. This is fuzzy bits. We'll return a non-stable read.
-       */
-      if (is_iffy_pulse) {
-        struct disc_drive_struct* p_current_drive = p_fdc->p_current_drive;
-        data_shifter = disc_drive_get_quasi_random_pulses(p_current_drive);
-        ibm_disc_format_2us_pulses_to_fm(&unused_clocks,
-                                         &p_fdc->deliver_data,
-                                         &is_iffy_pulse,
-                                         data_shifter);
-      }
-      p_fdc->data_shifter = 0;
-      p_fdc->data_shift_count = 0;
+    pulses <<= (32 - pulses_count);
+    for (i = 0; i < pulses_count; ++i) {
+      int bit = !!(pulses & 0x80000000);
+      wd_fdc_bit_received(p_fdc, bit);
+      pulses <<= 1;
     }
   }
 }
@@ -1209,15 +1340,7 @@ wd_fdc_bitstream_received(struct wd_fdc_struct* p_fdc,
                           uint32_t pulses,
                           uint32_t pulses_count,
                           int is_index_pulse_positive_edge) {
-  uint32_t i;
-
-  pulses <<= (32 - pulses_count);
-
-  for (i = 0; i < pulses_count; ++i) {
-    int bit = !!(pulses & 0x80000000);
-    wd_fdc_bit_received(p_fdc, bit);
-    pulses <<= 1;
-  }
+  wd_fdc_shift_pulses(p_fdc, pulses, pulses_count);
   wd_fdc_byte_received(p_fdc, is_index_pulse_positive_edge);
 }
 
@@ -1576,6 +1699,13 @@ wd_fdc_pulses_callback(void* p, uint32_t pulses, uint32_t count) {
   if (is_index_pulse_positive_edge) {
     p_fdc->index_pulse_count++;
   }
+
+  /* When idle, only index pulse edges matter, plus the byte that acts on the
+   * final index pulse before motor off.
+   */
+  wd_fdc_set_pulses_wanted(p_fdc,
+                           ((p_fdc->state != k_wd_fdc_state_idle) ||
+                            (p_fdc->index_pulse_count == 10)));
 }
 
 void
@@ -1595,3 +1725,5 @@ void
 wd_fdc_set_is_opus(struct wd_fdc_struct* p_fdc, int is_opus) {
   p_fdc->is_opus = is_opus;
 }
+
+#include "test-wd_fdc.c"